@@ -26,6 +26,7 @@
 static void SystemClock_Config(void);
 static void CPU_CACHE_Enable(void);
 static void MPU_Config(void);
+static void bsp_InitBkpSram(void);
 
 
 /*
@@ -69,6 +70,15 @@ void bsp_Init(void)
 	EventRecorderStart();
 #endif
 
+	bsp_InitDWT();		/* ʼDWTʱڼڲִʱ */
+
+	bsp_InitBkpSram();	/* ʹܱ SRAM, .BkpSramSection λ󱣳 (net_boot.c  DHCP Լ) */
+
+	bsp_InitExtSDRAM();	/* ʼⲿSDRAM, .SdramSection  lwIP 󴰿ڴ(TCP_PROFILE_BULK)  SDRAM  */
+
+	bsp_InitQSPI_W25Q256();	/* ʼQSPI Flash, ڴӳģʽ, httpd ҳļ (fs_qspi.c)  QSPI_MMAP_ADDR ֱӶȡ */
+	QSPI_MemoryMapped();
+
 	bsp_InitUart();		/* ʼ */
 
 	bsp_InitLed();    	/* ʼLED */	
@@ -231,7 +241,7 @@ static void MPU_Config( void )
      for ETH DMA descriptors */
   MPU_InitStruct.Enable = MPU_REGION_ENABLE;
   MPU_InitStruct.BaseAddress = 0x30040000;
-  MPU_InitStruct.Size = MPU_REGION_SIZE_256B;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_4KB;
   MPU_InitStruct.AccessPermission = MPU_REGION_FULL_ACCESS;
   MPU_InitStruct.IsBufferable = MPU_ACCESS_BUFFERABLE;
   MPU_InitStruct.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
@@ -259,10 +269,104 @@ static void MPU_Config( void )
 
   HAL_MPU_ConfigRegion(&MPU_InitStruct);
 
+  /* Configure the MPU attributes as Normal cacheable write back, write allocate
+     for the FMC SDRAM (the default memory map makes it Device memory) */
+  MPU_InitStruct.Enable = MPU_REGION_ENABLE;
+  MPU_InitStruct.BaseAddress = 0xC0000000;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_32MB;
+  MPU_InitStruct.AccessPermission = MPU_REGION_FULL_ACCESS;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_BUFFERABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_CACHEABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+  MPU_InitStruct.Number = MPU_REGION_NUMBER2;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL1;
+  MPU_InitStruct.SubRegionDisable = 0x00;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_ENABLE;
+
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+
+#if ETH_RX_BUFFER_NONCACHEABLE
+  /* Configure the MPU attributes as Normal not cacheable 
+     for ETH Rx buffers, no D-Cache maintenance is then needed */
+  MPU_InitStruct.Enable = MPU_REGION_ENABLE;
+#if ETH_RX_BUFFER_IN_SDRAM
+  MPU_InitStruct.BaseAddress = 0xC0000000;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_256KB;
+#else
+  MPU_InitStruct.BaseAddress = 0x30000000;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_256KB;
+#endif
+  MPU_InitStruct.AccessPermission = MPU_REGION_FULL_ACCESS;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+  MPU_InitStruct.Number = MPU_REGION_NUMBER3; /* above the SDRAM region */
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL1;
+  MPU_InitStruct.SubRegionDisable = 0x00;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_ENABLE;
+
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+#endif
+
+  /* Configure the MPU attributes as Normal cacheable write through, read only
+     for the memory-mapped QSPI Flash (httpd files read in place by the CPU and
+     the ETH DMA), no D-Cache maintenance is needed */
+  MPU_InitStruct.Enable = MPU_REGION_ENABLE;
+  MPU_InitStruct.BaseAddress = QSPI_MMAP_ADDR;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_32MB;
+  MPU_InitStruct.AccessPermission = MPU_REGION_PRIV_RO_URO;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_CACHEABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+  MPU_InitStruct.Number = MPU_REGION_NUMBER4;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL0;
+  MPU_InitStruct.SubRegionDisable = 0x00;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+
+  /* Configure the MPU attributes as Normal not cacheable for the backup SRAM
+     (net_boot.c lease), a write reaches it at once and survives a reset */
+  MPU_InitStruct.Enable = MPU_REGION_ENABLE;
+  MPU_InitStruct.BaseAddress = 0x38800000;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_4KB;
+  MPU_InitStruct.AccessPermission = MPU_REGION_FULL_ACCESS;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+  MPU_InitStruct.Number = MPU_REGION_NUMBER5;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL1;
+  MPU_InitStruct.SubRegionDisable = 0x00;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+
   /* Enable the MPU */
   HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
 }
 
+/*
+*********************************************************************************************************
+*	  : bsp_InitBkpSram
+*	˵: ʹܱ SRAM (0x38800000, 4KB) ʱӺд, 򿪱ѹ, ϵ VBAT 
+*	    : 
+*	  ֵ: 
+*********************************************************************************************************
+*/
+static void bsp_InitBkpSram(void)
+{
+	uint32_t timeout = 100000;
+
+	/* дʹ */
+	SET_BIT(PWR->CR1, PWR_CR1_DBP);
+
+	__HAL_RCC_BKPRAM_CLK_ENABLE();
+
+	/* ѹ, û VBAT ʱֻڸλ󱣳 */
+	SET_BIT(PWR->CR2, PWR_CR2_BREN);
+	while(((PWR->CR2 & PWR_CR2_BRRDY) == 0) && (--timeout != 0)) {}
+}
+
 /*
 *********************************************************************************************************
 *	  : CPU_CACHE_Enable
@@ -71,6 +71,7 @@
 //#include "bsp_msg.h"
 //#include "bsp_user_lib.h"
 #include "bsp_timer.h"
+#include "bsp_dwt.h"
 #include "bsp_led.h"
 #include "bsp_key.h"
 
@@ -91,7 +92,8 @@
 //#include "bsp_spi_tm7705.h"
 //#include "bsp_spi_vs1053b.h"
 
-//#include "bsp_fmc_sdram.h"
+#include "bsp_fmc_sdram.h"
+#include "bsp_qspi_w25q256.h"
 //#include "bsp_fmc_nand_flash.h"
 //#include "bsp_fmc_ad7606.h"
 //#include "bsp_fmc_oled.h"
@@ -16,15 +16,18 @@
 /* W25Q256JVϢ */
 #define QSPI_FLASH_SIZE     25                      /* FlashС2^25 = 32MB*/
 #define QSPI_SECTOR_SIZE    (4 * 1024)              /* С4KB */
+#define QSPI_BLOCK_SIZE     (64 * 1024)             /* С64KB */
 #define QSPI_PAGE_SIZE      256        				/* ҳС256ֽ */
 #define QSPI_END_ADDR    	(1 << QSPI_FLASH_SIZE)  /* ĩβַ */
 #define QSPI_FLASH_SIZES    32*1024*1024            /* FlashС2^25 = 32MB*/
+#define QSPI_MMAP_ADDR      0x90000000              /* ڴӳģʽʼַ */
 
 /* W25Q256JV */
 #define WRITE_ENABLE_CMD      0x06         /* дʹָ */  
 #define READ_ID_CMD2          0x9F         /* ȡID */  
 #define READ_STATUS_REG_CMD   0x05         /* ȡ״̬ */ 
 #define SUBSECTOR_ERASE_4_BYTE_ADDR_CMD      0x21    /* 32bitַָ, 4KB */
+#define BLOCK_ERASE_4_BYTE_ADDR_CMD          0xDC    /* 32bitַָ, 64KB */
 #define QUAD_IN_FAST_PROG_4_BYTE_ADDR_CMD    0x34    /* 32bitַ4߿д */
 #define QUAD_INOUT_FAST_READ_4_BYTE_ADDR_CMD 0xEC    /* 32bitַ4߿ٶȡ */
 
@@ -139,9 +142,12 @@
 
 void bsp_InitQSPI_W25Q256(void);
 void QSPI_EraseSector(uint32_t address);
+void QSPI_EraseBlock(uint32_t address);
 uint8_t QSPI_WriteBuffer(uint8_t *_pBuf, uint32_t _uiWriteAddr, uint16_t _usWriteSize);
 void QSPI_ReadBuffer(uint8_t * _pBuf, uint32_t _uiReadAddr, uint32_t _uiSize);
 uint32_t QSPI_ReadID(void);
+void QSPI_MemoryMapped(void);
+void QSPI_MemoryMappedExit(void);
 	
 #endif
 
@@ -301,6 +301,55 @@ void QSPI_EraseSector(uint32_t address)
 	StatusMatch = 0;
 }
 
+/*
+*********************************************************************************************************
+*	  : QSPI_EraseBlock
+*	˵: ָĿ飬С64KBÿֽڵĲʱԶС 16 
+*	    : address : ַ64KBΪλĵַ065536, 131072ȣ
+*	  ֵ: 
+*********************************************************************************************************
+*/
+void QSPI_EraseBlock(uint32_t address)
+{
+	QSPI_CommandTypeDef sCommand={0};
+
+	/* ɱ־ */	
+	CmdCplt = 0;
+
+	/* дʹ */
+	QSPI_WriteEnable(&QSPIHandle);	
+
+	/*  */
+	sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;    /* 1߷ʽָ */
+	sCommand.AddressSize       = QSPI_ADDRESS_32_BITS;       /* 32λַ */
+	sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;  /* ޽ֽ */
+	sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;      /* W25Q256JV֧DDR */
+	sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;  /* DDRģʽӳ */
+	sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;	 /* ÿδ䶼ָ */	
+	
+	/*  */
+	sCommand.Instruction = BLOCK_ERASE_4_BYTE_ADDR_CMD;   /* 32bitַʽĿС64KB*/       
+	sCommand.AddressMode = QSPI_ADDRESS_1_LINE;  /* ַ1߷ʽ */       
+	sCommand.Address     = address;              /* ׵ַ֤64KB */    
+	sCommand.DataMode    = QSPI_DATA_NONE;       /* 跢 */  
+	sCommand.DummyCycles = 0;                    /*  */  
+
+	if (HAL_QSPI_Command_IT(&QSPIHandle, &sCommand) != HAL_OK)
+	{
+		Error_Handler(__FILE__, __LINE__);
+	}
+	
+	/* ȴ */
+	while(CmdCplt == 0);
+	CmdCplt = 0;
+	
+	/* ȴ */
+	StatusMatch = 0;
+	QSPI_AutoPollingMemReady(&QSPIHandle);	
+	while(StatusMatch == 0);
+	StatusMatch = 0;
+}
+
 /*
 *********************************************************************************************************
 *	  : QSPI_WriteBuffer
@@ -411,6 +460,61 @@ void QSPI_ReadBuffer(uint8_t * _pBuf, uint32_t _uiReadAddr, uint32_t _uiSize)
 	RxCplt = 0;
 }
 
+/*
+*********************************************************************************************************
+*	  : QSPI_MemoryMapped
+*	˵: ڴӳģʽ, Flash ӳ䵽 QSPI_MMAP_ADDR, CPU  DMA (̫) ֱӶȡ.
+*	          4߿ٶȡ 0xEC, ȡطָ. ӳڼ䲻ܵò, д MDMA .
+*	    : 
+*	  ֵ: 
+*********************************************************************************************************
+*/
+void QSPI_MemoryMapped(void)
+{
+	QSPI_CommandTypeDef sCommand = {0};
+	QSPI_MemoryMappedTypeDef sMemMappedCfg = {0};
+
+	/*  */
+	sCommand.InstructionMode   = QSPI_INSTRUCTION_1_LINE;    	/* 1߷ʽָ */
+	sCommand.AddressSize       = QSPI_ADDRESS_32_BITS;      	/* 32λַ */
+	sCommand.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;  	/* ޽ֽ */
+	sCommand.DdrMode           = QSPI_DDR_MODE_DISABLE;      	/* W25Q256JV֧DDR */
+	sCommand.DdrHoldHalfCycle  = QSPI_DDR_HHC_ANALOG_DELAY;  	/* DDRģʽӳ */
+	sCommand.SIOOMode          = QSPI_SIOO_INST_EVERY_CMD;		/* ÿδҪָ */
+
+	/* ȡ,  QSPI_ReadBuffer ͬ */
+	sCommand.Instruction = QUAD_INOUT_FAST_READ_4_BYTE_ADDR_CMD; /* 32bitַ4߿ٶȡ */
+	sCommand.DummyCycles = 6;                    /*  */
+	sCommand.AddressMode = QSPI_ADDRESS_4_LINES; /* 4ߵַ */
+	sCommand.DataMode    = QSPI_DATA_4_LINES;    /* 4 */
+
+	/* ƬѡһֱЧ, ˳ȡʱط͵ַ */
+	sMemMappedCfg.TimeOutActivation = QSPI_TIMEOUT_COUNTER_DISABLE;
+	sMemMappedCfg.TimeOutPeriod     = 0;
+
+	if (HAL_QSPI_MemoryMapped(&QSPIHandle, &sCommand, &sMemMappedCfg) != HAL_OK)
+	{
+		Error_Handler(__FILE__, __LINE__);
+	}
+}
+
+/*
+*********************************************************************************************************
+*	  : QSPI_MemoryMappedExit
+*	˵: ˳ڴӳģʽ, ֮Եò, дͶ. ǰҪ֤û CPU  DMA
+*	          (̫) ڶȡӳ, дٴӳʱҪӳ D-Cache.
+*	    : 
+*	  ֵ: 
+*********************************************************************************************************
+*/
+void QSPI_MemoryMappedExit(void)
+{
+	if (HAL_QSPI_Abort(&QSPIHandle) != HAL_OK)
+	{
+		Error_Handler(__FILE__, __LINE__);
+	}
+}
+
 /*
 *********************************************************************************************************
 *	  : QSPI_WriteEnable
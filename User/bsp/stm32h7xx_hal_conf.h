@@ -171,8 +171,11 @@
 /* #define  USE_SD_TRANSCEIVER           1U   */            /*!< use uSD Transceiver */
 
 /* ########################### Ethernet Configuration ######################### */
-#define ETH_TX_DESC_CNT         4  /* number of Ethernet Tx DMA descriptors */
-#define ETH_RX_DESC_CNT         4  /* number of Ethernet Rx DMA descriptors */
+#define ETH_TX_DESC_CNT         8  /* number of Ethernet Tx DMA descriptors, up to 32 */
+#define ETH_RX_DESC_CNT         16 /* number of Ethernet Rx DMA descriptors, 16..64, 64 for TCP_PROFILE_BULK (lwipopts.h) */
+#define ETH_RX_BUFFER_CNT       (ETH_RX_DESC_CNT * 2) /* Rx buffers, ring + spares, ETH_RX_DESC_CNT..2*ETH_RX_DESC_CNT */
+#define ETH_RX_BUFFER_IN_SDRAM  0  /* 1: Rx buffers in FMC SDRAM, 0: in D2 SRAM1/SRAM2 */
+#define ETH_RX_BUFFER_NONCACHEABLE 0 /* 1: Rx buffers in a non-cacheable MPU region, 0: cacheable, invalidated per frame */
 
 #define ETH_MAC_ADDR0    ((uint8_t)0x02)
 #define ETH_MAC_ADDR1    ((uint8_t)0x00)
@@ -0,0 +1,696 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : frame_codec
+*	文件名称 : frame_codec.c
+*	版    本 : V1.0
+*	说    明 : Message framing for the TCP links, see the frame layout in frame_codec.h.
+*
+*              Decoder: frame_dec_feed() takes over the received pbuf chain and appends it to the
+*              bytes it holds, one pbuf at a time. Complete frames are checked in place (the CRC
+*              walks the chain) and passed to the callback as chain + offset, the application reads
+*              them with frame_msg_data() (a copy only when the payload spans pbufs) or
+*              pbuf_copy_partial(). Decoded bytes are dropped with pbuf_free_header(), so the
+*              receive buffers go back to the driver as soon as their frames are done; a partial
+*              frame stays in its pbufs by reference until the rest arrives. A corrupted header
+*              holds the frames behind it until its length has arrived, then resync skips it.
+*
+*              Encoder: frame_alloc() reserves FRAME_HDR_LEN bytes of headroom in front of the
+*              payload, frame_enc() writes the header there; a payload without headroom
+*              (PBUF_REF / PBUF_ROM) gets a small header pbuf chained in front. The payload is
+*              never copied.
+*
+*              frame_codec_test() feeds random streams with corrupted frames and garbage in random
+*              pieces and checks that exactly the intact frames come out, then measures decode and
+*              encode, in DWT cycles on the target and in ns on the host build (NETIF_HOST).
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年05月06日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "frame_codec.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "frame_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#include "lwip/def.h"
+#include "fs_qspi.h"
+#include <string.h>
+
+#if FRAME_CODEC_TEST
+#if defined(NETIF_HOST)
+#include <time.h>
+#else
+#include "stm32h7xx_hal.h"
+#include "bsp_dwt.h"
+#endif
+#endif
+
+#define FRAME_GET16(b)                ( (u16_t)( ( (b)[0] << 8 ) | (b)[1] ) )
+#define FRAME_GET32(b)                ( ( (u32_t)(b)[0] << 24 ) | ( (u32_t)(b)[1] << 16 ) | ( (u32_t)(b)[2] << 8 ) | (b)[3] )
+
+/* CRC-32 of len bytes of the chain from offset off, chained on crc */
+static u32_t frame_crc_chain( u32_t crc, const struct pbuf *p, u16_t off, u16_t len )
+{
+  u16_t n;
+
+  for( ; p != NULL && len > 0; p = p->next )
+  {
+    if( off >= p->len )
+    {
+      off -= p->len;
+      continue;
+    }
+    n = LWIP_MIN( (u16_t)( p->len - off ), len );
+    crc = fs_qspi_crc32( crc, (const u8_t *)p->payload + off, n );
+    len -= n;
+    off = 0;
+  }
+
+  return crc;
+}
+
+/* offset of the first sync byte in the chain, tot_len if there is none */
+static u16_t frame_sync_find( const struct pbuf *p )
+{
+  const u8_t *s;
+  u16_t off = 0;
+
+  for( ; p != NULL; p = p->next )
+  {
+    s = (const u8_t *)memchr( p->payload, FRAME_SYNC, p->len );
+    if( s != NULL )
+    {
+      return (u16_t)( off + ( s - (const u8_t *)p->payload ) );
+    }
+    off += p->len;
+  }
+
+  return off;
+}
+
+/* pass every complete frame held to the callback, drop the bytes that cannot start one */
+static void frame_dec_process( struct frame_dec *dec )
+{
+  struct frame_msg msg;
+  u8_t hdr[FRAME_HDR_LEN];
+  u16_t skip, len;
+
+  while( dec->held != NULL )
+  {
+    skip = frame_sync_find( dec->held );
+    if( skip == 0 )
+    {
+      if( dec->held->tot_len < FRAME_HDR_LEN )
+      {
+        break;
+      }
+      pbuf_copy_partial( dec->held, hdr, FRAME_HDR_LEN, 0 );
+      len = FRAME_GET16( &hdr[2] );
+
+      if( len <= FRAME_MAX_PAYLOAD )
+      {
+        if( dec->held->tot_len < FRAME_HDR_LEN + len )
+        {
+          break;      /* wait for the rest */
+        }
+        if( frame_crc_chain( fs_qspi_crc32( 0, &hdr[1], 3 ), dec->held, FRAME_HDR_LEN, len ) == FRAME_GET32( &hdr[4] ) )
+        {
+          msg.type = hdr[1];
+          msg.len  = len;
+          msg.p    = dec->held;
+          msg.off  = FRAME_HDR_LEN;
+          dec->stats.frames++;
+          dec->stats.bytes += len;
+          dec->msg( dec->arg, &msg );
+
+          dec->held = pbuf_free_header( dec->held, FRAME_HDR_LEN + len );
+          continue;
+        }
+        dec->stats.crc_err++;
+      }
+      else
+      {
+        dec->stats.bad_len++;
+      }
+      /* not a frame: resync after this sync byte */
+      skip = 1;
+    }
+
+    dec->stats.skipped += skip;
+    dec->held = pbuf_free_header( dec->held, skip );
+  }
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: frame_dec_init
+*	功能说明: initialise a decoder
+*	形    参: dec  the decoder
+*             msg  called for every frame decoded, in the task calling frame_dec_feed()
+*             arg  passed to msg
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void frame_dec_init( struct frame_dec *dec, frame_msg_fn msg, void *arg )
+{
+  memset( dec, 0, sizeof( *dec ) );
+  dec->msg = msg;
+  dec->arg = arg;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: frame_dec_feed
+*	功能说明: decode received data. The frames completed by it are passed to the callback before
+*             the function returns, a partial frame is kept by reference.
+*	形    参: dec  the decoder
+*             p    received chain, the decoder takes it over (and frees it)
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void frame_dec_feed( struct frame_dec *dec, struct pbuf *p )
+{
+  struct pbuf *next;
+
+  while( p != NULL )
+  {
+    /* one pbuf at a time: the held chain stays within a frame and a pbuf whatever is passed */
+    next = p->next;
+    if( next != NULL )
+    {
+      pbuf_ref( next );
+      pbuf_dechain( p );
+    }
+
+    if( dec->held == NULL )
+    {
+      dec->held = p;
+    }
+    else
+    {
+      pbuf_cat( dec->held, p );
+    }
+
+    frame_dec_process( dec );
+
+    if( dec->held != NULL && dec->held->tot_len > dec->stats.held_max )
+    {
+      dec->stats.held_max = dec->held->tot_len;
+    }
+    p = next;
+  }
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: frame_dec_reset
+*	功能说明: drop the partial frame held, e.g. when the connection is lost. The statistics stay.
+*	形    参: dec  the decoder
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void frame_dec_reset( struct frame_dec *dec )
+{
+  if( dec->held != NULL )
+  {
+    pbuf_free( dec->held );
+    dec->held = NULL;
+  }
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: frame_msg_data
+*	功能说明: contiguous view of the payload of a frame: in place when it lies in one pbuf,
+*             otherwise copied into scratch
+*	形    参: msg      the frame, in the callback
+*             scratch  msg->len bytes
+*	返 回 值: the payload
+*********************************************************************************************************
+*/
+const void *frame_msg_data( const struct frame_msg *msg, void *scratch )
+{
+  if( msg->len == 0 )
+  {
+    return scratch;
+  }
+
+  return pbuf_get_contiguous( msg->p, scratch, msg->len, msg->len, msg->off );
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: frame_hdr_fill
+*	功能说明: build the header of a frame whose payload is len bytes of a chain from offset off,
+*             e.g. to send a received payload by netvectors
+*	形    参: hdr   FRAME_HDR_LEN bytes, outside the payload
+*             type  frame type
+*             p     chain holding the payload
+*             off   offset of the payload in p
+*             len   payload bytes, up to FRAME_MAX_PAYLOAD
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void frame_hdr_fill( u8_t *hdr, u8_t type, const struct pbuf *p, u16_t off, u16_t len )
+{
+  u32_t crc;
+
+  hdr[0] = FRAME_SYNC;
+  hdr[1] = type;
+  hdr[2] = (u8_t)( len >> 8 );
+  hdr[3] = (u8_t)len;
+
+  crc = frame_crc_chain( fs_qspi_crc32( 0, &hdr[1], 3 ), p, off, len );
+  hdr[4] = (u8_t)( crc >> 24 );
+  hdr[5] = (u8_t)( crc >> 16 );
+  hdr[6] = (u8_t)( crc >> 8 );
+  hdr[7] = (u8_t)crc;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: frame_alloc
+*	功能说明: allocate the payload of a frame with room for the frame and transport headers
+*	形    参: len  payload bytes
+*	返 回 值: PBUF_RAM pbuf, NULL when out of memory
+*********************************************************************************************************
+*/
+struct pbuf *frame_alloc( u16_t len )
+{
+  if( len > FRAME_MAX_PAYLOAD )
+  {
+    return NULL;
+  }
+
+  return pbuf_alloc( (pbuf_layer)( PBUF_TRANSPORT + FRAME_HDR_LEN ), len, PBUF_RAM );
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: frame_enc
+*	功能说明: turn a payload into a frame: the header goes into the headroom of p, without
+*             headroom into a header pbuf chained in front of p
+*	形    参: type  frame type
+*             p     the payload (whole chain), e.g. from frame_alloc()
+*	返 回 值: the frame, p or the header pbuf holding p; NULL (p unchanged, still the caller's)
+*             when p is too long or out of memory
+*********************************************************************************************************
+*/
+struct pbuf *frame_enc( u8_t type, struct pbuf *p )
+{
+  struct pbuf *h;
+  u16_t len = p->tot_len;
+
+  if( len > FRAME_MAX_PAYLOAD )
+  {
+    return NULL;
+  }
+
+  if( pbuf_add_header( p, FRAME_HDR_LEN ) == 0 )
+  {
+    frame_hdr_fill( (u8_t *)p->payload, type, p, FRAME_HDR_LEN, len );
+    return p;
+  }
+
+  h = pbuf_alloc( PBUF_TRANSPORT, FRAME_HDR_LEN, PBUF_RAM );
+  if( h == NULL )
+  {
+    return NULL;
+  }
+  frame_hdr_fill( (u8_t *)h->payload, type, p, 0, len );
+  pbuf_cat( h, p );
+
+  return h;
+}
+
+#if FRAME_CODEC_TEST
+
+#define FRAME_TEST_STREAM_SIZE        6144
+#define FRAME_TEST_FRAMES             128     /* intact frames of a round, at most */
+#define FRAME_TEST_LEN_MAX            600     /* payload of the random frames */
+#define FRAME_TEST_PIECE_MAX          512     /* the stream is fed in pieces of 1..512 bytes */
+#define FRAME_TEST_PBUFS              64
+#define FRAME_TEST_BENCH_LEN          256     /* payload of the measured frames */
+#define FRAME_TEST_BENCH_LOOPS        10
+
+#if defined(NETIF_HOST)
+#define FRAME_TEST_UNIT               "ns"
+#else
+#define FRAME_TEST_UNIT               "cycles"
+#endif
+
+/* zero-copy pieces of the stream, like the Ethernet receive buffers */
+typedef struct
+{
+  struct pbuf_custom pc;
+  u8_t               used;
+} frame_test_pbuf_t;
+
+static frame_test_pbuf_t FrameTestPbuf[FRAME_TEST_PBUFS];
+static u8_t  FrameTestStream[FRAME_TEST_STREAM_SIZE];
+static u8_t  FrameTestZero[FRAME_TEST_PIECE_MAX];
+static u8_t  FrameTestScratch[FRAME_TEST_LEN_MAX];
+static u16_t FrameTestExpect[FRAME_TEST_FRAMES];    /* offsets of the intact frames */
+static u16_t FrameTestExpectCnt;
+static u16_t FrameTestNext;
+static int   FrameTestErrors;
+static u32_t FrameTestSeed = 0x2545F491;
+
+static u32_t frame_test_rand( void )
+{
+  FrameTestSeed ^= FrameTestSeed << 13;
+  FrameTestSeed ^= FrameTestSeed >> 17;
+  FrameTestSeed ^= FrameTestSeed << 5;
+  return FrameTestSeed;
+}
+
+static u32_t frame_test_time( void )
+{
+#if defined(NETIF_HOST)
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (u32_t)( ts.tv_sec * 1000000000UL + ts.tv_nsec );
+#else
+  return DWT_CYCCNT;
+#endif
+}
+
+static void frame_test_pbuf_free( struct pbuf *p )
+{
+  ( (frame_test_pbuf_t *)p )->used = 0;
+}
+
+static struct pbuf *frame_test_piece( u8_t *data, u16_t len )
+{
+  int i;
+
+  for( i = 0; i < FRAME_TEST_PBUFS; i++ )
+  {
+    if( !FrameTestPbuf[i].used )
+    {
+      FrameTestPbuf[i].used = 1;
+      FrameTestPbuf[i].pc.custom_free_function = frame_test_pbuf_free;
+      return pbuf_alloced_custom( PBUF_RAW, len, PBUF_REF, &FrameTestPbuf[i].pc, data, len );
+    }
+  }
+
+  return NULL;
+}
+
+/* feed len bytes in chains of 1..3 pieces, of random size or of 'piece' bytes */
+static void frame_test_feed( struct frame_dec *dec, u8_t *data, u32_t len, u16_t piece )
+{
+  struct pbuf *head, *p;
+  u32_t n;
+  int k;
+
+  while( len > 0 )
+  {
+    head = NULL;
+    for( k = 1 + frame_test_rand() % 3; k > 0 && len > 0; k-- )
+    {
+      n = piece;
+      if( n == 0 )
+      {
+        n = ( frame_test_rand() % 4 == 0 ) ? 1 + frame_test_rand() % 16 : 64 + frame_test_rand() % ( FRAME_TEST_PIECE_MAX - 64 );
+      }
+      n = LWIP_MIN( n, len );
+
+      p = frame_test_piece( data, (u16_t)n );
+      if( p == NULL )
+      {
+        log_e("frame test: out of test pbufs");
+        FrameTestErrors++;
+        return;
+      }
+      if( head == NULL )
+      {
+        head = p;
+      }
+      else
+      {
+        pbuf_cat( head, p );
+      }
+      data += n;
+      len -= n;
+    }
+    frame_dec_feed( dec, head );
+  }
+}
+
+/* check a decoded frame against the next intact frame of the stream */
+static void frame_test_msg( void *arg, const struct frame_msg *msg )
+{
+  const u8_t *frame, *data;
+
+  LWIP_UNUSED_ARG(arg);
+
+  if( FrameTestNext >= FrameTestExpectCnt )
+  {
+    log_e("frame test: unexpected frame, type %u len %u", msg->type, msg->len);
+    FrameTestErrors++;
+    return;
+  }
+
+  frame = &FrameTestStream[FrameTestExpect[FrameTestNext++]];
+  data = (const u8_t *)frame_msg_data( msg, FrameTestScratch );
+  if( msg->type != frame[1] || msg->len != FRAME_GET16( &frame[2] ) || data == NULL ||
+      memcmp( data, &frame[FRAME_HDR_LEN], msg->len ) != 0 )
+  {
+    log_e("frame test: frame %u wrong, type %u len %u", (unsigned)( FrameTestNext - 1 ), msg->type, msg->len);
+    FrameTestErrors++;
+  }
+}
+
+static void frame_test_count( void *arg, const struct frame_msg *msg )
+{
+  LWIP_UNUSED_ARG(msg);
+
+  ( *(u32_t *)arg )++;
+}
+
+/* encode a frame of len random bytes (type 'type') at pos, with or without headroom */
+static int frame_test_encode( u16_t pos, u8_t type, u16_t len, u8_t headroom )
+{
+  struct pbuf *p, *f;
+  u16_t i;
+
+  for( i = 0; i < len; i++ )
+  {
+    FrameTestStream[pos + FRAME_HDR_LEN + i] = (u8_t)frame_test_rand();
+  }
+
+  if( headroom )
+  {
+    p = frame_alloc( len );
+    if( p != NULL )
+    {
+      pbuf_take( p, &FrameTestStream[pos + FRAME_HDR_LEN], len );
+    }
+  }
+  else
+  {
+    p = pbuf_alloc( PBUF_RAW, len, PBUF_REF );
+    if( p != NULL )
+    {
+      p->payload = &FrameTestStream[pos + FRAME_HDR_LEN];
+    }
+  }
+  if( p == NULL )
+  {
+    return -1;
+  }
+
+  f = frame_enc( type, p );
+  if( f == NULL || ( f == p ) != ( headroom != 0 ) || f->tot_len != FRAME_HDR_LEN + len )
+  {
+    log_e("frame test: encode len %u headroom %u", len, headroom);
+    FrameTestErrors++;
+    pbuf_free( f != NULL ? f : p );
+    return -1;
+  }
+  pbuf_copy_partial( f, &FrameTestStream[pos], FRAME_HDR_LEN, 0 );
+  pbuf_free( f );
+
+  return 0;
+}
+
+/* random frames, 1 in 8 with a byte changed, garbage rich in sync bytes between them */
+static u16_t frame_test_build( void )
+{
+  u16_t pos = 0, len, gap;
+
+  FrameTestExpectCnt = 0;
+  FrameTestNext = 0;
+
+  while( FrameTestExpectCnt < FRAME_TEST_FRAMES )
+  {
+    gap = ( frame_test_rand() % 4 == 0 ) ? (u16_t)( frame_test_rand() % 32 ) : 0;
+    len = (u16_t)( frame_test_rand() % ( FRAME_TEST_LEN_MAX + 1 ) );
+    if( pos + gap + FRAME_HDR_LEN + len > FRAME_TEST_STREAM_SIZE )
+    {
+      break;
+    }
+
+    for( ; gap > 0; gap-- )
+    {
+      FrameTestStream[pos++] = ( frame_test_rand() % 4 == 0 ) ? FRAME_SYNC : (u8_t)frame_test_rand();
+    }
+
+    if( frame_test_encode( pos, (u8_t)frame_test_rand(), len, (u8_t)( frame_test_rand() & 1 ) ) != 0 )
+    {
+      break;
+    }
+
+    if( frame_test_rand() % 8 == 0 )
+    {
+      FrameTestStream[pos + frame_test_rand() % ( FRAME_HDR_LEN + len )] ^= (u8_t)( 1 + frame_test_rand() % 255 );
+    }
+    else
+    {
+      FrameTestExpect[FrameTestExpectCnt++] = pos;
+    }
+    pos += FRAME_HDR_LEN + len;
+  }
+
+  return pos;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: frame_codec_test
+*	功能说明: FRAME_CODEC_TEST_ROUNDS random streams (frames built by frame_enc(), corrupted frames,
+*             garbage, random pieces) must give exactly their intact frames and free every pbuf;
+*             then decode and encode are measured, the results are logged
+*	形    参: 无
+*	返 回 值: number of errors
+*********************************************************************************************************
+*/
+int frame_codec_test( void )
+{
+  struct frame_dec dec;
+  struct frame_dec_stats total;
+  struct pbuf *p;
+  u32_t round, i, len, frames, t0, t_dec, t_crc, t_enc;
+  volatile u32_t sink = 0;   /* keeps the measured calls */
+
+  FrameTestErrors = 0;
+  memset( &total, 0, sizeof( total ) );
+
+  for( round = 0; round < FRAME_CODEC_TEST_ROUNDS; round++ )
+  {
+    len = frame_test_build();
+
+    frame_dec_init( &dec, frame_test_msg, NULL );
+    frame_test_feed( &dec, FrameTestStream, len, 0 );
+    /* zeros push out a false sync still waiting for its length */
+    for( i = 0; i < FRAME_HDR_LEN + FRAME_MAX_PAYLOAD; i += sizeof( FrameTestZero ) )
+    {
+      frame_test_feed( &dec, FrameTestZero, sizeof( FrameTestZero ), sizeof( FrameTestZero ) );
+    }
+
+    if( FrameTestNext != FrameTestExpectCnt || dec.held != NULL )
+    {
+      log_e("frame test: round %u, %u of %u frames, %u bytes held", (unsigned)round, FrameTestNext,
+            FrameTestExpectCnt, dec.held != NULL ? dec.held->tot_len : 0);
+      FrameTestErrors++;
+      frame_dec_reset( &dec );
+    }
+
+    total.frames  += dec.stats.frames;
+    total.crc_err += dec.stats.crc_err;
+    total.bad_len += dec.stats.bad_len;
+    total.skipped += dec.stats.skipped;
+    total.held_max = LWIP_MAX( total.held_max, dec.stats.held_max );
+  }
+
+  for( i = 0; i < FRAME_TEST_PBUFS; i++ )
+  {
+    if( FrameTestPbuf[i].used )
+    {
+      log_e("frame test: pbuf %u not freed", (unsigned)i);
+      FrameTestErrors++;
+      FrameTestPbuf[i].used = 0;
+    }
+  }
+
+  /* decode: intact frames fed in TCP_MSS pieces, as from the receive path */
+  for( len = 0; len + FRAME_HDR_LEN + FRAME_TEST_BENCH_LEN <= FRAME_TEST_STREAM_SIZE; len += FRAME_HDR_LEN + FRAME_TEST_BENCH_LEN )
+  {
+    frame_test_encode( (u16_t)len, 1, FRAME_TEST_BENCH_LEN, 1 );
+  }
+
+  frames = 0;
+  frame_dec_init( &dec, frame_test_count, &frames );
+  t0 = frame_test_time();
+  for( i = 0; i < FRAME_TEST_BENCH_LOOPS; i++ )
+  {
+    frame_test_feed( &dec, FrameTestStream, len, TCP_MSS );
+  }
+  t_dec = ( frame_test_time() - t0 ) / FRAME_TEST_BENCH_LOOPS;
+  if( frames != FRAME_TEST_BENCH_LOOPS * ( len / ( FRAME_HDR_LEN + FRAME_TEST_BENCH_LEN ) ) )
+  {
+    log_e("frame test: bench decoded %u frames", (unsigned)frames);
+    FrameTestErrors++;
+  }
+
+  t0 = frame_test_time();
+  for( i = 0; i < FRAME_TEST_BENCH_LOOPS; i++ )
+  {
+    sink += fs_qspi_crc32( 0, FrameTestStream, len );
+  }
+  t_crc = ( frame_test_time() - t0 ) / FRAME_TEST_BENCH_LOOPS;
+
+  /* encode: allocation, header and CRC, free */
+  t0 = frame_test_time();
+  for( i = 0; i < FRAME_TEST_BENCH_LOOPS * 10; i++ )
+  {
+    p = frame_alloc( FRAME_TEST_BENCH_LEN );
+    if( p != NULL )
+    {
+      if( frame_enc( 1, p ) == NULL )
+      {
+        FrameTestErrors++;
+      }
+      pbuf_free( p );
+    }
+  }
+  t_enc = ( frame_test_time() - t0 ) / ( FRAME_TEST_BENCH_LOOPS * 10 );
+
+  log_i("frame test: %u rounds, %d errors", (unsigned)FRAME_CODEC_TEST_ROUNDS, FrameTestErrors);
+  log_i("  %u frames, %u CRC errors, %u bad lengths, %u bytes skipped, %u bytes held at most",
+        (unsigned)total.frames, (unsigned)total.crc_err, (unsigned)total.bad_len,
+        (unsigned)total.skipped, (unsigned)total.held_max);
+  log_i("  decode %u bytes (%u byte frames), %s: %u, CRC alone %u; encode one frame %u",
+        (unsigned)len, (unsigned)FRAME_TEST_BENCH_LEN, FRAME_TEST_UNIT, (unsigned)t_dec,
+        (unsigned)t_crc, (unsigned)t_enc);
+  log_i("  %s per 100 bytes: decode %u, CRC %u", FRAME_TEST_UNIT,
+        (unsigned)( t_dec * 100 / len ), (unsigned)( t_crc * 100 / len ));
+
+  return FrameTestErrors;
+}
+
+#else
+
+int frame_codec_test( void )
+{
+  return 0;
+}
+
+#endif /* FRAME_CODEC_TEST */
@@ -0,0 +1,91 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : frame_codec
+*	文件名称 : frame_codec.h
+*	版    本 : V1.0
+*	说    明 : message framing over a TCP stream (sync, type, length, CRC32): incremental decoder
+*              working on the received pbuf chains in place, encoder writing the header into the
+*              headroom of the payload pbuf
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年05月06日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __FRAME_CODEC_H__
+#define  __FRAME_CODEC_H__
+
+#include "lwip/opt.h"
+#include "lwip/pbuf.h"
+
+/*
+ * Frame, multi-byte fields big endian:
+ *   0  sync      FRAME_SYNC
+ *   1  type      application defined
+ *   2  length    payload bytes
+ *   4  crc       CRC-32 (fs_qspi_crc32) of type, length and payload
+ *   8  payload
+ * A frame failing the length or CRC check is skipped one byte at a time up to the next sync byte.
+ */
+#define FRAME_SYNC                    0xA5
+#define FRAME_HDR_LEN                 8
+
+/* longest payload accepted. A partial frame is held by reference until complete, so the held
+   chain stays below FRAME_HDR_LEN + FRAME_MAX_PAYLOAD + one received pbuf. */
+#ifndef FRAME_MAX_PAYLOAD
+#define FRAME_MAX_PAYLOAD             4096
+#endif
+#if FRAME_MAX_PAYLOAD > 32768
+#error "FRAME_MAX_PAYLOAD: the held chain must fit the u16_t tot_len of a pbuf"
+#endif
+
+/* 1: frame_codec_test() checks the decoder on corrupted streams and measures it */
+#ifndef FRAME_CODEC_TEST
+#define FRAME_CODEC_TEST              1
+#endif
+#ifndef FRAME_CODEC_TEST_ROUNDS
+#define FRAME_CODEC_TEST_ROUNDS       50
+#endif
+
+/* a decoded frame, valid during the callback only: the decoder drops its bytes afterwards */
+struct frame_msg
+{
+  u8_t         type;
+  u16_t        len;               /* payload bytes */
+  struct pbuf *p;                 /* chain holding the payload at offset 'off' */
+  u16_t        off;
+};
+
+typedef void (*frame_msg_fn)( void *arg, const struct frame_msg *msg );
+
+struct frame_dec_stats
+{
+  u32_t frames;
+  u32_t bytes;                    /* payload bytes of the frames */
+  u32_t crc_err;
+  u32_t bad_len;                  /* length above FRAME_MAX_PAYLOAD */
+  u32_t skipped;                  /* bytes dropped looking for a frame */
+  u32_t held_max;                 /* most bytes held waiting for the rest of a frame */
+};
+
+struct frame_dec
+{
+  struct pbuf           *held;    /* received bytes not decoded yet, by reference */
+  frame_msg_fn           msg;
+  void                  *arg;
+  struct frame_dec_stats stats;
+};
+
+void         frame_dec_init( struct frame_dec *dec, frame_msg_fn msg, void *arg );
+void         frame_dec_feed( struct frame_dec *dec, struct pbuf *p );
+void         frame_dec_reset( struct frame_dec *dec );
+const void  *frame_msg_data( const struct frame_msg *msg, void *scratch );
+struct pbuf *frame_alloc( u16_t len );
+struct pbuf *frame_enc( u8_t type, struct pbuf *p );
+void         frame_hdr_fill( u8_t *hdr, u8_t type, const struct pbuf *p, u16_t off, u16_t len );
+int          frame_codec_test( void );
+
+#endif
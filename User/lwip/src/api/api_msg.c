@@ -761,6 +761,9 @@ netconn_alloc(enum netconn_type t, netconn_callback callback)
   conn->socket       = -1;
 #endif /* LWIP_SOCKET */
   conn->callback     = callback;
+#if LWIP_NETCONN_CALLBACK_ARG
+  conn->callback_arg = NULL;
+#endif /* LWIP_NETCONN_CALLBACK_ARG */
 #if LWIP_TCP
   conn->current_msg  = NULL;
 #endif /* LWIP_TCP */
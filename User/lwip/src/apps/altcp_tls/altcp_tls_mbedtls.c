@@ -47,6 +47,15 @@
  * - define ALTCP_MBEDTLS_ENTROPY_PTR and ALTCP_MBEDTLS_ENTROPY_LEN to something providing
  *   GOOD custom entropy
  *
+ * Client session cache (ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE):
+ * - the session of each client handshake is saved per remote host (address and port,
+ *   or altcp_tls_session_host()) and offered on the next connect to it; the server
+ *   resumes it by session ID or ticket, skipping the key exchange and certificate check
+ * - to test it on Linux (unix port, mbedTLS of the host), connect repeatedly to
+ *   "openssl s_server -accept 4433 -cert cert.pem -key key.pem -www": with tickets,
+ *   with "-no_ticket" (session ID only) and with "-no_ticket -no_cache" (always full),
+ *   then compare the counts and times of altcp_tls_session_cache_stats()
+ *
  * Missing things / @todo:
  * - some unhandled/untested things migh be caught by LWIP_ASSERTs...
  */
@@ -62,6 +71,7 @@
 #include "lwip/altcp.h"
 #include "lwip/altcp_tls.h"
 #include "lwip/priv/altcp_priv.h"
+#include "lwip/sys.h"
 
 #include "altcp_tls_mbedtls_structs.h"
 #include "altcp_tls_mbedtls_mem.h"
@@ -114,6 +124,164 @@ static err_t altcp_mbedtls_lower_recv_process(struct altcp_pcb *conn, altcp_mbed
 static err_t altcp_mbedtls_handle_rx_appldata(struct altcp_pcb *conn, altcp_mbedtls_state_t *state);
 static int altcp_mbedtls_bio_send(void *ctx, const unsigned char *dataptr, size_t size);
 
+#if ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE
+
+/** One client session, 'used' orders the entries for replacement (0: free) */
+struct altcp_mbedtls_session_entry {
+  u32_t used;
+  u32_t host_hash;
+  ip_addr_t remote_ip;
+  u16_t remote_port;
+  mbedtls_ssl_session session;
+};
+
+static struct altcp_mbedtls_session_entry altcp_mbedtls_sessions[ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE];
+static u32_t altcp_mbedtls_session_use_ctr;
+static struct altcp_tls_session_stats altcp_mbedtls_session_stats;
+
+static int
+altcp_mbedtls_is_client(altcp_mbedtls_state_t *state)
+{
+  return state->ssl_context.conf->endpoint == MBEDTLS_SSL_IS_CLIENT;
+}
+
+static struct altcp_mbedtls_session_entry *
+altcp_mbedtls_session_find(altcp_mbedtls_state_t *state)
+{
+  int i;
+  for (i = 0; i < ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+    struct altcp_mbedtls_session_entry *e = &altcp_mbedtls_sessions[i];
+    if (e->used && (e->host_hash == state->host_hash) && (e->remote_port == state->remote_port) &&
+        ((state->host_hash != 0) || ip_addr_cmp(&e->remote_ip, &state->remote_ip))) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+static void
+altcp_mbedtls_session_drop(struct altcp_mbedtls_session_entry *e)
+{
+  mbedtls_ssl_session_free(&e->session);
+  e->used = 0;
+}
+
+/** Offer the session saved for the remote host, before the handshake starts */
+static void
+altcp_mbedtls_session_offer(altcp_mbedtls_state_t *state)
+{
+  struct altcp_mbedtls_session_entry *e = altcp_mbedtls_session_find(state);
+  if (e != NULL) {
+    e->used = ++altcp_mbedtls_session_use_ctr;
+    if (mbedtls_ssl_set_session(&state->ssl_context, &e->session) == 0) {
+      state->flags |= ALTCP_MBEDTLS_FLAGS_SESSION_OFFERED;
+      altcp_mbedtls_session_stats.offered++;
+    }
+  }
+}
+
+/** Handshake done: count it and save the (new or refreshed) session */
+static void
+altcp_mbedtls_session_save(altcp_mbedtls_state_t *state)
+{
+  struct altcp_mbedtls_session_entry *e;
+  int i;
+
+  if (state->flags & ALTCP_MBEDTLS_FLAGS_SESSION_RESUMED) {
+    altcp_mbedtls_session_stats.resumed++;
+    altcp_mbedtls_session_stats.resumed_time += state->hs_time;
+  } else {
+    altcp_mbedtls_session_stats.full++;
+    altcp_mbedtls_session_stats.full_time += state->hs_time;
+  }
+  LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("altcp_tls: %s handshake in %"U32_F" ticks\n",
+                                    (state->flags & ALTCP_MBEDTLS_FLAGS_SESSION_RESUMED) ? "resumed" : "full",
+                                    state->hs_time));
+
+  e = altcp_mbedtls_session_find(state);
+  if (e == NULL) {
+    /* a free entry, else the least recently used one */
+    e = &altcp_mbedtls_sessions[0];
+    for (i = 1; (i < ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE) && e->used; i++) {
+      if (altcp_mbedtls_sessions[i].used < e->used) {
+        e = &altcp_mbedtls_sessions[i];
+      }
+    }
+    if (e->used) {
+      altcp_mbedtls_session_drop(e);
+      altcp_mbedtls_session_stats.evicted++;
+    }
+    e->host_hash = state->host_hash;
+    ip_addr_copy(e->remote_ip, state->remote_ip);
+    e->remote_port = state->remote_port;
+  }
+  /* a ticket may have been renewed, copy the session every time */
+  if (mbedtls_ssl_get_session(&state->ssl_context, &e->session) != 0) {
+    altcp_mbedtls_session_drop(e);
+    return;
+  }
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  if ((e->session.id_len == 0) && (e->session.ticket_len == 0))
+#else
+  if (e->session.id_len == 0)
+#endif
+  {
+    /* the server does not resume sessions */
+    altcp_mbedtls_session_drop(e);
+    return;
+  }
+  e->used = ++altcp_mbedtls_session_use_ctr;
+}
+
+/** Handshake failed: a server refusing the offered session will not take it later */
+static void
+altcp_mbedtls_session_failed(altcp_mbedtls_state_t *state)
+{
+  struct altcp_mbedtls_session_entry *e;
+
+  altcp_mbedtls_session_stats.failed++;
+  if (state->flags & ALTCP_MBEDTLS_FLAGS_SESSION_OFFERED) {
+    e = altcp_mbedtls_session_find(state);
+    if (e != NULL) {
+      altcp_mbedtls_session_drop(e);
+    }
+  }
+}
+
+#endif /* ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE */
+
+/** mbedtls_ssl_handshake() with the client session cache bookkeeping */
+static int
+altcp_mbedtls_handshake(altcp_mbedtls_state_t *state)
+{
+#if ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE
+  int ret = 0;
+  u32_t t0 = ALTCP_MBEDTLS_HANDSHAKE_CLOCK();
+  /* mbedtls_ssl_handshake() step by step: whether the server resumed the session is only
+     known from the handshake data, which the last step frees */
+  while (state->ssl_context.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+    ret = mbedtls_ssl_handshake_step(&state->ssl_context);
+    if ((state->ssl_context.handshake != NULL) && state->ssl_context.handshake->resume) {
+      state->flags |= ALTCP_MBEDTLS_FLAGS_SESSION_RESUMED;
+    }
+    if (ret != 0) {
+      break;
+    }
+  }
+  state->hs_time += ALTCP_MBEDTLS_HANDSHAKE_CLOCK() - t0;
+  if (altcp_mbedtls_is_client(state)) {
+    if (ret == 0) {
+      altcp_mbedtls_session_save(state);
+    } else if ((ret != MBEDTLS_ERR_SSL_WANT_READ) && (ret != MBEDTLS_ERR_SSL_WANT_WRITE)) {
+      altcp_mbedtls_session_failed(state);
+    }
+  }
+  return ret;
+#else
+  return mbedtls_ssl_handshake(&state->ssl_context);
+#endif
+}
+
 
 /* callback functions from inner/lower connection: */
 
@@ -251,7 +419,7 @@ altcp_mbedtls_lower_recv_process(struct altcp_pcb *conn, altcp_mbedtls_state_t *
 {
   if (!(state->flags & ALTCP_MBEDTLS_FLAGS_HANDSHAKE_DONE)) {
     /* handle connection setup (handshake not done) */
-    int ret = mbedtls_ssl_handshake(&state->ssl_context);
+    int ret = altcp_mbedtls_handshake(state);
     /* try to send data... */
     altcp_output(conn->inner_conn);
     if (state->bio_bytes_read) {
@@ -636,6 +804,61 @@ altcp_tls_context(struct altcp_pcb *conn)
   return NULL;
 }
 
+err_t
+altcp_tls_session_host(struct altcp_pcb *conn, const char *host)
+{
+#if ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE
+  altcp_mbedtls_state_t *state;
+  u32_t hash = 2166136261UL;
+
+  if ((conn == NULL) || (conn->fns != &altcp_mbedtls_functions) || (conn->state == NULL) || (host == NULL)) {
+    return ERR_ARG;
+  }
+  state = (altcp_mbedtls_state_t *)conn->state;
+  /* FNV-1a, 0 is reserved for "key by remote address" */
+  while (*host) {
+    hash = (hash ^ (u8_t)*host++) * 16777619UL;
+  }
+  state->host_hash = hash ? hash : 1;
+  return ERR_OK;
+#else
+  LWIP_UNUSED_ARG(conn);
+  LWIP_UNUSED_ARG(host);
+  return ERR_VAL;
+#endif
+}
+
+void
+altcp_tls_session_cache_flush(void)
+{
+#if ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE
+  int i;
+  for (i = 0; i < ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+    if (altcp_mbedtls_sessions[i].used) {
+      altcp_mbedtls_session_drop(&altcp_mbedtls_sessions[i]);
+    }
+  }
+#endif
+}
+
+void
+altcp_tls_session_cache_stats(struct altcp_tls_session_stats *stats)
+{
+#if ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE
+  int i;
+  *stats = altcp_mbedtls_session_stats;
+  stats->entries = 0;
+  for (i = 0; i < ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+    if (altcp_mbedtls_sessions[i].used) {
+      stats->entries++;
+    }
+  }
+#else
+  memset(stats, 0, sizeof(*stats));
+#endif
+  stats->clock_hz = ALTCP_MBEDTLS_HANDSHAKE_CLOCK_HZ;
+}
+
 #if ALTCP_MBEDTLS_DEBUG != LWIP_DBG_OFF
 static void
 altcp_mbedtls_debug(void *ctx, int level, const char *file, int line, const char *str)
@@ -821,6 +1044,10 @@ altcp_tls_create_config_client_common(const u8_t *ca, size_t ca_len, int is_2way
 
     mbedtls_ssl_conf_ca_chain(&conf->conf, conf->ca, NULL);
   }
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  mbedtls_ssl_conf_session_tickets(&conf->conf, ALTCP_MBEDTLS_CLIENT_SESSION_TICKETS ?
+                                   MBEDTLS_SSL_SESSION_TICKETS_ENABLED : MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+#endif
   return conf;
 }
 
@@ -932,6 +1159,14 @@ altcp_mbedtls_connect(struct altcp_pcb *conn, const ip_addr_t *ipaddr, u16_t por
     return ERR_VAL;
   }
   conn->connected = connected;
+#if ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE
+  if ((conn->state != NULL) && (ipaddr != NULL)) {
+    altcp_mbedtls_state_t *state = (altcp_mbedtls_state_t *)conn->state;
+    ip_addr_copy(state->remote_ip, *ipaddr);
+    state->remote_port = port;
+    altcp_mbedtls_session_offer(state);
+  }
+#endif
   return altcp_connect(conn->inner_conn, ipaddr, port, altcp_mbedtls_lower_connected);
 }
 
@@ -61,6 +61,8 @@ extern "C" {
 #define ALTCP_MBEDTLS_FLAGS_RX_CLOSE_QUEUED   0x04
 #define ALTCP_MBEDTLS_FLAGS_RX_CLOSED         0x08
 #define ALTCP_MBEDTLS_FLAGS_APPLDATA_SENT     0x10
+#define ALTCP_MBEDTLS_FLAGS_SESSION_OFFERED   0x20
+#define ALTCP_MBEDTLS_FLAGS_SESSION_RESUMED   0x40
 
 typedef struct altcp_mbedtls_state_s {
   void *conf;
@@ -72,6 +74,14 @@ typedef struct altcp_mbedtls_state_s {
   int rx_passed_unrecved;
   int bio_bytes_read;
   int bio_bytes_appl;
+#if ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE
+  /* client session cache key: host name hash, or the remote address if 0 */
+  u32_t host_hash;
+  ip_addr_t remote_ip;
+  u16_t remote_port;
+  /* ALTCP_MBEDTLS_HANDSHAKE_CLOCK ticks spent in handshake steps */
+  u32_t hs_time;
+#endif
 } altcp_mbedtls_state_t;
 
 #ifdef __cplusplus
@@ -77,6 +77,11 @@ fs_open(struct fs_file *file, const char *name)
       file->index = f->len;
       file->pextension = NULL;
       file->flags = f->flags;
+#if LWIP_HTTPD_FS_ETAG
+      file->etag = NULL;
+      file->not_modified = NULL;
+      file->not_modified_len = 0;
+#endif /* LWIP_HTTPD_FS_ETAG */
 #if HTTPD_PRECALCULATED_CHECKSUM
       file->chksum_count = f->chksum_count;
       file->chksum = f->chksum;
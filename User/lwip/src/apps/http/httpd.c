@@ -121,6 +121,14 @@
 #if LWIP_HTTPD_SUPPORT_11_KEEPALIVE
 #define HTTP11_CONNECTIONKEEPALIVE  "Connection: keep-alive"
 #define HTTP11_CONNECTIONKEEPALIVE2 "Connection: Keep-Alive"
+#if LWIP_HTTPD_SUPPORT_11_PERSISTENT
+#define HTTP11_VERSION              " HTTP/1.1"
+#define HTTP11_CONNECTIONCLOSE      "Connection: close"
+#define HTTP11_CONNECTIONCLOSE2     "Connection: Close"
+#endif
+#endif
+#if LWIP_HTTPD_FS_ETAG
+#define HTTP_IF_NONE_MATCH          "If-None-Match:"
 #endif
 
 #if LWIP_HTTPD_DYNAMIC_FILE_READ
@@ -1937,6 +1945,47 @@ http_continue(void *connection)
 }
 #endif /* LWIP_HTTPD_FS_ASYNC_READ */
 
+#if LWIP_HTTPD_FS_ETAG
+/** Send the 304 response of the file instead of the file when the
+ * If-None-Match header of the request lists its entity tag (or "*").
+ *
+ * @param hs http connection state, the file has been opened
+ * @param hdrs the request headers (not NULL-terminated)
+ * @param hdrs_len length of hdrs
+ */
+static void
+http_check_not_modified(struct http_state *hs, const char *hdrs, u16_t hdrs_len)
+{
+  const char *inm;
+  const char *crlf;
+  struct fs_file *file = hs->handle;
+
+  if ((file == NULL) || (file->etag == NULL) || (file->not_modified == NULL)) {
+    return;
+  }
+#if LWIP_HTTPD_SSI
+  if (hs->ssi != NULL) {
+    return;
+  }
+#endif /* LWIP_HTTPD_SSI */
+  inm = lwip_strnstr(hdrs, HTTP_IF_NONE_MATCH, hdrs_len);
+  if (inm == NULL) {
+    return;
+  }
+  inm += sizeof(HTTP_IF_NONE_MATCH) - 1;
+  crlf = lwip_strnstr(inm, CRLF, hdrs_len - (u16_t)(inm - hdrs));
+  if (crlf == NULL) {
+    return;
+  }
+  if (lwip_strnstr(inm, file->etag, (size_t)(crlf - inm)) ||
+      lwip_strnstr(inm, "*", (size_t)(crlf - inm))) {
+    LWIP_DEBUGF(HTTPD_DEBUG, ("Not modified: %s\n", file->etag));
+    hs->file = file->not_modified;
+    hs->left = (u32_t)file->not_modified_len;
+  }
+}
+#endif /* LWIP_HTTPD_FS_ETAG */
+
 /**
  * When data has been received in the correct state, try to parse it
  * as a HTTP request.
@@ -1958,9 +2007,9 @@ http_parse_request(struct pbuf *inp, struct http_state *hs, struct altcp_pcb *pc
 #if LWIP_HTTPD_SUPPORT_REQUESTLIST
   u16_t clen;
 #endif /* LWIP_HTTPD_SUPPORT_REQUESTLIST */
-#if LWIP_HTTPD_SUPPORT_POST
+#if LWIP_HTTPD_SUPPORT_POST || LWIP_HTTPD_FS_ETAG
   err_t err;
-#endif /* LWIP_HTTPD_SUPPORT_POST */
+#endif /* LWIP_HTTPD_SUPPORT_POST || LWIP_HTTPD_FS_ETAG */
 
   LWIP_UNUSED_ARG(pcb); /* only used for post */
   LWIP_ASSERT("p != NULL", p != NULL);
@@ -2065,6 +2114,14 @@ http_parse_request(struct pbuf *inp, struct http_state *hs, struct altcp_pcb *pc
           if (!is_09 && (lwip_strnstr(data, HTTP11_CONNECTIONKEEPALIVE, data_len) ||
                          lwip_strnstr(data, HTTP11_CONNECTIONKEEPALIVE2, data_len))) {
             hs->keepalive = 1;
+#if LWIP_HTTPD_SUPPORT_11_PERSISTENT
+          } else if (!is_09 && ((size_t)(data_len - (sp2 - data)) >= sizeof(HTTP11_VERSION) - 1) &&
+                     !strncmp(sp2, HTTP11_VERSION, sizeof(HTTP11_VERSION) - 1) &&
+                     !lwip_strnstr(data, HTTP11_CONNECTIONCLOSE, data_len) &&
+                     !lwip_strnstr(data, HTTP11_CONNECTIONCLOSE2, data_len)) {
+            /* HTTP/1.1 connections are persistent by default */
+            hs->keepalive = 1;
+#endif /* LWIP_HTTPD_SUPPORT_11_PERSISTENT */
           } else {
             hs->keepalive = 0;
           }
@@ -2095,7 +2152,16 @@ http_parse_request(struct pbuf *inp, struct http_state *hs, struct altcp_pcb *pc
           } else
 #endif /* LWIP_HTTPD_SUPPORT_POST */
           {
+#if LWIP_HTTPD_FS_ETAG
+            err = http_find_file(hs, uri, is_09);
+            if ((err == ERR_OK) && !is_09) {
+              /* the headers follow the request line, sp2 has been overwritten */
+              http_check_not_modified(hs, sp2 + 1, (u16_t)(data_len - (sp2 + 1 - data)));
+            }
+            return err;
+#else /* LWIP_HTTPD_FS_ETAG */
             return http_find_file(hs, uri, is_09);
+#endif /* LWIP_HTTPD_FS_ETAG */
           }
         }
       } else {
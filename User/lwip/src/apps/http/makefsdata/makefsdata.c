@@ -115,7 +115,8 @@ struct file_entry {
 int process_sub(FILE *data_file, FILE *struct_file);
 int process_file(FILE *data_file, FILE *struct_file, const char *filename);
 int file_write_http_header(FILE *data_file, const char *filename, int file_size, u16_t *http_hdr_len,
-                           u16_t *http_hdr_chksum, u8_t provide_content_len, int is_compressed);
+                           u16_t *http_hdr_chksum, u8_t provide_content_len, int is_compressed,
+                           const char *etag);
 int file_put_ascii(FILE *file, const char *ascii_string, int len, int *i);
 int s_put_ascii(char *buf, const char *ascii_string, int len, int *i);
 void concat_files(const char *file1, const char *file2, const char *targetfile);
@@ -124,6 +125,10 @@ static int checkSsiByFilelist(const char* filename_listfile);
 static int ext_in_list(const char* filename, const char *ext_list);
 static int file_to_exclude(const char* filename);
 static int file_can_be_compressed(const char* filename);
+static int is_gzip_sibling(const char *filename);
+static u32_t crc32_update(u32_t crc, const u8_t *data, size_t len);
+static void img_add_file(const char *name, u8_t flags, const char *etag, const u8_t *file_data, size_t file_size);
+static int img_write(const char *filename);
 
 /* 5 bytes per char + 3 bytes per line */
 static char file_buffer_c[COPY_BUFSIZE * 5 + ((COPY_BUFSIZE / HEX_BYTES_PER_LINE) * 3)];
@@ -143,8 +148,43 @@ unsigned char deflateNonSsiFiles = 0;
 size_t deflatedBytesReduced = 0;
 size_t overallDataBytes = 0;
 #endif
+unsigned char gzipFiles = 0;
+unsigned char includeEtag = 0;
 const char *exclude_list = NULL;
 const char *ncompress_list = NULL;
+const char *imgFile = NULL;
+
+/** Binary image for a file system in (memory-mapped) flash, written with -img.
+ * The layout is the one read by the target, see fs_qspi.h in the port:
+ * header, entry table, then per file its name, entity tag and "304 Not
+ * Modified" response (NULL-terminated) and its data (HTTP header included,
+ * 4-byte aligned). All offsets are from the image start, little endian.
+ */
+#define IMG_MAGIC          0x4D495346UL /* "FSIM" */
+#define IMG_VERSION        1
+#define IMG_HDR_SIZE       16
+#define IMG_ENTRY_SIZE     28
+#define IMG_DATA_ALIGNMENT 4
+
+struct img_entry {
+  struct img_entry *next;
+  char *name;
+  u8_t flags;
+  char *etag;
+  char *not_modified;
+  u8_t *data;
+  size_t len;
+};
+
+struct img_entry *first_img_entry = NULL;
+struct img_entry *last_img_entry = NULL;
+int img_num_entries = 0;
+
+/* the HTTP header of the current file, captured from file_put_ascii() for the image */
+static char img_hdr_buf[4096];
+static size_t img_hdr_len;
+static int img_hdr_capture;
+static int img_hdr_etag;
 
 struct file_entry *first_file = NULL;
 struct file_entry *last_file = NULL;
@@ -155,7 +195,7 @@ static size_t ssi_file_num_lines;
 
 static void print_usage(void)
 {
-  printf(" Usage: htmlgen [targetdir] [-s] [-e] [-11] [-nossi] [-ssi:<filename>] [-c] [-f:<filename>] [-m] [-svr:<name>] [-x:<ext_list>] [-xc:<ext_list>" USAGE_ARG_DEFLATE NEWLINE NEWLINE);
+  printf(" Usage: htmlgen [targetdir] [-s] [-e] [-11] [-nossi] [-ssi:<filename>] [-c] [-f:<filename>] [-m] [-svr:<name>] [-x:<ext_list>] [-xc:<ext_list>] [-gz] [-etag] [-img:<filename>]" USAGE_ARG_DEFLATE NEWLINE NEWLINE);
   printf("   targetdir: relative or absolute path to files to convert" NEWLINE);
   printf("   switch -s: toggle processing of subdirectories (default is on)" NEWLINE);
   printf("   switch -e: exclude HTTP header from file (header is created at runtime, default is off)" NEWLINE);
@@ -172,6 +212,11 @@ static void print_usage(void)
   printf("   switch -defl: deflate-compress all non-SSI files (with opt. compr.-level, default=10)" NEWLINE);
   printf("                 ATTENTION: browser has to support \"Content-Encoding: deflate\"!" NEWLINE);
 #endif
+  printf("   switch -gz: serve all non-SSI files gzip-compressed (where size shrinks): a file" NEWLINE);
+  printf("               \"x.gz\" next to \"x\" is used as is, else \"x\" is compressed if deflate" NEWLINE);
+  printf("               support is compiled in" NEWLINE);
+  printf("   switch -etag: include an \"ETag\" header (CRC32 of the file data)" NEWLINE);
+  printf("   switch -img: also write a binary image for a file system in flash (e.g. QSPI)" NEWLINE);
   printf("   if targetdir not specified, htmlgen will attempt to" NEWLINE);
   printf("   process files in subdirectory 'fs'" NEWLINE);
 }
@@ -254,6 +299,14 @@ int main(int argc, char *argv[])
       } else if (strstr(argv[i], "-xc:") == argv[i]) {
         ncompress_list = &argv[i][4];
         printf("Skipping compresion for files with extensions %s" NEWLINE, ncompress_list);
+      } else if (!strcmp(argv[i], "-gz")) {
+        gzipFiles = 1;
+        printf("Using gzip for all non-SSI files (but only if size is reduced)" NEWLINE);
+      } else if (!strcmp(argv[i], "-etag")) {
+        includeEtag = 1;
+      } else if (strstr(argv[i], "-img:") == argv[i]) {
+        imgFile = &argv[i][5];
+        printf("Writing image to file \"%s\"" NEWLINE, imgFile);
       } else if ((strstr(argv[i], "-?")) || (strstr(argv[i], "-h"))) {
         print_usage();
         exit(0);
@@ -267,6 +320,11 @@ int main(int argc, char *argv[])
     }
   }
 
+  if (imgFile && !includeHttpHeader) {
+    printf("ERROR: -img needs the HTTP header included (no -e)" NEWLINE);
+    exit(-1);
+  }
+
   if (!check_path(path, sizeof(path))) {
     printf("Invalid path: \"%s\"." NEWLINE, path);
     exit(-1);
@@ -344,6 +402,11 @@ int main(int argc, char *argv[])
   /* append struct_file to data_file */
   printf(NEWLINE "Creating target file..." NEWLINE NEWLINE);
   concat_files("fsdata.tmp", "fshdr.tmp", targetfile);
+  if (imgFile) {
+    if (img_write(imgFile) < 0) {
+      exit(-1);
+    }
+  }
 
   /* if succeeded, delete the temporary files */
   if (remove("fsdata.tmp") != 0) {
@@ -355,7 +418,7 @@ int main(int argc, char *argv[])
 
   printf(NEWLINE "Processed %d files - done." NEWLINE, filesProcessed);
 #if MAKEFS_SUPPORT_DEFLATE
-  if (deflateNonSsiFiles) {
+  if (deflateNonSsiFiles || gzipFiles) {
     printf("(Deflated total byte reduction: %d bytes -> %d bytes (%.02f%%)" NEWLINE,
            (int)overallDataBytes, (int)deflatedBytesReduced, (float)((deflatedBytesReduced * 100.0) / overallDataBytes));
   }
@@ -367,6 +430,15 @@ int main(int argc, char *argv[])
     first_file = fe->next;
     free(fe);
   }
+  while (first_img_entry != NULL) {
+    struct img_entry *ie = first_img_entry;
+    first_img_entry = ie->next;
+    free(ie->name);
+    free(ie->etag);
+    free(ie->not_modified);
+    free(ie->data);
+    free(ie);
+  }
 
   if (ssi_file_buffer) {
     free(ssi_file_buffer);
@@ -432,6 +504,77 @@ void concat_files(const char *file1, const char *file2, const char *targetfile)
   fclose(fout);
 }
 
+/** CRC-32 as used by gzip (and the ETag / image checksums), start with crc = 0 */
+static u32_t crc32_update(u32_t crc, const u8_t *data, size_t len)
+{
+  size_t i;
+  int k;
+  crc = ~crc;
+  for (i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0UL - (crc & 1)));
+    }
+  }
+  return ~crc & 0xffffffffUL;
+}
+
+/** "x.gz" when "x" exists: only used as the gzip encoding of "x" */
+static int is_gzip_sibling(const char *filename)
+{
+  char orig_name[MAX_PATH_LEN];
+  size_t len = strlen(filename);
+  FILE *f;
+  if ((len <= 3) || (len >= sizeof(orig_name)) || strcmp(&filename[len - 3], ".gz")) {
+    return 0;
+  }
+  memcpy(orig_name, filename, len - 3);
+  orig_name[len - 3] = 0;
+  f = fopen(orig_name, "rb");
+  if (f == NULL) {
+    return 0;
+  }
+  fclose(f);
+  return 1;
+}
+
+/** Read the pre-compressed "x.gz" of a file "x", NULL if there is none */
+static u8_t *get_gzip_sibling_data(const char *filename, size_t *gz_size)
+{
+  char gz_name[MAX_PATH_LEN];
+  FILE *f;
+  long rs;
+  u8_t *buf;
+  size_t r;
+  if (strlen(filename) + 4 > sizeof(gz_name)) {
+    return NULL;
+  }
+  sprintf(gz_name, "%s.gz", filename);
+  f = fopen(gz_name, "rb");
+  if (f == NULL) {
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  rs = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (rs < 18) {
+    printf("WARNING: \"%s\" is no gzip file, ignored" NEWLINE, gz_name);
+    fclose(f);
+    return NULL;
+  }
+  buf = (u8_t *)malloc((size_t)rs);
+  LWIP_ASSERT("buf != NULL", buf != NULL);
+  r = fread(buf, 1, (size_t)rs, f);
+  fclose(f);
+  if ((r != (size_t)rs) || (buf[0] != 0x1f) || (buf[1] != 0x8b)) {
+    printf("WARNING: \"%s\" is no gzip file, ignored" NEWLINE, gz_name);
+    free(buf);
+    return NULL;
+  }
+  *gz_size = (size_t)rs;
+  return buf;
+}
+
 int process_sub(FILE *data_file, FILE *struct_file)
 {
   tinydir_dir dir;
@@ -512,6 +655,10 @@ int process_sub(FILE *data_file, FILE *struct_file)
               printf("skipping %s/%s by exclude list (-x option)..." NEWLINE, curSubdir, curName);
               continue;
             }
+            if (gzipFiles && is_gzip_sibling(curName)) {
+              printf("skipping %s/%s, served as gzip encoding of the original (-gz option)..." NEWLINE, curSubdir, curName);
+              continue;
+            }
 
             printf("processing %s/%s..." NEWLINE, curSubdir, curName);
 
@@ -536,6 +683,9 @@ static u8_t *get_file_data(const char *filename, int *file_size, int can_be_comp
   u8_t *buf;
   size_t r;
   int rs;
+#if MAKEFS_SUPPORT_DEFLATE
+  int i;
+#endif
   LWIP_UNUSED_ARG(r); /* for LWIP_NOASSERT */
   inFile = fopen(filename, "rb");
   if (inFile == NULL) {
@@ -556,9 +706,25 @@ static u8_t *get_file_data(const char *filename, int *file_size, int can_be_comp
   LWIP_ASSERT("r == fsize", r == fsize);
   *file_size = fsize;
   *is_compressed = 0;
+  if (gzipFiles && can_be_compressed) {
+    size_t gz_size;
+    u8_t *gz_buf = get_gzip_sibling_data(filename, &gz_size);
+    if (gz_buf != NULL) {
+      if (gz_size < fsize) {
+        printf(" - gzip (%s.gz): %d bytes -> %d bytes (%.02f%%)" NEWLINE, filename, (int)fsize, (int)gz_size, (float)((gz_size * 100.0) / fsize));
+        free(buf);
+        buf = gz_buf;
+        *file_size = gz_size;
+        *is_compressed = 2;
+      } else {
+        printf(" - uncompressed: (%s.gz is not smaller)" NEWLINE, filename);
+        free(gz_buf);
+      }
+    }
+  }
 #if MAKEFS_SUPPORT_DEFLATE
   overallDataBytes += fsize;
-  if (deflateNonSsiFiles) {
+  if ((deflateNonSsiFiles || gzipFiles) && !*is_compressed) {
     if (can_be_compressed) {
       if (fsize < OUT_BUF_SIZE) {
         u8_t *ret_buf;
@@ -584,8 +750,8 @@ static u8_t *get_file_data(const char *filename, int *file_size, int can_be_comp
           exit(-1);
         }
         LWIP_ASSERT("out_bytes <= COPY_BUFSIZE", out_bytes <= OUT_BUF_SIZE);
-        if (out_bytes < fsize) {
-          ret_buf = (u8_t *)malloc(out_bytes);
+        if (out_bytes + (gzipFiles ? 18 : 0) < fsize) {
+          ret_buf = (u8_t *)malloc(out_bytes + 18);
           LWIP_ASSERT("ret_buf != NULL", ret_buf != NULL);
           memcpy(ret_buf, s_outbuf, out_bytes);
           {
@@ -603,13 +769,25 @@ static u8_t *get_file_data(const char *filename, int *file_size, int can_be_comp
             LWIP_ASSERT("tinfl_decompress size mismatch", fsize == dec_out_bytes);
             LWIP_ASSERT("decompressed memcmp failed", !memcmp(s_checkbuf, buf, fsize));
           }
+          if (gzipFiles) {
+            /* wrap the deflate stream: 10 bytes gzip header, CRC32 and size of the original */
+            u32_t crc = crc32_update(0, buf, fsize);
+            static const u8_t gz_hdr[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 2, 3};
+            memmove(&ret_buf[10], ret_buf, out_bytes);
+            memcpy(ret_buf, gz_hdr, sizeof(gz_hdr));
+            for (i = 0; i < 4; i++) {
+              ret_buf[10 + out_bytes + i] = (u8_t)(crc >> (8 * i));
+              ret_buf[14 + out_bytes + i] = (u8_t)(fsize >> (8 * i));
+            }
+            out_bytes += 18;
+          }
           /* free original buffer, use compressed data + size */
           free(buf);
           buf = ret_buf;
           *file_size = out_bytes;
-          printf(" - deflate: %d bytes -> %d bytes (%.02f%%)" NEWLINE, (int)fsize, (int)out_bytes, (float)((out_bytes * 100.0) / fsize));
+          printf(" - %s: %d bytes -> %d bytes (%.02f%%)" NEWLINE, gzipFiles ? "gzip" : "deflate", (int)fsize, (int)out_bytes, (float)((out_bytes * 100.0) / fsize));
           deflatedBytesReduced += (size_t)(fsize - out_bytes);
-          *is_compressed = 1;
+          *is_compressed = gzipFiles ? 2 : 1;
         } else {
           printf(" - uncompressed: (would be %d bytes larger using deflate)" NEWLINE, (int)(out_bytes - fsize));
         }
@@ -620,8 +798,6 @@ static u8_t *get_file_data(const char *filename, int *file_size, int can_be_comp
       printf(" - cannot be compressed" NEWLINE);
     }
   }
-#else
-  LWIP_UNUSED_ARG(can_be_compressed);
 #endif
   fclose(inFile);
   return buf;
@@ -918,6 +1094,7 @@ int process_file(FILE *data_file, FILE *struct_file, const char *filename)
   int can_be_compressed;
   int is_compressed = 0;
   int flags_printed;
+  char etag[16];
 
   /* create qualified name (@todo: prepend slash or not?) */
   sprintf(qualifiedName, "%s/%s", curSubdir, filename);
@@ -952,8 +1129,18 @@ int process_file(FILE *data_file, FILE *struct_file, const char *filename)
   has_content_len = !is_ssi;
   can_be_compressed = includeHttpHeader && !is_ssi && file_can_be_compressed(filename);
   file_data = get_file_data(filename, &file_size, can_be_compressed, &is_compressed);
+  etag[0] = 0;
+  if (includeEtag && !is_ssi) {
+    /* strong tag of the data as sent, changes with the content and its encoding */
+    sprintf(etag, "\"%08x\"", (unsigned int)crc32_update(0, file_data, (size_t)file_size));
+  }
   if (includeHttpHeader) {
-    file_write_http_header(data_file, filename, file_size, &http_hdr_len, &http_hdr_chksum, has_content_len, is_compressed);
+    img_hdr_len = 0;
+    img_hdr_etag = 0;
+    img_hdr_capture = 1;
+    file_write_http_header(data_file, filename, file_size, &http_hdr_len, &http_hdr_chksum, has_content_len, is_compressed,
+                           includeEtag ? etag : "");
+    img_hdr_capture = 0;
     flags |= FS_FILE_FLAGS_HEADER_INCLUDED;
     if (has_content_len) {
       flags |= FS_FILE_FLAGS_HEADER_PERSISTENT;
@@ -1016,12 +1203,16 @@ int process_file(FILE *data_file, FILE *struct_file, const char *filename)
   fprintf(data_file, NEWLINE "/* raw file data (%d bytes) */" NEWLINE, file_size);
   process_file_data(data_file, file_data, file_size);
   fprintf(data_file, "};" NEWLINE NEWLINE);
+  if (imgFile) {
+    img_add_file(qualifiedName, flags, img_hdr_etag ? etag : "", file_data, (size_t)file_size);
+  }
   free(file_data);
   return 0;
 }
 
 int file_write_http_header(FILE *data_file, const char *filename, int file_size, u16_t *http_hdr_len,
-                           u16_t *http_hdr_chksum, u8_t provide_content_len, int is_compressed)
+                           u16_t *http_hdr_chksum, u8_t provide_content_len, int is_compressed,
+                           const char *etag)
 {
   int i = 0;
   int response_type = HTTP_HDR_OK;
@@ -1165,6 +1356,22 @@ int file_write_http_header(FILE *data_file, const char *filename, int file_size,
     }
   }
 
+  /* the entity tag is only sent with the content: not with error pages */
+  if ((etag[0] != 0) && ((response_type == HTTP_HDR_OK) || (response_type == HTTP_HDR_OK_11))) {
+    char etagbuf[32];
+    sprintf(etagbuf, "ETag: %s\r\n", etag);
+    cur_string = etagbuf;
+    cur_len = strlen(cur_string);
+    fprintf(data_file, NEWLINE "/* \"ETag: %s\r\n\" (%"SZT_F" bytes) */" NEWLINE, etag, cur_len);
+    written += file_put_ascii(data_file, cur_string, cur_len, &i);
+    i = 0;
+    img_hdr_etag = provide_content_len;
+    if (precalcChksum) {
+      memcpy(&hdr_buf[hdr_len], cur_string, cur_len);
+      hdr_len += cur_len;
+    }
+  }
+
   /* HTTP/1.1 implements persistent connections */
   if (useHttp11) {
     if (provide_content_len) {
@@ -1184,19 +1391,23 @@ int file_write_http_header(FILE *data_file, const char *filename, int file_size,
     }
   }
 
-#if MAKEFS_SUPPORT_DEFLATE
   if (is_compressed) {
-    /* tell the client about the deflate encoding */
-    LWIP_ASSERT("error", deflateNonSsiFiles);
-    cur_string = "Content-Encoding: deflate\r\n";
+    /* tell the client about the deflate or gzip encoding */
+    LWIP_ASSERT("error", gzipFiles || (is_compressed == 1));
+    if (is_compressed == 2) {
+      cur_string = "Content-Encoding: gzip\r\n";
+    } else {
+      cur_string = "Content-Encoding: deflate\r\n";
+    }
     cur_len = strlen(cur_string);
-    fprintf(data_file, NEWLINE "/* \"%s\" (%d bytes) */" NEWLINE, cur_string, cur_len);
+    fprintf(data_file, NEWLINE "/* \"%s\" (%"SZT_F" bytes) */" NEWLINE, cur_string, cur_len);
     written += file_put_ascii(data_file, cur_string, cur_len, &i);
     i = 0;
+    if (precalcChksum) {
+      memcpy(&hdr_buf[hdr_len], cur_string, cur_len);
+      hdr_len += cur_len;
+    }
   }
-#else
-  LWIP_UNUSED_ARG(is_compressed);
-#endif
 
   /* write content-type, ATTENTION: this includes the double-CRLF! */
   cur_string = file_type;
@@ -1224,6 +1435,11 @@ int file_write_http_header(FILE *data_file, const char *filename, int file_size,
 int file_put_ascii(FILE *file, const char *ascii_string, int len, int *i)
 {
   int x;
+  if (img_hdr_capture) {
+    LWIP_ASSERT("img_hdr_buf overflow", img_hdr_len + len <= sizeof(img_hdr_buf));
+    memcpy(&img_hdr_buf[img_hdr_len], ascii_string, len);
+    img_hdr_len += len;
+  }
   for (x = 0; x < len; x++) {
     unsigned char cur = ascii_string[x];
     fprintf(file, "0x%02x,", cur);
@@ -1249,3 +1465,141 @@ int s_put_ascii(char *buf, const char *ascii_string, int len, int *i)
   }
   return len;
 }
+
+static void img_put_u16(u8_t *p, u32_t v)
+{
+  p[0] = (u8_t)v;
+  p[1] = (u8_t)(v >> 8);
+}
+
+static void img_put_u32(u8_t *p, u32_t v)
+{
+  img_put_u16(p, v);
+  img_put_u16(p + 2, v >> 16);
+}
+
+/** FNV-1a hash of a file name, the target compares it before the name */
+static u32_t img_name_hash(const char *name)
+{
+  u32_t h = 2166136261UL;
+  while (*name) {
+    h = ((h ^ (u8_t)*name++) * 16777619UL) & 0xffffffffUL;
+  }
+  return h;
+}
+
+/** Remember a file for the image: the captured HTTP header followed by the data */
+static void img_add_file(const char *name, u8_t flags, const char *etag, const u8_t *file_data, size_t file_size)
+{
+  struct img_entry *ie = (struct img_entry *)malloc(sizeof(struct img_entry));
+  LWIP_ASSERT("ie != NULL", ie != NULL);
+  memset(ie, 0, sizeof(struct img_entry));
+  ie->name = strdup(name);
+  ie->flags = flags;
+  ie->etag = strdup(etag);
+  if (etag[0] != 0) {
+    /* everything the client needs to reuse its copy, no body */
+    char *nm = (char *)malloc(512);
+    LWIP_ASSERT("nm != NULL", nm != NULL);
+    snprintf(nm, 512, "%s%sETag: %s\r\n%s\r\n",
+             useHttp11 ? "HTTP/1.1 304 Not Modified\r\n" : "HTTP/1.0 304 Not Modified\r\n",
+             serverID, etag, useHttp11 ? g_psHTTPHeaderStrings[HTTP_HDR_CONN_KEEPALIVE] : "");
+    ie->not_modified = nm;
+  }
+  ie->len = img_hdr_len + file_size;
+  ie->data = (u8_t *)malloc(ie->len);
+  LWIP_ASSERT("ie->data != NULL", ie->data != NULL);
+  memcpy(ie->data, img_hdr_buf, img_hdr_len);
+  memcpy(ie->data + img_hdr_len, file_data, file_size);
+  if (first_img_entry == NULL) {
+    first_img_entry = last_img_entry = ie;
+  } else {
+    last_img_entry->next = ie;
+    last_img_entry = ie;
+  }
+  img_num_entries++;
+}
+
+/** Lay out and write the image collected by img_add_file() */
+static int img_write(const char *filename)
+{
+  struct img_entry *ie;
+  size_t size, off, data_off;
+  u8_t *img, *entry;
+  FILE *f;
+  size_t written;
+
+  if (img_num_entries > 0xffff) {
+    printf("ERROR: too many files for the image" NEWLINE);
+    return -1;
+  }
+  /* first pass: size */
+  size = IMG_HDR_SIZE + (size_t)img_num_entries * IMG_ENTRY_SIZE;
+  for (ie = first_img_entry; ie != NULL; ie = ie->next) {
+    size += strlen(ie->name) + 1 + strlen(ie->etag) + 1;
+    if (ie->not_modified != NULL) {
+      size += strlen(ie->not_modified) + 1;
+    }
+    size = (size + IMG_DATA_ALIGNMENT - 1) & ~(size_t)(IMG_DATA_ALIGNMENT - 1);
+    size += ie->len;
+  }
+  img = (u8_t *)malloc(size);
+  LWIP_ASSERT("img != NULL", img != NULL);
+  memset(img, 0xff, size); /* erased flash */
+
+  /* second pass: entries, strings and data */
+  entry = img + IMG_HDR_SIZE;
+  off = IMG_HDR_SIZE + (size_t)img_num_entries * IMG_ENTRY_SIZE;
+  for (ie = first_img_entry; ie != NULL; ie = ie->next) {
+    size_t name_off, etag_off, nm_off = 0, nm_len = 0;
+    name_off = off;
+    strcpy((char *)img + off, ie->name);
+    off += strlen(ie->name) + 1;
+    etag_off = off;
+    strcpy((char *)img + off, ie->etag);
+    off += strlen(ie->etag) + 1;
+    if (ie->not_modified != NULL) {
+      nm_off = off;
+      nm_len = strlen(ie->not_modified);
+      strcpy((char *)img + off, ie->not_modified);
+      off += nm_len + 1;
+    }
+    data_off = (off + IMG_DATA_ALIGNMENT - 1) & ~(size_t)(IMG_DATA_ALIGNMENT - 1);
+    memcpy(img + data_off, ie->data, ie->len);
+    off = data_off + ie->len;
+
+    img_put_u32(entry + 0, img_name_hash(ie->name));
+    img_put_u32(entry + 4, (u32_t)name_off);
+    img_put_u32(entry + 8, (u32_t)data_off);
+    img_put_u32(entry + 12, (u32_t)ie->len);
+    img_put_u32(entry + 16, ie->etag[0] ? (u32_t)etag_off : 0);
+    img_put_u32(entry + 20, (u32_t)nm_off);
+    img_put_u16(entry + 24, (u32_t)nm_len);
+    entry[26] = ie->flags;
+    entry[27] = 0;
+    entry += IMG_ENTRY_SIZE;
+  }
+  LWIP_ASSERT("off == size", off == size);
+
+  img_put_u32(img + 0, IMG_MAGIC);
+  img_put_u16(img + 4, IMG_VERSION);
+  img_put_u16(img + 6, (u32_t)img_num_entries);
+  img_put_u32(img + 8, (u32_t)size);
+  img_put_u32(img + 12, crc32_update(0, img + IMG_HDR_SIZE, size - IMG_HDR_SIZE));
+
+  f = fopen(filename, "wb");
+  if (f == NULL) {
+    printf("Failed to create file \"%s\"" NEWLINE, filename);
+    free(img);
+    return -1;
+  }
+  written = fwrite(img, 1, size, f);
+  fclose(f);
+  free(img);
+  if (written != size) {
+    printf("Failed to write file \"%s\"" NEWLINE, filename);
+    return -1;
+  }
+  printf("Image \"%s\": %d files, %d bytes" NEWLINE, filename, img_num_entries, (int)size);
+  return 0;
+}
@@ -54,15 +54,18 @@
 #include "lwip/udp.h"
 #include "lwip/timeouts.h"
 #include "lwip/debug.h"
+#include "lwip/def.h"
 
 #define TFTP_MAX_PAYLOAD_SIZE 512
 #define TFTP_HEADER_LENGTH    4
+#define TFTP_MIN_BLKSIZE      8
 
 #define TFTP_RRQ   1
 #define TFTP_WRQ   2
 #define TFTP_DATA  3
 #define TFTP_ACK   4
 #define TFTP_ERROR 5
+#define TFTP_OACK  6
 
 enum tftp_error {
   TFTP_ERROR_FILE_NOT_FOUND    = 1,
@@ -75,6 +78,7 @@ enum tftp_error {
 };
 
 #include <string.h>
+#include <stdlib.h>
 
 struct tftp_state {
   const struct tftp_context *ctx;
@@ -86,8 +90,11 @@ struct tftp_state {
   int timer;
   int last_pkt;
   u16_t blknum;
+  u16_t blksize;
   u8_t retries;
   u8_t mode_write;
+  u8_t ack_deferred;
+  u8_t ack_last;
 };
 
 static struct tftp_state tftp_state;
@@ -107,6 +114,8 @@ close_handle(void)
 
   sys_untimeout(tftp_tmr, NULL);
 
+  tftp_state.ack_deferred = 0;
+
   if (tftp_state.handle) {
     tftp_state.ctx->close(tftp_state.handle);
     tftp_state.handle = NULL;
@@ -180,7 +189,7 @@ send_data(void)
     pbuf_free(tftp_state.last_data);
   }
 
-  tftp_state.last_data = pbuf_alloc(PBUF_TRANSPORT, TFTP_HEADER_LENGTH + TFTP_MAX_PAYLOAD_SIZE, PBUF_RAM);
+  tftp_state.last_data = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(TFTP_HEADER_LENGTH + tftp_state.blksize), PBUF_RAM);
   if (tftp_state.last_data == NULL) {
     return;
   }
@@ -189,7 +198,7 @@ send_data(void)
   payload[0] = PP_HTONS(TFTP_DATA);
   payload[1] = lwip_htons(tftp_state.blknum);
 
-  ret = tftp_state.ctx->read(tftp_state.handle, &payload[2], TFTP_MAX_PAYLOAD_SIZE);
+  ret = tftp_state.ctx->read(tftp_state.handle, &payload[2], tftp_state.blksize);
   if (ret < 0) {
     send_error(&tftp_state.addr, tftp_state.port, TFTP_ERROR_ACCESS_VIOLATION, "Error occured while reading the file.");
     close_handle();
@@ -200,6 +209,70 @@ send_data(void)
   resend_data();
 }
 
+#if TFTP_MAX_BLKSIZE > TFTP_MAX_PAYLOAD_SIZE
+/* Parse the options following the mode (RFC 2347), only blksize (RFC 2348)
+ * is known. Returns the accepted block size, 0 if the option was not sent.
+ */
+static u16_t
+parse_blksize(struct pbuf *p, u16_t offset)
+{
+  const char tftp_null = 0;
+  char name[8];
+  char value[6];
+  u16_t name_end;
+  u16_t value_end;
+  int blksize;
+
+  while (offset < p->tot_len) {
+    name_end = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), offset);
+    if (name_end == 0xFFFF) {
+      break;
+    }
+    value_end = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), name_end + 1);
+    if (value_end == 0xFFFF) {
+      break;
+    }
+    if (((name_end - offset) == sizeof(name) - 1) && ((value_end - name_end - 1) < sizeof(value))) {
+      pbuf_copy_partial(p, name, sizeof(name), offset);
+      pbuf_copy_partial(p, value, (u16_t)(value_end - name_end), name_end + 1);
+      if (!lwip_stricmp(name, "blksize")) {
+        blksize = atoi(value);
+        if (blksize >= TFTP_MIN_BLKSIZE) {
+          return (u16_t)LWIP_MIN(blksize, TFTP_MAX_BLKSIZE);
+        }
+      }
+    }
+    offset = value_end + 1;
+  }
+  return 0;
+}
+
+/* Acknowledge the blksize option, kept as last_data to be resent on timeout */
+static void
+send_oack(void)
+{
+  char value[6];
+  u16_t value_len;
+  u8_t *payload;
+
+  if (tftp_state.last_data != NULL) {
+    pbuf_free(tftp_state.last_data);
+  }
+  lwip_itoa(value, sizeof(value), tftp_state.blksize);
+  value_len = (u16_t)(strlen(value) + 1);
+  tftp_state.last_data = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(2 + sizeof("blksize") + value_len), PBUF_RAM);
+  if (tftp_state.last_data == NULL) {
+    return;
+  }
+  payload = (u8_t *) tftp_state.last_data->payload;
+  payload[0] = 0;
+  payload[1] = TFTP_OACK;
+  MEMCPY(&payload[2], "blksize", sizeof("blksize"));
+  MEMCPY(&payload[2 + sizeof("blksize")], value, value_len);
+  resend_data();
+}
+#endif /* TFTP_MAX_BLKSIZE > TFTP_MAX_PAYLOAD_SIZE */
+
 static void
 recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
 {
@@ -229,6 +302,9 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       char mode[TFTP_MAX_MODE_LEN + 1];
       u16_t filename_end_offset;
       u16_t mode_end_offset;
+#if TFTP_MAX_BLKSIZE > TFTP_MAX_PAYLOAD_SIZE
+      u16_t blksize;
+#endif /* TFTP_MAX_BLKSIZE > TFTP_MAX_PAYLOAD_SIZE */
 
       if (tftp_state.handle != NULL) {
         send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "Only one connection at a time is supported");
@@ -253,6 +329,14 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       }
       pbuf_copy_partial(p, mode, mode_end_offset - filename_end_offset, filename_end_offset + 1);
 
+      tftp_state.blksize = TFTP_MAX_PAYLOAD_SIZE;
+#if TFTP_MAX_BLKSIZE > TFTP_MAX_PAYLOAD_SIZE
+      blksize = parse_blksize(p, mode_end_offset + 1);
+      if (blksize != 0) {
+        tftp_state.blksize = blksize;
+      }
+#endif /* TFTP_MAX_BLKSIZE > TFTP_MAX_PAYLOAD_SIZE */
+
       tftp_state.handle = tftp_state.ctx->open(filename, mode, opcode == PP_HTONS(TFTP_WRQ));
       tftp_state.blknum = 1;
 
@@ -263,16 +347,26 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
 
       LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: %s request from ", (opcode == PP_HTONS(TFTP_WRQ)) ? "write" : "read"));
       ip_addr_debug_print(TFTP_DEBUG | LWIP_DBG_STATE, addr);
-      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, (" for '%s' mode '%s'\n", filename, mode));
+      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, (" for '%s' mode '%s' blksize %u\n", filename, mode, (unsigned)tftp_state.blksize));
 
       ip_addr_copy(tftp_state.addr, *addr);
       tftp_state.port = port;
+      tftp_state.mode_write = (opcode == PP_HTONS(TFTP_WRQ));
+
+#if TFTP_MAX_BLKSIZE > TFTP_MAX_PAYLOAD_SIZE
+      if (blksize != 0) {
+        /* the client answers with DATA 1 (write) or ACK 0 (read) */
+        if (!tftp_state.mode_write) {
+          tftp_state.blknum = 0;
+        }
+        send_oack();
+        break;
+      }
+#endif /* TFTP_MAX_BLKSIZE > TFTP_MAX_PAYLOAD_SIZE */
 
-      if (opcode == PP_HTONS(TFTP_WRQ)) {
-        tftp_state.mode_write = 1;
+      if (tftp_state.mode_write) {
         send_ack(0);
       } else {
-        tftp_state.mode_write = 0;
         send_data();
       }
 
@@ -293,19 +387,37 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
         break;
       }
 
+      if (tftp_state.ack_deferred) {
+        /* the client repeats the block not acknowledged yet */
+        break;
+      }
+
       blknum = lwip_ntohs(sbuf[1]);
       if (blknum == tftp_state.blknum) {
         pbuf_remove_header(p, TFTP_HEADER_LENGTH);
 
+        if (tftp_state.last_data != NULL) {
+          /* the OACK has been received */
+          pbuf_free(tftp_state.last_data);
+          tftp_state.last_data = NULL;
+        }
+
         ret = tftp_state.ctx->write(tftp_state.handle, p);
         if (ret < 0) {
           send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "error writing file");
           close_handle();
+        } else if (tftp_state.ack_deferred) {
+          /* tftp_write_done() sends the ACK */
+          tftp_state.ack_last = (p->tot_len < tftp_state.blksize);
+          if (!tftp_state.ack_last) {
+            tftp_state.blknum++;
+          }
+          break;
         } else {
           send_ack(blknum);
         }
 
-        if (p->tot_len < TFTP_MAX_PAYLOAD_SIZE) {
+        if (p->tot_len < tftp_state.blksize) {
           close_handle();
         } else {
           tftp_state.blknum++;
@@ -341,8 +453,9 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
 
       lastpkt = 0;
 
-      if (tftp_state.last_data != NULL) {
-        lastpkt = tftp_state.last_data->tot_len != (TFTP_MAX_PAYLOAD_SIZE + TFTP_HEADER_LENGTH);
+      if ((tftp_state.last_data != NULL) && (blknum != 0)) {
+        /* (ACK 0 answers the OACK) */
+        lastpkt = tftp_state.last_data->tot_len != (tftp_state.blksize + TFTP_HEADER_LENGTH);
       }
 
       if (!lastpkt) {
@@ -388,6 +501,54 @@ tftp_tmr(void *arg)
   }
 }
 
+/** @ingroup tftp
+ * Block size of the transfer in progress: 512, or the one agreed with
+ * the blksize option.
+ */
+u16_t
+tftp_blksize(void)
+{
+  return tftp_state.blksize;
+}
+
+/** @ingroup tftp
+ * Called by the write() callback to keep the block it takes from being
+ * acknowledged: the client stops sending until tftp_write_done().
+ */
+void
+tftp_write_pending(void)
+{
+  tftp_state.ack_deferred = 1;
+}
+
+/** @ingroup tftp
+ * Acknowledge the block held by tftp_write_pending(). The transfer ends
+ * after its last block.
+ * @param result &gt;= 0: the block is written; &lt; 0: error, the
+ *        transfer is aborted
+ */
+void
+tftp_write_done(int result)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+
+  if (!tftp_state.ack_deferred || (tftp_state.handle == NULL)) {
+    return;
+  }
+  tftp_state.ack_deferred = 0;
+
+  if (result < 0) {
+    send_error(&tftp_state.addr, tftp_state.port, TFTP_ERROR_ACCESS_VIOLATION, "error writing file");
+    close_handle();
+    return;
+  }
+
+  send_ack(tftp_state.ack_last ? tftp_state.blknum : (u16_t)(tftp_state.blknum - 1));
+  if (tftp_state.ack_last) {
+    close_handle();
+  }
+}
+
 /** @ingroup tftp
  * Initialize TFTP server.
  * @param ctx TFTP callback struct
@@ -414,6 +575,7 @@ tftp_init(const struct tftp_context *ctx)
   tftp_state.ctx       = ctx;
   tftp_state.timer     = 0;
   tftp_state.last_data = NULL;
+  tftp_state.blksize   = TFTP_MAX_PAYLOAD_SIZE;
   tftp_state.upcb      = pcb;
 
   udp_recv(pcb, recv, NULL);
@@ -149,6 +149,9 @@ enum dhcp_option_idx {
   DHCP_OPTION_IDX_NTP_SERVER,
   DHCP_OPTION_IDX_NTP_SERVER_LAST = DHCP_OPTION_IDX_NTP_SERVER + LWIP_DHCP_MAX_NTP_SERVERS - 1,
 #endif /* LWIP_DHCP_GET_NTP_SRV */
+#if LWIP_DHCP_RAPID_COMMIT
+  DHCP_OPTION_IDX_RAPID_COMMIT,
+#endif /* LWIP_DHCP_RAPID_COMMIT */
   DHCP_OPTION_IDX_MAX
 };
 
@@ -188,6 +191,7 @@ static struct udp_pcb *dhcp_pcb;
 static u8_t dhcp_pcb_refcount;
 
 /* DHCP client state machine functions */
+static err_t dhcp_start_client(struct netif *netif);
 static err_t dhcp_discover(struct netif *netif);
 static err_t dhcp_select(struct netif *netif);
 static void dhcp_bind(struct netif *netif);
@@ -742,9 +746,85 @@ dhcp_start(struct netif *netif)
   LWIP_ASSERT_CORE_LOCKED();
   LWIP_ERROR("netif != NULL", (netif != NULL), return ERR_ARG;);
   LWIP_ERROR("netif is not up, old style port?", netif_is_up(netif), return ERR_ARG;);
-  dhcp = netif_dhcp_data(netif);
   LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, ("dhcp_start(netif=%p) %c%c%"U16_F"\n", (void *)netif, netif->name[0], netif->name[1], (u16_t)netif->num));
 
+  result = dhcp_start_client(netif);
+  if (result != ERR_OK) {
+    return result;
+  }
+  dhcp = netif_dhcp_data(netif);
+
+  if (!netif_is_link_up(netif)) {
+    /* set state INIT and wait for dhcp_network_changed() to call dhcp_discover() */
+    dhcp_set_state(dhcp, DHCP_STATE_INIT);
+    return ERR_OK;
+  }
+
+  /* (re)start the DHCP negotiation */
+  result = dhcp_discover(netif);
+  if (result != ERR_OK) {
+    /* free resources allocated above */
+    dhcp_release_and_stop(netif);
+    return ERR_MEM;
+  }
+  return result;
+}
+
+/**
+ * @ingroup dhcp4
+ * Start DHCP in the INIT-REBOOT state (RFC 2131 3.2): ask the server to
+ * confirm a lease obtained before (e.g. kept across a reset) with a REQUEST
+ * instead of discovering. The interface may already use the address, it is
+ * cleared on a NAK; without an answer the client falls back to discovering.
+ *
+ * @param netif The lwIP network interface
+ * @param addr the address leased before
+ * @return lwIP error code
+ * - ERR_OK - No error
+ * - ERR_MEM - Out of memory
+ */
+err_t
+dhcp_start_reboot(struct netif *netif, const ip4_addr_t *addr)
+{
+  struct dhcp *dhcp;
+  err_t result;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ERROR("netif != NULL", (netif != NULL), return ERR_ARG;);
+  LWIP_ERROR("addr != NULL", (addr != NULL), return ERR_ARG;);
+  LWIP_ERROR("netif is not up, old style port?", netif_is_up(netif), return ERR_ARG;);
+  LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, ("dhcp_start_reboot(netif=%p) %c%c%"U16_F"\n", (void *)netif, netif->name[0], netif->name[1], (u16_t)netif->num));
+
+  result = dhcp_start_client(netif);
+  if (result != ERR_OK) {
+    return result;
+  }
+  dhcp = netif_dhcp_data(netif);
+  ip4_addr_copy(dhcp->offered_ip_addr, *addr);
+
+  if (!netif_is_link_up(netif)) {
+    /* wait for dhcp_network_changed() to call dhcp_reboot() */
+    dhcp_set_state(dhcp, DHCP_STATE_REBOOTING);
+    return ERR_OK;
+  }
+
+  /* a failed REQUEST is retried by dhcp_timeout() */
+  dhcp_reboot(netif);
+  return ERR_OK;
+}
+
+/**
+ * Attach (or reset) the DHCP client of a netif and allocate the DHCP PCB,
+ * common part of dhcp_start() and dhcp_start_reboot().
+ *
+ * @param netif The lwIP network interface
+ * @return ERR_OK, or ERR_MEM when out of memory or the MTU is too small
+ */
+static err_t
+dhcp_start_client(struct netif *netif)
+{
+  struct dhcp *dhcp = netif_dhcp_data(netif);
+
   /* check MTU of the netif */
   if (netif->mtu < DHCP_MAX_MSG_LEN_MIN_REQUIRED) {
     LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE, ("dhcp_start(): Cannot use this netif with DHCP: MTU is too small\n"));
@@ -783,21 +863,7 @@ dhcp_start(struct netif *netif)
     return ERR_MEM;
   }
   dhcp->pcb_allocated = 1;
-
-  if (!netif_is_link_up(netif)) {
-    /* set state INIT and wait for dhcp_network_changed() to call dhcp_discover() */
-    dhcp_set_state(dhcp, DHCP_STATE_INIT);
-    return ERR_OK;
-  }
-
-  /* (re)start the DHCP negotiation */
-  result = dhcp_discover(netif);
-  if (result != ERR_OK) {
-    /* free resources allocated above */
-    dhcp_release_and_stop(netif);
-    return ERR_MEM;
-  }
-  return result;
+  return ERR_OK;
 }
 
 /**
@@ -1004,6 +1070,9 @@ dhcp_discover(struct netif *netif)
     for (i = 0; i < LWIP_ARRAYSIZE(dhcp_discover_request_options); i++) {
       options_out_len = dhcp_option_byte(options_out_len, msg_out->options, dhcp_discover_request_options[i]);
     }
+#if LWIP_DHCP_RAPID_COMMIT
+    options_out_len = dhcp_option(options_out_len, msg_out->options, DHCP_OPTION_RAPID_COMMIT, 0);
+#endif /* LWIP_DHCP_RAPID_COMMIT */
     LWIP_HOOK_DHCP_APPEND_OPTIONS(netif, dhcp, DHCP_STATE_SELECTING, msg_out, DHCP_DISCOVER, &options_out_len);
     dhcp_option_trailer(options_out_len, msg_out->options, p_out);
 
@@ -1633,6 +1702,13 @@ again:
         LWIP_ERROR("len == 4", len == 4, return ERR_VAL;);
         decode_idx = DHCP_OPTION_IDX_T2;
         break;
+#if LWIP_DHCP_RAPID_COMMIT
+      case (DHCP_OPTION_RAPID_COMMIT):
+        /* no value, only its presence counts */
+        LWIP_ERROR("len == 0", len == 0, return ERR_VAL;);
+        dhcp_got_option(dhcp, DHCP_OPTION_IDX_RAPID_COMMIT);
+        break;
+#endif /* LWIP_DHCP_RAPID_COMMIT */
       default:
         decode_len = 0;
         LWIP_DEBUGF(DHCP_DEBUG, ("skipping option %"U16_F" in options\n", (u16_t)op));
@@ -1823,7 +1899,19 @@ dhcp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr,
   if (msg_type == DHCP_ACK) {
     LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE, ("DHCP_ACK received\n"));
     /* in requesting state? */
-    if (dhcp->state == DHCP_STATE_REQUESTING) {
+    if ((dhcp->state == DHCP_STATE_REQUESTING)
+#if LWIP_DHCP_RAPID_COMMIT
+        /* or the server committed the lease in answer to the DISCOVER */
+        || ((dhcp->state == DHCP_STATE_SELECTING) && dhcp_option_given(dhcp, DHCP_OPTION_IDX_RAPID_COMMIT) &&
+            dhcp_option_given(dhcp, DHCP_OPTION_IDX_SERVER_ID))
+#endif /* LWIP_DHCP_RAPID_COMMIT */
+       ) {
+#if LWIP_DHCP_RAPID_COMMIT
+      if (dhcp->state == DHCP_STATE_SELECTING) {
+        LWIP_DEBUGF(DHCP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, ("DHCP_ACK with rapid commit in DHCP_STATE_SELECTING state\n"));
+        ip_addr_set_ip4_u32(&dhcp->server_ip_addr, lwip_htonl(dhcp_get_option_value(dhcp, DHCP_OPTION_IDX_SERVER_ID)));
+      }
+#endif /* LWIP_DHCP_RAPID_COMMIT */
       dhcp_handle_ack(netif, msg_in);
 #if DHCP_DOES_ARP_CHECK
       if ((netif->flags & NETIF_FLAG_ETHARP) != 0) {
@@ -71,6 +71,15 @@
 #define LWIP_MEM_ILLEGAL_FREE(msg)         LWIP_ASSERT(msg, 0)
 #endif
 
+/* heap profiling hooks, called with the heap protected and the payload size of
+   the block taken or given back */
+#ifndef LWIP_MEM_PROFILE_ALLOC
+#define LWIP_MEM_PROFILE_ALLOC(size)
+#endif
+#ifndef LWIP_MEM_PROFILE_FREE
+#define LWIP_MEM_PROFILE_FREE(size)
+#endif
+
 #define MEM_STATS_INC_LOCKED(x)         SYS_ARCH_LOCKED(MEM_STATS_INC(x))
 #define MEM_STATS_INC_USED_LOCKED(x, y) SYS_ARCH_LOCKED(MEM_STATS_INC_USED(x, y))
 #define MEM_STATS_DEC_USED_LOCKED(x, y) SYS_ARCH_LOCKED(MEM_STATS_DEC_USED(x, y))
@@ -668,6 +677,7 @@ mem_free(void *rmem)
 
   /* mem is now unused. */
   mem->used = 0;
+  LWIP_MEM_PROFILE_FREE(mem->next - mem_to_ptr(mem) - (SIZEOF_STRUCT_MEM + MEM_SANITY_OVERHEAD));
 
   if (mem < lfree) {
     /* the newly freed struct is now the lowest */
@@ -749,6 +759,7 @@ mem_trim(void *rmem, mem_size_t new_size)
 
   /* protect the heap from concurrent access */
   LWIP_MEM_FREE_PROTECT();
+  LWIP_MEM_PROFILE_FREE(size);
 
   mem2 = ptr_to_mem(mem->next);
   if (mem2->used == 0) {
@@ -808,6 +819,7 @@ mem_trim(void *rmem, mem_size_t new_size)
     -> don't do anyhting.
     -> the remaining space stays unused since it is too small
   } */
+  LWIP_MEM_PROFILE_ALLOC(mem->next - ptr - (SIZEOF_STRUCT_MEM + MEM_SANITY_OVERHEAD));
 #if MEM_OVERFLOW_CHECK
   mem_overflow_init_element(mem, new_size);
 #endif
@@ -925,6 +937,7 @@ mem_malloc(mem_size_t size_in)
           mem->used = 1;
           MEM_STATS_INC_USED(used, mem->next - mem_to_ptr(mem));
         }
+        LWIP_MEM_PROFILE_ALLOC(mem->next - ptr - (SIZEOF_STRUCT_MEM + MEM_SANITY_OVERHEAD));
 #if LWIP_ALLOW_MEM_FREE_FROM_OTHER_CONTEXT
 mem_malloc_adjust_lfree:
 #endif /* LWIP_ALLOW_MEM_FREE_FROM_OTHER_CONTEXT */
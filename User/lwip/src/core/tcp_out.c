@@ -1691,6 +1691,8 @@ tcp_rexmit_rto_commit(struct tcp_pcb *pcb)
   if (pcb->nrtx < 0xFF) {
     ++pcb->nrtx;
   }
+  /* count RTO retransmissions too, tcp_rexmit() only counts fast retransmits */
+  MIB2_STATS_INC(mib2.tcpretranssegs);
   /* Do the actual retransmission */
   tcp_output(pcb);
 }
@@ -90,6 +90,13 @@ typedef int sys_prot_t;
 
 #endif
 
+/* suozhang,add,2019427: TCP_PROFILE_BULK (lwipopts.h) places the pools that
+   grow with TCP_SND_BUF in MEMP_BULK_SECTION (FMC SDRAM), see memp.h LWIP_MEMPOOL_DECLARE */
+#if defined(MEMP_BULK_SECTION)
+extern u8_t memp_memory_TCP_SEG_base[] __attribute__((section(MEMP_BULK_SECTION)));
+extern u8_t memp_memory_PBUF_base[] __attribute__((section(MEMP_BULK_SECTION)));
+#endif
+
 void sys_arch_assert(const char* file, int line);
 
 /* suozhang,add,201812415:30:43 */
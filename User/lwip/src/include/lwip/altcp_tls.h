@@ -108,6 +108,40 @@ struct altcp_pcb *altcp_tls_alloc(void *arg, u8_t ip_type);
  */
 void *altcp_tls_context(struct altcp_pcb *conn);
 
+/** @ingroup altcp_tls
+ * Client session cache statistics, see @ref altcp_tls_session_cache_stats.
+ * Handshake times are in ALTCP_MBEDTLS_HANDSHAKE_CLOCK ticks, the resumption
+ * hit rate is resumed / (full + resumed).
+ */
+struct altcp_tls_session_stats {
+  u32_t full;           /* client handshakes completed without resumption */
+  u32_t resumed;        /* abbreviated handshakes (session ID or ticket) */
+  u32_t offered;        /* handshakes that offered a cached session */
+  u32_t failed;         /* client handshakes failed */
+  u32_t evicted;        /* sessions dropped for a newer one (least recently used) */
+  u32_t entries;        /* sessions cached now */
+  u32_t full_time;      /* CPU time in full handshakes */
+  u32_t resumed_time;   /* CPU time in resumed handshakes */
+  u32_t clock_hz;       /* ticks per second of the times */
+};
+
+/** @ingroup altcp_tls
+ * Key the cached session of a client connection by host name instead of the
+ * remote address (e.g. a server name resolving to several addresses).
+ * Call before altcp_connect().
+ */
+err_t altcp_tls_session_host(struct altcp_pcb *conn, const char *host);
+
+/** @ingroup altcp_tls
+ * Drop all cached client sessions (e.g. when the server keys changed)
+ */
+void altcp_tls_session_cache_flush(void);
+
+/** @ingroup altcp_tls
+ * Read the client session cache statistics (tcpip thread or core locked)
+ */
+void altcp_tls_session_cache_stats(struct altcp_tls_session_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
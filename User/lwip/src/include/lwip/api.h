@@ -283,6 +283,10 @@ struct netconn {
 #endif /* LWIP_TCP */
   /** A callback function that is informed about events for this netconn */
   netconn_callback callback;
+#if LWIP_NETCONN_CALLBACK_ARG
+  /** user data of the callback, not used by the stack */
+  void *callback_arg;
+#endif /* LWIP_NETCONN_CALLBACK_ARG */
 };
 
 /** This vector type is passed to @ref netconn_write_vectors_partly to send
@@ -381,6 +385,13 @@ err_t   netconn_err(struct netconn *conn);
 /** Get the blocking status of netconn calls (@todo: write/send is missing) */
 #define netconn_is_nonblocking(conn)        (((conn)->flags & NETCONN_FLAG_NON_BLOCKING) != 0)
 
+#if LWIP_NETCONN_CALLBACK_ARG
+/** Set the user data of the netconn callback (call with the core locked while events may arrive) */
+#define netconn_set_callback_arg(conn, arg) ((conn)->callback_arg = (arg))
+/** Get the user data of the netconn callback */
+#define netconn_get_callback_arg(conn)      ((conn)->callback_arg)
+#endif /* LWIP_NETCONN_CALLBACK_ARG */
+
 #if LWIP_IPV6
 /** @ingroup netconn_common
  * TCP: Set the IPv6 ONLY status of netconn calls (see NETCONN_FLAG_IPV6_V6ONLY)
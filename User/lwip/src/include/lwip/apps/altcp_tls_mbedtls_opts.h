@@ -62,6 +62,36 @@
 #define ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS   0
 #endif
 
+/** Number of sessions kept by the client side session cache (0: disabled).
+ * A client connection offers the session saved for its remote host (address and
+ * port, or the name given by altcp_tls_session_host()) so that the server can
+ * resume it by session ID or session ticket instead of a full handshake.
+ * The entries are a static array; the peer certificate and ticket of each
+ * session are allocated from the mbedTLS heap.
+ */
+#ifndef ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE
+#define ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE       0
+#endif
+
+/** ALTCP_MBEDTLS_CLIENT_SESSION_TICKETS==1: client configurations accept
+ * session tickets (RFC 5077, needs MBEDTLS_SSL_SESSION_TICKETS), the server
+ * then does not have to keep the session state.
+ */
+#ifndef ALTCP_MBEDTLS_CLIENT_SESSION_TICKETS
+#define ALTCP_MBEDTLS_CLIENT_SESSION_TICKETS          1
+#endif
+
+/** Clock measuring the CPU time spent in client handshakes, see
+ * altcp_tls_session_cache_stats(). On a Cortex-M, DWT->CYCCNT and
+ * SystemCoreClock give cycles instead of the default milliseconds.
+ */
+#ifndef ALTCP_MBEDTLS_HANDSHAKE_CLOCK
+#define ALTCP_MBEDTLS_HANDSHAKE_CLOCK()               sys_now()
+#endif
+#ifndef ALTCP_MBEDTLS_HANDSHAKE_CLOCK_HZ
+#define ALTCP_MBEDTLS_HANDSHAKE_CLOCK_HZ              1000
+#endif
+
 #endif /* LWIP_ALTCP */
 
 #endif /* LWIP_HDR_ALTCP_TLS_OPTS_H */
@@ -80,6 +80,13 @@ struct fs_file {
 #if LWIP_HTTPD_FILE_STATE
   void *state;
 #endif /* LWIP_HTTPD_FILE_STATE */
+#if LWIP_HTTPD_FS_ETAG
+  /* entity tag including the quotes, NULL if the file has none */
+  const char *etag;
+  /* complete "304 Not Modified" response, persistent like data */
+  const char *not_modified;
+  int not_modified_len;
+#endif /* LWIP_HTTPD_FS_ETAG */
 };
 
 #if LWIP_HTTPD_FS_ASYNC_READ
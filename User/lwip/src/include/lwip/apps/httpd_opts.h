@@ -248,6 +248,14 @@
 #define LWIP_HTTPD_SUPPORT_11_KEEPALIVE     0
 #endif
 
+/** Set this to 1 to keep HTTP/1.1 connections persistent unless the client
+ * sends "Connection: close" (RFC 7230), not only when it sends
+ * "Connection: keep-alive". Needs LWIP_HTTPD_SUPPORT_11_KEEPALIVE.
+ */
+#if !defined LWIP_HTTPD_SUPPORT_11_PERSISTENT || defined __DOXYGEN__
+#define LWIP_HTTPD_SUPPORT_11_PERSISTENT    0
+#endif
+
 /** Set this to 1 to support HTTP request coming in in multiple packets/pbufs */
 #if !defined LWIP_HTTPD_SUPPORT_REQUESTLIST || defined __DOXYGEN__
 #define LWIP_HTTPD_SUPPORT_REQUESTLIST      1
@@ -350,6 +358,15 @@
 #define LWIP_HTTPD_CUSTOM_FILES       0
 #endif
 
+/** Set this to 1 to answer a GET whose "If-None-Match" header carries the
+ * entity tag of the file with "304 Not Modified" instead of the file.
+ * The file system provides the tag and the complete 304 response in
+ * struct fs_file (etag, not_modified), see makefsdata -etag.
+ */
+#if !defined LWIP_HTTPD_FS_ETAG || defined __DOXYGEN__
+#define LWIP_HTTPD_FS_ETAG            0
+#endif
+
 /** Set this to 1 to support fs_read() to dynamically read file data.
  * Without this (default=off), only one-block files are supported,
  * and the contents must be ready after fs_open().
@@ -92,6 +92,15 @@
 #define TFTP_MAX_FILENAME_LEN 20
 #endif
 
+/**
+ * Largest block size accepted with the blksize option (RFC 2348), bytes.
+ * 512 (the RFC 1350 block size) ignores the option; 1468 fills an
+ * Ethernet frame without IP fragmentation.
+ */
+#if !defined TFTP_MAX_BLKSIZE || defined __DOXYGEN__
+#define TFTP_MAX_BLKSIZE      512
+#endif
+
 /**
  * Max. length of TFTP mode
  */
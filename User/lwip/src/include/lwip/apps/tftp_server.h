@@ -80,6 +80,9 @@ struct tftp_context {
    * @param pbuf PBUF adjusted such that payload pointer points
    *             to the beginning of write data. In other words,
    *             TFTP headers are stripped off.
+   *             A block shorter than tftp_blksize() is the last one.
+   *             Call tftp_write_pending() to acknowledge the block
+   *             later, with tftp_write_done().
    * @returns &gt;= 0: Success; &lt; 0: Error
    */
   int (*write)(void* handle, struct pbuf* p);
@@ -87,6 +90,9 @@ struct tftp_context {
 
 err_t tftp_init(const struct tftp_context* ctx);
 void tftp_cleanup(void);
+u16_t tftp_blksize(void);
+void tftp_write_pending(void);
+void tftp_write_done(int result);
 
 #ifdef __cplusplus
 }
@@ -961,6 +961,15 @@
 #if !defined LWIP_DHCP_MAX_DNS_SERVERS || defined __DOXYGEN__
 #define LWIP_DHCP_MAX_DNS_SERVERS       DNS_MAX_SERVERS
 #endif
+
+/**
+ * LWIP_DHCP_RAPID_COMMIT==1: Send the Rapid Commit option (RFC 4039) with
+ * DISCOVER and accept an ACK in answer to it: a server supporting it commits
+ * the lease in two messages instead of four.
+ */
+#if !defined LWIP_DHCP_RAPID_COMMIT || defined __DOXYGEN__
+#define LWIP_DHCP_RAPID_COMMIT          0
+#endif
 /**
  * @}
  */
@@ -1921,6 +1930,16 @@
 #if !defined LWIP_NETCONN_FULLDUPLEX || defined __DOXYGEN__
 #define LWIP_NETCONN_FULLDUPLEX         0
 #endif
+
+/** LWIP_NETCONN_CALLBACK_ARG==1: Add a user pointer to struct netconn for the
+ * netconn callback (netconn_set_callback_arg()), so that an event handler
+ * serving many netconns finds its per-connection data without a search.
+ * The stack initializes it to NULL and never reads it; accepted netconns
+ * inherit the callback of the listener, but not its argument.
+ */
+#if !defined LWIP_NETCONN_CALLBACK_ARG || defined __DOXYGEN__
+#define LWIP_NETCONN_CALLBACK_ARG       0
+#endif
 /**
  * @}
  */
@@ -0,0 +1,376 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\chksum_port.c
+  * @author  suozhang
+  * @brief   Internet checksum for the software paths (LWIP_CHKSUM and
+  *          LWIP_CHKSUM_COPY): loopback, ICMP, IP headers of the host build,
+  *          everything the Ethernet MAC checksum offload does not cover.
+  *
+  *          The data is summed as 32-bit words, 16 bytes per pass into two
+  *          independent 64-bit accumulators: each word costs one load and an
+  *          ADDS/ADC pair, and the two carry chains can be dual-issued by
+  *          the Cortex-M7. The carries are folded back once at the end. The
+  *          code is plain C, the same source is used by the host build.
+  *
+  *          lwip_chksum_port_test() checks both functions against lwIP's
+  *          generic lwip_standard_chksum() on random buffers and measures
+  *          them, in DWT cycles on the target and in ns on the host build.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/inet_chksum.h"
+#include "chksum_port.h"
+#include <string.h>
+#include <stdint.h>
+
+#if defined(NETIF_HOST)
+#include <time.h>
+#else
+#include "stm32h7xx_hal.h"
+#include "bsp_dwt.h"
+#endif
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "chksum_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+/* Private define ------------------------------------------------------------*/
+/* Fold a 64-bit accumulator of 32-bit words into 16 bits */
+#define CHKSUM_FOLD_U64(acc)       do { (acc) = ((acc) & 0xffffffffULL) + ((acc) >> 32); \
+                                        (acc) = ((acc) & 0xffffffffULL) + ((acc) >> 32); \
+                                        (acc) = FOLD_U32T((uint32_t)(acc));              \
+                                        (acc) = FOLD_U32T((uint32_t)(acc)); } while(0)
+
+#define CHKSUM_TEST_BUFF_SIZE      1600
+#define CHKSUM_TEST_BENCH_LEN      1460    /* TCP_MSS */
+#define CHKSUM_TEST_BENCH_LOOPS    100
+
+#if defined(NETIF_HOST)
+#define CHKSUM_TEST_UNIT           "ns"
+#else
+#define CHKSUM_TEST_UNIT           "cycles"
+#endif
+
+/* Private types -------------------------------------------------------------*/
+/* cc.h defines u32_t as unsigned long and no u64_t, the kernel needs exact widths */
+typedef uint32_t chksum_word_t;
+typedef uint64_t chksum_acc_t;
+
+/* Private variables ---------------------------------------------------------*/
+/* test buffers, 8 spare bytes to shift the start */
+static u8_t ChksumTestSrc[CHKSUM_TEST_BUFF_SIZE + 8];
+static u8_t ChksumTestDst[CHKSUM_TEST_BUFF_SIZE + 8];
+static chksum_word_t ChksumTestSeed = 0x2545F491;
+
+/* lwIP's generic checksum (LWIP_CHKSUM_ALGORITHM 2 in lwipopts.h), the reference */
+u16_t lwip_standard_chksum(const void *dataptr, int len);
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Sum len bytes (a multiple of 4) of 32-bit aligned data.
+  * @param  acc: running sum
+  * @param  pw: data, 32-bit aligned
+  * @param  len: number of bytes, a multiple of 4
+  * @retval acc plus the words, not folded
+  */
+static chksum_acc_t chksum_words(chksum_acc_t acc, const chksum_word_t *pw, u32_t len)
+{
+  chksum_acc_t acc1 = 0;
+
+  while(len >= 16)
+  {
+    acc  += pw[0];
+    acc1 += pw[1];
+    acc  += pw[2];
+    acc1 += pw[3];
+    pw += 4;
+    len -= 16;
+  }
+  while(len >= 4)
+  {
+    acc += *pw++;
+    len -= 4;
+  }
+
+  return acc + acc1;
+}
+
+/**
+  * @brief  Same as chksum_words(), the words are also copied to dst.
+  */
+static chksum_acc_t chksum_words_copy(chksum_acc_t acc, chksum_word_t *dst, const chksum_word_t *src, u32_t len)
+{
+  chksum_acc_t acc1 = 0;
+  chksum_word_t w0, w1, w2, w3;
+
+  while(len >= 16)
+  {
+    w0 = src[0];
+    w1 = src[1];
+    w2 = src[2];
+    w3 = src[3];
+    acc  += w0;
+    acc1 += w1;
+    acc  += w2;
+    acc1 += w3;
+    dst[0] = w0;
+    dst[1] = w1;
+    dst[2] = w2;
+    dst[3] = w3;
+    src += 4;
+    dst += 4;
+    len -= 16;
+  }
+  while(len >= 4)
+  {
+    w0 = *src++;
+    acc += w0;
+    *dst++ = w0;
+    len -= 4;
+  }
+
+  return acc + acc1;
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  LWIP_CHKSUM: non-inverted Internet sum of len bytes at any
+  *         alignment, the same value as lwip_standard_chksum().
+  * @param  dataptr: data
+  * @param  len: number of bytes
+  * @retval the sum, folded to 16 bits
+  */
+u16_t lwip_chksum_port(const void *dataptr, int len)
+{
+  const u8_t *pb = (const u8_t *)dataptr;
+  int odd = ((mem_ptr_t)pb & 1);
+  chksum_acc_t acc = 0;
+  u32_t words;
+  u16_t t = 0;
+
+  if(len <= 0)
+  {
+    return 0;
+  }
+
+  /* an odd start byte goes to the upper lane, the result is swapped back */
+  if(odd)
+  {
+    ((u8_t *)&t)[1] = *pb++;
+    len--;
+    acc = t;
+  }
+
+  /* then up to a 32-bit boundary */
+  if((((mem_ptr_t)pb & 2) != 0) && (len >= 2))
+  {
+    acc += *(const u16_t *)(const void *)pb;
+    pb += 2;
+    len -= 2;
+  }
+
+  words = (u32_t)len & ~3UL;
+  acc = chksum_words(acc, (const chksum_word_t *)(const void *)pb, words);
+  pb += words;
+  len -= (int)words;
+
+  if(len >= 2)
+  {
+    acc += *(const u16_t *)(const void *)pb;
+    pb += 2;
+    len -= 2;
+  }
+  if(len > 0)
+  {
+    t = 0;
+    ((u8_t *)&t)[0] = *pb;
+    acc += t;
+  }
+
+  CHKSUM_FOLD_U64(acc);
+
+  if(odd)
+  {
+    acc = SWAP_BYTES_IN_WORD(acc);
+  }
+
+  return (u16_t)acc;
+}
+
+/**
+  * @brief  LWIP_CHKSUM_COPY: MEMCPY that returns lwip_chksum_port() of the
+  *         copied data. When src and dst have the same alignment the words
+  *         are summed while they are copied; otherwise, and for short
+  *         copies, the data is copied first and summed from dst (in cache).
+  * @param  dst: destination
+  * @param  src: source
+  * @param  len: number of bytes
+  * @retval the sum, folded to 16 bits
+  */
+u16_t lwip_chksum_copy_port(void *dst, const void *src, u16_t len)
+{
+  u8_t *pd = (u8_t *)dst;
+  const u8_t *ps = (const u8_t *)src;
+  u32_t head, words, tail, sum;
+  chksum_acc_t acc;
+
+  if((len < CHKSUM_PORT_COPY_MIN) || ((((mem_ptr_t)pd ^ (mem_ptr_t)ps) & 3) != 0))
+  {
+    MEMCPY(dst, src, len);
+    return lwip_chksum_port(dst, len);
+  }
+
+  head = (4 - ((mem_ptr_t)ps & 3)) & 3;
+  words = (len - head) & ~3UL;
+  tail = len - head - words;
+
+  MEMCPY(pd, ps, head);
+  acc = chksum_words_copy(0, (chksum_word_t *)(void *)(pd + head), (const chksum_word_t *)(const void *)(ps + head), words);
+  MEMCPY(pd + head + words, ps + head + words, tail);
+
+  CHKSUM_FOLD_U64(acc);
+  sum = (u32_t)acc + lwip_chksum_port(pd + head + words, (int)tail);
+
+  /* the words start head bytes into the data: odd, they are in the other lane */
+  sum = FOLD_U32T(sum);
+  if((head & 1) != 0)
+  {
+    sum = SWAP_BYTES_IN_WORD(sum);
+  }
+
+  sum += lwip_chksum_port(pd, (int)head);
+  sum = FOLD_U32T(sum);
+  sum = FOLD_U32T(sum);
+
+  return (u16_t)sum;
+}
+
+/* xorshift32, reproducible test data */
+static u32_t chksum_test_rand(void)
+{
+  ChksumTestSeed ^= ChksumTestSeed << 13;
+  ChksumTestSeed ^= ChksumTestSeed >> 17;
+  ChksumTestSeed ^= ChksumTestSeed << 5;
+  return ChksumTestSeed;
+}
+
+static u32_t chksum_test_time(void)
+{
+#if defined(NETIF_HOST)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u32_t)(ts.tv_sec * 1000000000UL + ts.tv_nsec);
+#else
+  return DWT_CYCCNT;
+#endif
+}
+
+/**
+  * @brief  Check lwip_chksum_port() and lwip_chksum_copy_port() against
+  *         lwip_standard_chksum() over CHKSUM_PORT_TEST_ROUNDS random
+  *         buffers (length 0..1600, every start alignment, for the copy
+  *         every src/dst alignment pair), then log the time of the three
+  *         on a TCP_MSS segment, aligned and at an odd address.
+  * @retval number of mismatches, 0 when all agree
+  */
+int lwip_chksum_port_test(void)
+{
+  u32_t i, round, len, soff, doff, t0, t_std, t_port, t_odd, t_copy;
+  u16_t ref, sum;
+  volatile u16_t sink = 0;   /* keeps the measured calls */
+  int errors = 0;
+
+  for(i = 0; i < sizeof(ChksumTestSrc); i++)
+  {
+    ChksumTestSrc[i] = (u8_t)chksum_test_rand();
+  }
+
+  for(round = 0; round < CHKSUM_PORT_TEST_ROUNDS; round++)
+  {
+    /* short lengths and the 0xFF bytes runs exercise the carries */
+    len = chksum_test_rand() % ((round & 1) ? (CHKSUM_TEST_BUFF_SIZE + 1) : 80);
+    soff = chksum_test_rand() & 7;
+    doff = chksum_test_rand() & 7;
+    if((round & 7) == 0)
+    {
+      memset(&ChksumTestSrc[soff], 0xFF, len);
+    }
+    else
+    {
+      for(i = 0; i < len; i++)
+      {
+        ChksumTestSrc[soff + i] = (u8_t)chksum_test_rand();
+      }
+    }
+
+    ref = lwip_standard_chksum(&ChksumTestSrc[soff], (int)len);
+
+    sum = lwip_chksum_port(&ChksumTestSrc[soff], (int)len);
+    if(sum != ref)
+    {
+      log_e("chksum: len %u offset %u, 0x%04x expected 0x%04x", (unsigned)len, (unsigned)soff, sum, ref);
+      errors++;
+    }
+
+    memset(ChksumTestDst, 0, sizeof(ChksumTestDst));
+    sum = lwip_chksum_copy_port(&ChksumTestDst[doff], &ChksumTestSrc[soff], (u16_t)len);
+    if((sum != ref) || (memcmp(&ChksumTestDst[doff], &ChksumTestSrc[soff], len) != 0))
+    {
+      log_e("chksum copy: len %u offsets %u/%u, 0x%04x expected 0x%04x", (unsigned)len,
+            (unsigned)soff, (unsigned)doff, sum, ref);
+      errors++;
+    }
+  }
+
+  t0 = chksum_test_time();
+  for(i = 0; i < CHKSUM_TEST_BENCH_LOOPS; i++)
+  {
+    sink += lwip_standard_chksum(ChksumTestSrc, CHKSUM_TEST_BENCH_LEN);
+  }
+  t_std = (chksum_test_time() - t0) / CHKSUM_TEST_BENCH_LOOPS;
+
+  t0 = chksum_test_time();
+  for(i = 0; i < CHKSUM_TEST_BENCH_LOOPS; i++)
+  {
+    sink += lwip_chksum_port(ChksumTestSrc, CHKSUM_TEST_BENCH_LEN);
+  }
+  t_port = (chksum_test_time() - t0) / CHKSUM_TEST_BENCH_LOOPS;
+
+  t0 = chksum_test_time();
+  for(i = 0; i < CHKSUM_TEST_BENCH_LOOPS; i++)
+  {
+    sink += lwip_chksum_port(&ChksumTestSrc[1], CHKSUM_TEST_BENCH_LEN);
+  }
+  t_odd = (chksum_test_time() - t0) / CHKSUM_TEST_BENCH_LOOPS;
+
+  t0 = chksum_test_time();
+  for(i = 0; i < CHKSUM_TEST_BENCH_LOOPS; i++)
+  {
+    sink += lwip_chksum_copy_port(ChksumTestDst, ChksumTestSrc, CHKSUM_TEST_BENCH_LEN);
+  }
+  t_copy = (chksum_test_time() - t0) / CHKSUM_TEST_BENCH_LOOPS;
+
+  log_i("chksum test: %u rounds, %d errors", (unsigned)CHKSUM_PORT_TEST_ROUNDS, errors);
+  log_i("  %u bytes, %s: generic %u, port %u (odd address %u), copy+sum %u",
+        (unsigned)CHKSUM_TEST_BENCH_LEN, CHKSUM_TEST_UNIT,
+        (unsigned)t_std, (unsigned)t_port, (unsigned)t_odd, (unsigned)t_copy);
+  log_i("  %s per 100 bytes: generic %u, port %u, copy+sum %u", CHKSUM_TEST_UNIT,
+        (unsigned)(t_std * 100 / CHKSUM_TEST_BENCH_LEN), (unsigned)(t_port * 100 / CHKSUM_TEST_BENCH_LEN),
+        (unsigned)(t_copy * 100 / CHKSUM_TEST_BENCH_LEN));
+
+  return errors;
+}
@@ -0,0 +1,31 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\chksum_port.h
+  * @author  suozhang
+  * @brief   Header for chksum_port.c module
+  ******************************************************************************
+  */
+
+#ifndef __CHKSUM_PORT_H__
+#define __CHKSUM_PORT_H__
+
+#include "lwip/opt.h"
+
+/* Exported constants --------------------------------------------------------*/
+/* below this many bytes lwip_chksum_copy_port() copies then sums, the head
+   and tail handling of the single pass costs more than it saves */
+#ifndef CHKSUM_PORT_COPY_MIN
+#define CHKSUM_PORT_COPY_MIN       64
+#endif
+
+/* random buffers checked against lwIP's generic checksum by lwip_chksum_port_test() */
+#ifndef CHKSUM_PORT_TEST_ROUNDS
+#define CHKSUM_PORT_TEST_ROUNDS    2000
+#endif
+
+/* Exported functions ------------------------------------------------------- */
+u16_t lwip_chksum_port(const void *dataptr, int len);
+u16_t lwip_chksum_copy_port(void *dst, const void *src, u16_t len);
+int lwip_chksum_port_test(void);
+
+#endif
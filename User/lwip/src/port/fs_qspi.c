@@ -0,0 +1,274 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\fs_qspi.c
+  * @author  suozhang
+  * @brief   httpd custom files served from the memory-mapped QSPI flash.
+  *
+  *          "makefsdata -img" writes the web pages, HTTP header included,
+  *          into one image programmed at FS_QSPI_IMAGE_OFFSET of the W25Q256.
+  *          With the flash memory-mapped (QSPI_MemoryMapped()) fs_open_custom()
+  *          points the file straight into it: httpd hands these persistent
+  *          data to tcp_write() without TCP_WRITE_FLAG_COPY, the segments
+  *          reference the flash (PBUF_ROM) and the Ethernet DMA reads it.
+  *          Files missing from the image, or all of them without a valid
+  *          image, come from the fsdata.c compiled in.
+  *          Before the flash leaves the memory-mapped mode to be rewritten
+  *          fs_qspi_suspend() stops serving the image and reports when no
+  *          open file and no TCP segment still references it.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "lwip/opt.h"
+#include "lwip/apps/httpd_opts.h"
+
+#if LWIP_HTTPD_CUSTOM_FILES
+
+#include "lwip/def.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/apps/fs.h"
+#include "fs_qspi.h"
+#include "bsp_qspi_w25q256.h"
+#include <string.h>
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "fs_qspi_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+/* Private define ------------------------------------------------------------*/
+#define FS_QSPI_IMAGE_ADDR         (QSPI_MMAP_ADDR + FS_QSPI_IMAGE_OFFSET)
+
+/* Private variables ---------------------------------------------------------*/
+/* the image in the flash, NULL when there is no valid one */
+static const struct fs_qspi_hdr *fs_qspi_img;
+
+/* files of the image opened by httpd and not closed yet */
+static int fs_qspi_open_files;
+
+static u32_t fs_qspi_crc_table[256];
+
+/* Private functions ---------------------------------------------------------*/
+static u32_t fs_qspi_name_hash(const char *name)
+{
+  u32_t h = 2166136261UL;
+
+  while(*name)
+  {
+    h = (h ^ (u8_t)*name++) * 16777619UL;
+  }
+  return h;
+}
+
+/* an offset / length pair of the image that stays inside it */
+static int fs_qspi_in_image(const struct fs_qspi_hdr *img, u32_t off, u32_t len)
+{
+  return (off >= sizeof(struct fs_qspi_hdr)) && (off <= img->size) && (len <= img->size - off);
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  CRC-32 (gzip / makefsdata polynomial), table driven.
+  * @param  crc: 0 to start, else the result of the previous call
+  * @param  data: the bytes
+  * @param  len: their number
+  * @retval the updated CRC
+  */
+u32_t fs_qspi_crc32(u32_t crc, const void *data, u32_t len)
+{
+  const u8_t *p = (const u8_t *)data;
+  u32_t i, k, c;
+
+  if(fs_qspi_crc_table[1] == 0)
+  {
+    for(i = 0; i < 256; i++)
+    {
+      c = i;
+      for(k = 0; k < 8; k++)
+      {
+        c = (c & 1) ? (0xEDB88320UL ^ (c >> 1)) : (c >> 1);
+      }
+      fs_qspi_crc_table[i] = c;
+    }
+  }
+
+  crc = ~crc;
+  while(len--)
+  {
+    crc = fs_qspi_crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+/**
+  * @brief  Look for the image in the memory-mapped flash. Call it before
+  *         httpd_init(), again (in the tcpip thread) after the image has been
+  *         rewritten.
+  * @param  None
+  * @retval number of files in the image, 0 when there is no valid image
+  */
+int fs_qspi_init(void)
+{
+  const struct fs_qspi_hdr *img = (const struct fs_qspi_hdr *)FS_QSPI_IMAGE_ADDR;
+  const struct fs_qspi_entry *entry;
+  u32_t i;
+
+  fs_qspi_img = NULL;
+
+  if((img->magic != FS_QSPI_MAGIC) || (img->version != FS_QSPI_VERSION) ||
+     (img->size > FS_QSPI_IMAGE_MAX) || (img->size < sizeof(struct fs_qspi_hdr)) ||
+     ((img->size - sizeof(struct fs_qspi_hdr)) / sizeof(struct fs_qspi_entry) < img->count))
+  {
+    log_w("no file system image in the QSPI flash, using fsdata.c");
+    return 0;
+  }
+
+#if FS_QSPI_CHECK_CRC
+  if(fs_qspi_crc32(0, img + 1, img->size - sizeof(struct fs_qspi_hdr)) != img->crc)
+  {
+    log_e("file system image in the QSPI flash: CRC error, using fsdata.c");
+    return 0;
+  }
+#endif
+
+  /* check the entries once, fs_open_custom() then trusts them */
+  entry = (const struct fs_qspi_entry *)(img + 1);
+  for(i = 0; i < img->count; i++, entry++)
+  {
+    if(!fs_qspi_in_image(img, entry->name_off, 1) ||
+       !fs_qspi_in_image(img, entry->data_off, entry->data_len) ||
+       ((entry->etag_off != 0) && !fs_qspi_in_image(img, entry->etag_off, 1)) ||
+       ((entry->nm_off != 0) && !fs_qspi_in_image(img, entry->nm_off, entry->nm_len)) ||
+       ((entry->flags & FS_FILE_FLAGS_HEADER_INCLUDED) == 0))
+    {
+      log_e("file system image in the QSPI flash: bad entry %u, using fsdata.c", (unsigned)i);
+      return 0;
+    }
+  }
+
+  fs_qspi_img = img;
+  log_i("file system image in the QSPI flash: %u files, %u bytes", (unsigned)img->count, (unsigned)img->size);
+  return img->count;
+}
+
+/**
+  * @brief  Stop serving the image, new requests get fsdata.c. Call it in the
+  *         tcpip thread (or with the core locked) until it returns 0, then
+  *         the flash may leave the memory-mapped mode; fs_qspi_init() serves
+  *         the (new) image again.
+  * @param  force: 1 to reset the httpd connections still sending from the flash
+  * @retval 1 while files are open or httpd segments are not acknowledged
+  */
+int fs_qspi_suspend(int force)
+{
+  struct tcp_pcb *pcb;
+  int busy = (fs_qspi_open_files != 0);
+
+  fs_qspi_img = NULL;
+
+  /* the segments reference the flash until acknowledged (retransmissions) */
+  for(pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next)
+  {
+    if((pcb->local_port == HTTPD_SERVER_PORT) && ((pcb->unsent != NULL) || (pcb->unacked != NULL)))
+    {
+      busy = 1;
+    }
+  }
+  if(!busy || !force)
+  {
+    return busy;
+  }
+
+  log_w("resetting httpd connections still sending from the QSPI flash");
+  do
+  {
+    for(pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next)
+    {
+      if(pcb->local_port == HTTPD_SERVER_PORT)
+      {
+        tcp_abort(pcb);                  /* unlinks it, start over */
+        break;
+      }
+    }
+  } while(pcb != NULL);
+
+  return (fs_qspi_open_files != 0);
+}
+
+/**
+  * @brief  The image found by fs_qspi_init().
+  * @param  None
+  * @retval the image header in the flash, NULL without a valid image
+  */
+const struct fs_qspi_hdr *fs_qspi_image(void)
+{
+  return fs_qspi_img;
+}
+
+/**
+  * @brief  httpd hook: open a file of the image.
+  * @param  file: filled in when the file is found
+  * @param  name: the URI, e.g. "/index.html"
+  * @retval 1 when found, 0 to look in fsdata.c
+  */
+int fs_open_custom(struct fs_file *file, const char *name)
+{
+  const struct fs_qspi_hdr *img = fs_qspi_img;
+  const struct fs_qspi_entry *entry;
+  const char *base = (const char *)img;
+  u32_t hash;
+  u32_t i;
+
+  if(img == NULL)
+  {
+    return 0;
+  }
+
+  hash = fs_qspi_name_hash(name);
+  entry = (const struct fs_qspi_entry *)(img + 1);
+  for(i = 0; i < img->count; i++, entry++)
+  {
+    if((entry->name_hash == hash) && (strcmp(base + entry->name_off, name) == 0))
+    {
+      memset(file, 0, sizeof(struct fs_file));
+      file->data = base + entry->data_off;
+      file->len = (int)entry->data_len;
+      file->index = (int)entry->data_len;
+      file->flags = entry->flags;
+#if LWIP_HTTPD_FS_ETAG
+      if((entry->etag_off != 0) && (entry->nm_off != 0))
+      {
+        file->etag = base + entry->etag_off;
+        file->not_modified = base + entry->nm_off;
+        file->not_modified_len = entry->nm_len;
+      }
+#endif /* LWIP_HTTPD_FS_ETAG */
+      fs_qspi_open_files++;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+  * @brief  httpd hook: close a file of the image.
+  * @param  file: the file
+  * @retval None
+  */
+void fs_close_custom(struct fs_file *file)
+{
+  LWIP_UNUSED_ARG(file);
+  fs_qspi_open_files--;
+}
+
+#endif /* LWIP_HTTPD_CUSTOM_FILES */
@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\fs_qspi.h
+  * @author  suozhang
+  * @brief   Header for fs_qspi.c module
+  ******************************************************************************
+  */
+
+#ifndef __FS_QSPI_H__
+#define __FS_QSPI_H__
+
+#include "lwip/opt.h"
+
+/* Exported constants --------------------------------------------------------*/
+/* image written by "makefsdata -img", at this offset in the W25Q256 */
+#ifndef FS_QSPI_IMAGE_OFFSET
+#define FS_QSPI_IMAGE_OFFSET       0
+#endif
+
+/* largest image accepted, bytes */
+#ifndef FS_QSPI_IMAGE_MAX
+#define FS_QSPI_IMAGE_MAX          (8 * 1024 * 1024)
+#endif
+
+/* 1: fs_qspi_init() checks the CRC32 of the whole image */
+#ifndef FS_QSPI_CHECK_CRC
+#define FS_QSPI_CHECK_CRC          1
+#endif
+
+#define FS_QSPI_MAGIC              0x4D495346UL   /* "FSIM" read as little endian */
+#define FS_QSPI_VERSION            1
+
+/* Exported types ------------------------------------------------------------*/
+/*
+ * Image: this header, `count` entries, then per file its name, entity tag and
+ * "304 Not Modified" response (NULL-terminated) and its data, HTTP header
+ * included, 4-byte aligned. Offsets are from the image start, little endian.
+ */
+struct fs_qspi_hdr
+{
+  u32_t magic;
+  u16_t version;
+  u16_t count;                     /* entries */
+  u32_t size;                      /* bytes, header included */
+  u32_t crc;                       /* CRC32 of the bytes after the header */
+};
+
+struct fs_qspi_entry
+{
+  u32_t name_hash;                 /* FNV-1a of the name */
+  u32_t name_off;                  /* "/index.html" */
+  u32_t data_off;
+  u32_t data_len;
+  u32_t etag_off;                  /* "\"xxxxxxxx\"", 0: none */
+  u32_t nm_off;                    /* 304 response, 0: none */
+  u16_t nm_len;
+  u8_t  flags;                     /* FS_FILE_FLAGS_xxx */
+  u8_t  reserved;
+};
+
+/* Exported functions ------------------------------------------------------- */
+int fs_qspi_init(void);
+int fs_qspi_suspend(int force);
+const struct fs_qspi_hdr *fs_qspi_image(void);
+u32_t fs_qspi_crc32(u32_t crc, const void *data, u32_t len);
+
+#endif
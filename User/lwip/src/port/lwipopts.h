@@ -50,6 +50,11 @@
  */
 #define LWIP_NETCONN            1 
 
+/**
+ * LWIP_NETCONN_CALLBACK_ARG==1: user pointer in struct netconn for the netconn callback
+ */
+#define LWIP_NETCONN_CALLBACK_ARG 1 /* netconn_mux ͨڻصҵ, ò */
+
 /**
  * LWIP_IGMP==1: Turn on IGMP module.
  */
@@ -168,6 +173,9 @@
  * 
  * ʹ lwip Ĭϵ ̬ڴأpool ̬ڴ mem ķʽMEM_SIZE Ƕ̬ڴѵĴС
  * LWIP ĵ ڴ  MEM_SIZE ̬ڴ + MEMP ̬ڴpool ĵڴ
+ *
+ * suozhang 2019426: mem_malloc() Ϊ MEM_USE_POOLS ʽ lwippools.h еĳߴּ䣬
+ * ʱ̶Ƭlwippools.h ı MEM_PROFILE ͳɣ mem_profile.c
  * 
 */
 
@@ -175,31 +183,58 @@
 a lot of data that needs to be copied, this should be set high. */
 #define MEM_SIZE                (10*1024) /* Ӧó ʹ ҪƵģֵӦôһ */
 
-/* Relocate the LwIP RAM heap pointer */
+/* MEM_USE_POOLS==1: mem_malloc() takes the smallest free block of the size
+   classes listed in lwippools.h instead of using the first-fit heap */
+#define MEM_USE_POOLS                  1
+#define MEMP_USE_CUSTOM_POOLS          MEM_USE_POOLS
+#define MEM_USE_POOLS_TRY_BIGGER_POOL  1 /* ǰߴ pool ʱ ʹø pool */
+
+/* MEM_PROFILE==1 (MEM_USE_POOLS 0 only): record the heap block sizes and their
+   high-water marks, mem_profile_dump() prints the recommended lwippools.h */
+#define MEM_PROFILE                    0
+#if MEM_PROFILE
+void mem_profile_alloc(unsigned int size);
+void mem_profile_free(unsigned int size);
+#define LWIP_MEM_PROFILE_ALLOC(size)   mem_profile_alloc(size)
+#define LWIP_MEM_PROFILE_FREE(size)    mem_profile_free(size)
+#endif
+
+/* Relocate the LwIP RAM heap pointer (D2 SRAM3, the host build uses a static array) */
+#if !defined(NETIF_HOST)
 #define LWIP_RAM_HEAP_POINTER    (0x30044000)
+#endif
+
+/* TCP_PROFILE_BULK==1: high-bandwidth TCP profile, see the TCP options below.
+   TCP_PROFILE_BULK==0: every connection gets the small 4*TCP_MSS windows. */
+#define TCP_PROFILE_BULK        0
 
 /* MEMP_NUM_PBUF: the number of memp struct pbufs. If the application
    sends a lot of data out of ROM (or other static memory), this
    should be set high. */
+#if TCP_PROFILE_BULK
+#define MEMP_NUM_PBUF           TCP_SND_QUEUELEN /* ÿ(PBUF_REF)͵ıĶռһ */
+#else
 #define MEMP_NUM_PBUF           16 /* Ӧó ʹ ǴROM ģ ҳֵӦôһ */
+#endif
 
 /**
  * MEMP_NUM_NETCONN: the number of struct netconns.
  * (only needed if you use the sequential API, like api_lib.c)
  */
-#define MEMP_NUM_NETCONN        5 /* ϲAPI ʹ NETCONN ĸ UDP TCP */
+#define MEMP_NUM_NETCONN        12 /* ϲAPI ʹ NETCONN ĸ UDP TCPtcp_conn_mgr ÿռһ */
 
 /* MEMP_NUM_UDP_PCB: the number of UDP protocol control blocks. One
    per active UDP "connection". */
-#define MEMP_NUM_UDP_PCB        3 /* ϲAPI ʹ UDP ĸUDP ӽ϶ʱ Ӧֵ */
+#define MEMP_NUM_UDP_PCB        5 /* ϲAPI ʹ UDP ĸUDP ӽ϶ʱ Ӧֵ */
 
 /* MEMP_NUM_TCP_PCB: the number of simulatenously active TCP
    connections. */
-#define MEMP_NUM_TCP_PCB        6 /* ϲAPI ʹ TCP ĸUDP ӽ϶ʱ Ӧֵ */
+#define TCP_SRV_MAX_CLIENTS     16 /* tcp_srv ͬʱĿͻ (HMI/SCADA)ÿֻռһ tcp_pcbռ netconn */
+#define MEMP_NUM_TCP_PCB        (18 + TCP_SRV_MAX_CLIENTS) /* ϲAPI ʹ TCP ĸ TCP_CONN_MGR_MAX Ϸ(iperf, httpd, tcp_srv)ͬһ࿪ 6  */
 
 /* MEMP_NUM_TCP_PCB_LISTEN: the number of listening TCP
    connections. */
-#define MEMP_NUM_TCP_PCB_LISTEN 3 /* ϲAPI ʹ TCP ĸTCP ϶ʱ Ӧֵ */
+#define MEMP_NUM_TCP_PCB_LISTEN 4 /* ϲAPI ʹ TCP ĸTCP ϶ʱ Ӧֵ */
 
 /* MEMP_NUM_TCP_SEG: the number of simultaneously queued TCP
    segments. */
@@ -210,7 +245,7 @@ a lot of data that needs to be copied, this should be set high. */
  * The default number of timeouts is calculated here for all enabled modules.
  * The formula expects settings to be either '0' or '1'.
  */
-#define MEMP_NUM_SYS_TIMEOUT    10 /* ͬʱ ʱ */
+#define MEMP_NUM_SYS_TIMEOUT    18 /* ͬʱ ʱ, TCP/ARP/DHCP ڶʱϸӦ (mqtt_pub, net_stats, tftp, net_boot, tcp_srv ) ̫ */
 
 
 /* ---------- Pbuf options ---------- */
@@ -250,18 +285,50 @@ a lot of data that needs to be copied, this should be set high. */
 /* TCP Maximum segment size. */
 #define TCP_MSS                 (1500 - 40)	  /* TCP_MSS = (Ethernet MTU - IP header size - TCP header size) TCPĶδС */
 
+/* window and send buffer of the control connections, tcp_profile_control() */
+#define TCP_PROFILE_CONTROL_WND      (4*TCP_MSS)
+#define TCP_PROFILE_CONTROL_SND_BUF  (4*TCP_MSS)
+
+#if TCP_PROFILE_BULK
+/*
+ * suozhang 2019427: 󴰿 TCP ã lwiperf / ݴ䡣
+ * - window scaling (RFC 7323), the receive window is held in the Ethernet Rx
+ *   buffers lent to the stack: stm32h7xx_hal_conf.h needs ETH_RX_DESC_CNT 64
+ *   (128 Rx buffers, 64 spares), netif_port.c checks it.
+ * - the TCP_SEG and PBUF (PBUF_REF/ROM) pools grow with TCP_SND_BUF and are
+ *   placed in the FMC SDRAM (MEMP_BULK_SECTION, see arch/cc.h); bulk senders
+ *   should write by reference (no TCP_WRITE_FLAG_COPY) from their own buffers.
+ * - connections opened with tcp_profile_control() keep the 4*TCP_MSS window and
+ *   send buffer, so the data copied for them stays in the SRAM mem_malloc() pools.
+ */
+#define LWIP_WND_SCALE          1
+#define TCP_RCV_SCALE           2             /* windows up to 256 KB */
+#define TCP_WND                 (64*1024)     /* TCP մ */
+#define TCP_SND_BUF             (128*1024)    /* TCP ͻ */
+#define TCP_SND_QUEUELEN        (2 * TCP_SND_BUF / TCP_MSS + 8) /* ÿĶ: ͷ PBUF_RAM +  PBUF_REF */
+#define MEMP_BULK_SECTION       ".SdramLwipSection"
+/* the PBUF_POOL check of init.c does not apply, the Rx frames use the driver
+   buffers (LWIP_SUPPORT_CUSTOM_PBUF); netif_port.c checks TCP_WND against them */
+#define LWIP_DISABLE_TCP_SANITY_CHECKS 1
+#else
 /* TCP sender buffer space (bytes). */
 #define TCP_SND_BUF             (4*TCP_MSS)   /* TCP ͻСֵTCP */
 
 /* TCP receive window. */
 #define TCP_WND                 (4*TCP_MSS)   /* TCP ʹڴСֵTCP */
+#endif
 
 
 /* ---------- DHCP options ---------- */
 /* Define LWIP_DHCP to 1 if you want DHCP configuration of
    interfaces. DHCP is not implemented in lwIP 0.5.1, however, so
    turning this on does currently not work. */
-#define LWIP_DHCP               0
+#define LWIP_DHCP               1
+
+/* net_boot.c: ϴεԼڱ SRAM, ϵ INIT-REBOOT ȷϲʹøõַ;
+   Լ Rapid Commit (RFC 4039) .  ARP ͻ, ǰԼ 1  */
+#define LWIP_DHCP_RAPID_COMMIT  1
+#define DHCP_DOES_ARP_CHECK     0
 
 
 /* ---------- UDP options ---------- */
@@ -270,7 +337,22 @@ a lot of data that needs to be copied, this should be set high. */
 
 
 /* ---------- Statistics options ---------- */
-#define LWIP_STATS 0
+/* counters read by net_stats.c and lwiperf_service.c. Each is a plain increment
+   (SYS_STATS/MEMP_STATS inside the existing critical sections), cheap enough for
+   release builds, see net_stats_overhead(). IP_FRAG/IP_REASSEMBLY are off. */
+#define LWIP_STATS 1
+#define LWIP_STATS_DISPLAY      0
+#define LINK_STATS              1
+#define ETHARP_STATS            1
+#define IP_STATS                1
+#define IPFRAG_STATS            0
+#define ICMP_STATS              1
+#define UDP_STATS               1
+#define SYS_STATS               1
+#define TCP_STATS               1
+#define MEM_STATS               1
+#define MEMP_STATS              1
+#define MIB2_STATS              1
 #define LWIP_PROVIDE_ERRNO 1
 
 /* ---------- link callback options ---------- */
@@ -284,8 +366,11 @@ a lot of data that needs to be copied, this should be set high. */
 The STM32F4x7 allows computing and verifying the IP, UDP, TCP and ICMP checksums by hardware:
  - To use this feature let the following define uncommented.
  - To disable it and process by CPU comment the  the checksum.
+ - The host build (NETIF_HOST, netif_host.c) has no offload engine.
 */
+#if !defined(NETIF_HOST)
 #define CHECKSUM_BY_HARDWARE 
+#endif
 
 
 #ifdef CHECKSUM_BY_HARDWARE
@@ -318,8 +403,19 @@ The STM32F4x7 allows computing and verifying the IP, UDP, TCP and ICMP checksums
   #define CHECKSUM_CHECK_TCP              1
   /* CHECKSUM_CHECK_ICMP==1: Check checksums by hardware for incoming ICMP packets.*/  
   #define CHECKSUM_GEN_ICMP               1
+  /* LWIP_CHECKSUM_ON_COPY==1: TCP/UDP data copied into pbufs is summed in the same pass (LWIP_CHKSUM_COPY) */
+  #define LWIP_CHECKSUM_ON_COPY           1
 #endif
 
+/* Checksums still computed by the CPU (loopback, ICMP, the host build): 32-bit word
+   kernel of chksum_port.c. lwIP's generic version (algorithm 2) is kept as the
+   reference of lwip_chksum_port_test(). */
+#define LWIP_CHKSUM_ALGORITHM           2
+#define LWIP_CHKSUM                     lwip_chksum_port
+#define LWIP_CHKSUM_COPY(dst, src, len) lwip_chksum_copy_port(dst, src, len)
+unsigned short lwip_chksum_port(const void *dataptr, int len);
+unsigned short lwip_chksum_copy_port(void *dst, const void *src, unsigned short len);
+
 
 #define ETHARP_TRUST_IP_MAC     0
 #define IP_REASSEMBLY           0
@@ -355,6 +451,21 @@ The STM32F4x7 allows computing and verifying the IP, UDP, TCP and ICMP checksums
 
 
 #define MQTT_DEBUG                  LWIP_DBG_OFF
+/* mqtt_pub.c: a whole MQTT_PUB_BATCH_SIZE publish must fit the output ring, and one
+   request slot per QoS1 publish of the window waiting for its PUBACK */
+#define MQTT_OUTPUT_RINGBUF_SIZE    4096
+#define MQTT_REQ_MAX_IN_FLIGHT      16
+
+/* httpd: ҳڴӳ QSPI Flash (port/fs_qspi.c, makefsdata -img)ûоʱ fsdata.c
+   ļݲֱӽ tcp_write()HTTP/1.1 ӱ֣If-None-Match ʱظ 304 */
+#define LWIP_HTTPD_CUSTOM_FILES           1
+#define LWIP_HTTPD_SUPPORT_11_KEEPALIVE   1
+#define LWIP_HTTPD_SUPPORT_11_PERSISTENT  1
+#define LWIP_HTTPD_FS_ETAG                1
+#define HTTPD_LIMIT_SENDING_TO_2MSS       0   /* ÿηͻ */
+
+/* tftp: ϴд QSPI Flash (tftp_qspi.c)blksize ѡ 1468 ֽڣһݿһ̫֡ */
+#define TFTP_MAX_BLKSIZE                  1468
 
 
 /*
@@ -0,0 +1,40 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\lwippools.h
+  * @author  suozhang
+  * @brief   mem_malloc() size classes, used with MEM_USE_POOLS.
+  *
+  *          A request is served by the smallest class it fits in (the next
+  *          ones too with MEM_USE_POOLS_TRY_BIGGER_POOL). The classes must be
+  *          listed in ascending size. Sizes are the payload; the pool adds
+  *          the memp_malloc_helper header itself.
+  *
+  *          To regenerate the table, build with MEM_USE_POOLS 0 and
+  *          MEM_PROFILE 1, run the real traffic, then paste the table
+  *          printed by mem_profile_dump(). In pool mode mem_profile_dump()
+  *          prints the high-water mark and the failures of each class.
+  *
+  *          Initial table, sized from the allocations of this application:
+  *          - 128:  TCP control segments (ACK/SYN/FIN), ARP, small UDP
+  *          - 512:  short application writes copied by netconn_write
+  *          - 1536: full TCP_MSS segments (54 bytes of headers + 16 bytes
+  *                  of struct pbuf + 1460), up to TCP_SND_BUF per connection
+  *
+  *          With TCP_PROFILE_BULK every segment written by reference takes
+  *          a 128 bytes header block, up to TCP_SND_QUEUELEN / 2 of them.
+  ******************************************************************************
+  */
+
+#if MEM_USE_POOLS
+
+LWIP_MALLOC_MEMPOOL_START
+#if TCP_PROFILE_BULK
+LWIP_MALLOC_MEMPOOL(16 + TCP_SND_QUEUELEN / 2, 128)
+#else
+LWIP_MALLOC_MEMPOOL(16, 128)
+#endif
+LWIP_MALLOC_MEMPOOL(8,  512)
+LWIP_MALLOC_MEMPOOL(8,  1536)
+LWIP_MALLOC_MEMPOOL_END
+
+#endif /* MEM_USE_POOLS */
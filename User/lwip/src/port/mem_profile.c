@@ -0,0 +1,245 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\mem_profile.c
+  * @author  suozhang
+  * @brief   lwIP heap profiling, used to size the lwippools.h table.
+  *
+  *          With MEM_PROFILE (heap mode) mem.c reports every block taken or
+  *          given back; the blocks are counted per MEM_PROFILE_GRANULE size
+  *          bin with their high-water mark. mem_profile_dump() prints the
+  *          histogram and a table of at most MEM_PROFILE_CLASSES size classes
+  *          that holds the high-water marks with the least memory.
+  *          With MEM_USE_POOLS it prints the use of each size class instead.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/mem.h"
+#include "lwip/memp.h"
+#include "lwip/stats.h"
+#include "lwip/sys.h"
+#include "mem_profile.h"
+#include <string.h>
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "mem_profile_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#if MEM_PROFILE && MEM_USE_POOLS
+#error "MEM_PROFILE profiles the heap, build it with MEM_USE_POOLS 0"
+#endif
+
+/* Private define ------------------------------------------------------------*/
+#define MEM_PROFILE_BINS                       (MEM_PROFILE_MAX_SIZE / MEM_PROFILE_GRANULE + 1)
+
+/* Private variables ---------------------------------------------------------*/
+#if MEM_PROFILE
+
+typedef struct
+{
+  u32_t allocs;                    /* blocks taken */
+  u16_t used;                      /* blocks in use */
+  u16_t peak;                      /* high-water mark of used */
+  u16_t max_size;                  /* largest block seen */
+} MemProfBin_t;
+
+/* updated by mem.c inside its critical sections */
+static MemProfBin_t MemProfBin[MEM_PROFILE_BINS];
+
+/* snapshot and class search, used by mem_profile_dump() only */
+static MemProfBin_t MemProfSnap[MEM_PROFILE_BINS];
+static u8_t  MemProfUsedBin[MEM_PROFILE_BINS];
+static u32_t MemProfCost[MEM_PROFILE_CLASSES + 1][MEM_PROFILE_BINS + 1];
+static u8_t  MemProfSplit[MEM_PROFILE_CLASSES + 1][MEM_PROFILE_BINS + 1];
+
+/* Private functions ---------------------------------------------------------*/
+static u32_t mem_profile_bin(unsigned int size)
+{
+  u32_t bin = (size > 0) ? (size - 1) / MEM_PROFILE_GRANULE : 0;
+
+  return (bin < MEM_PROFILE_BINS) ? bin : (MEM_PROFILE_BINS - 1);
+}
+
+/**
+  * @brief  mem.c hook: a block of size bytes was taken from the heap.
+  *         Called with the heap protected.
+  */
+void mem_profile_alloc(unsigned int size)
+{
+  MemProfBin_t *bin = &MemProfBin[mem_profile_bin(size)];
+
+  bin->allocs++;
+  if(++bin->used > bin->peak)
+  {
+    bin->peak = bin->used;
+  }
+  if(size > bin->max_size)
+  {
+    bin->max_size = (u16_t)size;
+  }
+}
+
+/**
+  * @brief  mem.c hook: a block of size bytes went back to the heap.
+  *         Called with the heap protected.
+  */
+void mem_profile_free(unsigned int size)
+{
+  MemProfBin_t *bin = &MemProfBin[mem_profile_bin(size)];
+
+  if(bin->used > 0)
+  {
+    bin->used--;
+  }
+}
+
+/* blocks to provision for used bins first..last: their high-water marks, plus 25% */
+static u32_t mem_profile_class_num(u32_t first, u32_t last)
+{
+  u32_t i, num = 0;
+
+  for(i = first; i <= last; i++)
+  {
+    num += MemProfSnap[MemProfUsedBin[i]].peak;
+  }
+  return num + num / 4 + 1;
+}
+
+/* bytes of the class covering used bins first..last */
+static u32_t mem_profile_class_cost(u32_t first, u32_t last)
+{
+  return mem_profile_class_num(first, last) *
+         LWIP_MEM_ALIGN_SIZE(MemProfSnap[MemProfUsedBin[last]].max_size);
+}
+
+/**
+  * @brief  Print the size histogram and the recommended lwippools.h table.
+  *         The classes split the sorted bins so that the sum over the
+  *         classes of (size of its largest block) * (its blocks) is minimal.
+  */
+static void mem_profile_dump_heap(void)
+{
+  u32_t i, j, k, classes, used = 0, cost, total = 0;
+  u32_t last[MEM_PROFILE_CLASSES];
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  MEMCPY(MemProfSnap, MemProfBin, sizeof(MemProfSnap));
+  SYS_ARCH_UNPROTECT(lev);
+
+  log_i("mem_malloc() histogram, block size: taken, in use, high-water");
+  for(i = 0; i < MEM_PROFILE_BINS; i++)
+  {
+    if(MemProfSnap[i].allocs != 0)
+    {
+      log_i("  <= %4u: %8u %4u %4u", (unsigned)MemProfSnap[i].max_size, (unsigned)MemProfSnap[i].allocs,
+            (unsigned)MemProfSnap[i].used, (unsigned)MemProfSnap[i].peak);
+      MemProfUsedBin[used++] = (u8_t)i;
+    }
+  }
+  if(used == 0)
+  {
+    return;
+  }
+
+  classes = LWIP_MIN(used, MEM_PROFILE_CLASSES);
+
+  /* MemProfCost[k][i]: best cost of the first i used bins in k classes */
+  for(i = 1; i <= used; i++)
+  {
+    MemProfCost[1][i] = mem_profile_class_cost(0, i - 1);
+    MemProfSplit[1][i] = 0;
+  }
+  for(k = 2; k <= classes; k++)
+  {
+    for(i = k; i <= used; i++)
+    {
+      MemProfCost[k][i] = 0xFFFFFFFFU;
+      for(j = k - 1; j < i; j++)
+      {
+        cost = MemProfCost[k - 1][j] + mem_profile_class_cost(j, i - 1);
+        if(cost < MemProfCost[k][i])
+        {
+          MemProfCost[k][i] = cost;
+          MemProfSplit[k][i] = (u8_t)j;
+        }
+      }
+    }
+  }
+
+  /* walk the splits back, last[] gets the last used bin of each class */
+  for(k = classes, i = used; k > 0; k--)
+  {
+    last[k - 1] = i - 1;
+    i = MemProfSplit[k][i];
+  }
+
+#if MEM_STATS
+  log_i("recommended lwippools.h, heap high-water %u of %u bytes:",
+        (unsigned)lwip_stats.mem.max, (unsigned)MEM_SIZE);
+#endif
+  log_i("LWIP_MALLOC_MEMPOOL_START");
+  for(k = 0, j = 0; k < classes; k++)
+  {
+    log_i("LWIP_MALLOC_MEMPOOL(%u, %u)", (unsigned)mem_profile_class_num(j, last[k]),
+          (unsigned)LWIP_MEM_ALIGN_SIZE(MemProfSnap[MemProfUsedBin[last[k]]].max_size));
+    total += mem_profile_class_cost(j, last[k]);
+    j = last[k] + 1;
+  }
+  log_i("LWIP_MALLOC_MEMPOOL_END");
+  log_i("pools payload %u bytes", (unsigned)total);
+}
+
+#endif /* MEM_PROFILE */
+
+#if MEM_USE_POOLS
+/**
+  * @brief  Print the use of each mem_malloc() size class.
+  */
+static void mem_profile_dump_pools(void)
+{
+#if MEMP_STATS
+  u32_t i;
+
+  log_i("mem_malloc() pools, size: total, in use, high-water, failed");
+  for(i = MEMP_POOL_FIRST; i <= MEMP_POOL_LAST; i++)
+  {
+    log_i("  %4u: %4u %4u %4u %4u",
+          (unsigned)(memp_pools[i]->size - LWIP_MEM_ALIGN_SIZE(sizeof(struct memp_malloc_helper))),
+          (unsigned)lwip_stats.memp[i]->avail, (unsigned)lwip_stats.memp[i]->used,
+          (unsigned)lwip_stats.memp[i]->max, (unsigned)lwip_stats.memp[i]->err);
+  }
+#endif /* MEMP_STATS */
+}
+#endif /* MEM_USE_POOLS */
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  Log the mem_malloc() profile: the recommended lwippools.h table
+  *         (MEM_PROFILE) or the use of the size classes (MEM_USE_POOLS).
+  * @retval None
+  */
+void mem_profile_dump(void)
+{
+#if MEM_PROFILE
+  mem_profile_dump_heap();
+#elif MEM_USE_POOLS
+  mem_profile_dump_pools();
+#elif MEM_STATS
+  log_i("mem_malloc() heap: %u of %u bytes in use, high-water %u, failed %u",
+        (unsigned)lwip_stats.mem.used, (unsigned)MEM_SIZE,
+        (unsigned)lwip_stats.mem.max, (unsigned)lwip_stats.mem.err);
+#endif
+}
@@ -0,0 +1,32 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\mem_profile.h
+  * @author  suozhang
+  * @brief   Header for mem_profile.c module
+  ******************************************************************************
+  */
+
+#ifndef __MEM_PROFILE_H__
+#define __MEM_PROFILE_H__
+
+#include "lwip/opt.h"
+
+/* Exported constants --------------------------------------------------------*/
+/* histogram bin width and largest size tracked, bigger requests share the last bin */
+#ifndef MEM_PROFILE_GRANULE
+#define MEM_PROFILE_GRANULE        32
+#endif
+
+#ifndef MEM_PROFILE_MAX_SIZE
+#define MEM_PROFILE_MAX_SIZE       1600
+#endif
+
+/* number of size classes of the recommended lwippools.h table */
+#ifndef MEM_PROFILE_CLASSES
+#define MEM_PROFILE_CLASSES        4
+#endif
+
+/* Exported functions ------------------------------------------------------- */
+void mem_profile_dump(void);
+
+#endif
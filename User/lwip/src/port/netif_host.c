@@ -0,0 +1,614 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\netif_host.c
+  * @author  suozhang
+  * @brief   Host (Linux) backend of the Ethernet netif, replaces netif_port.c
+  *          when the stack is built with the FreeRTOS POSIX port (NETIF_HOST).
+  ******************************************************************************
+  * @attention
+  *
+  * Frames are exchanged with a Linux TAP device, or read from a pcap file
+  * (replay) with the transmitted frames optionally written to another pcap
+  * file. low_level_input()/low_level_output() keep the contract of the
+  * target driver: one frame per pbuf in, one pbuf chain per frame out, the
+  * input task hands frames to the stack in budgeted passes under the TCPIP
+  * core lock. lwipopts.h is used unchanged except for the hardware checksum
+  * offload and the heap placement, see NETIF_HOST in lwipopts.h.
+  *
+  * Environment variables:
+  *   NETIF_HOST_TAP       TAP interface name, default "tap0"
+  *   NETIF_HOST_PCAP      pcap file to replay instead of the TAP device
+  *   NETIF_HOST_PCAP_OUT  pcap file receiving the transmitted frames
+  *   NETIF_HOST_REALTIME  "1": replay with the capture timing, otherwise
+  *                        as fast as the stack consumes the frames
+  *
+  * TAP setup (once, as root):
+  *   ip tuntap add dev tap0 mode tap user $USER
+  *   ip addr add 192.168.0.22/24 dev tap0 && ip link set tap0 up
+  *
+  ******************************************************************************
+  */
+
+#if defined(NETIF_HOST) && defined(__linux__)
+
+/* Includes ------------------------------------------------------------------*/
+#include "lwip/opt.h"
+#include "lwip/timeouts.h"
+#include "netif/ethernet.h"
+#include "netif/etharp.h"
+#include "lwip/stats.h"
+#include "lwip/snmp.h"
+#include "lwip/tcpip.h"
+#include "netif_port.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+
+/* Scheduler includes */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "netif_host_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+/* Private define ------------------------------------------------------------*/
+/* Stack size of the interface thread */
+#define INTERFACE_THREAD_STACK_SIZE            ( 350 )
+#define INTERFACE_TASK_PRIORITY		  		 			 ( configMAX_PRIORITIES - 1 )
+
+/* Define those to better describe your network interface. */
+#define IFNAME0 's'
+#define IFNAME1 'z'
+
+/* same MAC address as the board, see stm32h7xx_hal_conf.h */
+#define ETH_MAC_ADDR0    ((uint8_t)0x02)
+#define ETH_MAC_ADDR1    ((uint8_t)0x00)
+#define ETH_MAC_ADDR2    ((uint8_t)0x00)
+#define ETH_MAC_ADDR3    ((uint8_t)0x00)
+#define ETH_MAC_ADDR4    ((uint8_t)0x00)
+#define ETH_MAC_ADDR5    ((uint8_t)0x00)
+
+#define ETH_MAX_FRAME_SIZE                     ( 1536 )
+
+#ifndef ETH_RX_POLL_BUDGET
+#define ETH_RX_POLL_BUDGET                     ( 8 )
+#endif
+
+/* pcap file format */
+#define PCAP_MAGIC_USEC                        ( 0xa1b2c3d4UL )
+#define PCAP_MAGIC_NSEC                        ( 0xa1b23c4dUL )
+#define PCAP_LINKTYPE_ETHERNET                 ( 1 )
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int32_t  thiszone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t network;
+} PcapFileHdr_t;
+
+typedef struct
+{
+  uint32_t ts_sec;
+  uint32_t ts_frac;  /* usec or nsec, depending on the file magic */
+  uint32_t incl_len;
+  uint32_t orig_len;
+} PcapRecHdr_t;
+
+/* Private variables ---------------------------------------------------------*/
+static int    TapFd = -1;
+static FILE  *PcapIn;
+static FILE  *PcapOut;
+static int    PcapSwapped;       /* file written with the other byte order */
+static int    PcapNsec;          /* nanosecond timestamps */
+static int    PcapRealtime;
+static uint64_t PcapFirstTs;     /* first record timestamp, ns */
+static uint64_t PcapStartNs;     /* host time when replay started, ns */
+
+static struct ethernetif_stats EthIfStats; /* driver counters, see ethernetif_get_stats() */
+
+/* Private function prototypes -----------------------------------------------*/
+void ethernetif_input( void * argument );
+static uint32_t low_level_rx_poll(struct netif *netif, uint32_t budget);
+
+/* Private functions ---------------------------------------------------------*/
+static uint32_t pcap_u32(uint32_t v)
+{
+  if(PcapSwapped)
+  {
+    v = ((v & 0xff) << 24) | ((v & 0xff00) << 8) | ((v >> 8) & 0xff00) | (v >> 24);
+  }
+  return v;
+}
+
+static uint64_t host_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+  * @brief Open the TAP device named by NETIF_HOST_TAP.
+  * @retval 0 if OK, -1 if ERROR
+  */
+static int low_level_tap_open(void)
+{
+  struct ifreq ifr;
+  const char *name = getenv("NETIF_HOST_TAP");
+
+  if(name == NULL)
+  {
+    name = "tap0";
+  }
+
+  TapFd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+  if(TapFd < 0)
+  {
+    log_e("open /dev/net/tun failed, errno %d", errno);
+    return -1;
+  }
+
+  memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+  strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+
+  if(ioctl(TapFd, TUNSETIFF, (void *)&ifr) < 0)
+  {
+    log_e("TUNSETIFF %s failed, errno %d", name, errno);
+    close(TapFd);
+    TapFd = -1;
+    return -1;
+  }
+
+  log_i("netif on TAP device %s", ifr.ifr_name);
+  return 0;
+}
+
+/**
+  * @brief Open the pcap replay file and, if requested, the capture file.
+  * @retval 0 if OK, -1 if ERROR
+  */
+static int low_level_pcap_open(const char *path)
+{
+  PcapFileHdr_t hdr;
+  const char *out = getenv("NETIF_HOST_PCAP_OUT");
+  const char *realtime = getenv("NETIF_HOST_REALTIME");
+
+  PcapIn = fopen(path, "rb");
+  if(PcapIn == NULL || fread(&hdr, sizeof(hdr), 1, PcapIn) != 1)
+  {
+    log_e("cannot read pcap file %s", path);
+    return -1;
+  }
+
+  PcapSwapped = 0;
+  if(hdr.magic != PCAP_MAGIC_USEC && hdr.magic != PCAP_MAGIC_NSEC)
+  {
+    PcapSwapped = 1;
+  }
+  PcapNsec = (pcap_u32(hdr.magic) == PCAP_MAGIC_NSEC);
+
+  if((pcap_u32(hdr.magic) != PCAP_MAGIC_USEC && !PcapNsec) ||
+     pcap_u32(hdr.network) != PCAP_LINKTYPE_ETHERNET)
+  {
+    log_e("%s is not an Ethernet pcap file", path);
+    return -1;
+  }
+
+  PcapRealtime = (realtime != NULL && realtime[0] == '1');
+  PcapFirstTs = 0;
+
+  if(out != NULL)
+  {
+    PcapOut = fopen(out, "wb");
+    if(PcapOut != NULL)
+    {
+      hdr.magic = PCAP_MAGIC_USEC;
+      hdr.version_major = 2;
+      hdr.version_minor = 4;
+      hdr.thiszone = 0;
+      hdr.sigfigs = 0;
+      hdr.snaplen = ETH_MAX_FRAME_SIZE;
+      hdr.network = PCAP_LINKTYPE_ETHERNET;
+      fwrite(&hdr, sizeof(hdr), 1, PcapOut);
+    }
+  }
+
+  log_i("netif replaying %s%s", path, PcapRealtime ? " in real time" : "");
+  return 0;
+}
+
+/*******************************************************************************
+                       LL Driver Interface ( LwIP stack --> host)
+*******************************************************************************/
+/**
+  * @brief In this function, the backend is opened.
+  * Called from ethernetif_init().
+  *
+  * @param netif the already initialized lwip network interface structure
+  *        for this ethernetif
+  */
+static void low_level_init(struct netif *netif)
+{
+  const char *pcap = getenv("NETIF_HOST_PCAP");
+  int ret;
+
+  /* set MAC hardware address length */
+  netif->hwaddr_len = ETH_HWADDR_LEN;
+
+  /* set MAC hardware address */
+  netif->hwaddr[0] =  ETH_MAC_ADDR0;
+  netif->hwaddr[1] =  ETH_MAC_ADDR1;
+  netif->hwaddr[2] =  ETH_MAC_ADDR2;
+  netif->hwaddr[3] =  ETH_MAC_ADDR3;
+  netif->hwaddr[4] =  ETH_MAC_ADDR4;
+  netif->hwaddr[5] =  ETH_MAC_ADDR5;
+
+  /* maximum transfer unit */
+  netif->mtu = 1500;
+
+  /* device capabilities */
+  /* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
+  netif->flags |= NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP;
+
+  ret = (pcap != NULL) ? low_level_pcap_open(pcap) : low_level_tap_open();
+
+  /* create the task that handles the host frames */
+  xTaskCreate( ethernetif_input, "eth_if", INTERFACE_THREAD_STACK_SIZE, netif, INTERFACE_TASK_PRIORITY, NULL);
+
+  if(ret == 0)
+  {
+    netif_set_up(netif);
+    netif_set_link_up(netif);
+  }
+}
+
+/**
+  * @brief Transmit a frame: the pbuf chain is flattened and written to the TAP
+  * device or to the capture file. Same contract as the target driver.
+  *
+  * @param netif the lwip network interface structure for this ethernetif
+  * @param p the MAC packet to send (e.g. IP packet including MAC addresses and type)
+  * @return ERR_OK if the packet could be sent
+  *         an err_t value if the packet couldn't be sent
+  */
+static err_t low_level_output(struct netif *netif, struct pbuf *p)
+{
+  uint8_t frame[ETH_MAX_FRAME_SIZE];
+  uint16_t framelen;
+  PcapRecHdr_t rec;
+  uint64_t now;
+
+  if(p->tot_len > sizeof(frame))
+  {
+    EthIfStats.tx_dropped++;
+    return ERR_IF;
+  }
+
+  framelen = pbuf_copy_partial(p, frame, p->tot_len, 0);
+
+  if(TapFd >= 0)
+  {
+    if(write(TapFd, frame, framelen) != (ssize_t)framelen)
+    {
+      EthIfStats.tx_dropped++;
+      return ERR_IF;
+    }
+  }
+  else if(PcapOut != NULL)
+  {
+    now = host_now_ns();
+    rec.ts_sec = (uint32_t)(now / 1000000000ULL);
+    rec.ts_frac = (uint32_t)((now % 1000000000ULL) / 1000);
+    rec.incl_len = framelen;
+    rec.orig_len = framelen;
+    fwrite(&rec, sizeof(rec), 1, PcapOut);
+    fwrite(frame, 1, framelen, PcapOut);
+  }
+
+  /* written synchronously: queued and completed at once */
+  EthIfStats.tx_frames++;
+  EthIfStats.tx_completed++;
+  EthIfStats.tx_bytes += framelen;
+
+  return ERR_OK;
+}
+
+/**
+  * @brief Read one frame from the backend into a pbuf.
+  *
+  * @param netif the lwip network interface structure for this ethernetif
+  * @return a pbuf filled with the received packet (including MAC header)
+  *         NULL if no frame is pending or on memory error
+  */
+static struct pbuf * low_level_input(struct netif *netif)
+{
+  uint8_t frame[ETH_MAX_FRAME_SIZE];
+  ssize_t framelength = 0;
+  struct pbuf *p;
+  PcapRecHdr_t rec;
+  uint64_t ts;
+
+  if(TapFd >= 0)
+  {
+    framelength = read(TapFd, frame, sizeof(frame));
+    if(framelength <= 0)
+    {
+      return NULL;
+    }
+  }
+  else if(PcapIn != NULL)
+  {
+    if(fread(&rec, sizeof(rec), 1, PcapIn) != 1)
+    {
+      log_i("pcap replay done");
+      fclose(PcapIn);
+      PcapIn = NULL;
+      return NULL;
+    }
+
+    /* pace the replay on the capture timestamps */
+    if(PcapRealtime)
+    {
+      ts = (uint64_t)pcap_u32(rec.ts_sec) * 1000000000ULL +
+           (uint64_t)pcap_u32(rec.ts_frac) * (PcapNsec ? 1ULL : 1000ULL);
+      if(PcapFirstTs == 0)
+      {
+        PcapFirstTs = ts;
+        PcapStartNs = host_now_ns();
+      }
+      while(host_now_ns() - PcapStartNs < ts - PcapFirstTs)
+      {
+        vTaskDelay(1);
+      }
+    }
+
+    framelength = pcap_u32(rec.incl_len);
+    if(framelength > (ssize_t)sizeof(frame))
+    {
+      fseek(PcapIn, framelength, SEEK_CUR);
+      EthIfStats.rx_dropped++;
+      return NULL;
+    }
+    if(fread(frame, 1, framelength, PcapIn) != (size_t)framelength)
+    {
+      fclose(PcapIn);
+      PcapIn = NULL;
+      return NULL;
+    }
+  }
+  else
+  {
+    return NULL;
+  }
+
+  p = pbuf_alloc(PBUF_RAW, (u16_t)framelength, PBUF_POOL);
+  if(p == NULL)
+  {
+    EthIfStats.rx_dropped++;
+    EthIfStats.rx_pool_empty++;
+    return NULL;
+  }
+
+  pbuf_take(p, frame, (u16_t)framelength);
+  EthIfStats.rx_bytes += framelength;
+
+  return p;
+}
+
+/**
+  * @brief Drain up to budget frames from the backend into the stack.
+  * Must be called with the TCPIP core locked.
+  *
+  * @param netif the lwip network interface structure for this ethernetif
+  * @param budget maximum number of frames handled by this pass
+  * @retval number of frames handled
+  */
+static uint32_t low_level_rx_poll(struct netif *netif, uint32_t budget)
+{
+  struct pbuf *p;
+  uint32_t frames = 0;
+
+  while(frames < budget)
+  {
+    p = low_level_input( netif );
+    if (p == NULL)
+    {
+      break;
+    }
+
+    if (netif->input( p, netif) != ERR_OK )
+    {
+      pbuf_free(p);
+    }
+
+    frames++;
+  }
+
+  return frames;
+}
+
+/**
+  * @brief This function is the ethernetif_input task. The host backend has no
+  * interrupt: the TAP descriptor is polled without blocking the simulator
+  * and the task sleeps one tick whenever a pass finds no frame.
+  *
+  * @param netif the lwip network interface structure for this ethernetif
+  */
+void ethernetif_input( void * argument )
+{
+  struct netif *netif = (struct netif *) argument;
+  struct pollfd pfd;
+  uint32_t frames;
+
+  for( ;; )
+  {
+    if(TapFd >= 0)
+    {
+      pfd.fd = TapFd;
+      pfd.events = POLLIN;
+      if(poll(&pfd, 1, 0) <= 0)
+      {
+        vTaskDelay(1);
+        continue;
+      }
+    }
+    else if(PcapIn == NULL)
+    {
+      vTaskDelay(100);
+      continue;
+    }
+
+    EthIfStats.rx_wakeups++;
+
+    LOCK_TCPIP_CORE();
+    frames = low_level_rx_poll( netif, ETH_RX_POLL_BUDGET );
+    UNLOCK_TCPIP_CORE();
+
+    EthIfStats.rx_poll_passes++;
+    EthIfStats.rx_frames += frames;
+    if(frames > EthIfStats.rx_max_frames_per_wakeup)
+    {
+      EthIfStats.rx_max_frames_per_wakeup = frames;
+    }
+
+    if(frames < ETH_RX_POLL_BUDGET)
+    {
+      vTaskDelay(1);
+    }
+  }
+}
+
+/**
+  * @brief Should be called at the beginning of the program to set up the
+  * network interface. It calls the function low_level_init() to do the
+  * actual setup of the backend.
+  *
+  * This function should be passed as a parameter to netif_add().
+  *
+  * @param netif the lwip network interface structure for this ethernetif
+  * @return ERR_OK if the loopif is initialized
+  *         any other err_t on error
+  */
+err_t ethernetif_init(struct netif *netif)
+{
+  LWIP_ASSERT("netif != NULL", (netif != NULL));
+
+#if LWIP_NETIF_HOSTNAME
+  /* Initialize interface hostname */
+  netif->hostname = "lwip";
+#endif /* LWIP_NETIF_HOSTNAME */
+
+  MIB2_INIT_NETIF(netif, snmp_ifType_ethernet_csmacd, 100000000);
+
+  netif->name[0] = IFNAME0;
+  netif->name[1] = IFNAME1;
+
+  netif->output = etharp_output;
+  netif->linkoutput = low_level_output;
+
+  /* initialize the backend */
+  low_level_init(netif);
+
+  return ERR_OK;
+}
+
+/**
+  * @brief  Copy the driver counters, see struct ethernetif_stats.
+  *         Fields without meaning on the host stay 0.
+  * @param  stats: destination
+  * @retval None
+  */
+void ethernetif_get_stats(struct ethernetif_stats *stats)
+{
+  taskENTER_CRITICAL();
+  *stats = EthIfStats;
+  taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  The host backend sends in order, without Tx scheduler.
+  * @param  stats: destination, all zero
+  * @retval None
+  */
+void ethernetif_get_tx_sched_stats(struct ethernetif_tx_sched_stats *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+}
+
+/**
+  * @brief  No Tx scheduler on the host.
+  * @retval ERR_VAL
+  */
+err_t ethernetif_tx_sched_shape(u8_t pct, u32_t burst)
+{
+  LWIP_UNUSED_ARG(pct);
+  LWIP_UNUSED_ARG(burst);
+  return ERR_VAL;
+}
+
+/**
+  * @brief  No D-cache on the host, nothing to measure.
+  * @retval None
+  */
+void ethernetif_cache_benchmark(void)
+{
+}
+
+/**
+  * @brief  The host backend has no PHY: the link is up once the backend is
+  *         open, this thread is provided for API compatibility only.
+  * @param  argument: netif
+  * @retval None
+  */
+void ethernet_link_thread( void * argument )
+{
+  for(;;)
+  {
+    vTaskDelay(1000);
+  }
+}
+
+/**
+  * @brief  This function notify user about link status changement.
+  * @param  netif: the network interface
+  * @retval None
+  */
+void eth_link_callback(struct netif *netif)
+{
+
+  if(netif_is_link_up(netif))
+  {
+		log_e( "eth_link_callback: %s netif is up.\r\n", netif->name );
+  }
+  else
+  {
+		log_e( "eth_link_callback: %s netif is down.\r\n", netif->name );
+  }
+}
+
+#endif /* NETIF_HOST && __linux__ */
@@ -50,9 +50,12 @@
 #include "netif/etharp.h"
 #include "lwip/stats.h"
 #include "lwip/snmp.h"
+#include "lwip/ip.h"
 #include "lwip/tcpip.h"
 #include "netif_port.h"
 #include "lan8742.h"
+#include "bsp_dwt.h"
+#include "tcp_conn_mgr.h"
 #include <string.h>
 
 /* Scheduler includes */
@@ -88,6 +91,122 @@
 
 #define ETH_RX_BUFFER_SIZE                     (1536UL)
 
+/* Adaptive Rx mode: the Rx interrupt only wakes ethernetif_input(), which then
+   masks it and drains the DMA ring in poll mode, at most ETH_RX_POLL_BUDGET
+   frames per TCPIP core-lock hold. The interrupt is re-armed once a pass
+   finds the ring idle (fewer frames than the budget). */
+#ifndef ETH_RX_POLL_BUDGET
+#define ETH_RX_POLL_BUDGET                     ( 8 )
+#endif
+
+/* Asynchronous Tx: a frame is handed to the DMA in place, each descriptor
+   carries two pbufs; chains longer than ETH_TX_BOUNCE_THRESHOLD pbufs are
+   coalesced into one bounce pbuf first. When the ring is full the sender
+   waits at most ETH_TX_TIMEOUT ms for a completion before dropping. */
+#ifndef ETH_TX_BOUNCE_THRESHOLD
+#define ETH_TX_BOUNCE_THRESHOLD                ( 4 )
+#endif
+
+#ifndef ETH_TX_TIMEOUT
+#define ETH_TX_TIMEOUT                         ( 20 )
+#endif
+
+/* Tx scheduler between etharp_output() and the DMA ring: low_level_output()
+   queues the frame in its class (ETH_TX_CLASS_xxx, netif_port.h) and never
+   waits. Frames go to the ring as descriptors free up, the control class
+   first (strict priority), the bulk class within its token bucket and on at
+   most ETH_TX_SCHED_BULK_DESC descriptors, so a control frame finds at most
+   that many bulk frames ahead of it in the ring. A frame arriving at a full
+   class queue is dropped (ERR_MEM, TCP retransmits it).
+   0: FIFO straight to the ring, the sender waits for descriptors as above. */
+#ifndef ETH_TX_SCHED
+#define ETH_TX_SCHED                           1
+#endif
+
+#ifndef ETH_TX_SCHED_QLEN
+#define ETH_TX_SCHED_QLEN                      ( 32 )
+#endif
+
+/* IPv4/IPv6 frames with at least this DSCP are control: 40 (CS5) takes EF
+   (ETH_TX_TOS_CONTROL, tcp_profile_control()), CS6 and CS7 */
+#ifndef ETH_TX_SCHED_CTRL_DSCP
+#define ETH_TX_SCHED_CTRL_DSCP                 ( 40 )
+#endif
+
+#ifndef ETH_TX_SCHED_BULK_DESC
+#define ETH_TX_SCHED_BULK_DESC                 ( ETH_TX_DESC_CNT / 2 )
+#endif
+
+/* bulk token bucket: rate in percent of the link speed (0: not shaped) and
+   depth in bytes, changed by ethernetif_tx_sched_shape() */
+#ifndef ETH_TX_SCHED_BULK_PCT
+#define ETH_TX_SCHED_BULK_PCT                  ( 90 )
+#endif
+
+#ifndef ETH_TX_SCHED_BULK_BURST
+#define ETH_TX_SCHED_BULK_BURST                ( 8 * ETH_TX_FRAME_MAX )
+#endif
+
+#define ETH_TX_FRAME_MAX                       ( 1514U )
+
+#if ETH_TX_SCHED && (ETH_TX_SCHED_BULK_DESC < (ETH_TX_BOUNCE_THRESHOLD + 1) / 2)
+#error "ETH_TX_SCHED_BULK_DESC must hold the descriptors of one frame"
+#endif
+
+#define ETH_CACHE_LINE_SIZE                    ( 32U )
+
+/* PHY link detection: with ETH_PHY_INT_ENABLE the LAN8742 nINT output (the
+   nINTSEL strap must select the interrupt function) on ETH_PHY_INT_PIN wakes
+   ethernet_link_thread() on a link change, and the PHY is only polled every
+   ETH_LINK_POLL_SLOW ms in case an event is lost. Without it the PHY is polled
+   every ETH_LINK_POLL_FAST ms. A new link state is applied to the netif once it
+   has been stable for ETH_LINK_DEBOUNCE ms. */
+#ifndef ETH_PHY_INT_ENABLE
+#define ETH_PHY_INT_ENABLE                     0
+#endif
+
+#ifndef ETH_PHY_INT_GPIO
+#define ETH_PHY_INT_GPIO                       GPIOG
+#define ETH_PHY_INT_GPIO_CLK_ENABLE()          __HAL_RCC_GPIOG_CLK_ENABLE()
+#define ETH_PHY_INT_PIN                        GPIO_PIN_3
+#define ETH_PHY_INT_IRQn                       EXTI3_IRQn
+#define ETH_PHY_INT_IRQHandler                 EXTI3_IRQHandler
+#endif
+
+#ifndef ETH_LINK_POLL_FAST
+#define ETH_LINK_POLL_FAST                     ( 100 )
+#endif
+
+#ifndef ETH_LINK_POLL_SLOW
+#define ETH_LINK_POLL_SLOW                     ( 1000 )
+#endif
+
+#ifndef ETH_LINK_DEBOUNCE
+#define ETH_LINK_DEBOUNCE                      ( 50 )
+#endif
+
+/* Rx MAC filter: up to ETH_MAC_FILTER_MAX multicast addresses (IGMP/MLD groups
+   or ethernetif_mac_filter()), the first ETH_MAC_FILTER_PERFECT use the
+   perfect filter registers MACA1..3, the others the 64-bin hash table.
+   ETH_MAC_FILTER_MODE is the mode applied by low_level_init(), see
+   ethernetif_set_filter_mode(). */
+#ifndef ETH_MAC_FILTER_MAX
+#define ETH_MAC_FILTER_MAX                     ( 16 )
+#endif
+
+#define ETH_MAC_FILTER_PERFECT                 ( 3 )
+
+#ifndef ETH_MAC_FILTER_MODE
+#define ETH_MAC_FILTER_MODE                    ETH_FILTER_NORMAL
+#endif
+
+/* Tx payloads in the lwIP heap (MPU write-through), in flash or in the
+   memory-mapped QSPI Flash (read only, fs_qspi.c) need no clean */
+#define ETH_TX_NOCLEAN(addr)                   ( ((uint32_t)(addr) < 0x20000000U) || \
+                                                 (((uint32_t)(addr) >= 0x90000000U) && ((uint32_t)(addr) < 0xA0000000U)) || \
+                                                 (((uint32_t)(addr) >= LWIP_RAM_HEAP_POINTER) && \
+                                                  ((uint32_t)(addr) < (LWIP_RAM_HEAP_POINTER + MEM_SIZE))) )
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 /* 
@@ -95,39 +214,70 @@
         - Rx buffers are allocated statically and passed directly to the LwIP stack,
           they will return back to ETH DMA after been processed by the stack.
         - Tx Buffers will be allocated from LwIP stack memory heap, 
-          then passed to ETH HAL driver.
+          then passed to ETH HAL driver; they are referenced (pbuf_ref) while
+          queued and released by low_level_tx_reclaim() once the DMA has given
+          the descriptors back.
 
 @Notes: 
-  1.a. ETH DMA Rx descriptors must be contiguous, the default count is 4, 
+  1.a. ETH DMA Rx descriptors must be contiguous, the count is 16..64, 
        to customize it please redefine ETH_RX_DESC_CNT in stm32xxxx_hal_conf.h
-  1.b. ETH DMA Tx descriptors must be contiguous, the default count is 4, 
+  1.b. ETH DMA Tx descriptors must be contiguous, the default count is 8, 
        to customize it please redefine ETH_TX_DESC_CNT in stm32xxxx_hal_conf.h
 
-  2.a. Rx Buffers number must be between ETH_RX_DESC_CNT and 2*ETH_RX_DESC_CNT
+  2.a. Rx Buffers number (ETH_RX_BUFFER_CNT) must be between ETH_RX_DESC_CNT 
+       and 2*ETH_RX_DESC_CNT. The buffers beyond ETH_RX_DESC_CNT are spares:
+       a descriptor whose buffer has been lent to the stack is refilled from
+       the free list, so pbufs held by the application do not stall the ring.
   2.b. Rx Buffers must have the same size: ETH_RX_BUFFER_SIZE, this value must
        passed to ETH DMA in the init field (EthHandle.Init.RxBuffLen)
+  2.c. Rx Buffers live in D2 SRAM1/SRAM2 (.RxArraySection), or in the FMC SDRAM
+       (.SdramSection) when ETH_RX_BUFFER_IN_SDRAM is 1; the SDRAM must then be
+       initialized before ethernetif_init().
+
+  3.   D-cache: Rx buffers are cacheable (write-back) by default; only the
+       32-byte lines spanned by a received frame are invalidated, and on Tx
+       only the pbuf payloads outside the write-through lwIP heap are cleaned.
+       With ETH_RX_BUFFER_NONCACHEABLE = 1 MPU_Config() maps the Rx buffers
+       non-cacheable and the Rx maintenance is compiled out.
 */
 
+#if (ETH_RX_BUFFER_CNT < ETH_RX_DESC_CNT) || (ETH_RX_BUFFER_CNT > (2 * ETH_RX_DESC_CNT))
+#error "ETH_RX_BUFFER_CNT must be between ETH_RX_DESC_CNT and 2*ETH_RX_DESC_CNT"
+#endif
+
+/* the TCP receive window is held in the Rx buffers lent to the stack: it must
+   fit in the spares, or the ring runs dry before the window is full */
+#if LWIP_TCP && (TCP_WND > (ETH_RX_BUFFER_CNT - ETH_RX_DESC_CNT) * TCP_MSS)
+#error "TCP_WND is larger than the spare Rx buffers, raise ETH_RX_DESC_CNT or lower TCP_WND"
+#endif
+
+#if ETH_RX_BUFFER_IN_SDRAM
+#define ETH_RX_BUFFER_SECTION                  ".SdramSection"
+#else
+#define ETH_RX_BUFFER_SECTION                  ".RxArraySection"
+#endif
+
 #if defined ( __ICCARM__ ) /*!< IAR Compiler */
 
 #pragma location=0x30040000
 ETH_DMADescTypeDef  DMARxDscrTab[ETH_RX_DESC_CNT]; /* Ethernet Rx DMA Descriptors */
-#pragma location=0x30040060
+#pragma location=0x30040600
 ETH_DMADescTypeDef  DMATxDscrTab[ETH_TX_DESC_CNT]; /* Ethernet Tx DMA Descriptors */
-#pragma location=0x30040200
-uint8_t Rx_Buff[ETH_RX_DESC_CNT][ETH_RX_BUFFER_SIZE]; /* Ethernet Receive Buffers */
+#pragma location=ETH_RX_BUFFER_SECTION
+#pragma data_alignment=32
+uint8_t Rx_Buff[ETH_RX_BUFFER_CNT][ETH_RX_BUFFER_SIZE]; /* Ethernet Receive Buffers */
 
 #elif defined ( __CC_ARM )  /* MDK ARM Compiler */
 
 __attribute__((section(".RxDecripSection"))) ETH_DMADescTypeDef  DMARxDscrTab[ETH_RX_DESC_CNT]; /* Ethernet Rx DMA Descriptors */
 __attribute__((section(".TxDecripSection"))) ETH_DMADescTypeDef  DMATxDscrTab[ETH_TX_DESC_CNT]; /* Ethernet Tx DMA Descriptors */
-__attribute__((section(".RxArraySection")))  uint8_t Rx_Buff[ETH_RX_DESC_CNT][ETH_RX_BUFFER_SIZE]; /* Ethernet Receive Buffer */
+__attribute__((section(ETH_RX_BUFFER_SECTION), aligned(32)))  uint8_t Rx_Buff[ETH_RX_BUFFER_CNT][ETH_RX_BUFFER_SIZE]; /* Ethernet Receive Buffer */
 
 #elif defined ( __GNUC__ ) /* GNU Compiler */ 
 
 ETH_DMADescTypeDef DMARxDscrTab[ETH_RX_DESC_CNT] __attribute__((section(".RxDecripSection"))); /* Ethernet Rx DMA Descriptors */
 ETH_DMADescTypeDef DMATxDscrTab[ETH_TX_DESC_CNT] __attribute__((section(".TxDecripSection")));   /* Ethernet Tx DMA Descriptors */
-uint8_t Rx_Buff[ETH_RX_DESC_CNT][ETH_RX_BUFFER_SIZE] __attribute__((section(".RxArraySection"))); /* Ethernet Receive Buffers */
+uint8_t Rx_Buff[ETH_RX_BUFFER_CNT][ETH_RX_BUFFER_SIZE] __attribute__((section(ETH_RX_BUFFER_SECTION), aligned(32))); /* Ethernet Receive Buffers */
 
 #endif
 
@@ -137,13 +287,109 @@ ETH_TxPacketConfig TxConfig;
 lan8742_Object_t LAN8742;
 
 xSemaphoreHandle RxPktSemaphore = NULL; /* 用于同步以太网接收数据信号 */
+xSemaphoreHandle TxPktSemaphore = NULL; /* signals a Tx completion to a sender waiting for descriptors */
+
+static struct ethernetif_stats EthIfStats; /* driver counters, see ethernetif_get_stats() */
+
+static TaskHandle_t LinkTaskHandle = NULL;       /* woken by the PHY interrupt */
+
+/* Rx MAC filter state, changed under the TCPIP core lock */
+static uint8_t MacFilterMode = ETH_MAC_FILTER_MODE;
+static uint8_t MacFilterAddr[ETH_MAC_FILTER_MAX][ETH_HWADDR_LEN];
+static uint8_t MacFilterRef[ETH_MAC_FILTER_MAX]; /* several groups may share one MAC */
+static uint32_t MacFilterCnt;
+static volatile TickType_t LinkIrqTick;          /* time of the last PHY interrupt */
 
-LWIP_MEMPOOL_DECLARE(RX_POOL, 4, sizeof(struct pbuf_custom), "Zero-copy RX PBUF pool");
+/* Zero-copy Rx pool: each custom pbuf is bound to one Rx_Buff[] entry */
+typedef struct
+{
+  struct pbuf_custom pbuf_custom;
+  uint8_t *buff;
+  uint32_t len;   /* frame length while lent to the stack */
+} RxBuff_t;
+
+static RxBuff_t  RxBuffTab[ETH_RX_BUFFER_CNT];
+static RxBuff_t *RxFreeList[ETH_RX_BUFFER_CNT]; /* buffers owned neither by the DMA nor by the stack */
+static uint32_t  RxFreeCnt;
+
+/* Frames owned by the Tx DMA, in ring order. A frame is reclaimed when the
+   DMA has cleared the OWN bit of its last descriptor. */
+typedef struct
+{
+  struct pbuf *p;
+  uint32_t seq;       /* EthIfStats.tx_frames when accepted */
+  uint8_t last_desc;
+  uint8_t desc_cnt;
+  uint8_t cls;        /* ETH_TX_CLASS_xxx */
+} TxPkt_t;
+
+static TxPkt_t  TxPktTab[ETH_TX_DESC_CNT];
+static uint32_t TxPktHead, TxPktTail, TxPktCnt;
+static uint32_t TxDescInUse;              /* descriptors not reclaimed yet */
+static volatile uint32_t TxReclaimPending;
+
+#if ETH_TX_SCHED
+/* Frames waiting for the Tx DMA, one FIFO per class. The scheduler state
+   changes under the TCPIP core lock only. */
+typedef struct
+{
+  struct pbuf *p;
+  uint32_t seq;       /* EthIfStats.tx_frames when accepted */
+  uint32_t t_in;      /* DWT_CYCCNT when queued */
+  uint8_t desc_cnt;
+} TxSchedEnt_t;
+
+typedef struct
+{
+  TxSchedEnt_t ent[ETH_TX_SCHED_QLEN];
+  uint32_t head, tail, cnt;
+} TxSchedQ_t;
+
+static TxSchedQ_t TxSchedQ[ETH_TX_CLASSES];
+static struct ethernetif_tx_sched_stats TxSchedStats;
+static const uint32_t TxSchedLatEdges[ETH_TX_LAT_BUCKETS - 1] = ETH_TX_LAT_EDGES;
+static uint32_t TxBulkDescInUse;          /* descriptors held by bulk frames */
+static uint32_t TxSchedLinkRate = 12500000; /* link speed, bytes/s */
+static uint8_t  TxSchedBulkPct = ETH_TX_SCHED_BULK_PCT;
+static uint32_t TxSchedTokens;            /* bulk bytes that may leave now */
+static uint32_t TxSchedRefillCycles, TxSchedRefillMs;
+static uint8_t  TxSchedTimerArmed;
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
 void ethernetif_input( void * argument );
+#if ETH_PHY_INT_ENABLE
+static void low_level_phy_int_init(void);
+#endif
+static uint32_t low_level_rx_poll(struct netif *netif, uint32_t budget);
+static void low_level_rx_irq_rearm(void);
 u32_t    sys_now(void);
 void     pbuf_free_custom(struct pbuf *p);
+static RxBuff_t *low_level_rx_buff_get(void);
+static void low_level_rx_buff_put(RxBuff_t *rx_buff);
+static void low_level_tx_reclaim(void);
+static struct pbuf *low_level_tx_hold(struct netif *netif, struct pbuf *p);
+static err_t low_level_tx_submit(struct netif *netif, struct pbuf *p, uint32_t descnbr, uint32_t seq, uint8_t cls);
+static void low_level_tx_completed_update(void);
+#if ETH_TX_SCHED
+static uint8_t low_level_tx_class(const struct pbuf *p);
+static void low_level_tx_sched_run(struct netif *netif);
+static void low_level_tx_sched_timer(void *arg);
+static void low_level_tx_sched_refill(void);
+static void low_level_tx_sched_rate(void);
+static void low_level_tx_sched_flush(void);
+#endif
+static void low_level_cache_invalidate(const void *addr, uint32_t len);
+static void low_level_cache_clean(const void *addr, uint32_t len);
+static void low_level_filter_apply(void);
+static uint32_t low_level_rx_filter(struct netif *netif, const uint8_t *frame, uint32_t len);
+static void low_level_link_speed(struct netif *netif, uint32_t speed);
+#if LWIP_IPV4 && LWIP_IGMP
+static err_t low_level_igmp_mac_filter(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action);
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+static err_t low_level_mld_mac_filter(struct netif *netif, const ip6_addr_t *group, enum netif_mac_filter_action action);
+#endif
 
 int32_t ETH_PHY_IO_Init(void);
 int32_t ETH_PHY_IO_DeInit (void);
@@ -223,21 +469,52 @@ static void low_level_init(struct netif *netif)
 	/* NETIF_FLAG_ETHARP:    网络接口是否支持ARP功能 */
   netif->flags |= NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP;
   
-  for(idx = 0; idx < ETH_RX_DESC_CNT; idx ++)
+  /* multicast groups are added to the MAC filter on join */
+#if LWIP_IPV4 && LWIP_IGMP
+  netif->flags |= NETIF_FLAG_IGMP;
+  netif_set_igmp_mac_filter(netif, low_level_igmp_mac_filter);
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+  netif->flags |= NETIF_FLAG_MLD6;
+  netif_set_mld_mac_filter(netif, low_level_mld_mac_filter);
+#endif
+  low_level_filter_apply();
+  
+  /* Initialize the RX POOL: bind every custom pbuf to its buffer, the first
+     ETH_RX_DESC_CNT buffers go to the DMA ring, the others to the free list */
+  RxFreeCnt = 0;
+  for(idx = 0; idx < ETH_RX_BUFFER_CNT; idx ++)
   {
-    HAL_ETH_DescAssignMemory(&EthHandle, idx, Rx_Buff[idx], NULL);
+    RxBuffTab[idx].buff = Rx_Buff[idx];
+    RxBuffTab[idx].pbuf_custom.custom_free_function = pbuf_free_custom;
+    
+    if(idx < ETH_RX_DESC_CNT)
+    {
+      HAL_ETH_DescAssignMemory(&EthHandle, idx, Rx_Buff[idx], NULL);
+    }
+    else
+    {
+      RxFreeList[RxFreeCnt++] = &RxBuffTab[idx];
+    }
   }
-	
-  /* Initialize the RX POOL */
-  LWIP_MEMPOOL_INIT(RX_POOL);
+  EthIfStats.rx_buff_min_free = RxFreeCnt;
 	
   memset(&TxConfig, 0 , sizeof(ETH_TxPacketConfig));  
   TxConfig.Attributes = ETH_TX_PACKETS_FEATURES_CSUM | ETH_TX_PACKETS_FEATURES_CRCPAD;
   TxConfig.ChecksumCtrl = ETH_CHECKSUM_IPHDR_PAYLOAD_INSERT_PHDR_CALC;
   TxConfig.CRCPadCtrl = ETH_CRC_PAD_INSERT;
+  
+#if ETH_TX_SCHED
+  TxSchedStats.bulk_burst = ETH_TX_SCHED_BULK_BURST;
+  TxSchedTokens = ETH_TX_SCHED_BULK_BURST;
+  low_level_tx_sched_rate();
+#endif
    
   /* create a binary semaphore used for informing ethernetif of frame reception */
   RxPktSemaphore = xSemaphoreCreateBinary();
+  
+  /* create a binary semaphore used for informing a blocked sender of frame transmission */
+  TxPktSemaphore = xSemaphoreCreateBinary();
 
   /* Set PHY IO functions */
   LAN8742_RegisterBusIO(&LAN8742, &LAN8742_IOCtx);
@@ -245,6 +522,10 @@ static void low_level_init(struct netif *netif)
   /* Initialize the LAN8742 ETH PHY */
   LAN8742_Init(&LAN8742);
   
+#if ETH_PHY_INT_ENABLE
+  low_level_phy_int_init();
+#endif
+  
   PHYLinkState = LAN8742_GetLinkState(&LAN8742);
   
   /* Get link state */  
@@ -285,6 +566,7 @@ static void low_level_init(struct netif *netif)
     MACConf.Speed = speed;
     HAL_ETH_SetMACConfig(&EthHandle, &MACConf);
     HAL_ETH_Start_IT(&EthHandle);
+    low_level_link_speed(netif, speed);
     netif_set_up(netif);
     netif_set_link_up(netif);
   }
@@ -293,7 +575,7 @@ static void low_level_init(struct netif *netif)
   xTaskCreate( ethernetif_input, "eth_if", INTERFACE_THREAD_STACK_SIZE, netif, INTERFACE_TASK_PRIORITY,NULL);
 
   /* create the task that handles the eth_link */
-  xTaskCreate( ethernet_link_thread, "eth_link", INTERFACE_THREAD_STACK_SIZE, netif, INTERFACE_TASK_PRIORITY,NULL);
+  xTaskCreate( ethernet_link_thread, "eth_link", INTERFACE_THREAD_STACK_SIZE, netif, INTERFACE_TASK_PRIORITY, &LinkTaskHandle);
 	
 }
 
@@ -307,27 +589,155 @@ static void low_level_init(struct netif *netif)
   * @return ERR_OK if the packet could be sent
   *         an err_t value if the packet couldn't be sent
   *
-  * @note Returning ERR_MEM here if a DMA queue of your MAC is full can lead to
-  *       strange results. You might consider waiting for space in the DMA queue
-  *       to become available since the stack doesn't retry to send a packet
-  *       dropped because of memory failure (except for the TCP timers).
+  * The frame is queued to the DMA without copy and without waiting for the
+  * transmission: p is referenced until low_level_tx_reclaim() sees its
+  * descriptors completed. A chain longer than ETH_TX_BOUNCE_THRESHOLD is
+  * first coalesced into a single PBUF_RAM. With ETH_TX_SCHED the frame waits
+  * in its class queue for low_level_tx_sched_run() and is dropped with
+  * ERR_MEM when that queue is full; without, if the ring stays full for
+  * ETH_TX_TIMEOUT ms the frame is dropped with ERR_MEM. Either way TCP keeps
+  * the segment queued and retries it.
+  *
+  * Must be called with the TCPIP core locked (always true for linkoutput).
   */
 static err_t low_level_output(struct netif *netif, struct pbuf *p)
 {
-  uint32_t i=0, framelen = 0;
-  struct pbuf *q;
-  err_t errval = ERR_OK;
-  ETH_BufferTypeDef Txbuffer[ETH_TX_DESC_CNT];
+#if ETH_TX_SCHED
+  TxSchedQ_t *q;
+  TxSchedEnt_t *e;
+  struct ethernetif_tx_class_stats *cs;
+  uint32_t i;
+  uint8_t cls;
+#else
+  uint32_t descnbr;
+#endif
 	
 //	elog_hexdump( "low_level_output:", 8, q->payload, q->len );
   
+  low_level_tx_reclaim();
+  
+#if ETH_TX_SCHED
+  cls = low_level_tx_class(p);
+  q = &TxSchedQ[cls];
+  cs = &TxSchedStats.cls[cls];
+  
+  if(q->cnt >= ETH_TX_SCHED_QLEN)
+  {
+    cs->dropped++;
+    EthIfStats.tx_dropped++;
+    LINK_STATS_INC(link.drop);
+    MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+    return ERR_MEM;
+  }
+  
+  p = low_level_tx_hold(netif, p);
+  if(p == NULL)
+  {
+    return ERR_MEM;
+  }
+  
+  e = &q->ent[q->head];
+  e->p = p;
+  e->seq = EthIfStats.tx_frames++;
+  e->t_in = DWT_CYCCNT;
+  e->desc_cnt = (pbuf_clen(p) + 1) / 2;   /* two buffers per descriptor */
+  q->head = (q->head + 1) % ETH_TX_SCHED_QLEN;
+  q->cnt++;
+  
+  for(i = 0; (i < ETH_TX_DEPTH_BUCKETS - 1) && (q->cnt > (1UL << i)); i++)
+  {
+  }
+  cs->depth_hist[i]++;
+  if(q->cnt > cs->depth_max)
+  {
+    cs->depth_max = q->cnt;
+  }
+  
+  low_level_tx_sched_run(netif);
+  
+  return ERR_OK;
+#else
+  p = low_level_tx_hold(netif, p);
+  if(p == NULL)
+  {
+    return ERR_MEM;
+  }
+  
+  /* two buffers per descriptor */
+  descnbr = (pbuf_clen(p) + 1) / 2;
+  
+  while(TxDescInUse + descnbr > ETH_TX_DESC_CNT)
+  {
+    EthIfStats.tx_ring_full++;
+    
+    if(xSemaphoreTake(TxPktSemaphore, pdMS_TO_TICKS(ETH_TX_TIMEOUT)) != pdTRUE)
+    {
+      pbuf_free(p);
+      EthIfStats.tx_dropped++;
+      LINK_STATS_INC(link.drop);
+      MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+      return ERR_MEM;
+    }
+    
+    low_level_tx_reclaim();
+  }
+  
+  return low_level_tx_submit(netif, p, descnbr, EthIfStats.tx_frames++, ETH_TX_CLASS_BULK);
+#endif
+}
+
+/**
+  * @brief Keep a frame for the DMA: referenced in place, or coalesced into
+  * one PBUF_RAM when it spans more than ETH_TX_BOUNCE_THRESHOLD pbufs.
+  * @retval the frame to send, NULL when out of memory (counted as dropped)
+  */
+static struct pbuf *low_level_tx_hold(struct netif *netif, struct pbuf *p)
+{
+  if(pbuf_clen(p) > ETH_TX_BOUNCE_THRESHOLD)
+  {
+    /* too fragmented to be sent in place */
+    p = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+    if(p == NULL)
+    {
+      EthIfStats.tx_dropped++;
+      LINK_STATS_INC(link.memerr);
+      MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+      return NULL;
+    }
+    EthIfStats.tx_bounced++;
+  }
+  else
+  {
+    pbuf_ref(p);
+  }
+  
+  return p;
+}
+
+/**
+  * @brief Hand a held frame to the DMA, descnbr descriptors must be free.
+  * The frame belongs to the ring afterwards, or is freed on a DMA error.
+  * @param seq its EthIfStats.tx_frames number
+  * @param cls its ETH_TX_CLASS_xxx
+  * @retval ERR_OK, ERR_IF on a DMA error
+  */
+static err_t low_level_tx_submit(struct netif *netif, struct pbuf *p, uint32_t descnbr, uint32_t seq, uint8_t cls)
+{
+  uint32_t i = 0, framelen = 0;
+  struct pbuf *q;
+  ETH_BufferTypeDef Txbuffer[ETH_TX_BOUNCE_THRESHOLD];
+  TxPkt_t *pkt;
+  
   memset(Txbuffer, 0 , sizeof(Txbuffer));
   
   for(q = p; q != NULL; q = q->next)
   {
-    if(i >= ETH_TX_DESC_CNT)	
-      return ERR_IF;
-	
+    /* write the payload back to memory before the DMA reads it */
+    if(!ETH_TX_NOCLEAN(q->payload))
+    {
+      low_level_cache_clean(q->payload, q->len);
+    }
+    
     Txbuffer[i].buffer = q->payload;
     Txbuffer[i].len = q->len;
     framelen += q->len;
@@ -342,140 +752,725 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
 
   TxConfig.Length = framelen;
   TxConfig.TxBuffer = Txbuffer;
+  
+  pkt = &TxPktTab[TxPktHead];
+  pkt->p = p;
+  pkt->seq = seq;
+  pkt->cls = cls;
+  pkt->desc_cnt = descnbr;
+  pkt->last_desc = (EthHandle.TxDescList.CurTxDesc + descnbr - 1) % ETH_TX_DESC_CNT;
+  
+  if(HAL_ETH_Transmit_IT(&EthHandle, &TxConfig) != HAL_OK)
+  {
+    pkt->p = NULL;
+    pbuf_free(p);
+    low_level_tx_completed_update();
+    EthIfStats.tx_dropped++;
+    LINK_STATS_INC(link.err);
+    MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+    return ERR_IF;
+  }
+  
+  TxPktHead = (TxPktHead + 1) % ETH_TX_DESC_CNT;
+  TxPktCnt++;
+  TxDescInUse += descnbr;
+#if ETH_TX_SCHED
+  if(cls == ETH_TX_CLASS_BULK)
+  {
+    TxBulkDescInUse += descnbr;
+  }
+#endif
+  
+  EthIfStats.tx_bytes += framelen;
+  LINK_STATS_INC(link.xmit);
+  MIB2_STATS_NETIF_ADD(netif, ifoutoctets, framelen);
+  if((((uint8_t *)p->payload)[0] & 0x01) == 0)
+  {
+    MIB2_STATS_NETIF_INC(netif, ifoutucastpkts);
+  }
+  else
+  {
+    MIB2_STATS_NETIF_INC(netif, ifoutnucastpkts);
+  }
+  if(TxDescInUse > EthIfStats.tx_max_desc_in_use)
+  {
+    EthIfStats.tx_max_desc_in_use = TxDescInUse;
+  }
 
-  HAL_ETH_Transmit(&EthHandle, &TxConfig, 0);
-
-  return errval;
+  return ERR_OK;
 }
 
+#if ETH_TX_SCHED
 /**
-  * @brief Should allocate a pbuf and transfer the bytes of the incoming
-  * packet from the interface into the pbuf.
-  *
-  * @param netif the lwip network interface structure for this ethernetif
-  * @return a pbuf filled with the received packet (including MAC header)
-  *         NULL on memory error
+  * @brief Class of a frame: ARP, and IPv4/IPv6 with a DSCP of at least
+  * ETH_TX_SCHED_CTRL_DSCP (the tos of the sending pcb) are control.
   */
-static struct pbuf * low_level_input(struct netif *netif)
+static uint8_t low_level_tx_class(const struct pbuf *p)
 {
-  struct pbuf *p = NULL;
-  ETH_BufferTypeDef RxBuff;
-  uint32_t framelength = 0;
-	struct pbuf_custom* custom_pbuf;
-	
-  if(HAL_ETH_GetRxDataBuffer(&EthHandle, &RxBuff) == HAL_OK) 
+  const uint8_t *ip = (const uint8_t *)p->payload + SIZEOF_ETH_HDR;
+  uint8_t dscp;
+  
+  if(p->len < SIZEOF_ETH_HDR + 2)
   {
-    HAL_ETH_GetRxDataLength(&EthHandle, &framelength);
-    
-    /* Invalidate data cache for ETH Rx Buffers */
-    SCB_InvalidateDCache_by_Addr((uint32_t *)Rx_Buff, (ETH_RX_DESC_CNT*ETH_RX_BUFFER_SIZE));
-    
-    custom_pbuf  = (struct pbuf_custom*)LWIP_MEMPOOL_ALLOC(RX_POOL);
-    custom_pbuf->custom_free_function = pbuf_free_custom;
-
-    p = pbuf_alloced_custom(PBUF_RAW, framelength, PBUF_REF, custom_pbuf, RxBuff.buffer, ETH_RX_BUFFER_SIZE);
-   
-   }
+    return ETH_TX_CLASS_BULK;
+  }
   
-  return p;
+  switch(lwip_htons(((const struct eth_hdr *)p->payload)->type))
+  {
+  case ETHTYPE_ARP:
+    return ETH_TX_CLASS_CONTROL;
+  case ETHTYPE_IP:
+    dscp = ip[1] >> 2;
+    break;
+  case ETHTYPE_IPV6:
+    dscp = (uint8_t)(((ip[0] & 0x0F) << 4) | (ip[1] >> 4)) >> 2;
+    break;
+  default:
+    return ETH_TX_CLASS_BULK;
+  }
+  
+  return (dscp >= ETH_TX_SCHED_CTRL_DSCP) ? ETH_TX_CLASS_CONTROL : ETH_TX_CLASS_BULK;
 }
 
 /**
-  * @brief This function is the ethernetif_input task, it is processed when a packet 
-  * is ready to be read from the interface. It uses the function low_level_input() 
-  * that should handle the actual reception of bytes from the network
-  * interface. Then the type of the received packet is determined and
-  * the appropriate input function is called.
-  *
-  * @param netif the lwip network interface structure for this ethernetif
+  * @brief Hand the queued frames to the DMA while descriptors are free: the
+  * control class first, then the bulk class within its share of the ring
+  * and its token bucket. Called with the TCPIP core locked when a frame was
+  * queued, by ethernetif_input() after a Tx completion and by the token
+  * bucket timer.
   */
-void ethernetif_input( void * argument )
+static void low_level_tx_sched_run(struct netif *netif)
 {
-  struct pbuf *p;
-  struct netif *netif = (struct netif *) argument;
+  TxSchedQ_t *q;
+  TxSchedEnt_t *e;
+  struct ethernetif_tx_class_stats *cs;
+  uint32_t len, us, i, wait;
+  uint8_t cls;
   
-  for( ;; )
+  for(;;)
   {
-    if (xSemaphoreTake( RxPktSemaphore, TIME_WAITING_FOR_INPUT)==pdTRUE)
+    cls = ETH_TX_CLASS_CONTROL;
+    if(TxSchedQ[cls].cnt == 0)
     {
-      do
+      cls = ETH_TX_CLASS_BULK;
+      if(TxSchedQ[cls].cnt == 0)
+      {
+        break;
+      }
+    }
+    q = &TxSchedQ[cls];
+    e = &q->ent[q->tail];
+    len = e->p->tot_len;
+    
+    /* resumed by the Tx completion */
+    if(TxDescInUse + e->desc_cnt > ETH_TX_DESC_CNT)
+    {
+      EthIfStats.tx_ring_full++;
+      break;
+    }
+    
+    if(cls == ETH_TX_CLASS_BULK)
+    {
+      if(TxBulkDescInUse + e->desc_cnt > ETH_TX_SCHED_BULK_DESC)
       {
-				 LOCK_TCPIP_CORE();
-				
-        p = low_level_input( netif );
-        if (p != NULL)
+        TxSchedStats.bulk_desc_full++;
+        break;
+      }
+      
+      if(TxSchedStats.bulk_rate != 0)
+      {
+        low_level_tx_sched_refill();
+        if(TxSchedTokens < len)
         {
-          if (netif->input( p, netif) != ERR_OK )
+          TxSchedStats.bulk_shaped++;
+          if(!TxSchedTimerArmed)
           {
-            pbuf_free(p);
+            wait = ((len - TxSchedTokens) * 1000 + TxSchedStats.bulk_rate - 1) / TxSchedStats.bulk_rate;
+            TxSchedTimerArmed = 1;
+            sys_timeout(LWIP_MAX(wait, 1), low_level_tx_sched_timer, netif);
           }
+          break;
         }
-        
-        /* Build Rx descriptor to be ready for next data reception */   
-        HAL_ETH_BuildRxDescriptors(&EthHandle);
-				
-        UNLOCK_TCPIP_CORE();
-				
-      }while(p!=NULL);
+        TxSchedTokens -= len;
+      }
+    }
+    
+    q->tail = (q->tail + 1) % ETH_TX_SCHED_QLEN;
+    q->cnt--;
+    
+    cs = &TxSchedStats.cls[cls];
+    us = (DWT_CYCCNT - e->t_in) / (SystemCoreClock / 1000000U);
+    for(i = 0; (i < ETH_TX_LAT_BUCKETS - 1) && (us > TxSchedLatEdges[i]); i++)
+    {
+    }
+    cs->lat_hist[i]++;
+    if(us > cs->lat_max)
+    {
+      cs->lat_max = us;
+    }
+    
+    if(low_level_tx_submit(netif, e->p, e->desc_cnt, e->seq, cls) == ERR_OK)
+    {
+      cs->frames++;
+      cs->bytes += len;
     }
+    e->p = NULL;
   }
 }
 
 /**
-  * @brief Should be called at the beginning of the program to set up the
-  * network interface. It calls the function low_level_init() to do the
-  * actual setup of the hardware.
-  *
-  * This function should be passed as a parameter to netif_add().
-  *
-  * @param netif the lwip network interface structure for this ethernetif
-  * @return ERR_OK if the loopif is initialized
-  *         ERR_MEM if private data couldn't be allocated
-  *         any other err_t on error
+  * @brief Token bucket timer: the bulk frame at the head has its tokens.
   */
-err_t ethernetif_init(struct netif *netif)
+static void low_level_tx_sched_timer(void *arg)
 {
-  LWIP_ASSERT("netif != NULL", (netif != NULL));
-
-#if LWIP_NETIF_HOSTNAME
-  /* Initialize interface hostname */
-  netif->hostname = "lwip";
-#endif /* LWIP_NETIF_HOSTNAME */
-  
-  /*
-   * Initialize the snmp variables and counters inside the struct netif.
-   * The last argument should be replaced with your link speed, in units
-   * of bits per second.
-   */
-  MIB2_INIT_NETIF(netif, snmp_ifType_ethernet_csmacd, LINK_SPEED_OF_YOUR_NETIF_IN_BPS);
-
-  netif->name[0] = IFNAME0;
-  netif->name[1] = IFNAME1;
-
-  /* We directly use etharp_output() here to save a function call.
-   * You can instead declare your own function an call etharp_output()
-   * from it if you have to do some checks before sending (e.g. if link
-   * is available...) */
-  netif->output = etharp_output;
-  netif->linkoutput = low_level_output;
-
-  /* initialize the hardware */
-  low_level_init(netif);
-
-  return ERR_OK;
+  TxSchedTimerArmed = 0;
+  low_level_tx_sched_run((struct netif *)arg);
 }
 
 /**
-  * @brief  Custom Rx pbuf free callback
-  * @param  pbuf: pbuf to be freed
-  * @retval None
+  * @brief Add the bulk tokens earned since the last refill, timed with the
+  * DWT cycle counter. It wraps after a few seconds, so after a second
+  * without refill the bucket is simply full.
   */
-void pbuf_free_custom(struct pbuf *p)
+static void low_level_tx_sched_refill(void)
 {
-  struct pbuf_custom* custom_pbuf = (struct pbuf_custom*)p;;
-  LWIP_MEMPOOL_FREE(RX_POOL, custom_pbuf);
+  uint32_t now = DWT_CYCCNT, ms = sys_now();
+  uint64_t tokens;
+  
+  if(ms - TxSchedRefillMs >= 1000)
+  {
+    TxSchedTokens = TxSchedStats.bulk_burst;
+  }
+  else
+  {
+    tokens = TxSchedTokens + (uint64_t)(now - TxSchedRefillCycles) * TxSchedStats.bulk_rate / SystemCoreClock;
+    TxSchedTokens = (uint32_t)LWIP_MIN(tokens, TxSchedStats.bulk_burst);
+  }
+  TxSchedRefillCycles = now;
+  TxSchedRefillMs = ms;
+}
+
+/**
+  * @brief Bulk token bucket rate from the link speed and TxSchedBulkPct.
+  */
+static void low_level_tx_sched_rate(void)
+{
+  TxSchedStats.bulk_rate = TxSchedLinkRate / 100 * TxSchedBulkPct;
+}
+
+/**
+  * @brief Drop the queued frames, at link down. Core locked.
+  */
+static void low_level_tx_sched_flush(void)
+{
+  TxSchedQ_t *q;
+  uint32_t cls;
+  
+  for(cls = 0; cls < ETH_TX_CLASSES; cls++)
+  {
+    q = &TxSchedQ[cls];
+    while(q->cnt > 0)
+    {
+      pbuf_free(q->ent[q->tail].p);
+      q->ent[q->tail].p = NULL;
+      q->tail = (q->tail + 1) % ETH_TX_SCHED_QLEN;
+      q->cnt--;
+      TxSchedStats.cls[cls].dropped++;
+      EthIfStats.tx_dropped++;
+    }
+  }
+  
+  low_level_tx_completed_update();
+}
+#endif /* ETH_TX_SCHED */
+
+/**
+  * @brief tx_completed: number of the oldest frame still held (in the ring
+  * or queued by the scheduler), tx_frames when none is. The scheduler sends
+  * out of order, so the count only tells that every frame accepted before
+  * it is released (the tcp_client NOCOPY buffers rely on that).
+  * Must be called with the TCPIP core locked.
+  */
+static void low_level_tx_completed_update(void)
+{
+  uint32_t oldest = EthIfStats.tx_frames, i, k;
+  
+  for(i = 0, k = TxPktTail; i < TxPktCnt; i++, k = (k + 1) % ETH_TX_DESC_CNT)
+  {
+    if((TxPktTab[k].p != NULL) && ((int32_t)(TxPktTab[k].seq - oldest) < 0))
+    {
+      oldest = TxPktTab[k].seq;
+    }
+  }
+#if ETH_TX_SCHED
+  for(i = 0; i < ETH_TX_CLASSES; i++)
+  {
+    if((TxSchedQ[i].cnt > 0) && ((int32_t)(TxSchedQ[i].ent[TxSchedQ[i].tail].seq - oldest) < 0))
+    {
+      oldest = TxSchedQ[i].ent[TxSchedQ[i].tail].seq;
+    }
+  }
+#endif
+  
+  EthIfStats.tx_completed = oldest;
+}
+
+/**
+  * @brief Release the frames whose descriptors the Tx DMA has completed.
+  * Must be called with the TCPIP core locked.
+  */
+static void low_level_tx_reclaim(void)
+{
+  TxPkt_t *pkt;
+  ETH_DMADescTypeDef *dmatxdesc;
+  uint8_t reclaimed = 0;
+  
+  while(TxPktCnt > 0)
+  {
+    pkt = &TxPktTab[TxPktTail];
+    dmatxdesc = (ETH_DMADescTypeDef *)EthHandle.TxDescList.TxDesc[pkt->last_desc];
+    
+    if(READ_BIT(dmatxdesc->DESC3, ETH_DMATXNDESCWBF_OWN) != 0)
+    {
+      break;
+    }
+    
+    pbuf_free(pkt->p);
+    pkt->p = NULL;
+    
+    TxDescInUse -= pkt->desc_cnt;
+#if ETH_TX_SCHED
+    if(pkt->cls == ETH_TX_CLASS_BULK)
+    {
+      TxBulkDescInUse -= pkt->desc_cnt;
+    }
+#endif
+    TxPktTail = (TxPktTail + 1) % ETH_TX_DESC_CNT;
+    TxPktCnt--;
+    
+    reclaimed = 1;
+  }
+  
+  if(reclaimed)
+  {
+    low_level_tx_completed_update();
+  }
+}
+
+/**
+  * @brief Invalidate the D-cache lines spanned by [addr, addr + len).
+  * The span is widened to whole 32-byte lines: the caller must own them all,
+  * which holds for Rx_Buff[] (32-byte aligned, size a multiple of 32).
+  */
+static void low_level_cache_invalidate(const void *addr, uint32_t len)
+{
+  uint32_t start = (uint32_t)addr & ~(ETH_CACHE_LINE_SIZE - 1);
+  uint32_t end = ((uint32_t)addr + len + ETH_CACHE_LINE_SIZE - 1) & ~(ETH_CACHE_LINE_SIZE - 1);
+  uint32_t cycles = DWT_CYCCNT;
+  
+  SCB_InvalidateDCache_by_Addr((uint32_t *)start, (int32_t)(end - start));
+  
+  EthIfStats.rx_cache_cycles += DWT_CYCCNT - cycles;
+}
+
+/**
+  * @brief Clean (write back) the D-cache lines spanned by [addr, addr + len).
+  */
+static void low_level_cache_clean(const void *addr, uint32_t len)
+{
+  uint32_t start = (uint32_t)addr & ~(ETH_CACHE_LINE_SIZE - 1);
+  uint32_t end = ((uint32_t)addr + len + ETH_CACHE_LINE_SIZE - 1) & ~(ETH_CACHE_LINE_SIZE - 1);
+  uint32_t cycles = DWT_CYCCNT;
+  
+  SCB_CleanDCache_by_Addr((uint32_t *)start, (int32_t)(end - start));
+  
+  EthIfStats.tx_cache_cycles += DWT_CYCCNT - cycles;
+}
+
+/**
+  * @brief Should allocate a pbuf and transfer the bytes of the incoming
+  * packet from the interface into the pbuf.
+  *
+  * @param netif the lwip network interface structure for this ethernetif
+  * @return a pbuf filled with the received packet (including MAC header)
+  *         NULL on memory error
+  */
+static struct pbuf * low_level_input(struct netif *netif)
+{
+  struct pbuf *p = NULL;
+  ETH_BufferTypeDef RxBuff;
+  uint32_t framelength = 0;
+  ETH_DMADescTypeDef *dmarxdesc;
+  RxBuff_t *rx_buff, *refill;
+	
+  if(HAL_ETH_GetRxDataBuffer(&EthHandle, &RxBuff) == HAL_OK) 
+  {
+    HAL_ETH_GetRxDataLength(&EthHandle, &framelength);
+    
+    /* a frame spread over several descriptors cannot be lent as one buffer */
+    if(EthHandle.RxDescList.AppDescNbr != 1)
+    {
+      EthIfStats.rx_dropped++;
+      LINK_STATS_INC(link.lenerr);
+      MIB2_STATS_NETIF_INC(netif, ifinerrors);
+      return NULL;
+    }
+    
+#if !ETH_RX_BUFFER_NONCACHEABLE
+    /* Invalidate data cache for the received part of the ETH Rx Buffer only */
+    low_level_cache_invalidate(RxBuff.buffer, framelength);
+#endif
+    
+    /* frames the MAC filter let through but nobody here wants are dropped
+       before a buffer is lent, the descriptor keeps its buffer */
+    if(!low_level_rx_filter(netif, RxBuff.buffer, framelength))
+    {
+      MIB2_STATS_NETIF_INC(netif, ifindiscards);
+      return NULL;
+    }
+    
+    /* Refill the descriptor from the free list before its buffer is lent
+       to the stack; without a spare buffer the frame is dropped and the
+       descriptor keeps its buffer */
+    refill = low_level_rx_buff_get();
+    if(refill == NULL)
+    {
+      EthIfStats.rx_pool_empty++;
+      EthIfStats.rx_dropped++;
+      LINK_STATS_INC(link.memerr);
+      MIB2_STATS_NETIF_INC(netif, ifindiscards);
+      return NULL;
+    }
+    
+    dmarxdesc = (ETH_DMADescTypeDef *)EthHandle.RxDescList.RxDesc[EthHandle.RxDescList.FirstAppDesc];
+    WRITE_REG(dmarxdesc->BackupAddr0, (uint32_t)refill->buff);
+    
+    rx_buff = &RxBuffTab[(RxBuff.buffer - &Rx_Buff[0][0]) / ETH_RX_BUFFER_SIZE];
+    rx_buff->len = framelength;
+    
+    p = pbuf_alloced_custom(PBUF_RAW, framelength, PBUF_REF, &rx_buff->pbuf_custom, rx_buff->buff, ETH_RX_BUFFER_SIZE);
+    EthIfStats.rx_bytes += framelength;
+    LINK_STATS_INC(link.recv);
+    MIB2_STATS_NETIF_ADD(netif, ifinoctets, framelength);
+    if((RxBuff.buffer[0] & 0x01) == 0)
+    {
+      MIB2_STATS_NETIF_INC(netif, ifinucastpkts);
+    }
+    else
+    {
+      MIB2_STATS_NETIF_INC(netif, ifinnucastpkts);
+    }
+   }
+  
+  return p;
+}
+
+/**
+  * @brief Drain up to budget frames from the Rx DMA ring into the stack.
+  * Must be called with the TCPIP core locked.
+  *
+  * @param netif the lwip network interface structure for this ethernetif
+  * @param budget maximum number of frames handled in this pass
+  * @return number of frames taken from the ring
+  */
+static uint32_t low_level_rx_poll(struct netif *netif, uint32_t budget)
+{
+  struct pbuf *p;
+  uint32_t frames = 0;
+  
+  while(frames < budget)
+  {
+    p = low_level_input( netif );
+    if (p == NULL)
+    {
+      /* ring empty, otherwise the frame was dropped and its
+         descriptor still has to be given back to the DMA */
+      if(EthHandle.RxDescList.AppDescNbr == 0)
+      {
+        break;
+      }
+    }
+    else if (netif->input( p, netif) != ERR_OK )
+    {
+      pbuf_free(p);
+    }
+    
+    frames++;
+    
+    /* Build Rx descriptor to be ready for next data reception */
+    HAL_ETH_BuildRxDescriptors(&EthHandle);
+  }
+  
+  return frames;
+}
+
+/**
+  * @brief Leave poll mode: clear the pending Rx status and unmask the Rx
+  * interrupt. A frame landing after the last poll pass keeps RI set, so the
+  * interrupt fires as soon as it is unmasked and no frame is stranded.
+  */
+static void low_level_rx_irq_rearm(void)
+{
+  __HAL_ETH_DMA_CLEAR_IT(&EthHandle, ETH_DMACSR_RI | ETH_DMACSR_NIS);
+  __HAL_ETH_DMA_ENABLE_IT(&EthHandle, ETH_DMACIER_RIE);
+  
+  EthIfStats.rx_to_irq++;
+}
+
+/**
+  * @brief This function is the ethernetif_input task, it is processed when a packet 
+  * is ready to be read from the interface. It uses the function low_level_input() 
+  * that should handle the actual reception of bytes from the network
+  * interface. Then the type of the received packet is determined and
+  * the appropriate input function is called.
+  *
+  * When woken by HAL_ETH_RxCpltCallback() the Rx interrupt is masked: the
+  * ring is polled in budgeted passes, each under a single core-lock hold,
+  * until a pass finds it idle; then the interrupt is re-armed.
+  * When woken by HAL_ETH_TxCpltCallback() the completed Tx frames are
+  * released, so that pbufs (e.g. TCP segments) are not held until the
+  * next transmission.
+  *
+  * @param netif the lwip network interface structure for this ethernetif
+  */
+void ethernetif_input( void * argument )
+{
+  struct netif *netif = (struct netif *) argument;
+  uint32_t frames, wakeup_frames;
+  
+  for( ;; )
+  {
+    if (xSemaphoreTake( RxPktSemaphore, TIME_WAITING_FOR_INPUT)!=pdTRUE)
+    {
+      continue;
+    }
+    
+    if(TxReclaimPending)
+    {
+      TxReclaimPending = 0;
+      
+      LOCK_TCPIP_CORE();
+      low_level_tx_reclaim();
+#if ETH_TX_SCHED
+      /* descriptors freed: the queued frames go on */
+      low_level_tx_sched_run(netif);
+#endif
+      UNLOCK_TCPIP_CORE();
+    }
+    
+    /* Rx interrupt masked by HAL_ETH_RxCpltCallback(): drain the ring */
+    if(READ_BIT(EthHandle.Instance->DMACIER, ETH_DMACIER_RIE) == 0)
+    {
+      EthIfStats.rx_wakeups++;
+      wakeup_frames = 0;
+      
+      do
+      {
+        LOCK_TCPIP_CORE();
+        
+        frames = low_level_rx_poll( netif, ETH_RX_POLL_BUDGET );
+        
+        UNLOCK_TCPIP_CORE();
+        
+        EthIfStats.rx_poll_passes++;
+        wakeup_frames += frames;
+        
+        /* budget used up: more frames are likely pending, let the
+           application tasks run before the next pass */
+        if(frames == ETH_RX_POLL_BUDGET)
+        {
+          taskYIELD();
+        }
+        
+      }while(frames == ETH_RX_POLL_BUDGET);
+      
+      low_level_rx_irq_rearm();
+      
+      /* frames the DMA dropped for lack of a free descriptor (clear on read) */
+      EthIfStats.rx_missed += READ_REG(EthHandle.Instance->DMACMFCR) & ETH_DMACMFCR_MFC;
+      
+      EthIfStats.rx_frames += wakeup_frames;
+      if(wakeup_frames > EthIfStats.rx_max_frames_per_wakeup)
+      {
+        EthIfStats.rx_max_frames_per_wakeup = wakeup_frames;
+      }
+    }
+  }
+}
+
+/**
+  * @brief Should be called at the beginning of the program to set up the
+  * network interface. It calls the function low_level_init() to do the
+  * actual setup of the hardware.
+  *
+  * This function should be passed as a parameter to netif_add().
+  *
+  * @param netif the lwip network interface structure for this ethernetif
+  * @return ERR_OK if the loopif is initialized
+  *         ERR_MEM if private data couldn't be allocated
+  *         any other err_t on error
+  */
+err_t ethernetif_init(struct netif *netif)
+{
+  LWIP_ASSERT("netif != NULL", (netif != NULL));
+
+#if LWIP_NETIF_HOSTNAME
+  /* Initialize interface hostname */
+  netif->hostname = "lwip";
+#endif /* LWIP_NETIF_HOSTNAME */
+  
+  /*
+   * Initialize the snmp variables and counters inside the struct netif.
+   * The last argument is the link speed, in units of bits per second:
+   * unknown until the PHY reports the link, see low_level_link_speed().
+   */
+  MIB2_INIT_NETIF(netif, snmp_ifType_ethernet_csmacd, 0);
+
+  netif->name[0] = IFNAME0;
+  netif->name[1] = IFNAME1;
+
+  /* We directly use etharp_output() here to save a function call.
+   * You can instead declare your own function an call etharp_output()
+   * from it if you have to do some checks before sending (e.g. if link
+   * is available...) */
+  netif->output = etharp_output;
+  netif->linkoutput = low_level_output;
+
+  /* initialize the hardware */
+  low_level_init(netif);
+
+  return ERR_OK;
+}
+
+/**
+  * @brief  Report the speed the MAC was configured for as the MIB2 ifSpeed,
+  *         the bulk shaping rate follows it.
+  * @param  netif: the network interface
+  * @param  speed: ETH_SPEED_100M or ETH_SPEED_10M
+  * @retval None
+  */
+static void low_level_link_speed(struct netif *netif, uint32_t speed)
+{
+#if MIB2_STATS
+  netif->link_speed = (speed == ETH_SPEED_100M) ? 100000000 : 10000000;
+#else
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(speed);
+#endif
+#if ETH_TX_SCHED
+  TxSchedLinkRate = (speed == ETH_SPEED_100M) ? 12500000 : 1250000;
+  low_level_tx_sched_rate();
+#endif
+}
+
+/**
+  * @brief  Custom Rx pbuf free callback
+  * @param  pbuf: pbuf to be freed
+  * @retval None
+  */
+void pbuf_free_custom(struct pbuf *p)
+{
+  RxBuff_t *rx_buff = (RxBuff_t *)p;
+  
+#if !ETH_RX_BUFFER_NONCACHEABLE
+  /* drop lines the stack may have dirtied (it only writes inside the frame)
+     before the DMA owns the buffer again */
+  low_level_cache_invalidate(rx_buff->buff, rx_buff->len);
+#endif
+  
+  low_level_rx_buff_put(rx_buff);
 }
 
+/**
+  * @brief  Take a spare Rx buffer from the free list.
+  * @retval the buffer, NULL if the pool is exhausted
+  */
+static RxBuff_t *low_level_rx_buff_get(void)
+{
+  RxBuff_t *rx_buff = NULL;
+  SYS_ARCH_DECL_PROTECT(old_level);
+  
+  SYS_ARCH_PROTECT(old_level);
+  if(RxFreeCnt > 0)
+  {
+    rx_buff = RxFreeList[--RxFreeCnt];
+    if(RxFreeCnt < EthIfStats.rx_buff_min_free)
+    {
+      EthIfStats.rx_buff_min_free = RxFreeCnt;
+    }
+  }
+  SYS_ARCH_UNPROTECT(old_level);
+  
+  return rx_buff;
+}
+
+/**
+  * @brief  Give an Rx buffer released by the stack back to the free list.
+  * @param  rx_buff: buffer to release
+  * @retval None
+  */
+static void low_level_rx_buff_put(RxBuff_t *rx_buff)
+{
+  SYS_ARCH_DECL_PROTECT(old_level);
+  
+  SYS_ARCH_PROTECT(old_level);
+  RxFreeList[RxFreeCnt++] = rx_buff;
+  SYS_ARCH_UNPROTECT(old_level);
+}
+
+#if ETH_PHY_INT_ENABLE
+/**
+  * @brief  Route the LAN8742 nINT output (open-drain, active low) to an EXTI
+  *         line and unmask the link down and auto-negotiation complete
+  *         interrupts in the PHY.
+  * @retval None
+  */
+static void low_level_phy_int_init(void)
+{
+  GPIO_InitTypeDef GPIO_InitStructure;
+  
+  ETH_PHY_INT_GPIO_CLK_ENABLE();
+  
+  GPIO_InitStructure.Pin = ETH_PHY_INT_PIN;
+  GPIO_InitStructure.Mode = GPIO_MODE_IT_FALLING;
+  GPIO_InitStructure.Pull = GPIO_PULLUP;
+  GPIO_InitStructure.Speed = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(ETH_PHY_INT_GPIO, &GPIO_InitStructure);
+  
+  /* reading ISFR releases nINT */
+  LAN8742_ClearIT(&LAN8742, LAN8742_LINK_DOWN_IT | LAN8742_AUTONEGO_COMPLETE_IT);
+  LAN8742_EnableIT(&LAN8742, LAN8742_LINK_DOWN_IT | LAN8742_AUTONEGO_COMPLETE_IT);
+  __HAL_GPIO_EXTI_CLEAR_IT(ETH_PHY_INT_PIN);
+  
+  /* same priority as the ETH interrupt, it uses the FreeRTOS API */
+  HAL_NVIC_SetPriority(ETH_PHY_INT_IRQn, 0x7, 0);
+  HAL_NVIC_EnableIRQ(ETH_PHY_INT_IRQn);
+}
+
+/**
+  * @brief  PHY interrupt: only timestamps the event and wakes the link task,
+  *         the MDIO accesses are done there.
+  * @retval None
+  */
+void ETH_PHY_INT_IRQHandler(void)
+{
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  
+  if(__HAL_GPIO_EXTI_GET_IT(ETH_PHY_INT_PIN) != RESET)
+  {
+    __HAL_GPIO_EXTI_CLEAR_IT(ETH_PHY_INT_PIN);
+    LinkIrqTick = xTaskGetTickCountFromISR();
+    
+    if(LinkTaskHandle != NULL)
+    {
+      vTaskNotifyGiveFromISR(LinkTaskHandle, &xHigherPriorityTaskWoken);
+    }
+  }
+  
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+#endif /* ETH_PHY_INT_ENABLE */
+
 /*******************************************************************************
                        Ethernet MSP Routines
 *******************************************************************************/
@@ -547,7 +1542,11 @@ void HAL_ETH_MspInit(ETH_HandleTypeDef *heth)
   */
 void HAL_ETH_RxCpltCallback(ETH_HandleTypeDef *heth)
 {
-	BaseType_t xHigherPriorityTaskWoken;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	
+  /* Switch to poll mode: ethernetif_input() drains the ring and re-arms the interrupt */
+  __HAL_ETH_DMA_DISABLE_IT(heth, ETH_DMACIER_RIE);
+  EthIfStats.rx_to_poll++;
 	
   xSemaphoreGiveFromISR( RxPktSemaphore , &xHigherPriorityTaskWoken );
 	
@@ -557,6 +1556,41 @@ void HAL_ETH_RxCpltCallback(ETH_HandleTypeDef *heth)
 	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
 }
 
+/**
+  * @brief  Ethernet Tx Transfer completed callback
+  * @param  heth: ETH handle
+  * @retval None
+  */
+void HAL_ETH_TxCpltCallback(ETH_HandleTypeDef *heth)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	
+  /* the frames are released by ethernetif_input(), under the core lock */
+  TxReclaimPending = 1;
+	
+  xSemaphoreGiveFromISR( TxPktSemaphore , &xHigherPriorityTaskWoken );
+  xSemaphoreGiveFromISR( RxPktSemaphore , &xHigherPriorityTaskWoken );
+	
+	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+}
+
+/**
+  * @brief  Ethernet DMA error callback. On a fatal bus error the HAL has
+  *         already stopped the DMA interrupts; the error is only counted
+  *         here, the interface recovers on the next link down/up.
+  * @param  heth: ETH handle
+  * @retval None
+  */
+void HAL_ETH_DMAErrorCallback(ETH_HandleTypeDef *heth)
+{
+  EthIfStats.dma_errors++;
+  EthIfStats.dma_error_code = heth->DMAErrorCode;
+  if((heth->DMAErrorCode & ETH_DMACSR_FBE) != 0)
+  {
+    EthIfStats.dma_fatal++;
+  }
+}
+
 /*******************************************************************************
                        PHI IO Functions
 *******************************************************************************/
@@ -632,6 +1666,11 @@ int32_t ETH_PHY_IO_GetTick(void)
 
 /**
   * @brief  Check the ETH link state and update netif accordingly.
+  *         The task sleeps until the PHY interrupt (ETH_PHY_INT_ENABLE) or the
+  *         poll period; a state different from the netif is only applied once
+  *         it is still seen ETH_LINK_DEBOUNCE ms later, shorter flaps are
+  *         counted and ignored. The time from the detection (interrupt or
+  *         poll) to the netif update is kept in the driver counters.
   * @param  argument: netif
   * @retval None
   */
@@ -640,20 +1679,68 @@ void ethernet_link_thread( void* argument )
   ETH_MACConfigTypeDef MACConf;
   int32_t PHYLinkState;
   uint32_t linkchanged = 0, speed = 0, duplex =0;
+  uint32_t pending = 0, latency;
+  TickType_t detected = 0, wait;
   struct netif *netif = (struct netif *) argument;
   
   for(;;)
   {
+    wait = pending ? pdMS_TO_TICKS(ETH_LINK_DEBOUNCE) :
+           pdMS_TO_TICKS(ETH_PHY_INT_ENABLE ? ETH_LINK_POLL_SLOW : ETH_LINK_POLL_FAST);
+    
+    if(ulTaskNotifyTake(pdTRUE, wait) != 0)
+    {
+      EthIfStats.link_irqs++;
+      if(!pending)
+      {
+        detected = LinkIrqTick;
+      }
+#if ETH_PHY_INT_ENABLE
+      /* release nINT before reading the state, a later event raises it again */
+      LAN8742_ClearIT(&LAN8742, LAN8742_LINK_DOWN_IT | LAN8742_AUTONEGO_COMPLETE_IT);
+#endif
+    }
+    else if(!pending)
+    {
+      detected = xTaskGetTickCount();
+    }
     
     PHYLinkState = LAN8742_GetLinkState(&LAN8742);
+    EthIfStats.link_polls++;
+    
+    if((PHYLinkState > LAN8742_STATUS_LINK_DOWN) == (netif_is_link_up(netif) != 0))
+    {
+      if(pending)
+      {
+        /* back to the netif state within the debounce time */
+        pending = 0;
+        EthIfStats.link_flaps++;
+      }
+      continue;
+    }
     
-    if(netif_is_link_up(netif) && (PHYLinkState <= LAN8742_STATUS_LINK_DOWN))
+    if(!pending || (xTaskGetTickCount() - detected) < pdMS_TO_TICKS(ETH_LINK_DEBOUNCE))
+    {
+      pending = 1;
+      continue;
+    }
+    pending = 0;
+    linkchanged = 0;
+    
+    /* the netif is owned by the tcpip thread */
+    LOCK_TCPIP_CORE();
+    
+    if(netif_is_link_up(netif))
     {
       HAL_ETH_Stop_IT(&EthHandle);
+#if ETH_TX_SCHED
+      low_level_tx_sched_flush();
+#endif
       netif_set_down(netif);
       netif_set_link_down(netif);
+      linkchanged = 1;
     }
-    else if(!netif_is_link_up(netif) && (PHYLinkState > LAN8742_STATUS_LINK_DOWN))
+    else
     {
       switch (PHYLinkState)
       {
@@ -689,13 +1776,420 @@ void ethernet_link_thread( void* argument )
         MACConf.Speed = speed;
         HAL_ETH_SetMACConfig(&EthHandle, &MACConf);
         HAL_ETH_Start_IT(&EthHandle);
+        low_level_link_speed(netif, speed);
         netif_set_up(netif);
         netif_set_link_up(netif);
       }
     }
     
-    vTaskDelay(100);
+    UNLOCK_TCPIP_CORE();
+    
+    if(linkchanged)
+    {
+      latency = (xTaskGetTickCount() - detected) * portTICK_PERIOD_MS;
+      EthIfStats.link_changes++;
+      EthIfStats.link_latency_last = latency;
+      if(latency > EthIfStats.link_latency_max)
+      {
+        EthIfStats.link_latency_max = latency;
+      }
+    }
+  }
+}
+
+/**
+  * @brief  Program the MAC address filter from the mode and the multicast
+  *         list: our unicast address (MACA0, set by HAL_ETH_Init()), the
+  *         first multicast addresses in the perfect filter, the others in
+  *         the hash table. Broadcast always passes the MAC, ARP needs it;
+  *         in strict mode low_level_rx_filter() sheds it.
+  *         Called with the TCPIP core locked.
+  * @retval None
+  */
+static void low_level_filter_apply(void)
+{
+  ETH_MACFilterConfigTypeDef FilterConf;
+  uint32_t hash[2] = {0, 0};
+  uint32_t i, j, crc;
+  __IO uint32_t *addrhr;
+  const uint8_t *mac;
+  
+  for(i = 0; i < ETH_MAC_FILTER_PERFECT; i++)
+  {
+    /* MACA1HR, MACA1LR, MACA2HR, ... */
+    addrhr = &EthHandle.Instance->MACA1HR + 2 * i;
+    
+    if(i < MacFilterCnt)
+    {
+      mac = MacFilterAddr[i];
+      addrhr[1] = ((uint32_t)mac[3] << 24) | ((uint32_t)mac[2] << 16) | ((uint32_t)mac[1] << 8) | mac[0];
+      addrhr[0] = ((uint32_t)mac[5] << 8) | mac[4] | ETH_MACAHR_AE;
+    }
+    else
+    {
+      addrhr[0] = 0;
+    }
+  }
+  
+  /* hash bin: upper 6 bits of the bit reversed CRC-32 of the address */
+  for(i = ETH_MAC_FILTER_PERFECT; i < MacFilterCnt; i++)
+  {
+    crc = 0xFFFFFFFFU;
+    for(j = 0; j < ETH_HWADDR_LEN; j++)
+    {
+      crc ^= MacFilterAddr[i][j];
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+    crc = __RBIT(~crc) >> 26;
+    hash[crc >> 5] |= 1U << (crc & 0x1F);
+  }
+  HAL_ETH_SetHashTable(&EthHandle, hash);
+  
+  HAL_ETH_GetMACFilterConfig(&EthHandle, &FilterConf);
+  FilterConf.PromiscuousMode = (MacFilterMode == ETH_FILTER_PROMISCUOUS) ? ENABLE : DISABLE;
+  FilterConf.ReceiveAllMode = DISABLE;
+  FilterConf.PassAllMulticast = DISABLE;
+  FilterConf.HashUnicast = DISABLE;
+  FilterConf.HashMulticast = (MacFilterCnt > ETH_MAC_FILTER_PERFECT) ? ENABLE : DISABLE;
+  FilterConf.HachOrPerfectFilter = FilterConf.HashMulticast;
+  FilterConf.DestAddrInverseFiltering = DISABLE;
+  FilterConf.SrcAddrFiltering = DISABLE;
+  FilterConf.BroadcastFilter = ENABLE;
+  FilterConf.ControlPacketsFilter = ETH_CTRLPACKETS_BLOCK_ALL;
+  HAL_ETH_SetMACFilterConfig(&EthHandle, &FilterConf);
+}
+
+/**
+  * @brief  Software stage of the Rx filter, run before a buffer is lent to
+  *         the stack. Counts the broadcast and multicast frames that passed
+  *         the MAC and, in strict mode, drops the broadcasts other than an
+  *         ARP for our address (or a DHCP reply) and the multicasts that
+  *         only matched a shared hash bin.
+  * @param  netif: the network interface
+  * @param  frame: the received frame, cache already invalidated
+  * @param  len: frame length
+  * @retval 1 to deliver the frame, 0 to drop it
+  */
+static uint32_t low_level_rx_filter(struct netif *netif, const uint8_t *frame, uint32_t len)
+{
+  uint32_t i, ihl;
+  
+  if((frame[0] & 0x01) == 0)
+  {
+    /* unicast, the MAC only lets ours through */
+    return 1;
+  }
+  
+  if(memcmp(frame, ethbroadcast.addr, ETH_HWADDR_LEN) == 0)
+  {
+    EthIfStats.rx_bcast++;
+    
+    if(MacFilterMode != ETH_FILTER_STRICT)
+    {
+      return 1;
+    }
+    
+    /* ARP request or announcement whose target protocol address is ours */
+    if((len >= 42) && (frame[12] == 0x08) && (frame[13] == 0x06) &&
+       (memcmp(&frame[38], netif_ip4_addr(netif), 4) == 0))
+    {
+      return 1;
+    }
+    
+#if LWIP_DHCP
+    /* UDP to the DHCP client port, the server may answer by broadcast */
+    ihl = (frame[14] & 0x0F) * 4;
+    if((frame[12] == 0x08) && (frame[13] == 0x00) && (frame[23] == IP_PROTO_UDP) &&
+       (len >= 14 + ihl + 4) && (frame[14 + ihl + 2] == 0) && (frame[14 + ihl + 3] == 68))
+    {
+      return 1;
+    }
+#else
+    LWIP_UNUSED_ARG(ihl);
+#endif
+    
+    EthIfStats.rx_filter_bcast++;
+    return 0;
+  }
+  
+  EthIfStats.rx_mcast++;
+  
+  if(MacFilterMode != ETH_FILTER_STRICT)
+  {
+    return 1;
+  }
+  
+  for(i = 0; i < MacFilterCnt; i++)
+  {
+    if(memcmp(frame, MacFilterAddr[i], ETH_HWADDR_LEN) == 0)
+    {
+      return 1;
+    }
+  }
+  
+  EthIfStats.rx_filter_mcast++;
+  return 0;
+}
+
+/**
+  * @brief  Add or remove a multicast address in the MAC filter. An address
+  *         added n times stays until removed n times.
+  *         Called with the TCPIP core locked.
+  * @param  mac: the multicast MAC address
+  * @param  action: NETIF_ADD_MAC_FILTER or NETIF_DEL_MAC_FILTER
+  * @retval ERR_OK, ERR_MEM when the list is full, ERR_VAL on an unknown address
+  */
+static err_t low_level_mac_filter(const uint8_t *mac, enum netif_mac_filter_action action)
+{
+  uint32_t i;
+  
+  for(i = 0; i < MacFilterCnt; i++)
+  {
+    if(memcmp(MacFilterAddr[i], mac, ETH_HWADDR_LEN) == 0)
+    {
+      break;
+    }
+  }
+  
+  if(action == NETIF_ADD_MAC_FILTER)
+  {
+    if(i < MacFilterCnt)
+    {
+      MacFilterRef[i]++;
+      return ERR_OK;
+    }
+    if(MacFilterCnt >= ETH_MAC_FILTER_MAX)
+    {
+      return ERR_MEM;
+    }
+    memcpy(MacFilterAddr[MacFilterCnt], mac, ETH_HWADDR_LEN);
+    MacFilterRef[MacFilterCnt++] = 1;
+  }
+  else
+  {
+    if(i == MacFilterCnt)
+    {
+      return ERR_VAL;
+    }
+    if(--MacFilterRef[i] != 0)
+    {
+      return ERR_OK;
+    }
+    /* keep the list packed, the perfect filter takes the first entries */
+    for(MacFilterCnt--; i < MacFilterCnt; i++)
+    {
+      memcpy(MacFilterAddr[i], MacFilterAddr[i + 1], ETH_HWADDR_LEN);
+      MacFilterRef[i] = MacFilterRef[i + 1];
+    }
   }
+  
+  low_level_filter_apply();
+  return ERR_OK;
+}
+
+#if LWIP_IPV4 && LWIP_IGMP
+/**
+  * @brief  netif igmp_mac_filter callback: 01:00:5e + low 23 bits of the group.
+  */
+static err_t low_level_igmp_mac_filter(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action)
+{
+  uint8_t mac[ETH_HWADDR_LEN];
+  
+  LWIP_UNUSED_ARG(netif);
+  
+  mac[0] = LL_IP4_MULTICAST_ADDR_0;
+  mac[1] = LL_IP4_MULTICAST_ADDR_1;
+  mac[2] = LL_IP4_MULTICAST_ADDR_2;
+  mac[3] = ip4_addr2(group) & 0x7F;
+  mac[4] = ip4_addr3(group);
+  mac[5] = ip4_addr4(group);
+  
+  return low_level_mac_filter(mac, action);
+}
+#endif /* LWIP_IPV4 && LWIP_IGMP */
+
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+/**
+  * @brief  netif mld_mac_filter callback: 33:33 + low 32 bits of the group.
+  */
+static err_t low_level_mld_mac_filter(struct netif *netif, const ip6_addr_t *group, enum netif_mac_filter_action action)
+{
+  uint8_t mac[ETH_HWADDR_LEN];
+  uint32_t low = lwip_ntohl(group->addr[3]);
+  
+  LWIP_UNUSED_ARG(netif);
+  
+  mac[0] = LL_IP6_MULTICAST_ADDR_0;
+  mac[1] = LL_IP6_MULTICAST_ADDR_1;
+  mac[2] = (uint8_t)(low >> 24);
+  mac[3] = (uint8_t)(low >> 16);
+  mac[4] = (uint8_t)(low >> 8);
+  mac[5] = (uint8_t)low;
+  
+  return low_level_mac_filter(mac, action);
+}
+#endif /* LWIP_IPV6 && LWIP_IPV6_MLD */
+
+/**
+  * @brief  Select the Rx filter mode.
+  * @param  mode: ETH_FILTER_NORMAL: our unicast, broadcast and the multicast
+  *               groups joined; ETH_FILTER_STRICT: our unicast, the joined
+  *               groups and only the broadcasts for us (ARP for our address,
+  *               DHCP replies); ETH_FILTER_PROMISCUOUS: everything.
+  * @retval ERR_OK or ERR_ARG
+  */
+err_t ethernetif_set_filter_mode(uint8_t mode)
+{
+  if(mode > ETH_FILTER_PROMISCUOUS)
+  {
+    return ERR_ARG;
+  }
+  
+  LOCK_TCPIP_CORE();
+  MacFilterMode = mode;
+  low_level_filter_apply();
+  UNLOCK_TCPIP_CORE();
+  
+  return ERR_OK;
+}
+
+/**
+  * @brief  Accept (or stop accepting) a multicast MAC address that is not
+  *         managed by IGMP/MLD, e.g. a raw L2 protocol.
+  * @param  mac: the multicast MAC address
+  * @param  action: NETIF_ADD_MAC_FILTER or NETIF_DEL_MAC_FILTER
+  * @retval ERR_OK, ERR_ARG if not a multicast address, ERR_MEM, ERR_VAL
+  */
+err_t ethernetif_mac_filter(const uint8_t *mac, enum netif_mac_filter_action action)
+{
+  err_t err;
+  
+  if((mac[0] & 0x01) == 0 || memcmp(mac, ethbroadcast.addr, ETH_HWADDR_LEN) == 0)
+  {
+    return ERR_ARG;
+  }
+  
+  LOCK_TCPIP_CORE();
+  err = low_level_mac_filter(mac, action);
+  UNLOCK_TCPIP_CORE();
+  
+  return err;
+}
+
+/**
+  * @brief  Take a snapshot of the driver counters.
+  * @param  stats: destination of the snapshot
+  * @retval None
+  */
+void ethernetif_get_stats(struct ethernetif_stats *stats)
+{
+  taskENTER_CRITICAL();
+  *stats = EthIfStats;
+  taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Take a snapshot of the Tx scheduler counters and histograms.
+  * @param  stats: destination of the snapshot, zero without ETH_TX_SCHED
+  * @retval None
+  */
+void ethernetif_get_tx_sched_stats(struct ethernetif_tx_sched_stats *stats)
+{
+#if ETH_TX_SCHED
+  uint32_t cls;
+  
+  taskENTER_CRITICAL();
+  *stats = TxSchedStats;
+  for(cls = 0; cls < ETH_TX_CLASSES; cls++)
+  {
+    stats->cls[cls].depth = TxSchedQ[cls].cnt;
+  }
+  taskEXIT_CRITICAL();
+#else
+  memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+/**
+  * @brief  Shape the bulk class of the Tx scheduler.
+  * @param  pct: token bucket rate in percent of the link speed, 0: not shaped
+  * @param  burst: bucket depth in bytes, at least one frame
+  * @retval ERR_OK, ERR_VAL without ETH_TX_SCHED
+  */
+err_t ethernetif_tx_sched_shape(u8_t pct, u32_t burst)
+{
+#if ETH_TX_SCHED
+  LOCK_TCPIP_CORE();
+  TxSchedBulkPct = pct;
+  TxSchedStats.bulk_burst = LWIP_MAX(burst, ETH_TX_FRAME_MAX);
+  TxSchedTokens = LWIP_MIN(TxSchedTokens, TxSchedStats.bulk_burst);
+  low_level_tx_sched_rate();
+  UNLOCK_TCPIP_CORE();
+  
+  return ERR_OK;
+#else
+  LWIP_UNUSED_ARG(pct);
+  LWIP_UNUSED_ARG(burst);
+  return ERR_VAL;
+#endif
+}
+
+/**
+  * @brief  Measure, in CPU cycles, the D-cache maintenance of the selected
+  *         Rx buffer mode and the cost of reading a frame from it, then log
+  *         the results. Build once with ETH_RX_BUFFER_NONCACHEABLE = 0 and
+  *         once with 1 to compare both modes. A spare Rx buffer is borrowed
+  *         for the measure, so this may run while the interface is up.
+  * @retval None
+  */
+void ethernetif_cache_benchmark(void)
+{
+  RxBuff_t *rx_buff;
+  uint32_t cycles, inval_ack, inval_full, clean_full, read_full, idx;
+  volatile uint32_t sum = 0;
+  
+  rx_buff = low_level_rx_buff_get();
+  if(rx_buff == NULL)
+  {
+    log_e("cache benchmark: no spare Rx buffer");
+    return;
+  }
+  
+  /* 64 bytes frame (TCP ACK) and full size frame, precise invalidation */
+  cycles = DWT_CYCCNT;
+  SCB_InvalidateDCache_by_Addr((uint32_t *)rx_buff->buff, 64);
+  inval_ack = DWT_CYCCNT - cycles;
+  
+  cycles = DWT_CYCCNT;
+  SCB_InvalidateDCache_by_Addr((uint32_t *)rx_buff->buff, ETH_RX_BUFFER_SIZE);
+  inval_full = DWT_CYCCNT - cycles;
+  
+  /* CPU read of a full size frame just handed over by the DMA */
+  cycles = DWT_CYCCNT;
+  for(idx = 0; idx < ETH_RX_BUFFER_SIZE / 4; idx++)
+  {
+    sum += ((uint32_t *)rx_buff->buff)[idx];
+  }
+  read_full = DWT_CYCCNT - cycles;
+  
+  cycles = DWT_CYCCNT;
+  SCB_CleanDCache_by_Addr((uint32_t *)rx_buff->buff, ETH_RX_BUFFER_SIZE);
+  clean_full = DWT_CYCCNT - cycles;
+  
+  /* nothing written to the buffer, it can go back as is */
+  low_level_rx_buff_put(rx_buff);
+  
+  log_i("cache benchmark, Rx buffers %s, cycles:", ETH_RX_BUFFER_NONCACHEABLE ? "non-cacheable" : "cacheable");
+  log_i("  invalidate 64B %u, 1536B %u, whole ring (%u buffers) ~%u",
+        inval_ack, inval_full, ETH_RX_DESC_CNT, inval_full * ETH_RX_DESC_CNT);
+  log_i("  clean 1536B %u, read 1536B %u", clean_full, read_full);
 }
 
 /**
@@ -710,6 +2204,9 @@ void eth_link_callback(struct netif *netif)
   if(netif_is_link_up(netif))
   {
 		log_e( "eth_link_callback: %s netif is up.\r\n", netif->name );
+		
+		/* reconnect the managed TCP clients now rather than after their backoff */
+		tcp_conn_mgr_link_changed(1);
   }
   else
   {
@@ -50,10 +50,112 @@
 #include "lwip/err.h"
 #include "lwip/netif.h"
 
+/* Exported constants --------------------------------------------------------*/
+/* Rx filter modes, see ethernetif_set_filter_mode() */
+#define ETH_FILTER_NORMAL                      0
+#define ETH_FILTER_STRICT                      1
+#define ETH_FILTER_PROMISCUOUS                 2
+
+/* Tx scheduler classes (ETH_TX_SCHED in netif_port.c): ARP and the frames whose DSCP is at
+   least ETH_TX_SCHED_CTRL_DSCP are control, the others bulk. A pcb picks its class with its
+   tos field, e.g. pcb->tos = ETH_TX_TOS_CONTROL. */
+#define ETH_TX_CLASS_CONTROL                   0
+#define ETH_TX_CLASS_BULK                      1
+#define ETH_TX_CLASSES                         2
+
+#define ETH_TX_TOS_CONTROL                     0xB8    /* DSCP EF (46) */
+
+/* Tx scheduler histograms: queueing latency, upper bucket edges in us, and queue depth seen by
+   an arriving frame, bucket i up to 2^i frames */
+#define ETH_TX_LAT_EDGES                       { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000 }
+#define ETH_TX_LAT_BUCKETS                     12      /* the edges and above the last one */
+#define ETH_TX_DEPTH_BUCKETS                   7
+
 /* Exported types ------------------------------------------------------------*/
 /* Structure that include link thread parameters */
+
+/* Ethernet driver counters */
+struct ethernetif_stats
+{
+  /* Rx adaptive interrupt/poll mode */
+  u32_t rx_frames;                 /* frames handed to the stack */
+  u32_t rx_bytes;                  /* bytes handed to the stack */
+  u32_t rx_wakeups;                /* input task wakeups by the Rx interrupt */
+  u32_t rx_poll_passes;            /* budgeted passes, one core-lock hold each */
+  u32_t rx_max_frames_per_wakeup;  /* largest burst drained by one wakeup */
+  u32_t rx_to_poll;                /* interrupt -> poll mode switches */
+  u32_t rx_to_irq;                 /* poll -> interrupt mode switches */
+  
+  /* Rx ring and zero-copy buffer pool */
+  u32_t rx_dropped;                /* frames dropped by the driver */
+  u32_t rx_pool_empty;             /* drops because no spare Rx buffer was free */
+  u32_t rx_buff_min_free;          /* low-water mark of the Rx buffer free list */
+  u32_t rx_missed;                 /* frames dropped by the DMA, no descriptor available */
+  
+  /* asynchronous Tx */
+  u32_t tx_frames;                 /* frames accepted (queued to the Tx scheduler or the DMA) */
+  u32_t tx_bytes;                  /* bytes queued to the DMA */
+  u32_t tx_completed;              /* frames released: all those accepted before this count are done */
+  u32_t tx_bounced;                /* frames coalesced into a bounce pbuf */
+  u32_t tx_ring_full;              /* waits for a free descriptor (scheduler: passes stopped by the ring) */
+  u32_t tx_dropped;                /* frames dropped: ring full, no memory or DMA error */
+  u32_t tx_max_desc_in_use;        /* high-water mark of busy Tx descriptors */
+  
+  /* D-cache maintenance, DWT cycles */
+  u32_t rx_cache_cycles;           /* spent invalidating Rx buffers */
+  u32_t tx_cache_cycles;           /* spent cleaning Tx payloads */
+  
+  /* PHY link detection */
+  u32_t link_changes;              /* link up/down applied to the netif */
+  u32_t link_irqs;                 /* link task wakeups by the PHY interrupt */
+  u32_t link_polls;                /* PHY link state reads (MDIO) */
+  u32_t link_flaps;                /* changes shorter than ETH_LINK_DEBOUNCE, ignored */
+  u32_t link_latency_last;         /* ms from the detection to the netif update */
+  u32_t link_latency_max;
+  
+  /* Rx filter, see ethernetif_set_filter_mode() */
+  u32_t rx_bcast;                  /* broadcast frames passed by the MAC */
+  u32_t rx_mcast;                  /* multicast frames passed by the MAC */
+  u32_t rx_filter_bcast;           /* broadcasts not for us, dropped in strict mode */
+  u32_t rx_filter_mcast;           /* multicasts of a shared hash bin, dropped in strict mode */
+  
+  /* DMA errors, see HAL_ETH_DMAErrorCallback() */
+  u32_t dma_errors;                /* abnormal DMA interrupts */
+  u32_t dma_fatal;                 /* fatal bus errors, the DMA is stopped */
+  u32_t dma_error_code;            /* DMACSR error bits of the last one */
+};
+
+/* Tx scheduler counters of one class */
+struct ethernetif_tx_class_stats
+{
+  u32_t frames;                    /* handed to the DMA */
+  u32_t bytes;
+  u32_t dropped;                   /* class queue full, or flushed at link down */
+  u32_t depth;                     /* frames queued now */
+  u32_t depth_max;
+  u32_t lat_max;                   /* us from the queue to the DMA ring */
+  u32_t depth_hist[ETH_TX_DEPTH_BUCKETS];
+  u32_t lat_hist[ETH_TX_LAT_BUCKETS];
+};
+
+/* Tx scheduler, see ethernetif_get_tx_sched_stats() */
+struct ethernetif_tx_sched_stats
+{
+  struct ethernetif_tx_class_stats cls[ETH_TX_CLASSES];
+  u32_t bulk_rate;                 /* token bucket, bytes/s, 0: not shaped */
+  u32_t bulk_burst;                /* bucket depth, bytes */
+  u32_t bulk_shaped;               /* passes stopped for lack of tokens */
+  u32_t bulk_desc_full;            /* passes stopped by the bulk share of the ring */
+};
+
 /* Exported functions ------------------------------------------------------- */
 err_t ethernetif_init(struct netif *netif);      
 void ethernet_link_thread( void * argument );
 void eth_link_callback(struct netif *netif);
+void ethernetif_get_stats(struct ethernetif_stats *stats);
+void ethernetif_cache_benchmark(void);
+err_t ethernetif_set_filter_mode(u8_t mode);
+err_t ethernetif_mac_filter(const u8_t *mac, enum netif_mac_filter_action action);
+void ethernetif_get_tx_sched_stats(struct ethernetif_tx_sched_stats *stats);
+err_t ethernetif_tx_sched_shape(u8_t pct, u32_t burst);
 #endif
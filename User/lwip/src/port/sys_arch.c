@@ -39,7 +39,9 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+#if !defined(NETIF_HOST)
 #include "bsp.h"
+#endif
 
 /**
  * @ingroup sys_time
@@ -83,8 +85,12 @@ err_t sys_mbox_new(sys_mbox_t *mbox, int size)
 	*mbox = xQueueCreate( archMessageLength, sizeof( void * ) );
 
 	if (*mbox == NULL)
+	{
+		SYS_STATS_INC(mbox.err);
 		return ERR_MEM;
+	}
  
+	SYS_STATS_INC_USED(mbox);
 	return ERR_OK;
  
 }
@@ -113,6 +119,7 @@ void sys_mbox_free(sys_mbox_t *mbox)
 	}
 
 	vQueueDelete( *mbox );
+	SYS_STATS_DEC(mbox.used);
 
 }
 
@@ -153,7 +160,7 @@ err_t sys_mbox_trypost(sys_mbox_t *mbox, void *msg)
 	 {
       // could not post, queue must be full
       result = ERR_MEM;
-		 
+      SYS_STATS_INC(mbox.err);
    }
 
    return result;
@@ -181,7 +188,7 @@ err_t sys_mbox_trypost_fromisr(sys_mbox_t *mbox, void *msg)
 	 {
       // could not post, queue must be full
       result = ERR_MEM;
-		 
+      SYS_STATS_INC(mbox.err);
    }
 
 		// Actual macro used here is port specific.
@@ -326,9 +333,12 @@ err_t sys_sem_new( sys_sem_t *sem, u8_t count )
 	
 	if(*sem == NULL)
 	{
+		SYS_STATS_INC(sem.err);
 		return ERR_MEM;
 	}
 	
+	SYS_STATS_INC_USED(sem);
+	
 	if(count == 0)	// Means it can't be taken
 	{
 		xSemaphoreTake(*sem,1);
@@ -413,6 +423,7 @@ void sys_sem_signal(sys_sem_t *sem)
 void sys_sem_free(sys_sem_t *sem)
 {
 	vSemaphoreDelete(*sem);
+	SYS_STATS_DEC(sem.used);
 }
 
 #ifndef sys_sem_valid
@@ -468,9 +479,12 @@ err_t sys_mutex_new(sys_mutex_t *mutex)
 	
 	if(*mutex == NULL)
 	{
+		SYS_STATS_INC(mutex.err);
 		return ERR_MEM;
 	}
 	
+	SYS_STATS_INC_USED(mutex);
+	
   return ERR_OK;
 	
 }
@@ -483,6 +497,7 @@ err_t sys_mutex_new(sys_mutex_t *mutex)
 void sys_mutex_free(sys_mutex_t *mutex)
 {
 	vSemaphoreDelete(*mutex);
+	SYS_STATS_DEC(mutex.used);
 }
 
 /**
@@ -0,0 +1,62 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\tcp_profile.c
+  * @author  suozhang
+  * @brief   Per connection TCP window profile.
+  *
+  *          With TCP_PROFILE_BULK the stack wide TCP_WND / TCP_SND_BUF are
+  *          sized for bulk transfers. tcp_profile_control() brings a
+  *          connection back to the TCP_PROFILE_CONTROL_WND receive window
+  *          and TCP_PROFILE_CONTROL_SND_BUF send buffer:
+  *          - the send buffer is a credit, given back by the ACKs, so the
+  *            lower initial value caps the connection for its whole life;
+  *          - the receive window cap is pcb->rcv_wnd_max, used by lwIP in
+  *            place of TCP_WND once window scaling is agreed.
+  *          It also marks the connection TCP_PROFILE_CONTROL_TOS, which puts
+  *          its segments ahead of the bulk traffic in the Ethernet Tx
+  *          scheduler.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "lwip/opt.h"
+
+#if LWIP_TCP
+
+#include "lwip/tcp.h"
+#include "tcp_profile.h"
+
+#if LWIP_WND_SCALE && ((TCP_PROFILE_CONTROL_WND >> TCP_RCV_SCALE) == 0)
+#error "TCP_PROFILE_CONTROL_WND is too small for TCP_RCV_SCALE"
+#endif
+
+/* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  Give a connection the small control window and send buffer,
+  *         and the control TOS.
+  *         Call it on a new pcb, before tcp_connect() (netconn: between
+  *         netconn_new() and netconn_connect()); the pcb is not yet known to
+  *         the stack then. Connections accepted by a listener keep TCP_WND.
+  * @param  pcb: the tcp_pcb, in the CLOSED state
+  * @retval ERR_OK, or ERR_VAL when the connection is already open
+  */
+err_t tcp_profile_control(struct tcp_pcb *pcb)
+{
+  if((pcb == NULL) || (pcb->state != CLOSED))
+  {
+    return ERR_VAL;
+  }
+
+#if LWIP_WND_SCALE
+  pcb->rcv_wnd_max = LWIP_MIN(TCP_PROFILE_CONTROL_WND, TCP_WND);
+  pcb->rcv_wnd = pcb->rcv_ann_wnd = TCP_WND_MAX(pcb);
+#endif
+  if(pcb->snd_buf > TCP_PROFILE_CONTROL_SND_BUF)
+  {
+    pcb->snd_buf = TCP_PROFILE_CONTROL_SND_BUF;
+  }
+  pcb->tos = TCP_PROFILE_CONTROL_TOS;
+  return ERR_OK;
+}
+
+#endif /* LWIP_TCP */
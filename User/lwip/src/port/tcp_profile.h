@@ -0,0 +1,33 @@
+/**
+  ******************************************************************************
+  * @file    stm32h7_freertos\User\lwip\src\port\tcp_profile.h
+  * @author  suozhang
+  * @brief   Header for tcp_profile.c module
+  ******************************************************************************
+  */
+
+#ifndef __TCP_PROFILE_H__
+#define __TCP_PROFILE_H__
+
+#include "lwip/opt.h"
+#include "lwip/tcp.h"
+
+/* Exported constants --------------------------------------------------------*/
+#ifndef TCP_PROFILE_CONTROL_WND
+#define TCP_PROFILE_CONTROL_WND       TCP_WND
+#endif
+
+#ifndef TCP_PROFILE_CONTROL_SND_BUF
+#define TCP_PROFILE_CONTROL_SND_BUF   TCP_SND_BUF
+#endif
+
+/* IP TOS of the control connections, DSCP EF: the Ethernet Tx scheduler
+   sends them in its control class (ETH_TX_TOS_CONTROL, netif_port.h) */
+#ifndef TCP_PROFILE_CONTROL_TOS
+#define TCP_PROFILE_CONTROL_TOS       0xB8
+#endif
+
+/* Exported functions ------------------------------------------------------- */
+err_t tcp_profile_control(struct tcp_pcb *pcb);
+
+#endif
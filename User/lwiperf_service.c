@@ -0,0 +1,182 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : lwiperf_service
+*	文件名称 : lwiperf_service.c
+*	版    本 : V1.0
+*	说    明 : iperf2 compatible TCP throughput benchmark built on lwip/apps/lwiperf.
+*              Every LWIPERF_SERVICE_INTERVAL ms of traffic the interface throughput, the TCP
+*              retransmits and the buffer exhaustion events are reported through EasyLogger,
+*              tagged with the TCP_WND / TCP_SND_BUF profile of the build.
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月20日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "lwiperf_service.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "lwiperf_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#include "lwip/apps/lwiperf.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+#include "netif_port.h"
+#include "mem_profile.h"
+
+/* below this many bytes in one interval the link is considered idle and nothing is logged */
+#define LWIPERF_SERVICE_IDLE_BYTES    1024
+
+/* counters sampled at the previous interval */
+static struct ethernetif_stats lwiperf_last_eth;
+static u32_t lwiperf_last_rexmit;
+static u32_t lwiperf_last_mem_err;
+
+/* sum of the allocation failures of the lwIP heap and of all the memp pools */
+static u32_t lwiperf_mem_err( void )
+{
+  u32_t err = 0;
+#if MEMP_STATS
+  int i;
+  
+  for( i = 0; i < MEMP_MAX; i++ )
+  {
+    err += lwip_stats.memp[i]->err;
+  }
+#endif
+#if MEM_STATS
+  err += lwip_stats.mem.err;
+#endif
+  return err;
+}
+
+static u32_t lwiperf_rexmit( void )
+{
+#if MIB2_STATS
+  return lwip_stats.mib2.tcpretranssegs;
+#else
+  return 0;
+#endif
+}
+
+/* sys_timeout handler, runs in the tcpip thread */
+static void lwiperf_interval_report( void *arg )
+{
+  struct ethernetif_stats eth;
+  u32_t rx_bytes, tx_bytes, rexmit, mem_err;
+  
+  LWIP_UNUSED_ARG(arg);
+  
+  ethernetif_get_stats( &eth );
+  
+  rx_bytes = eth.rx_bytes - lwiperf_last_eth.rx_bytes;
+  tx_bytes = eth.tx_bytes - lwiperf_last_eth.tx_bytes;
+  rexmit   = lwiperf_rexmit() - lwiperf_last_rexmit;
+  mem_err  = lwiperf_mem_err() - lwiperf_last_mem_err;
+  
+  if( rx_bytes + tx_bytes > LWIPERF_SERVICE_IDLE_BYTES )
+  {
+    /* bytes * 8 / ms = kbit/s */
+    log_i( "[%s] rx %u kbit/s, tx %u kbit/s, rexmit %u, mem err %u, rx pool empty %u, rx dropped %u, tx ring full %u",
+           LWIPERF_SERVICE_PROFILE,
+           (unsigned)(rx_bytes / LWIPERF_SERVICE_INTERVAL * 8),
+           (unsigned)(tx_bytes / LWIPERF_SERVICE_INTERVAL * 8),
+           (unsigned)rexmit, (unsigned)mem_err,
+           (unsigned)(eth.rx_pool_empty - lwiperf_last_eth.rx_pool_empty),
+           (unsigned)(eth.rx_dropped + eth.rx_missed - lwiperf_last_eth.rx_dropped - lwiperf_last_eth.rx_missed),
+           (unsigned)(eth.tx_ring_full - lwiperf_last_eth.tx_ring_full) );
+  }
+  
+  lwiperf_last_eth     = eth;
+  lwiperf_last_rexmit += rexmit;
+  lwiperf_last_mem_err += mem_err;
+  
+  sys_timeout( LWIPERF_SERVICE_INTERVAL, lwiperf_interval_report, NULL );
+}
+
+/* end of session report from lwiperf, runs in the tcpip thread */
+static void lwiperf_report( void *arg, enum lwiperf_report_type report_type,
+                            const ip_addr_t* local_addr, u16_t local_port, const ip_addr_t* remote_addr, u16_t remote_port,
+                            u32_t bytes_transferred, u32_t ms_duration, u32_t bandwidth_kbitpsec )
+{
+  static const char * const report_name[] =
+  {
+    "server done", "client done", "aborted local", "aborted data error", "aborted tx error", "aborted remote"
+  };
+  
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(local_addr);
+  LWIP_UNUSED_ARG(local_port);
+  
+  log_i( "[%s] %s, peer %s:%u, %u bytes in %u ms, %u kbit/s",
+         LWIPERF_SERVICE_PROFILE,
+         report_type < LWIP_ARRAYSIZE(report_name) ? report_name[report_type] : "?",
+         ipaddr_ntoa( remote_addr ), remote_port,
+         (unsigned)bytes_transferred, (unsigned)ms_duration, (unsigned)bandwidth_kbitpsec );
+  
+  /* mem_malloc() size classes after the run, see lwippools.h */
+  mem_profile_dump();
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: lwiperf_service_start
+*	功能说明: 启动 iperf 服务端 (和可选的客户端) 以及周期性统计输出，在 netif 初始化之后调用
+*	形    参: 无
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void lwiperf_service_start( void )
+{
+#ifdef LWIPERF_SERVICE_CLIENT_IP
+  ip_addr_t remote_ip;
+#endif
+  
+  log_i( "[%s] TCP_MSS %u, TCP_WND %u, TCP_SND_BUF %u, MEM_SIZE %u, PBUF_POOL_SIZE %u",
+         LWIPERF_SERVICE_PROFILE, TCP_MSS, TCP_WND, TCP_SND_BUF, MEM_SIZE, PBUF_POOL_SIZE );
+#if LWIP_WND_SCALE
+  log_i( "[%s] window scale %u, TCP_SND_QUEUELEN %u, MEMP_NUM_TCP_SEG %u, MEMP_NUM_PBUF %u",
+         LWIPERF_SERVICE_PROFILE, TCP_RCV_SCALE, TCP_SND_QUEUELEN, MEMP_NUM_TCP_SEG, MEMP_NUM_PBUF );
+#endif
+  
+  LOCK_TCPIP_CORE();
+  
+  ethernetif_get_stats( &lwiperf_last_eth );
+  lwiperf_last_rexmit  = lwiperf_rexmit();
+  lwiperf_last_mem_err = lwiperf_mem_err();
+  
+#if LWIPERF_SERVICE_SERVER
+  if( lwiperf_start_tcp_server_default( lwiperf_report, NULL ) == NULL )
+  {
+    log_e( "lwiperf server start failed" );
+  }
+#endif
+
+#ifdef LWIPERF_SERVICE_CLIENT_IP
+  ipaddr_aton( LWIPERF_SERVICE_CLIENT_IP, &remote_ip );
+  if( lwiperf_start_tcp_client_default( &remote_ip, lwiperf_report, NULL ) == NULL )
+  {
+    log_e( "lwiperf client start failed" );
+  }
+#endif
+  
+  sys_timeout( LWIPERF_SERVICE_INTERVAL, lwiperf_interval_report, NULL );
+  
+  UNLOCK_TCPIP_CORE();
+}
@@ -0,0 +1,45 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : lwiperf_service
+*	文件名称 : lwiperf_service.h
+*	版    本 : V1.0
+*	说    明 : iperf2 compatible TCP throughput benchmark (lwiperf) with periodic report
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月20日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __LWIPERF_SERVICE_H__
+#define  __LWIPERF_SERVICE_H__
+
+#include "lwip/opt.h"
+
+/* 1: start the iperf server on LWIPERF_TCP_PORT_DEFAULT (5001), test with "iperf -c <board ip> -i 1" */
+#ifndef LWIPERF_SERVICE_SERVER
+#define LWIPERF_SERVICE_SERVER        1
+#endif
+
+/* define to run a client session against "iperf -s" on this host, e.g. "192.168.0.22" */
+/* #define LWIPERF_SERVICE_CLIENT_IP  "192.168.0.22" */
+
+/* period of the throughput / retransmit / pool exhaustion report, in ms */
+#ifndef LWIPERF_SERVICE_INTERVAL
+#define LWIPERF_SERVICE_INTERVAL      1000
+#endif
+
+/* name of the TCP_WND / TCP_SND_BUF configuration being measured, printed with every result */
+#ifndef LWIPERF_SERVICE_PROFILE
+#if TCP_PROFILE_BULK
+#define LWIPERF_SERVICE_PROFILE       "bulk"
+#else
+#define LWIPERF_SERVICE_PROFILE       "default"
+#endif
+#endif
+
+void lwiperf_service_start( void );
+
+#endif
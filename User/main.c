@@ -43,8 +43,20 @@
 #include "lwip/netif.h"
 #include "lwip/tcpip.h"
 #include "netif_port.h"
+#include "chksum_port.h"
+#include "frame_codec.h"
+#include "fs_qspi.h"
+#include "lwip/apps/httpd.h"
+#include "tftp_qspi.h"
+#include "tcp_srv.h"
+#include "net_boot.h"
 
 #include "tcp_client.h"
+#include "lwiperf_service.h"
+#include "net_stats.h"
+#include "udp_stream.h"
+#include "mqtt_pub.h"
+#include "tcp_conn_mgr.h"
 
 static void vTaskLED (void *pvParameters);
 static void vTaskLwip(void *pvParameters);
@@ -104,6 +116,9 @@ static void netif_config(void)
   IP_ADDR4(&netmask,255,255,255,0);
   IP_ADDR4(&gw,192,168,0,1);
 
+  /* DHCP ʱʹñ SRAM ϴεԼ (net_boot.c)ûԼʱΪ 0.0.0.0 */
+  net_boot_addr(ip_2_ip4(&ipaddr), ip_2_ip4(&netmask), ip_2_ip4(&gw));
+
   /* add the network interface */ 
   netif_add(&gnetif, &ipaddr, &netmask, &gw, NULL, &ethernetif_init, &tcpip_input);
   
@@ -133,13 +148,53 @@ static void vTaskLwip(void *pvParameters)
   /* Initilaize the netif */
   netif_config();
 
-	for(;;)
-	{
-		
-		tcp_client_conn_server_task();
-		
-		vTaskDelay( 2000 / portTICK_PERIOD_MS );
-	}
+  /* DHCP: ϴεԼʱ INIT-REBOOT ȷϲʹã DISCOVER (Rapid Commit)¼׸ TCP ӵʱ */
+  net_boot_start(&gnetif);
+  
+  /* ̫ջ D-Cache άͨ elog  */
+  ethernetif_cache_benchmark();
+  
+  /* У (chksum_port.c)  lwIP ͨʵֵһУͺʱ */
+  lwip_chksum_port_test();
+  
+  /* ֡: ֡ݵУ, ʱ */
+  frame_codec_test();
+  
+  /* iperf ԷPC ʹ iperf -c 192.168.0.11 -i 1  */
+  lwiperf_service_start();
+  
+  /* ҳҳ QSPI Flash еļϵͳ (makefsdata -img)ûоʱ fsdata.c */
+  fs_qspi_init();
+  LOCK_TCPIP_CORE();
+  httpd_init();
+  UNLOCK_TCPIP_CORE();
+  
+  /* TFTP ϴ fs.img / firmware.bin д QSPI FlashPC ʹ tftp -m binary 192.168.0.11 -c put fs.img */
+  tftp_qspi_start();
+  
+  /* ͻ TCP  (raw API)TCP_SRV_ECHO_PORT ϵ echo ڸز */
+  tcp_srv_start();
+  
+  /* ͳ: , Կ (־ / UDP ) */
+  net_stats_overhead();
+  net_stats_start();
+
+#ifdef UDP_STREAM_IP
+  /* UDP ңUDP_STREAM_BENCH Ϊ 1 ʱʲ */
+  udp_stream_start();
+  udp_stream_bench_start();
+#endif
+
+#ifdef MQTT_PUB_BROKER_IP
+  /* MQTT , ʱ浽 SDRAM, MQTT_PUB_BENCH Ϊ 1 ʱзʺӳٲ */
+  mqtt_pub_start();
+  mqtt_pub_bench_start();
+#endif
+
+	/* ̨ӵǼǵӹΪӹУ */
+	tcp_client_init();
+	
+	tcp_conn_mgr_run();
 }
 
 /*
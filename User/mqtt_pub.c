@@ -0,0 +1,729 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : mqtt_pub
+*	文件名称 : mqtt_pub.c
+*	版    本 : V1.0
+*	说    明 : Messages published by any task are appended to a spool (SDRAM) in place: the open
+*              batch of a topic grows, separator joined, until it holds MQTT_PUB_BATCH_SIZE bytes,
+*              another topic is published or MQTT_PUB_BATCH_MS expires. Closed batches are
+*              published QoS1 from the tcpip thread, up to MQTT_PUB_WINDOW waiting for their PUBACK,
+*              and leave the spool in order once acknowledged. The MQTT client copies a publish
+*              into its output ring (MQTT_OUTPUT_RINGBUF_SIZE), a full ring or window only defers
+*              the next batch to the next PUBACK or batch tick.
+*
+*              While the broker is unreachable the batches stay in the spool, with the oldest
+*              dropped when it is full, and are drained back to back after the reconnect. The
+*              publishes not acknowledged when the connection was lost are sent again: delivery
+*              is at least once (the lwIP client always opens a clean session).
+*
+*              Latency: mqtt_pub_publish() of the first message of a batch to its PUBACK,
+*              counted per message in a histogram, see mqtt_pub_get_stats().
+*
+*              Test with a local mosquitto (host build NETIF_HOST, TAP device, or the board):
+*                mosquitto -p 1883 -v
+*                mosquitto_sub -h 192.168.0.22 -t "stm32h7/#" -v
+*              with MQTT_PUB_BROKER_IP the broker address and MQTT_PUB_BENCH 1. Stopping the
+*              broker during the bench fills the spool, restarting it shows the drain.
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月29日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "mqtt_pub.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "mqtt_pub_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#include "lwip/sys.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "lwip/apps/mqtt.h"
+#include "lwip/apps/mqtt_priv.h"
+#include <string.h>
+#include <stdio.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if !LWIP_TCP || !LWIP_TCPIP_CORE_LOCKING
+#error "mqtt_pub needs LWIP_TCP and LWIP_TCPIP_CORE_LOCKING"
+#endif
+
+#if MQTT_PUB_WINDOW > MQTT_REQ_MAX_IN_FLIGHT
+#error "MQTT_PUB_WINDOW is larger than the request slots of the MQTT client (MQTT_REQ_MAX_IN_FLIGHT)"
+#endif
+
+#if (MQTT_PUB_BATCH_SIZE < MQTT_PUB_MSG_MAX) || (MQTT_PUB_BATCH_SIZE > 0xFFFF)
+#error "MQTT_PUB_BATCH_SIZE must hold one MQTT_PUB_MSG_MAX message and fit a u16_t"
+#endif
+
+/* fixed header (5), topic, packet id: a whole publish must fit the output ring */
+#if (5 + 2 + MQTT_PUB_TOPIC_MAX + 2 + MQTT_PUB_BATCH_SIZE) > MQTT_OUTPUT_RINGBUF_SIZE
+#error "MQTT_OUTPUT_RINGBUF_SIZE cannot hold a MQTT_PUB_BATCH_SIZE publish"
+#endif
+
+#if (MQTT_PUB_SPOOL_SIZE % 4) || (MQTT_PUB_SPOOL_SIZE < 4 * (MQTT_PUB_BATCH_SIZE + MQTT_PUB_TOPIC_MAX))
+#error "MQTT_PUB_SPOOL_SIZE must be a multiple of 4 and hold a few batches"
+#endif
+
+/* batch in the spool: this header, the topic and its NUL, the payload, padded to 4 bytes */
+typedef struct
+{
+  u16_t topic_len;                /* MQTT_PUB_WRAP: continue at the start of the spool */
+  u16_t len;                      /* payload */
+  u16_t msgs;
+  u16_t reserved;
+  u32_t t_first;                  /* sys_now() of the first message */
+} mqtt_pub_rec_t;
+
+#define MQTT_PUB_WRAP                 0xFFFF
+#define MQTT_PUB_SPAN(tl, len)        ((sizeof(mqtt_pub_rec_t) + (tl) + 1 + (len) + 3) & ~3UL)
+#define MQTT_PUB_REC(off)             ((mqtt_pub_rec_t *)((u8_t *)mqtt_pub_spool + (off)))
+#define MQTT_PUB_TOPIC(r)             ((char *)((r) + 1))
+#define MQTT_PUB_PAYLOAD(r)           ((u8_t *)((r) + 1) + (r)->topic_len + 1)
+
+#if defined(MQTT_PUB_SPOOL_SECTION)
+static u32_t mqtt_pub_spool[MQTT_PUB_SPOOL_SIZE / 4] __attribute__((section(MQTT_PUB_SPOOL_SECTION)));
+#else
+static u32_t mqtt_pub_spool[MQTT_PUB_SPOOL_SIZE / 4];
+#endif
+
+/*
+ * Free running batch counters: [free, send) published and waiting for the
+ * PUBACK, [send, head) closed and waiting for the window, the batch at wr is
+ * being filled when mqtt_pub_open is set. Spool offsets: free_off the oldest
+ * batch, rd the batch at send, wr the first free byte. Producers and the
+ * tcpip thread share them under SYS_ARCH_PROTECT.
+ */
+static u32_t mqtt_pub_head;
+static u32_t mqtt_pub_send;
+static u32_t mqtt_pub_free;
+static u32_t mqtt_pub_free_off;
+static u32_t mqtt_pub_rd;
+static u32_t mqtt_pub_wr;
+static u32_t mqtt_pub_used;         /* spool bytes taken, open batch included */
+static u32_t mqtt_pub_open_off;
+static u8_t  mqtt_pub_open;
+static u8_t  mqtt_pub_scheduled;    /* mqtt_pub_kick_cb() is queued to the tcpip thread */
+static u8_t  mqtt_pub_acked_flag[MQTT_PUB_WINDOW];  /* PUBACK arrived, slot send % MQTT_PUB_WINDOW */
+
+/* tcpip thread only */
+static mqtt_client_t mqtt_pub_client;
+static struct mqtt_connect_client_info_t mqtt_pub_info;
+static ip_addr_t mqtt_pub_broker;
+static u8_t  mqtt_pub_started;
+static u8_t  mqtt_pub_connected;
+static u8_t  mqtt_pub_lost_pending;
+static u32_t mqtt_pub_resend_mark;  /* batches before it were sent on a lost connection */
+static u32_t mqtt_pub_backoff = MQTT_PUB_RECONNECT_MS;
+
+static struct mqtt_pub_stats mqtt_pub_stats;
+
+static const u32_t mqtt_pub_lat_edges[MQTT_PUB_LAT_BUCKETS - 1] = MQTT_PUB_LAT_EDGES;
+
+static void mqtt_pub_connect( void *arg );
+
+/* offset of the batch stored at off, *skip the bytes left unused at the end of the spool */
+static u32_t mqtt_pub_rec_at( u32_t off, u32_t *skip )
+{
+  *skip = 0;
+  if( (off == MQTT_PUB_SPOOL_SIZE) || (MQTT_PUB_REC(off)->topic_len == MQTT_PUB_WRAP) )
+  {
+    *skip = MQTT_PUB_SPOOL_SIZE - off;
+    off = 0;
+  }
+  return off;
+}
+
+/* give the space of the oldest batch back, called protected */
+static void mqtt_pub_release( void )
+{
+  mqtt_pub_rec_t *r;
+  u32_t off, skip, span;
+
+  off  = mqtt_pub_rec_at( mqtt_pub_free_off, &skip );
+  r    = MQTT_PUB_REC(off);
+  span = MQTT_PUB_SPAN(r->topic_len, r->len);
+
+  mqtt_pub_used    -= skip + span;
+  mqtt_pub_free_off = off + span;
+  mqtt_pub_free++;
+}
+
+/* drop the oldest batch to make room, only when nothing is in flight, called protected */
+static u8_t mqtt_pub_drop_oldest( void )
+{
+  u32_t skip;
+
+  if( (mqtt_pub_send != mqtt_pub_free) || (mqtt_pub_free == mqtt_pub_head) )
+  {
+    return 0;
+  }
+
+  mqtt_pub_stats.dropped += MQTT_PUB_REC(mqtt_pub_rec_at( mqtt_pub_free_off, &skip ))->msgs;
+  mqtt_pub_release();
+  mqtt_pub_send = mqtt_pub_free;
+  mqtt_pub_rd   = mqtt_pub_free_off;
+  return 1;
+}
+
+/* start a batch of topic at wr with room for a first message of len bytes, called protected */
+static err_t mqtt_pub_open_batch( const char *topic, u32_t tl, u32_t len )
+{
+  mqtt_pub_rec_t *r;
+  u32_t need = MQTT_PUB_SPAN(tl, len);
+  u32_t start, skip;
+
+  /* a batch is contiguous: skip the end of the spool if it does not fit */
+  for( ;; )
+  {
+    start = mqtt_pub_wr;
+    skip  = 0;
+    if( start + need > MQTT_PUB_SPOOL_SIZE )
+    {
+      skip  = MQTT_PUB_SPOOL_SIZE - start;
+      start = 0;
+    }
+    if( mqtt_pub_used + skip + need <= MQTT_PUB_SPOOL_SIZE )
+    {
+      break;
+    }
+    if( !mqtt_pub_drop_oldest() )
+    {
+      return ERR_MEM;
+    }
+  }
+
+  if( skip != 0 )
+  {
+    MQTT_PUB_REC(mqtt_pub_wr)->topic_len = MQTT_PUB_WRAP;
+  }
+
+  r = MQTT_PUB_REC(start);
+  r->topic_len = (u16_t)tl;
+  r->len       = 0;
+  r->msgs      = 0;
+  r->reserved  = 0;
+  r->t_first   = sys_now();
+  memcpy( MQTT_PUB_TOPIC(r), topic, tl + 1 );
+
+  mqtt_pub_used    += skip + MQTT_PUB_SPAN(tl, 0);
+  mqtt_pub_wr       = start + MQTT_PUB_SPAN(tl, 0);
+  mqtt_pub_open_off = start;
+  mqtt_pub_open     = 1;
+  return ERR_OK;
+}
+
+/* hand the batch being filled to the tcpip thread, called protected */
+static void mqtt_pub_close_batch( void )
+{
+  mqtt_pub_open = 0;
+  mqtt_pub_head++;
+}
+
+/* mqtt_publish() callback, in the tcpip thread: PUBACK received (ERR_OK) or ERR_TIMEOUT */
+static void mqtt_pub_acked( void *arg, err_t err );
+
+/* publish the closed batches while the window has room, in the tcpip thread */
+static void mqtt_pub_drain( void )
+{
+  mqtt_pub_rec_t *r;
+  u32_t off, skip, slot, seq;
+  err_t err;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  while( mqtt_pub_connected )
+  {
+    SYS_ARCH_PROTECT(lev);
+    if( (mqtt_pub_send == mqtt_pub_head) || (mqtt_pub_send - mqtt_pub_free >= MQTT_PUB_WINDOW) )
+    {
+      SYS_ARCH_UNPROTECT(lev);
+      break;
+    }
+    off  = mqtt_pub_rec_at( mqtt_pub_rd, &skip );
+    seq  = mqtt_pub_send++;         /* claimed: not dropped while the client copies it */
+    slot = seq % MQTT_PUB_WINDOW;
+    mqtt_pub_acked_flag[slot] = 0;
+    SYS_ARCH_UNPROTECT(lev);
+
+    r   = MQTT_PUB_REC(off);
+    err = mqtt_publish( &mqtt_pub_client, MQTT_PUB_TOPIC(r), MQTT_PUB_PAYLOAD(r), r->len, 1, 0,
+                        mqtt_pub_acked, &mqtt_pub_acked_flag[slot] );
+
+    SYS_ARCH_PROTECT(lev);
+    if( err != ERR_OK )
+    {
+      /* output ring or request slots full: retried on the next PUBACK or batch tick */
+      mqtt_pub_send--;
+      SYS_ARCH_UNPROTECT(lev);
+      break;
+    }
+    mqtt_pub_rd = off + MQTT_PUB_SPAN(r->topic_len, r->len);
+    mqtt_pub_stats.batches++;
+    if( (s32_t)(mqtt_pub_resend_mark - seq) > 0 )
+    {
+      mqtt_pub_stats.resent++;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+  }
+}
+
+/* count the messages of the oldest batch in the latency histogram, called protected */
+static void mqtt_pub_latency( void )
+{
+  mqtt_pub_rec_t *r;
+  u32_t skip, ms, i;
+
+  r  = MQTT_PUB_REC(mqtt_pub_rec_at( mqtt_pub_free_off, &skip ));
+  ms = sys_now() - r->t_first;
+
+  for( i = 0; i < MQTT_PUB_LAT_BUCKETS - 1; i++ )
+  {
+    if( ms <= mqtt_pub_lat_edges[i] )
+    {
+      break;
+    }
+  }
+  mqtt_pub_stats.lat_hist[i] += r->msgs;
+  mqtt_pub_stats.acked       += r->msgs;
+  if( ms > mqtt_pub_stats.lat_max )
+  {
+    mqtt_pub_stats.lat_max = ms;
+  }
+}
+
+/* connection lost: the batches in flight are sent again after the reconnect, in the tcpip thread */
+static void mqtt_pub_lost( void )
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  mqtt_pub_connected = 0;
+
+  SYS_ARCH_PROTECT(lev);
+  mqtt_pub_resend_mark = mqtt_pub_send;
+  mqtt_pub_send        = mqtt_pub_free;
+  mqtt_pub_rd          = mqtt_pub_free_off;
+  mqtt_pub_stats.disconnects++;
+  SYS_ARCH_UNPROTECT(lev);
+
+  sys_untimeout( mqtt_pub_connect, NULL );
+  sys_timeout( mqtt_pub_backoff, mqtt_pub_connect, NULL );
+  log_w( "mqtt_pub disconnected, %u batches to resend, reconnect in %u ms",
+         (unsigned)(mqtt_pub_resend_mark - mqtt_pub_send), (unsigned)mqtt_pub_backoff );
+
+  mqtt_pub_backoff = LWIP_MIN( mqtt_pub_backoff * 2, MQTT_PUB_RECONNECT_MAX_MS );
+}
+
+/* sys_timeout handler: a PUBACK timed out, the connection is considered dead */
+static void mqtt_pub_timeout( void *arg )
+{
+  LWIP_UNUSED_ARG(arg);
+
+  mqtt_pub_lost_pending = 0;
+  if( mqtt_pub_connected )
+  {
+    /* no connection callback from mqtt_disconnect() */
+    mqtt_disconnect( &mqtt_pub_client );
+    mqtt_pub_lost();
+  }
+}
+
+static void mqtt_pub_acked( void *arg, err_t err )
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  if( err != ERR_OK )
+  {
+    /* called from the request list walk of the client: disconnect later */
+    if( !mqtt_pub_lost_pending )
+    {
+      mqtt_pub_lost_pending = 1;
+      sys_timeout( 0, mqtt_pub_timeout, NULL );
+    }
+    return;
+  }
+
+  *(u8_t *)arg = 1;
+
+  /* the PUBACKs may come out of order, the spool is released in order */
+  SYS_ARCH_PROTECT(lev);
+  while( (mqtt_pub_free != mqtt_pub_send) && mqtt_pub_acked_flag[mqtt_pub_free % MQTT_PUB_WINDOW] )
+  {
+    mqtt_pub_acked_flag[mqtt_pub_free % MQTT_PUB_WINDOW] = 0;
+    mqtt_pub_latency();
+    mqtt_pub_release();
+  }
+  SYS_ARCH_UNPROTECT(lev);
+
+  mqtt_pub_drain();
+}
+
+static void mqtt_pub_connection_cb( mqtt_client_t *client, void *arg, mqtt_connection_status_t status )
+{
+  LWIP_UNUSED_ARG(client);
+  LWIP_UNUSED_ARG(arg);
+
+  if( status == MQTT_CONNECT_ACCEPTED )
+  {
+    mqtt_pub_connected = 1;
+    mqtt_pub_backoff   = MQTT_PUB_RECONNECT_MS;
+    mqtt_pub_stats.connects++;
+    log_i( "mqtt_pub connected to %s:%d, %u batches spooled",
+           ipaddr_ntoa( &mqtt_pub_broker ), MQTT_PUB_BROKER_PORT, (unsigned)(mqtt_pub_head - mqtt_pub_free) );
+    mqtt_pub_drain();
+  }
+  else
+  {
+    log_w( "mqtt_pub connection status %d", (int)status );
+    mqtt_pub_lost();
+  }
+}
+
+/* sys_timeout handler: (re)connect to the broker */
+static void mqtt_pub_connect( void *arg )
+{
+  err_t err;
+
+  LWIP_UNUSED_ARG(arg);
+
+  err = mqtt_client_connect( &mqtt_pub_client, &mqtt_pub_broker, MQTT_PUB_BROKER_PORT,
+                             mqtt_pub_connection_cb, NULL, &mqtt_pub_info );
+  if( err != ERR_OK )
+  {
+    log_w( "mqtt_pub connect err %d, retry in %u ms", (int)err, (unsigned)mqtt_pub_backoff );
+    sys_timeout( mqtt_pub_backoff, mqtt_pub_connect, NULL );
+    mqtt_pub_backoff = LWIP_MIN( mqtt_pub_backoff * 2, MQTT_PUB_RECONNECT_MAX_MS );
+  }
+}
+
+/* tcpip_try_callback() handler */
+static void mqtt_pub_kick_cb( void *arg )
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  LWIP_UNUSED_ARG(arg);
+
+  SYS_ARCH_PROTECT(lev);
+  mqtt_pub_scheduled = 0;
+  SYS_ARCH_UNPROTECT(lev);
+
+  mqtt_pub_drain();
+}
+
+/* wake the tcpip thread once for any number of closed batches */
+static void mqtt_pub_schedule( void )
+{
+  u8_t run;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  run = !mqtt_pub_scheduled;
+  mqtt_pub_scheduled = 1;
+  SYS_ARCH_UNPROTECT(lev);
+
+  if( run && (tcpip_try_callback( mqtt_pub_kick_cb, NULL ) != ERR_OK) )
+  {
+    /* tcpip mbox full: the batch tick publishes them */
+    SYS_ARCH_PROTECT(lev);
+    mqtt_pub_scheduled = 0;
+    SYS_ARCH_UNPROTECT(lev);
+  }
+}
+
+/* sys_timeout handler, runs in the tcpip thread: the deadline of the batch being filled */
+static void mqtt_pub_tick( void *arg )
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  LWIP_UNUSED_ARG(arg);
+
+  SYS_ARCH_PROTECT(lev);
+  if( mqtt_pub_open && (MQTT_PUB_REC(mqtt_pub_open_off)->msgs != 0) )
+  {
+    mqtt_pub_close_batch();
+  }
+  SYS_ARCH_UNPROTECT(lev);
+
+  mqtt_pub_drain();
+
+  sys_timeout( MQTT_PUB_BATCH_MS, mqtt_pub_tick, NULL );
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: mqtt_pub_publish
+*	功能说明: 发布一条消息 (QoS1), 复制到缓存区后返回, 不等待发送和确认. 同一主题的连续消息合并发布,
+*             以 MQTT_PUB_SEPARATOR 分隔. 任意任务中调用, 不能在中断中调用
+*	形    参: topic 主题, 1..MQTT_PUB_TOPIC_MAX 字节
+*             payload 消息, len 消息长度 1..MQTT_PUB_MSG_MAX
+*	返 回 值: ERR_OK, 缓存区满且有消息等待确认时 ERR_MEM (消息丢弃, 见 mqtt_pub_pressure),
+*             参数错误或未启动时 ERR_VAL
+*********************************************************************************************************
+*/
+err_t mqtt_pub_publish( const char *topic, const void *payload, u16_t len )
+{
+  mqtt_pub_rec_t *r;
+  size_t tl = (topic != NULL) ? strlen( topic ) : 0;
+  u32_t old_span, new_span;
+  u8_t *dst;
+  u8_t kick = 0;
+  err_t err = ERR_OK;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  if( (tl == 0) || (tl > MQTT_PUB_TOPIC_MAX) || (len == 0) || (len > MQTT_PUB_MSG_MAX) || !mqtt_pub_started )
+  {
+    return ERR_VAL;
+  }
+
+  SYS_ARCH_PROTECT(lev);
+
+  if( mqtt_pub_open )
+  {
+    r        = MQTT_PUB_REC(mqtt_pub_open_off);
+    old_span = MQTT_PUB_SPAN(tl, r->len);
+    new_span = MQTT_PUB_SPAN(tl, r->len + 1 + len);
+    if( (r->topic_len != tl) || (memcmp( MQTT_PUB_TOPIC(r), topic, tl ) != 0) ||
+        (r->len + 1 + len > MQTT_PUB_BATCH_SIZE) ||
+        (mqtt_pub_open_off + new_span > MQTT_PUB_SPOOL_SIZE) ||
+        (mqtt_pub_used + new_span - old_span > MQTT_PUB_SPOOL_SIZE) )
+    {
+      mqtt_pub_close_batch();
+      kick = 1;
+    }
+  }
+
+  if( !mqtt_pub_open )
+  {
+    err = mqtt_pub_open_batch( topic, tl, len );
+  }
+
+  if( err == ERR_OK )
+  {
+    r        = MQTT_PUB_REC(mqtt_pub_open_off);
+    old_span = MQTT_PUB_SPAN(tl, r->len);
+    dst      = MQTT_PUB_PAYLOAD(r) + r->len;
+    if( r->len != 0 )
+    {
+      *dst++ = MQTT_PUB_SEPARATOR;
+      r->len++;
+    }
+    memcpy( dst, payload, len );
+    r->len += len;
+    r->msgs++;
+
+    new_span = MQTT_PUB_SPAN(tl, r->len);
+    mqtt_pub_used += new_span - old_span;
+    mqtt_pub_wr   += new_span - old_span;
+    mqtt_pub_stats.msgs++;
+    if( mqtt_pub_used > mqtt_pub_stats.spool_peak )
+    {
+      mqtt_pub_stats.spool_peak = mqtt_pub_used;
+    }
+
+    /* no room left for another message: publish it now */
+    if( r->len + 1 + 1 > MQTT_PUB_BATCH_SIZE )
+    {
+      mqtt_pub_close_batch();
+      kick = 1;
+    }
+  }
+  else
+  {
+    mqtt_pub_stats.dropped++;
+  }
+
+  SYS_ARCH_UNPROTECT(lev);
+
+  if( kick )
+  {
+    mqtt_pub_schedule();
+  }
+  return err;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: mqtt_pub_pressure
+*	功能说明: 缓存区占用百分比, 生产者据此降低速率. 离线时为 100 表示开始丢弃最早的消息
+*	形    参: 无
+*	返 回 值: 0..100
+*********************************************************************************************************
+*/
+u32_t mqtt_pub_pressure( void )
+{
+  u32_t used;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  used = mqtt_pub_used;
+  SYS_ARCH_UNPROTECT(lev);
+
+  return used / (MQTT_PUB_SPOOL_SIZE / 100);
+}
+
+/* upper edge of the histogram bucket holding the pct percentile, ms */
+static u32_t mqtt_pub_percentile( const struct mqtt_pub_stats *st, u32_t pct )
+{
+  u32_t total = 0, target, sum = 0, i;
+
+  for( i = 0; i < MQTT_PUB_LAT_BUCKETS; i++ )
+  {
+    total += st->lat_hist[i];
+  }
+  if( total == 0 )
+  {
+    return 0;
+  }
+
+  target = total / 100 * pct + (total % 100 * pct + 99) / 100;
+  for( i = 0; i < MQTT_PUB_LAT_BUCKETS - 1; i++ )
+  {
+    sum += st->lat_hist[i];
+    if( sum >= target )
+    {
+      return LWIP_MIN( mqtt_pub_lat_edges[i], st->lat_max );
+    }
+  }
+  return st->lat_max;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: mqtt_pub_get_stats
+*	功能说明: 取计数器, 缓存区占用和发布延迟 (mqtt_pub_publish 到 PUBACK) 的 50/90/99 百分位, 任意任务中调用
+*	形    参: st 目的地址
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void mqtt_pub_get_stats( struct mqtt_pub_stats *st )
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  *st = mqtt_pub_stats;
+  st->spool_used = mqtt_pub_used;
+  st->in_flight  = mqtt_pub_send - mqtt_pub_free;
+  SYS_ARCH_UNPROTECT(lev);
+
+  st->lat_p50 = mqtt_pub_percentile( st, 50 );
+  st->lat_p90 = mqtt_pub_percentile( st, 90 );
+  st->lat_p99 = mqtt_pub_percentile( st, 99 );
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: mqtt_pub_start
+*	功能说明: 启动批处理定时器并连接 MQTT 服务器, 断开后自动重连, 在 netif 初始化之后调用
+*	形    参: 无
+*	返 回 值: ERR_OK, 未定义 MQTT_PUB_BROKER_IP 时 ERR_ARG
+*********************************************************************************************************
+*/
+err_t mqtt_pub_start( void )
+{
+#ifdef MQTT_PUB_BROKER_IP
+  LOCK_TCPIP_CORE();
+
+  ipaddr_aton( MQTT_PUB_BROKER_IP, &mqtt_pub_broker );
+
+  memset( &mqtt_pub_info, 0, sizeof(mqtt_pub_info) );
+  mqtt_pub_info.client_id  = MQTT_PUB_CLIENT_ID;
+  mqtt_pub_info.keep_alive = MQTT_PUB_KEEP_ALIVE;
+
+  mqtt_pub_started = 1;
+  sys_timeout( MQTT_PUB_BATCH_MS, mqtt_pub_tick, NULL );
+  mqtt_pub_connect( NULL );
+
+  UNLOCK_TCPIP_CORE();
+
+  log_i( "mqtt_pub to %s:%d, spool %u bytes, batch %u bytes / %u ms, window %u",
+         MQTT_PUB_BROKER_IP, MQTT_PUB_BROKER_PORT, (unsigned)MQTT_PUB_SPOOL_SIZE,
+         (unsigned)MQTT_PUB_BATCH_SIZE, (unsigned)MQTT_PUB_BATCH_MS, (unsigned)MQTT_PUB_WINDOW );
+  return ERR_OK;
+#else
+  log_w( "mqtt_pub: MQTT_PUB_BROKER_IP not defined" );
+  return ERR_ARG;
+#endif
+}
+
+#if MQTT_PUB_BENCH
+/* producer at the lowest priority above idle: publishes as fast as the spool takes the messages */
+static void mqtt_pub_bench_thread( void *arg )
+{
+  char msg[MQTT_PUB_BENCH_SIZE + 1];
+  struct mqtt_pub_stats st;
+  u32_t t0, ms, n = 0, backoff = 0, wait;
+
+  LWIP_UNUSED_ARG(arg);
+
+  memset( msg, '.', sizeof(msg) );
+
+  t0 = sys_now();
+  while( (ms = sys_now() - t0) < MQTT_PUB_BENCH_MS )
+  {
+    /* readable with mosquitto_sub: message number, then padding */
+    snprintf( msg, sizeof(msg), "%010lu", (unsigned long)n );
+    msg[10] = '.';
+    if( mqtt_pub_publish( MQTT_PUB_BENCH_TOPIC, msg, MQTT_PUB_BENCH_SIZE ) == ERR_OK )
+    {
+      n++;
+    }
+    else
+    {
+      backoff++;
+      sys_msleep( 1 );
+    }
+  }
+
+  /* let the window drain before reading the latency */
+  for( wait = 0; wait < 50; wait++ )
+  {
+    mqtt_pub_get_stats( &st );
+    if( st.acked + st.dropped >= st.msgs )
+    {
+      break;
+    }
+    sys_msleep( 100 );
+  }
+
+  log_i( "mqtt_pub bench: %u messages of %u bytes in %u ms, %u messages/s, %u batches, %u acked",
+         (unsigned)n, (unsigned)MQTT_PUB_BENCH_SIZE, (unsigned)ms,
+         (unsigned)(n / ms * 1000 + n % ms * 1000 / ms), (unsigned)st.batches, (unsigned)st.acked );
+  log_i( "mqtt_pub bench: latency p50 %u p90 %u p99 %u max %u ms, dropped %u (backoff %u), resent %u, spool peak %u, reconnects %u",
+         (unsigned)st.lat_p50, (unsigned)st.lat_p90, (unsigned)st.lat_p99, (unsigned)st.lat_max,
+         (unsigned)st.dropped, (unsigned)backoff, (unsigned)st.resent, (unsigned)st.spool_peak,
+         (unsigned)st.disconnects );
+
+  vTaskDelete( NULL );
+}
+#endif /* MQTT_PUB_BENCH */
+
+/*
+*********************************************************************************************************
+*	函 数 名: mqtt_pub_bench_start
+*	功能说明: MQTT_PUB_BENCH 为 1 时创建生产者任务, 以最大速率发布 MQTT_PUB_BENCH_MS 毫秒,
+*             等待确认后输出消息速率, 发布延迟百分位, 丢弃和重发数
+*	形    参: 无
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void mqtt_pub_bench_start( void )
+{
+#if MQTT_PUB_BENCH
+  sys_thread_new( "mqtt_bench", mqtt_pub_bench_thread, NULL, 512, tskIDLE_PRIORITY + 1 );
+#endif
+}
@@ -0,0 +1,119 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : mqtt_pub
+*	文件名称 : mqtt_pub.h
+*	版    本 : V1.0
+*	说    明 : batching MQTT publisher on the lwIP MQTT client: small messages are coalesced per
+*              topic, spooled while the broker is unreachable and published QoS1 with a window
+*              of PUBACKs outstanding
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月29日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __MQTT_PUB_H__
+#define  __MQTT_PUB_H__
+
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/apps/mqtt_opts.h"
+
+/* define to publish to this broker, e.g. "192.168.0.22" */
+/* #define MQTT_PUB_BROKER_IP         "192.168.0.22" */
+
+#ifndef MQTT_PUB_BROKER_PORT
+#define MQTT_PUB_BROKER_PORT          1883
+#endif
+
+#ifndef MQTT_PUB_CLIENT_ID
+#define MQTT_PUB_CLIENT_ID            "stm32h7"
+#endif
+
+/* MQTT keep alive, s: a silent broker is detected after 1.5 times this */
+#ifndef MQTT_PUB_KEEP_ALIVE
+#define MQTT_PUB_KEEP_ALIVE           10
+#endif
+
+/* reconnect delay, doubled after each failure up to the maximum, ms */
+#ifndef MQTT_PUB_RECONNECT_MS
+#define MQTT_PUB_RECONNECT_MS         500
+#endif
+#ifndef MQTT_PUB_RECONNECT_MAX_MS
+#define MQTT_PUB_RECONNECT_MAX_MS     8000
+#endif
+
+/* QoS1 publishes waiting for their PUBACK, at most the request slots of the MQTT client */
+#ifndef MQTT_PUB_WINDOW
+#define MQTT_PUB_WINDOW               MQTT_REQ_MAX_IN_FLIGHT
+#endif
+
+/* largest topic and message accepted by mqtt_pub_publish(), bytes */
+#ifndef MQTT_PUB_TOPIC_MAX
+#define MQTT_PUB_TOPIC_MAX            64
+#endif
+#ifndef MQTT_PUB_MSG_MAX
+#define MQTT_PUB_MSG_MAX              256
+#endif
+
+/* messages of one topic are joined, separated by MQTT_PUB_SEPARATOR, into one publish of
+   at most MQTT_PUB_BATCH_SIZE bytes; a batch waits at most MQTT_PUB_BATCH_MS to fill.
+   MQTT_PUB_BATCH_SIZE equal to MQTT_PUB_MSG_MAX publishes every message alone. */
+#ifndef MQTT_PUB_BATCH_SIZE
+#define MQTT_PUB_BATCH_SIZE           1024
+#endif
+#ifndef MQTT_PUB_BATCH_MS
+#define MQTT_PUB_BATCH_MS             20
+#endif
+#define MQTT_PUB_SEPARATOR            '\n'
+
+/* spool holding the batches until their PUBACK, bytes. It lives in the SDRAM on the target,
+   offline the oldest batches are dropped when it is full. */
+#ifndef MQTT_PUB_SPOOL_SIZE
+#define MQTT_PUB_SPOOL_SIZE           (1024 * 1024)
+#endif
+#if !defined(MQTT_PUB_SPOOL_SECTION) && !defined(NETIF_HOST)
+#define MQTT_PUB_SPOOL_SECTION        ".SdramSection"
+#endif
+
+/* 1: mqtt_pub_bench_start() runs a producer task, message size / duration below */
+#ifndef MQTT_PUB_BENCH
+#define MQTT_PUB_BENCH                0
+#endif
+#define MQTT_PUB_BENCH_SIZE           32
+#define MQTT_PUB_BENCH_MS             10000
+#define MQTT_PUB_BENCH_TOPIC          MQTT_PUB_CLIENT_ID "/bench"
+
+/* latency histogram: upper bucket edges, ms, from mqtt_pub_publish() to the PUBACK */
+#define MQTT_PUB_LAT_EDGES            { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000 }
+#define MQTT_PUB_LAT_BUCKETS          15      /* the edges and above the last one */
+
+struct mqtt_pub_stats
+{
+  u32_t msgs;                     /* accepted by mqtt_pub_publish() */
+  u32_t acked;                    /* messages whose PUBACK arrived */
+  u32_t dropped;                  /* refused, or dropped from a full spool */
+  u32_t batches;                  /* publishes handed to the MQTT client */
+  u32_t resent;                   /* publishes sent again after a reconnect */
+  u32_t connects;                 /* CONNACK accepted */
+  u32_t disconnects;              /* connection lost or refused, PUBACK timeout */
+  u32_t spool_used;               /* bytes, now and high-water */
+  u32_t spool_peak;
+  u32_t in_flight;                /* publishes waiting for their PUBACK */
+  u32_t lat_p50;                  /* ms, upper edge of the bucket holding the percentile */
+  u32_t lat_p90;
+  u32_t lat_p99;
+  u32_t lat_max;                  /* ms, exact */
+  u32_t lat_hist[MQTT_PUB_LAT_BUCKETS];
+};
+
+err_t mqtt_pub_start( void );
+err_t mqtt_pub_publish( const char *topic, const void *payload, u16_t len );
+u32_t mqtt_pub_pressure( void );
+void mqtt_pub_get_stats( struct mqtt_pub_stats *st );
+void mqtt_pub_bench_start( void );
+
+#endif
@@ -0,0 +1,314 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : net_boot
+*	文件名称 : net_boot.c
+*	版    本 : V1.0
+*	说    明 : The last DHCP lease (address, mask, gateway, server, lease time) is kept in the backup
+*              SRAM (.BkpSramSection, non-cacheable, retained across resets and on VBAT). At boot
+*              netif_config() gives the interface this address with net_boot_addr() and
+*              net_boot_start() confirms it in the INIT-REBOOT state (dhcp_start_reboot()): TCP can
+*              connect at once, a NAK clears the address and the client discovers again. Without
+*              a kept lease DHCP discovers with the Rapid Commit option, two messages when the
+*              server supports it.
+*
+*              There is no RTC here, so the time elapsed since the lease was granted is unknown:
+*              the lease is only used until the server answers, which it must do for INIT-REBOOT.
+*
+*              Each boot records, ms after reset: address in use, lease bound, first connection of
+*              tcp_conn_mgr. The last NET_BOOT_HISTORY boots are logged at startup to compare the
+*              startup paths, e.g. a power cycle with and without a kept lease.
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年05月02日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "net_boot.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "net_boot_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "lwip/dhcp.h"
+#include <string.h>
+#include <stddef.h>
+
+#include "stm32h7xx_hal.h"
+
+#if NET_BOOT_DHCP && !LWIP_DHCP
+#error "NET_BOOT_DHCP needs LWIP_DHCP"
+#endif
+
+#define NET_BOOT_MAGIC                0x544F4F42UL   /* "BOOT" read as little endian */
+
+/* kept in the backup SRAM, ms times from HAL_GetTick(), addresses in network order */
+typedef struct
+{
+  u32_t magic;
+  u32_t boots;                    /* this one included, its times in hist[boots % NET_BOOT_HISTORY] */
+  u32_t ip;                       /* the last lease, 0: none */
+  u32_t netmask;
+  u32_t gw;
+  u32_t server;
+  u32_t lease_s;
+  struct net_boot_times hist[NET_BOOT_HISTORY];
+  u32_t sum;                      /* of the words above */
+} net_boot_rec_t;
+
+static net_boot_rec_t net_boot_rec __attribute__((section(NET_BOOT_SECTION)));
+
+static struct net_boot_times *net_boot_cur;
+static struct netif *net_boot_netif;
+static u32_t net_boot_kept_ip;            /* the lease tried with INIT-REBOOT */
+
+static const char * const net_boot_mode_name[] =
+{
+  "-", "static", "discover", "init-reboot", "init-reboot, new lease"
+};
+
+static u32_t net_boot_sum( void )
+{
+  const u32_t *w = (const u32_t *)&net_boot_rec;
+  u32_t i, sum = 0x5A5A5A5AUL;
+
+  for( i = 0; i < offsetof(net_boot_rec_t, sum) / 4; i++ )
+  {
+    sum = ((sum << 5) | (sum >> 27)) ^ w[i];
+  }
+  return sum;
+}
+
+static void net_boot_save( void )
+{
+  net_boot_rec.sum = net_boot_sum();
+}
+
+/* bound: keep the lease when it changed, tcpip thread */
+static void net_boot_poll( void *arg )
+{
+  struct dhcp *dhcp = netif_dhcp_data(net_boot_netif);
+  u32_t now = HAL_GetTick();
+  u32_t ip, netmask, gw, server;
+
+  LWIP_UNUSED_ARG(arg);
+
+  if( (dhcp == NULL) || !dhcp_supplied_address(net_boot_netif) )
+  {
+    sys_timeout( NET_BOOT_POLL_MS, net_boot_poll, NULL );
+    return;
+  }
+
+  ip      = ip4_addr_get_u32(netif_ip4_addr(net_boot_netif));
+  netmask = ip4_addr_get_u32(netif_ip4_netmask(net_boot_netif));
+  gw      = ip4_addr_get_u32(netif_ip4_gw(net_boot_netif));
+  server  = ip4_addr_get_u32(ip_2_ip4(&dhcp->server_ip_addr));
+
+  if( net_boot_cur->bound_ms == 0 )
+  {
+    net_boot_cur->bound_ms = now;
+    if( (net_boot_cur->mode == NET_BOOT_MODE_REBOOT) && (ip != net_boot_kept_ip) )
+    {
+      net_boot_cur->mode = NET_BOOT_MODE_REBOOT_NEW;
+    }
+    if( (net_boot_cur->addr_ms == 0) || (net_boot_cur->mode == NET_BOOT_MODE_REBOOT_NEW) )
+    {
+      net_boot_cur->addr_ms = now;
+    }
+    log_i("DHCP bound %s (%s) %u ms after reset, lease %u s",
+          ip4addr_ntoa(netif_ip4_addr(net_boot_netif)), net_boot_mode_name[net_boot_cur->mode],
+          (unsigned)now, (unsigned)dhcp->offered_t0_lease);
+    net_boot_save();
+  }
+
+  if( (ip != net_boot_rec.ip) || (netmask != net_boot_rec.netmask) || (gw != net_boot_rec.gw) ||
+      (server != net_boot_rec.server) || (dhcp->offered_t0_lease != net_boot_rec.lease_s) )
+  {
+    net_boot_rec.ip      = ip;
+    net_boot_rec.netmask = netmask;
+    net_boot_rec.gw      = gw;
+    net_boot_rec.server  = server;
+    net_boot_rec.lease_s = dhcp->offered_t0_lease;
+    net_boot_save();
+  }
+
+  sys_timeout( NET_BOOT_POLL_BOUND_MS, net_boot_poll, NULL );
+}
+
+/* the previous boots, oldest first */
+static void net_boot_log_history( void )
+{
+  const struct net_boot_times *t;
+  u32_t n, boot;
+
+  n = LWIP_MIN( net_boot_rec.boots - 1, NET_BOOT_HISTORY - 1 );
+  for( boot = net_boot_rec.boots - n; boot < net_boot_rec.boots; boot++ )
+  {
+    t = &net_boot_rec.hist[boot % NET_BOOT_HISTORY];
+    if( t->mode == 0 )
+    {
+      continue;
+    }
+    log_i("boot %u: %s, address %u ms, bound %u ms, first TCP connect %u ms",
+          (unsigned)boot, net_boot_mode_name[t->mode < LWIP_ARRAYSIZE(net_boot_mode_name) ? t->mode : 0],
+          (unsigned)t->addr_ms, (unsigned)t->bound_ms, (unsigned)t->conn_ms);
+  }
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: net_boot_addr
+*	功能说明: 读取备份 SRAM 中上次的 DHCP 租约，在 netif_add() 之前调用，同时开始记录本次启动
+*	形    参: ipaddr netmask gw 输出，DHCP 时为租约的地址 (没有租约时为 0)，静态地址时不修改
+*	返 回 值: 1 有保存的租约，0 没有
+*********************************************************************************************************
+*/
+int net_boot_addr( ip4_addr_t *ipaddr, ip4_addr_t *netmask, ip4_addr_t *gw )
+{
+  if( (net_boot_rec.magic != NET_BOOT_MAGIC) || (net_boot_rec.sum != net_boot_sum()) )
+  {
+    /* first power up without VBAT, or the layout changed */
+    memset( &net_boot_rec, 0, sizeof(net_boot_rec) );
+    net_boot_rec.magic = NET_BOOT_MAGIC;
+  }
+
+  net_boot_rec.boots++;
+  net_boot_cur = &net_boot_rec.hist[net_boot_rec.boots % NET_BOOT_HISTORY];
+  memset( net_boot_cur, 0, sizeof(*net_boot_cur) );
+  net_boot_cur->mode = NET_BOOT_DHCP ? NET_BOOT_MODE_DISCOVER : NET_BOOT_MODE_STATIC;
+  net_boot_save();
+
+#if NET_BOOT_DHCP
+  if( net_boot_rec.ip != 0 )
+  {
+    ip4_addr_set_u32( ipaddr, net_boot_rec.ip );
+    ip4_addr_set_u32( netmask, net_boot_rec.netmask );
+    ip4_addr_set_u32( gw, net_boot_rec.gw );
+    return 1;
+  }
+  ip4_addr_set_zero( ipaddr );
+  ip4_addr_set_zero( netmask );
+  ip4_addr_set_zero( gw );
+#else
+  LWIP_UNUSED_ARG(ipaddr);
+  LWIP_UNUSED_ARG(netmask);
+  LWIP_UNUSED_ARG(gw);
+#endif
+  return 0;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: net_boot_start
+*	功能说明: 网卡配置完成后调用：有保存的租约时以 INIT-REBOOT 确认，否则 DHCP DISCOVER
+*	形    参: netif 网卡
+*	返 回 值: ERR_OK 成功
+*********************************************************************************************************
+*/
+err_t net_boot_start( struct netif *netif )
+{
+  err_t err = ERR_OK;
+
+  if( net_boot_cur == NULL )
+  {
+    return ERR_ARG;                       /* net_boot_addr() first */
+  }
+
+  net_boot_log_history();
+
+  LOCK_TCPIP_CORE();
+  net_boot_netif = netif;
+
+#if NET_BOOT_DHCP
+  if( !ip4_addr_isany(netif_ip4_addr(netif)) )
+  {
+    /* the kept lease is used while the server confirms it */
+    net_boot_kept_ip = ip4_addr_get_u32(netif_ip4_addr(netif));
+    net_boot_cur->mode = NET_BOOT_MODE_REBOOT;
+    net_boot_cur->addr_ms = HAL_GetTick();
+    log_i("using the kept lease %s, lease %u s from %s, confirming",
+          ip4addr_ntoa(netif_ip4_addr(netif)), (unsigned)net_boot_rec.lease_s,
+          ip4addr_ntoa((const ip4_addr_t *)&net_boot_rec.server));
+    err = dhcp_start_reboot( netif, netif_ip4_addr(netif) );
+  }
+  else
+  {
+    err = dhcp_start( netif );
+  }
+  if( err == ERR_OK )
+  {
+    sys_timeout( NET_BOOT_POLL_MS, net_boot_poll, NULL );
+  }
+  else
+  {
+    log_e("DHCP start failed: %d", (int)err);
+  }
+#else
+  net_boot_cur->addr_ms = HAL_GetTick();
+#endif
+
+  net_boot_save();
+  UNLOCK_TCPIP_CORE();
+
+  return err;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: net_boot_tcp_connected
+*	功能说明: TCP 连接建立时调用 (tcp_conn_mgr)，记录本次启动后的第一次连接
+*	形    参: 无
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void net_boot_tcp_connected( void )
+{
+  if( (net_boot_cur == NULL) || (net_boot_cur->conn_ms != 0) )
+  {
+    return;
+  }
+
+  LOCK_TCPIP_CORE();
+  net_boot_cur->conn_ms = HAL_GetTick();
+  net_boot_save();
+  UNLOCK_TCPIP_CORE();
+
+  log_i("boot %u: %s, address %u ms, bound %u ms, first TCP connect %u ms",
+        (unsigned)net_boot_rec.boots, net_boot_mode_name[net_boot_cur->mode],
+        (unsigned)net_boot_cur->addr_ms, (unsigned)net_boot_cur->bound_ms, (unsigned)net_boot_cur->conn_ms);
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: net_boot_get_times
+*	功能说明: 读取本次启动的时间记录
+*	形    参: t 输出
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void net_boot_get_times( struct net_boot_times *t )
+{
+  if( net_boot_cur == NULL )
+  {
+    memset( t, 0, sizeof(*t) );
+    return;
+  }
+
+  LOCK_TCPIP_CORE();
+  *t = *net_boot_cur;
+  UNLOCK_TCPIP_CORE();
+}
@@ -0,0 +1,68 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : net_boot
+*	文件名称 : net_boot.h
+*	版    本 : V1.0
+*	说    明 : network startup: the DHCP lease is kept in the backup SRAM across resets and confirmed
+*              with INIT-REBOOT while already in use, the time from reset to the address and to the
+*              first TCP connection is recorded for the last boots
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年05月02日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __NET_BOOT_H__
+#define  __NET_BOOT_H__
+
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/netif.h"
+
+/* 1: address from DHCP, 0: the static address of netif_config() */
+#ifndef NET_BOOT_DHCP
+#define NET_BOOT_DHCP                 LWIP_DHCP
+#endif
+
+/* boots kept in the backup SRAM and logged at startup */
+#ifndef NET_BOOT_HISTORY
+#define NET_BOOT_HISTORY              8
+#endif
+
+/* DHCP state polled this often until bound, then at the slower rate for renewals, ms */
+#ifndef NET_BOOT_POLL_MS
+#define NET_BOOT_POLL_MS              10
+#endif
+#ifndef NET_BOOT_POLL_BOUND_MS
+#define NET_BOOT_POLL_BOUND_MS        1000
+#endif
+
+#ifndef NET_BOOT_SECTION
+#define NET_BOOT_SECTION              ".BkpSramSection"
+#endif
+
+/* how the address of a boot was obtained */
+#define NET_BOOT_MODE_STATIC          1
+#define NET_BOOT_MODE_DISCOVER        2       /* no lease kept: DISCOVER, rapid commit if supported */
+#define NET_BOOT_MODE_REBOOT          3       /* kept lease confirmed by INIT-REBOOT */
+#define NET_BOOT_MODE_REBOOT_NEW      4       /* kept lease refused (NAK) or unanswered, new lease */
+
+/* one boot, ms after reset, 0: not reached */
+struct net_boot_times
+{
+  u32_t addr_ms;                  /* address in use, optimistically with a kept lease */
+  u32_t bound_ms;                 /* DHCP lease bound (confirmed) */
+  u32_t conn_ms;                  /* first managed TCP connection (tcp_conn_mgr) */
+  u8_t  mode;                     /* NET_BOOT_MODE_xxx */
+  u8_t  reserved[3];
+};
+
+int net_boot_addr( ip4_addr_t *ipaddr, ip4_addr_t *netmask, ip4_addr_t *gw );
+err_t net_boot_start( struct netif *netif );
+void net_boot_tcp_connected( void );
+void net_boot_get_times( struct net_boot_times *t );
+
+#endif
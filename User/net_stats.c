@@ -0,0 +1,367 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : net_stats
+*	文件名称 : net_stats.c
+*	版    本 : V1.0
+*	说    明 : Every NET_STATS_INTERVAL ms a struct net_stats_record is built from lwip_stats,
+*              the MIB2 counters and the Ethernet driver counters, in the tcpip thread. It is
+*              sent as one UDP datagram to NET_STATS_UDP_IP and/or summarized in the log.
+*              net_stats_overhead() measures what the counters cost, so they can stay enabled
+*              in release builds.
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月26日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "net_stats.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "net_stats_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+#include "lwip/netif.h"
+#include "lwip/udp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "netif_port.h"
+#include "stm32h7xx_hal.h"
+#include "bsp_dwt.h"
+#include <string.h>
+
+#if !LWIP_STATS || !LINK_STATS
+#error "net_stats needs LWIP_STATS and LINK_STATS"
+#endif
+
+/* lwIP counter increments on the path of one received TCP segment: link, ip, tcp, MIB2 ip/tcp/netif, memp */
+#define NET_STATS_INC_PER_SEGMENT     12
+
+#define NET_STATS_BENCH_LOOPS         1000
+
+static u32_t net_stats_seq;
+static u32_t net_stats_cycles_per_inc;
+static u32_t net_stats_cycles_snapshot;
+
+#ifdef NET_STATS_UDP_IP
+static struct udp_pcb *net_stats_pcb;
+static ip_addr_t net_stats_collector;
+#endif
+
+/* counters of the previous snapshot, for the rates in the log */
+static struct net_stats_record net_stats_last;
+
+static u32_t net_stats_memp_err( void )
+{
+  u32_t err = 0;
+#if MEMP_STATS
+  int i;
+
+  for( i = 0; i < MEMP_MAX; i++ )
+  {
+    err += lwip_stats.memp[i]->err;
+  }
+#endif
+  return err;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: net_stats_get
+*	功能说明: 取一份当前计数器的快照，在 tcpip 线程中或持有内核锁时调用
+*	形    参: rec 快照的目的地址
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void net_stats_get( struct net_stats_record *rec )
+{
+  struct ethernetif_stats eth;
+  struct netif *netif = netif_default;
+
+  ethernetif_get_stats( &eth );
+
+  memset( rec, 0, sizeof(*rec) );
+
+  rec->magic   = NET_STATS_MAGIC;
+  rec->version = NET_STATS_VERSION;
+  rec->length  = sizeof(*rec);
+  rec->seq     = net_stats_seq;
+  rec->uptime  = sys_now();
+
+  if( netif != NULL )
+  {
+    rec->link_up = netif_is_link_up( netif ) ? 1 : 0;
+#if MIB2_STATS
+    rec->link_speed = netif->link_speed;
+#endif
+  }
+
+  rec->eth_rx_frames     = eth.rx_frames;
+  rec->eth_rx_bytes      = eth.rx_bytes;
+  rec->eth_rx_dropped    = eth.rx_dropped;
+  rec->eth_rx_pool_empty = eth.rx_pool_empty;
+  rec->eth_rx_missed     = eth.rx_missed;
+  rec->eth_rx_filtered   = eth.rx_filter_bcast + eth.rx_filter_mcast;
+  rec->eth_tx_frames     = eth.tx_frames;
+  rec->eth_tx_bytes      = eth.tx_bytes;
+  rec->eth_tx_dropped    = eth.tx_dropped;
+  rec->eth_tx_ring_full  = eth.tx_ring_full;
+  rec->eth_dma_errors    = eth.dma_errors;
+  rec->eth_link_changes  = eth.link_changes;
+
+#if ETHARP_STATS
+  rec->etharp_drop = lwip_stats.etharp.drop;
+#endif
+#if IP_STATS
+  rec->ip_recv = lwip_stats.ip.recv;
+  rec->ip_xmit = lwip_stats.ip.xmit;
+  rec->ip_drop = lwip_stats.ip.drop;
+#endif
+#if ICMP_STATS
+  rec->icmp_recv = lwip_stats.icmp.recv;
+  rec->icmp_xmit = lwip_stats.icmp.xmit;
+#endif
+#if UDP_STATS
+  rec->udp_recv = lwip_stats.udp.recv;
+  rec->udp_xmit = lwip_stats.udp.xmit;
+  rec->udp_drop = lwip_stats.udp.drop;
+#endif
+#if TCP_STATS
+  rec->tcp_recv = lwip_stats.tcp.recv;
+  rec->tcp_xmit = lwip_stats.tcp.xmit;
+  rec->tcp_drop = lwip_stats.tcp.drop;
+#endif
+#if MIB2_STATS
+  rec->tcp_rexmit        = lwip_stats.mib2.tcpretranssegs;
+  rec->tcp_resets        = lwip_stats.mib2.tcpestabresets;
+  rec->tcp_attempt_fails = lwip_stats.mib2.tcpattemptfails;
+#endif
+#if LWIP_TCP
+  {
+    struct tcp_pcb *pcb;
+    u32_t estab = 0;
+
+    /* what the MIB2 tcpCurrEstab getter counts */
+    for( pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next )
+    {
+      if( (pcb->state == ESTABLISHED) || (pcb->state == CLOSE_WAIT) )
+      {
+        estab++;
+      }
+    }
+    rec->tcp_curr_estab = estab;
+  }
+#endif
+
+#if MEM_STATS
+  rec->mem_used = lwip_stats.mem.used;
+  rec->mem_max  = lwip_stats.mem.max;
+  rec->mem_err  = lwip_stats.mem.err;
+#endif
+  rec->memp_err = net_stats_memp_err();
+#if MEMP_STATS
+  rec->pbuf_pool_used = lwip_stats.memp[MEMP_PBUF_POOL]->used;
+  rec->pbuf_pool_max  = lwip_stats.memp[MEMP_PBUF_POOL]->max;
+  rec->pbuf_pool_err  = lwip_stats.memp[MEMP_PBUF_POOL]->err;
+#endif
+
+#if SYS_STATS
+  rec->mbox_used = lwip_stats.sys.mbox.used;
+  rec->mbox_err  = lwip_stats.sys.mbox.err;
+  rec->sem_err   = lwip_stats.sys.sem.err;
+  rec->mutex_err = lwip_stats.sys.mutex.err;
+#endif
+
+  rec->cycles_per_inc  = net_stats_cycles_per_inc;
+  rec->cycles_snapshot = net_stats_cycles_snapshot;
+}
+
+/* one line per snapshot, with the counters that moved since the previous one */
+static void net_stats_log_record( const struct net_stats_record *rec, const struct net_stats_record *last )
+{
+  log_i( "#%u link %s, rx %u/%u frames dropped (pool empty %u, missed %u), tx %u/%u frames dropped (ring full %u), dma err %u",
+         (unsigned)rec->seq, rec->link_up ? "up" : "down",
+         (unsigned)(rec->eth_rx_dropped + rec->eth_rx_missed - last->eth_rx_dropped - last->eth_rx_missed),
+         (unsigned)(rec->eth_rx_frames - last->eth_rx_frames),
+         (unsigned)(rec->eth_rx_pool_empty - last->eth_rx_pool_empty),
+         (unsigned)(rec->eth_rx_missed - last->eth_rx_missed),
+         (unsigned)(rec->eth_tx_dropped - last->eth_tx_dropped),
+         (unsigned)(rec->eth_tx_frames - last->eth_tx_frames),
+         (unsigned)(rec->eth_tx_ring_full - last->eth_tx_ring_full),
+         (unsigned)(rec->eth_dma_errors - last->eth_dma_errors) );
+  log_i( "#%u ip drop %u, udp drop %u, tcp drop %u rexmit %u resets %u, estab %u, mem %u/%u err %u, memp err %u, pbuf pool %u/%u, mbox err %u",
+         (unsigned)rec->seq,
+         (unsigned)(rec->ip_drop - last->ip_drop),
+         (unsigned)(rec->udp_drop - last->udp_drop),
+         (unsigned)(rec->tcp_drop - last->tcp_drop),
+         (unsigned)(rec->tcp_rexmit - last->tcp_rexmit),
+         (unsigned)(rec->tcp_resets - last->tcp_resets),
+         (unsigned)rec->tcp_curr_estab,
+         (unsigned)rec->mem_used, (unsigned)rec->mem_max,
+         (unsigned)(rec->mem_err - last->mem_err),
+         (unsigned)(rec->memp_err - last->memp_err),
+         (unsigned)rec->pbuf_pool_used, (unsigned)rec->pbuf_pool_max,
+         (unsigned)(rec->mbox_err - last->mbox_err) );
+}
+
+#ifdef NET_STATS_UDP_IP
+static void net_stats_send( const struct net_stats_record *rec )
+{
+  struct pbuf *p;
+  err_t err;
+
+  if( net_stats_pcb == NULL )
+  {
+    return;
+  }
+
+  p = pbuf_alloc( PBUF_TRANSPORT, sizeof(*rec), PBUF_RAM );
+  if( p == NULL )
+  {
+    return;
+  }
+
+  memcpy( p->payload, rec, sizeof(*rec) );
+
+  err = udp_sendto( net_stats_pcb, p, &net_stats_collector, NET_STATS_UDP_PORT );
+  if( err != ERR_OK )
+  {
+    log_d( "net_stats send err %d", err );
+  }
+
+  pbuf_free( p );
+}
+#endif
+
+/* sys_timeout handler, runs in the tcpip thread */
+static void net_stats_report( void *arg )
+{
+  struct net_stats_record rec;
+  u32_t cycles;
+
+  LWIP_UNUSED_ARG(arg);
+
+  cycles = DWT_CYCCNT;
+  net_stats_get( &rec );
+  net_stats_cycles_snapshot = DWT_CYCCNT - cycles;
+
+#ifdef NET_STATS_UDP_IP
+  net_stats_send( &rec );
+#endif
+#if NET_STATS_LOG
+  net_stats_log_record( &rec, &net_stats_last );
+#endif
+
+  net_stats_last = rec;
+  net_stats_seq++;
+
+  sys_timeout( NET_STATS_INTERVAL, net_stats_report, NULL );
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: net_stats_log
+*	功能说明: 立即输出一次计数器摘要 (与上一次周期快照比较)，任意任务中调用
+*	形    参: 无
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void net_stats_log( void )
+{
+  struct net_stats_record rec;
+
+  LOCK_TCPIP_CORE();
+  net_stats_get( &rec );
+  net_stats_log_record( &rec, &net_stats_last );
+  UNLOCK_TCPIP_CORE();
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: net_stats_overhead
+*	功能说明: 用 DWT 周期计数测量 lwIP 计数器的开销: 单次计数 (STATS_INC, 普通的读-加-写),
+*             每个 TCP 报文段大约 NET_STATS_INC_PER_SEGMENT 次计数的总开销, 以及一次快照的开销,
+*             结果通过 elog 输出并写入之后的快照记录
+*	形    参: 无
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void net_stats_overhead( void )
+{
+  struct net_stats_record rec;
+  u32_t i, cycles, per_segment;
+  /* through a volatile pointer every pass is a real load-add-store, as in
+     the stack where calls separate the increments; the loop overhead is
+     included, the result is an upper bound */
+  volatile STAT_COUNTER *counter = &lwip_stats.link.recv;
+
+  /* link.recv is only written by the Rx path, under the core lock */
+  LOCK_TCPIP_CORE();
+
+  cycles = DWT_CYCCNT;
+  for( i = 0; i < NET_STATS_BENCH_LOOPS; i++ )
+  {
+    (*counter)++;
+  }
+  cycles = DWT_CYCCNT - cycles;
+  *counter -= NET_STATS_BENCH_LOOPS;
+
+  net_stats_cycles_per_inc = (cycles + NET_STATS_BENCH_LOOPS / 2) / NET_STATS_BENCH_LOOPS;
+
+  cycles = DWT_CYCCNT;
+  net_stats_get( &rec );
+  net_stats_cycles_snapshot = DWT_CYCCNT - cycles;
+
+  UNLOCK_TCPIP_CORE();
+
+  per_segment = net_stats_cycles_per_inc * NET_STATS_INC_PER_SEGMENT;
+
+  log_i( "stats overhead: %u cycles per counter, ~%u cycles (%u ns) per TCP segment, snapshot %u cycles (%u bytes)",
+         (unsigned)net_stats_cycles_per_inc, (unsigned)per_segment,
+         (unsigned)(per_segment * 1000 / (SystemCoreClock / 1000000)),
+         (unsigned)net_stats_cycles_snapshot, (unsigned)sizeof(rec) );
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: net_stats_start
+*	功能说明: 启动周期性快照 (和可选的 UDP 推送)，在 netif 初始化之后调用
+*	形    参: 无
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void net_stats_start( void )
+{
+  LOCK_TCPIP_CORE();
+
+  net_stats_get( &net_stats_last );
+  net_stats_seq = 1;
+
+#ifdef NET_STATS_UDP_IP
+  ipaddr_aton( NET_STATS_UDP_IP, &net_stats_collector );
+  net_stats_pcb = udp_new();
+  if( net_stats_pcb == NULL )
+  {
+    log_e( "net_stats udp_new failed" );
+  }
+#endif
+
+  sys_timeout( NET_STATS_INTERVAL, net_stats_report, NULL );
+
+  UNLOCK_TCPIP_CORE();
+}
@@ -0,0 +1,115 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : net_stats
+*	文件名称 : net_stats.h
+*	版    本 : V1.0
+*	说    明 : periodic snapshot of the lwIP (LWIP_STATS / MIB2) and Ethernet driver counters,
+*              pushed over UDP as a compact binary record and/or logged through EasyLogger
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月26日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __NET_STATS_H__
+#define  __NET_STATS_H__
+
+#include "lwip/opt.h"
+
+/* period of the snapshot, in ms */
+#ifndef NET_STATS_INTERVAL
+#define NET_STATS_INTERVAL            5000
+#endif
+
+/* 1: log a one line summary of every snapshot */
+#ifndef NET_STATS_LOG
+#define NET_STATS_LOG                 1
+#endif
+
+/* define to push every snapshot as one UDP datagram to this collector, e.g. "192.168.0.22" */
+/* #define NET_STATS_UDP_IP           "192.168.0.22" */
+
+#ifndef NET_STATS_UDP_PORT
+#define NET_STATS_UDP_PORT            5140
+#endif
+
+/* first word of the record ("NSTA" read as little endian) and record layout version */
+#define NET_STATS_MAGIC               0x4154534EUL
+#define NET_STATS_VERSION             1
+
+/*
+ * Binary record, little endian, all the counters are free running u32_t:
+ * the collector computes the rates from two consecutive records.
+ * New fields are only appended, with NET_STATS_VERSION incremented.
+ */
+struct net_stats_record
+{
+  u32_t magic;
+  u16_t version;
+  u16_t length;                   /* sizeof(struct net_stats_record) */
+  u32_t seq;
+  u32_t uptime;                   /* ms */
+  u32_t link_up;
+  u32_t link_speed;               /* bit/s, 0 when unknown */
+
+  /* Ethernet driver, see struct ethernetif_stats */
+  u32_t eth_rx_frames;
+  u32_t eth_rx_bytes;
+  u32_t eth_rx_dropped;
+  u32_t eth_rx_pool_empty;        /* no spare Rx buffer */
+  u32_t eth_rx_missed;            /* no Rx descriptor, counted by the DMA */
+  u32_t eth_rx_filtered;          /* broadcasts and multicasts shed in strict mode */
+  u32_t eth_tx_frames;
+  u32_t eth_tx_bytes;
+  u32_t eth_tx_dropped;
+  u32_t eth_tx_ring_full;
+  u32_t eth_dma_errors;
+  u32_t eth_link_changes;
+
+  /* lwIP protocols: received, sent, dropped */
+  u32_t etharp_drop;
+  u32_t ip_recv;
+  u32_t ip_xmit;
+  u32_t ip_drop;
+  u32_t icmp_recv;
+  u32_t icmp_xmit;
+  u32_t udp_recv;
+  u32_t udp_xmit;
+  u32_t udp_drop;
+  u32_t tcp_recv;
+  u32_t tcp_xmit;
+  u32_t tcp_drop;
+  u32_t tcp_rexmit;               /* MIB2 tcpRetransSegs */
+  u32_t tcp_resets;               /* MIB2 tcpEstabResets */
+  u32_t tcp_attempt_fails;        /* MIB2 tcpAttemptFails */
+  u32_t tcp_curr_estab;           /* MIB2 tcpCurrEstab, not a counter */
+
+  /* buffers */
+  u32_t mem_used;                 /* heap or mem_malloc() pools, bytes */
+  u32_t mem_max;
+  u32_t mem_err;
+  u32_t memp_err;                 /* sum over all the memp pools */
+  u32_t pbuf_pool_used;
+  u32_t pbuf_pool_max;
+  u32_t pbuf_pool_err;
+
+  /* OS mailboxes, semaphores and mutexes: creation failures and mbox overflows */
+  u32_t mbox_used;
+  u32_t mbox_err;
+  u32_t sem_err;
+  u32_t mutex_err;
+
+  /* net_stats_overhead(), DWT cycles */
+  u32_t cycles_per_inc;           /* one lwIP counter increment */
+  u32_t cycles_snapshot;          /* building this record */
+};
+
+void net_stats_start( void );
+void net_stats_get( struct net_stats_record *rec );
+void net_stats_log( void );
+void net_stats_overhead( void );
+
+#endif
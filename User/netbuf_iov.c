@@ -0,0 +1,147 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : netbuf_iov
+*	文件名称 : netbuf_iov.c
+*	版    本 : V1.0
+*	说    明 : Scatter list (iovec) view of a received netbuf. A TCP netbuf is a pbuf chain
+*              (one pbuf per coalesced segment or Rx buffer): the fragments are handed to the
+*              application in place, a message is copied into a contiguous buffer only when
+*              it straddles two fragments.
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月22日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "netbuf_iov.h"
+
+#if LWIP_NETCONN
+
+#include <string.h>
+
+/*
+*********************************************************************************************************
+*	函 数 名: netbuf_iov_fill
+*	功能说明: 从 netbuf 当前片段开始, 最多填充 iovmax 个片段到 iov, 不拷贝数据.
+*             返回后 netbuf 指向下一个未填充的片段, 再次调用可继续取剩余片段.
+*	形    参: buf    接收到的 netbuf, 第一次调用前由 netconn_recv 定位在第一个片段
+*             iov    片段表
+*             iovmax 片段表大小
+*             total  输出, 本次填充的字节数, 可以为 NULL
+*	返 回 值: 填充的片段数, 0 表示 netbuf 已经取完
+*********************************************************************************************************
+*/
+int netbuf_iov_fill( struct netbuf *buf, struct netbuf_iov *iov, int iovmax, u32_t *total )
+{
+	int cnt = 0;
+	u32_t bytes = 0;
+	
+	/* ptr == NULL: the previous call consumed the last fragment */
+	while( cnt < iovmax && buf->ptr != NULL )
+	{
+		if( netbuf_data( buf, &iov[cnt].base, &iov[cnt].len ) != ERR_OK )
+		{
+			break;
+		}
+		
+		bytes += iov[cnt].len;
+		cnt++;
+		
+		if( netbuf_next( buf ) < 0 )
+		{
+			/* last fragment consumed */
+			buf->ptr = NULL;
+		}
+	}
+	
+	if( total != NULL )
+	{
+		*total = bytes;
+	}
+	
+	return cnt;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: netbuf_iov_peek
+*	功能说明: 取得片段表中 offset 开始的 len 个连续字节. 数据在一个片段内时直接返回片段内的地址,
+*             跨越片段时才拷贝到 scratch.
+*	形    参: iov     片段表
+*             iovcnt  片段数
+*             offset  在整个片段表中的字节偏移
+*             len     需要的长度
+*             scratch 至少 len 字节的缓冲区, 仅在数据跨片段时使用
+*	返 回 值: 指向连续数据的指针, 数据不足 len 字节时返回 NULL
+*********************************************************************************************************
+*/
+const void *netbuf_iov_peek( const struct netbuf_iov *iov, int iovcnt, u32_t offset, u16_t len, void *scratch )
+{
+	int i;
+	
+	for( i = 0; i < iovcnt; i++ )
+	{
+		if( offset < iov[i].len )
+		{
+			break;
+		}
+		offset -= iov[i].len;
+	}
+	
+	if( i == iovcnt )
+	{
+		return NULL;
+	}
+	
+	if( offset + len <= iov[i].len )
+	{
+		return (const u8_t *)iov[i].base + offset;
+	}
+	
+	/* straddles fragments */
+	if( netbuf_iov_copy( &iov[i], iovcnt - i, offset, scratch, len ) != len )
+	{
+		return NULL;
+	}
+	
+	return scratch;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: netbuf_iov_copy
+*	功能说明: 从片段表 offset 开始拷贝 len 字节到 dst
+*	形    参: iov     片段表
+*             iovcnt  片段数
+*             offset  在整个片段表中的字节偏移
+*             dst     目的缓冲区
+*             len     拷贝长度
+*	返 回 值: 实际拷贝的字节数
+*********************************************************************************************************
+*/
+u32_t netbuf_iov_copy( const struct netbuf_iov *iov, int iovcnt, u32_t offset, void *dst, u32_t len )
+{
+	int i;
+	u32_t copied = 0, chunk;
+	
+	for( i = 0; i < iovcnt && copied < len; i++ )
+	{
+		if( offset >= iov[i].len )
+		{
+			offset -= iov[i].len;
+			continue;
+		}
+		
+		chunk = LWIP_MIN( (u32_t)iov[i].len - offset, len - copied );
+		memcpy( (u8_t *)dst + copied, (const u8_t *)iov[i].base + offset, chunk );
+		copied += chunk;
+		offset = 0;
+	}
+	
+	return copied;
+}
+
+#endif /* LWIP_NETCONN */
@@ -0,0 +1,43 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : netbuf_iov
+*	文件名称 : netbuf_iov.h
+*	版    本 : V1.0
+*	说    明 : Scatter list (iovec) view of a received netbuf, without copy
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月22日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __NETBUF_IOV_H__
+#define  __NETBUF_IOV_H__
+
+#include "lwip/opt.h"
+
+#if LWIP_NETCONN
+
+#include "lwip/netbuf.h"
+
+/* fragments handed to the application per call, a netbuf with more is delivered in several calls */
+#ifndef NETBUF_IOV_MAX
+#define NETBUF_IOV_MAX    8
+#endif
+
+/* one fragment of a netbuf, points into the pbuf payload */
+struct netbuf_iov
+{
+  void  *base;
+  u16_t  len;
+};
+
+int         netbuf_iov_fill( struct netbuf *buf, struct netbuf_iov *iov, int iovmax, u32_t *total );
+const void *netbuf_iov_peek( const struct netbuf_iov *iov, int iovcnt, u32_t offset, u16_t len, void *scratch );
+u32_t       netbuf_iov_copy( const struct netbuf_iov *iov, int iovcnt, u32_t offset, void *dst, u32_t len );
+
+#endif /* LWIP_NETCONN */
+
+#endif
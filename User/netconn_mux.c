@@ -0,0 +1,445 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : netconn_mux
+*	文件名称 : netconn_mux.c
+*	版    本 : V1.0
+*	说    明 : netconn 就绪事件多路复用. 登记的 netconn 改用本模块的事件回调并设为非阻塞, 回调在
+*              tcpip 线程中把事件记在连接上, 连接第一次有事件时把它的序号放入 mux 的 FreeRTOS 队列;
+*              等待的任务从队列取出一批序号, 每个连接得到一个合并后的事件.
+*
+*              事件是边沿触发的 (同 EPOLLET): 可读时要一直 netconn_recv() 到 ERR_WOULDBLOCK, 可写时
+*              一直写到 ERR_WOULDBLOCK, 不然剩下的数据不会再报告. 对端 ACK 时都会报告可写, 只在发送
+*              受阻时才用 netconn_mux_modify() 打开 NETCONN_MUX_WRITE.
+*
+*              监听的 netconn 有新连接时可读, netconn_accept() 得到的连接继承监听的事件回调, 再
+*              netconn_mux_add() 登记后才上报事件; 登记 (或打开关注) 时先报告一次可读/可写, 登记
+*              之前到达的数据由此取走. netconn_delete() 之前先 netconn_mux_del().
+*
+*              同一个 mux 只由一个任务等待. 所有 netconn 共用一个任务, 不再每个连接一个 512 word
+*              的栈, 节省的 RAM 见 netconn_mux_get_stats().
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年05月04日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "netconn_mux.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "netconn_mux_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#if LWIP_NETCONN
+
+#include "lwip/sys.h"
+#include "lwip/tcpip.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#if !LWIP_NETCONN_CALLBACK_ARG
+#error "netconn_mux needs LWIP_NETCONN_CALLBACK_ARG"
+#endif
+
+#if NETCONN_MUX_CONNS > 255
+#error "NETCONN_MUX_CONNS too big, the event queue holds u8_t"
+#endif
+
+/* 每连接一个任务时每个任务的开销: 栈与 TCB */
+#define NETCONN_MUX_TASK_BYTES    ( NETCONN_MUX_CONN_TASK_STACK * sizeof(StackType_t) + sizeof(StaticTask_t) )
+
+typedef struct
+{
+	struct netconn *conn;       /* NULL: 空闲 */
+	void           *arg;
+	netconn_mux_t  *mux;
+	u8_t            interest;   /* 关注的事件 */
+	u8_t            pending;    /* 已发生还没有取走的事件 */
+	u8_t            queued;     /* 序号在队列中, 删除后也保留, 保证队列不会满 */
+} netconn_mux_entry_t;
+
+struct netconn_mux
+{
+	QueueHandle_t        queue;   /* 有事件的连接序号 */
+	TaskHandle_t         task;    /* 最近一次等待的任务 */
+	u8_t                 used;
+	netconn_mux_entry_t  entry[NETCONN_MUX_CONNS];
+	netconn_mux_stats_t  stats;
+};
+
+static struct netconn_mux netconn_mux_tab[NETCONN_MUX_MAX];
+
+/* 有事件且不在队列中时放入队列. 调用者持有内核锁 */
+static void netconn_mux_kick( netconn_mux_entry_t *e )
+{
+	u8_t idx;
+
+	if( e->pending == 0 || e->queued )
+	{
+		return;
+	}
+
+	idx = (u8_t)( e - e->mux->entry );
+	e->queued = 1;
+	xQueueSend( e->mux->queue, &idx, 0 );   /* 每个连接最多一个, 不会满 */
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: netconn_mux_event
+*	功能说明: 登记的 netconn 的事件回调, 在 tcpip 线程中(持有内核锁)执行. RCVMINUS / SENDMINUS 不处理:
+*             RCVMINUS 在应用任务的 netconn_recv() 中调用, 不持有内核锁.
+*********************************************************************************************************
+*/
+static void netconn_mux_event( struct netconn *conn, enum netconn_evt evt, u16_t len )
+{
+	netconn_mux_entry_t *e;
+	u8_t ev;
+
+	LWIP_UNUSED_ARG(len);
+
+	switch( evt )
+	{
+		case NETCONN_EVT_RCVPLUS:
+			ev = NETCONN_MUX_READ;
+			break;
+		case NETCONN_EVT_SENDPLUS:
+			ev = NETCONN_MUX_WRITE;
+			break;
+		case NETCONN_EVT_ERROR:
+			ev = NETCONN_MUX_ERR;
+			break;
+		default:
+			return;
+	}
+
+	/* NULL: accept 得到还没有登记的连接, 或已删除 */
+	e = (netconn_mux_entry_t *)netconn_get_callback_arg( conn );
+	if( e == NULL )
+	{
+		return;
+	}
+
+	ev &= e->interest | NETCONN_MUX_ERR;
+	if( ev != 0 )
+	{
+		e->pending |= ev;
+		netconn_mux_kick( e );
+	}
+}
+
+/* 登记的连接. 调用者持有内核锁 */
+static netconn_mux_entry_t *netconn_mux_find( netconn_mux_t *mux, struct netconn *conn )
+{
+	netconn_mux_entry_t *e = (netconn_mux_entry_t *)netconn_get_callback_arg( conn );
+
+	if( e == NULL || e->mux != mux || e->conn != conn )
+	{
+		return NULL;
+	}
+	return e;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: netconn_mux_create
+*	功能说明: 创建一个 mux
+*	形    参: 无
+*	返 回 值: mux, NULL: 没有空闲的 mux (NETCONN_MUX_MAX) 或队列创建失败
+*********************************************************************************************************
+*/
+netconn_mux_t *netconn_mux_create( void )
+{
+	netconn_mux_t *mux = NULL;
+	int i;
+
+	taskENTER_CRITICAL();
+	for( i = 0; i < NETCONN_MUX_MAX; i++ )
+	{
+		if( !netconn_mux_tab[i].used )
+		{
+			mux = &netconn_mux_tab[i];
+			mux->used = 1;
+			break;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	if( mux == NULL )
+	{
+		log_e("no free mux, NETCONN_MUX_MAX %d", NETCONN_MUX_MAX);
+		return NULL;
+	}
+
+	mux->queue = xQueueCreate( NETCONN_MUX_CONNS, sizeof(u8_t) );
+	if( mux->queue == NULL )
+	{
+		log_e("event queue create failed");
+		mux->used = 0;
+		return NULL;
+	}
+
+	mux->task = NULL;
+	memset( mux->entry, 0, sizeof(mux->entry) );
+	memset( &mux->stats, 0, sizeof(mux->stats) );
+
+	return mux;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: netconn_mux_add
+*	功能说明: 登记一个 netconn: 替换它的事件回调并设为非阻塞, 先报告一次关注的可读/可写.
+*	形    参: mux      netconn_mux_create() 的返回值
+*             conn     netconn, 没有登记在其他 mux 中
+*             interest 关注的事件 NETCONN_MUX_READ / NETCONN_MUX_WRITE, 出错总是上报
+*             arg      事件中带回的参数
+*	返 回 值: >= 0 成功, -1 参数错误, 已经登记或 mux 已满
+*********************************************************************************************************
+*/
+int netconn_mux_add( netconn_mux_t *mux, struct netconn *conn, u8_t interest, void *arg )
+{
+	netconn_mux_entry_t *e = NULL;
+	int i;
+
+	if( mux == NULL || conn == NULL )
+	{
+		return -1;
+	}
+
+	LOCK_TCPIP_CORE();
+
+	if( netconn_get_callback_arg( conn ) != NULL )
+	{
+		UNLOCK_TCPIP_CORE();
+		return -1;
+	}
+
+	for( i = 0; i < NETCONN_MUX_CONNS; i++ )
+	{
+		if( mux->entry[i].conn == NULL )
+		{
+			e = &mux->entry[i];
+			break;
+		}
+	}
+	if( e == NULL )
+	{
+		UNLOCK_TCPIP_CORE();
+		log_w("mux full, NETCONN_MUX_CONNS %d", NETCONN_MUX_CONNS);
+		return -1;
+	}
+
+	e->conn     = conn;
+	e->arg      = arg;
+	e->mux      = mux;
+	e->interest = interest;
+	e->pending  = interest & ( NETCONN_MUX_READ | NETCONN_MUX_WRITE );
+
+	conn->callback = netconn_mux_event;
+	netconn_set_callback_arg( conn, e );
+	netconn_set_nonblocking( conn, 1 );
+
+	netconn_mux_kick( e );
+
+	mux->stats.conns++;
+	if( mux->stats.conns > mux->stats.conns_max )
+	{
+		mux->stats.conns_max = mux->stats.conns;
+	}
+
+	UNLOCK_TCPIP_CORE();
+
+	return i;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: netconn_mux_modify
+*	功能说明: 修改关注的事件, 新打开的可读/可写先报告一次
+*	形    参: mux      mux
+*             conn     已登记的 netconn
+*             interest 关注的事件
+*	返 回 值: 0 成功, -1 没有登记在这个 mux 中
+*********************************************************************************************************
+*/
+int netconn_mux_modify( netconn_mux_t *mux, struct netconn *conn, u8_t interest )
+{
+	netconn_mux_entry_t *e;
+
+	if( mux == NULL || conn == NULL )
+	{
+		return -1;
+	}
+
+	LOCK_TCPIP_CORE();
+
+	e = netconn_mux_find( mux, conn );
+	if( e == NULL )
+	{
+		UNLOCK_TCPIP_CORE();
+		return -1;
+	}
+
+	e->pending |= interest & ~e->interest & ( NETCONN_MUX_READ | NETCONN_MUX_WRITE );
+	e->pending &= interest | NETCONN_MUX_ERR;
+	e->interest = interest;
+	netconn_mux_kick( e );
+
+	UNLOCK_TCPIP_CORE();
+
+	return 0;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: netconn_mux_del
+*	功能说明: 取消登记, 之后的事件丢弃. 在 netconn_delete() 之前调用.
+*	形    参: mux  mux
+*             conn 已登记的 netconn
+*	返 回 值: 0 成功, -1 没有登记在这个 mux 中
+*********************************************************************************************************
+*/
+int netconn_mux_del( netconn_mux_t *mux, struct netconn *conn )
+{
+	netconn_mux_entry_t *e;
+
+	if( mux == NULL || conn == NULL )
+	{
+		return -1;
+	}
+
+	LOCK_TCPIP_CORE();
+
+	e = netconn_mux_find( mux, conn );
+	if( e == NULL )
+	{
+		UNLOCK_TCPIP_CORE();
+		return -1;
+	}
+
+	/* 回调留给 netconn, callback_arg 为 NULL 时忽略事件; queued 保留到序号从队列中取出 */
+	netconn_set_callback_arg( conn, NULL );
+	e->conn    = NULL;
+	e->arg     = NULL;
+	e->pending = 0;
+	mux->stats.conns--;
+
+	UNLOCK_TCPIP_CORE();
+
+	return 0;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: netconn_mux_wait
+*	功能说明: 等待登记的 netconn 有事件, 一次取回所有 (最多 max 个) 已发生的事件. 同一个 mux 只能由一个
+*             任务等待.
+*	形    参: mux     mux
+*             ev      事件输出
+*             max     ev 的个数
+*             timeout 超时 ms, 0: 不等待, NETCONN_MUX_WAIT_FOREVER: 一直等待
+*	返 回 值: 事件个数, 0: 超时 (或只取到已删除连接的事件), -1 参数错误
+*********************************************************************************************************
+*/
+int netconn_mux_wait( netconn_mux_t *mux, netconn_mux_event_t *ev, int max, u32_t timeout )
+{
+	netconn_mux_entry_t *e;
+	TickType_t ticks;
+	u8_t idx;
+	int n = 0;
+
+	if( mux == NULL || ev == NULL || max <= 0 )
+	{
+		return -1;
+	}
+
+	mux->task = xTaskGetCurrentTaskHandle();
+
+	ticks = ( timeout == NETCONN_MUX_WAIT_FOREVER ) ? portMAX_DELAY : pdMS_TO_TICKS( timeout );
+	if( xQueueReceive( mux->queue, &idx, ticks ) != pdPASS )
+	{
+		LOCK_TCPIP_CORE();
+		mux->stats.waits++;
+		UNLOCK_TCPIP_CORE();
+		return 0;
+	}
+
+	LOCK_TCPIP_CORE();
+
+	do
+	{
+		e = &mux->entry[idx];
+		e->queued = 0;
+		if( e->conn != NULL && e->pending != 0 )
+		{
+			ev[n].conn   = e->conn;
+			ev[n].arg    = e->arg;
+			ev[n].events = e->pending;
+			e->pending   = 0;
+			n++;
+		}
+	}
+	while( n < max && xQueueReceive( mux->queue, &idx, 0 ) == pdPASS );
+
+	mux->stats.waits++;
+	mux->stats.events += n;
+	if( (u32_t)n > mux->stats.batch_max )
+	{
+		mux->stats.batch_max = n;
+	}
+
+	UNLOCK_TCPIP_CORE();
+
+	return n;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: netconn_mux_get_stats
+*	功能说明: 读取统计, 以及与每连接一个任务相比节省的 RAM
+*	形    参: mux   mux
+*             stats 输出
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void netconn_mux_get_stats( netconn_mux_t *mux, netconn_mux_stats_t *stats )
+{
+	u32_t used;
+
+	if( mux == NULL )
+	{
+		memset( stats, 0, sizeof(*stats) );
+		return;
+	}
+
+	LOCK_TCPIP_CORE();
+	*stats = mux->stats;
+	UNLOCK_TCPIP_CORE();
+
+	/* 队列: 控制块 + 每个连接一个字节 */
+	stats->ram_bytes = sizeof(struct netconn_mux) + sizeof(StaticQueue_t) + NETCONN_MUX_CONNS * sizeof(u8_t);
+	stats->stack_free = ( mux->task != NULL ) ? uxTaskGetStackHighWaterMark( mux->task ) * sizeof(StackType_t) : 0;
+	stats->task_model_bytes = stats->conns_max * NETCONN_MUX_TASK_BYTES;
+
+	used = stats->ram_bytes + NETCONN_MUX_TASK_BYTES;
+	stats->saved_bytes = ( stats->task_model_bytes > used ) ? stats->task_model_bytes - used : 0;
+}
+
+#endif /* LWIP_NETCONN */
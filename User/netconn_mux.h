@@ -0,0 +1,75 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : netconn_mux
+*	文件名称 : netconn_mux.h
+*	版    本 : V1.0
+*	说    明 : netconn 就绪事件多路复用 (类似 select/epoll, 不需要 LWIP_SOCKET): 一个任务登记多个
+*              非阻塞 netconn, 一次等待取回一批 可读/可写/出错 事件
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年05月04日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __NETCONN_MUX_H__
+#define  __NETCONN_MUX_H__
+
+#include "lwip/opt.h"
+#include "lwip/api.h"
+
+/* 每个 mux 最多登记的 netconn 数 (不超过 255), lwipopts.h 中 MEMP_NUM_NETCONN / MEMP_NUM_TCP_PCB 要留出余量 */
+#ifndef NETCONN_MUX_CONNS
+#define NETCONN_MUX_CONNS             32
+#endif
+
+/* 可以创建的 mux 个数 */
+#ifndef NETCONN_MUX_MAX
+#define NETCONN_MUX_MAX               2
+#endif
+
+/* 每连接一个任务时每个任务的栈, 单位 word, 只用于统计中估算节省的 RAM */
+#ifndef NETCONN_MUX_CONN_TASK_STACK
+#define NETCONN_MUX_CONN_TASK_STACK   DEFAULT_THREAD_STACKSIZE
+#endif
+
+/* 事件 */
+#define NETCONN_MUX_READ              0x01    /* 有数据, 有新连接 (监听), 对端关闭 */
+#define NETCONN_MUX_WRITE             0x02    /* 发送缓冲区有空间 */
+#define NETCONN_MUX_ERR               0x04    /* 连接出错, 总是上报 */
+
+/* netconn_mux_wait() 的超时 */
+#define NETCONN_MUX_WAIT_FOREVER      0xFFFFFFFFUL
+
+typedef struct netconn_mux netconn_mux_t;
+
+typedef struct
+{
+	struct netconn *conn;
+	void           *arg;        /* netconn_mux_add() 时给出 */
+	u8_t            events;     /* NETCONN_MUX_xxx */
+} netconn_mux_event_t;
+
+typedef struct
+{
+	u32_t conns;                /* 当前登记的 netconn */
+	u32_t conns_max;            /* 同时登记的最大数 */
+	u32_t waits;                /* netconn_mux_wait() 调用次数 */
+	u32_t events;               /* 取回的事件 (每个 netconn 每次等待最多一个) */
+	u32_t batch_max;            /* 一次等待取回的最多事件 */
+	u32_t ram_bytes;            /* mux 本身与事件队列 */
+	u32_t stack_free;           /* 等待任务的栈最少剩余, 字节, 0: 还没有等待过 */
+	u32_t task_model_bytes;     /* 每连接一个任务的开销: conns_max 个 (栈 + TCB) */
+	u32_t saved_bytes;          /* task_model_bytes 减去 mux 与一个等待任务 */
+} netconn_mux_stats_t;
+
+netconn_mux_t *netconn_mux_create( void );
+int  netconn_mux_add( netconn_mux_t *mux, struct netconn *conn, u8_t interest, void *arg );
+int  netconn_mux_modify( netconn_mux_t *mux, struct netconn *conn, u8_t interest );
+int  netconn_mux_del( netconn_mux_t *mux, struct netconn *conn );
+int  netconn_mux_wait( netconn_mux_t *mux, netconn_mux_event_t *ev, int max, u32_t timeout );
+void netconn_mux_get_stats( netconn_mux_t *mux, netconn_mux_stats_t *stats );
+
+#endif
@@ -39,6 +39,14 @@
 #include "lwip/tcp.h"
 #include "lwip/ip.h"
 
+#include "lwip/tcpip.h"
+
+#include <string.h>
+
+#include "netbuf_iov.h"
+#include "netif_port.h"
+#include "tcp_conn_mgr.h"
+
 extern TaskHandle_t xHandleTaskLED;
 
 #define TCP_SERVER_IP   "192.168.0.22"
@@ -49,22 +57,65 @@ SemaphoreHandle_t xServerCommunicationLockSemaphore = NULL;
 
 static struct netconn *tcp_client_server_conn;
 
-void tcp_client_conn_server_task( void )
+/* NOCOPY ͻ:  lwIP ֱ÷, ݱ ACK  DMA ɺŻ.
+   ص״ֻ̬ڳ TCPIP ںʱ޸. */
+typedef struct
 {
-  struct netbuf *buf;
-  void *data;
-  u16_t len;
-  err_t err;
-	
-	ip_addr_t server_ip;
-	
+	uint8_t data[TCP_CLIENT_TXBUF_SIZE];
+	u32_t   end_seq;   /* һη͵֮, Զ ACK ż */
+	u32_t   tx_mark;   /* ۲쵽 ACK ʱŶӵ֡, ɵ֡ſɻ */
+	u8_t    ref;       /* Ӧó 1  + ÿδȷϵķ 1  */
+	u8_t    acked;
+} tcp_client_txbuf_t;
+
+static tcp_client_txbuf_t  tcp_client_txbuf[TCP_CLIENT_TXBUF_CNT];
+static tcp_client_txbuf_t *tcp_client_txbuf_inflight[TCP_CLIENT_TXBUF_CNT * 2]; /* ˳ */
+static u16_t               tcp_client_txbuf_inflight_cnt;
+static SemaphoreHandle_t   xTxBufFreeSemaphore = NULL; /* л */
+
+static int tcp_client_conn_id = -1;
+
+#if TCP_CLIENT_FRAMING
+static struct frame_dec tcp_client_dec;	/* ݵ֡, ֻӹʹ */
+#endif
 
-	
-	u16_t server_port = TCP_SERVER_PORT;				     // ˿ںųʼ
+static void tcp_client_connected( int id, void *arg );
+static void tcp_client_disconnected( int id, void *arg, err_t err );
+static void tcp_client_recv( int id, void *arg, const struct netbuf_iov *iov, int iovcnt );
+#if TCP_CLIENT_FRAMING
+static void tcp_client_recv_pbuf( int id, void *arg, struct pbuf *p );
+static void tcp_client_frame( void *arg, const struct frame_msg *msg );
+#endif
+static void tcp_client_sent( int id, void *arg );
+static void tcp_client_txbuf_reclaim( void );
+static void tcp_client_txbuf_release_all( void );
 
-	ip4addr_aton( TCP_SERVER_IP, &server_ip ); 			 // IPַʼ
+/*
+*********************************************************************************************************
+*	  : tcp_client_init
+*	˵: Ѻ̨Ǽǵӹ, , պͶ tcp_conn_mgr_run() 
+*	    : 
+*	  ֵ: 
+*********************************************************************************************************
+*/
+void tcp_client_init( void )
+{
+	static const tcp_conn_cb_t cb =
+	{
+		tcp_client_connected,
+		tcp_client_disconnected,
+		tcp_client_recv,
+		tcp_client_sent,
+#if TCP_CLIENT_FRAMING
+		tcp_client_recv_pbuf,
+#else
+		NULL,
+#endif
+	};
 
 	xServerCommunicationLockSemaphore = xSemaphoreCreateBinary();
+	
+	xTxBufFreeSemaphore = xSemaphoreCreateBinary();
 
 	if( NULL == xServerCommunicationLockSemaphore )
 	{
@@ -72,86 +123,495 @@ void tcp_client_conn_server_task( void )
 			while(1);
 	}
 	
-	for( ;; )
+	xTaskNotify( xHandleTaskLED, 200, eSetValueWithOverwrite );/* Ͽ״̬LED˸Ϊ200mSһ. */
+	
+#if TCP_CLIENT_FRAMING
+	frame_dec_init( &tcp_client_dec, tcp_client_frame, NULL );
+#endif
+	
+	tcp_client_conn_id = tcp_conn_mgr_add( TCP_SERVER_IP, TCP_SERVER_PORT, &cb, NULL );
+	if( tcp_client_conn_id < 0 )
 	{
-				
-		log_i("tcp server connecting %s:%d......", ipaddr_ntoa(&server_ip), server_port );
-		
+		log_e("err:tcp_conn_mgr_add:%d.", tcp_client_conn_id );
+	}
+}
+
+static void tcp_client_connected( int id, void *arg )
+{
+	LWIP_UNUSED_ARG(arg);
+	
+	tcp_client_server_conn = tcp_conn_mgr_netconn( id );
+	
+	xSemaphoreGive( xServerCommunicationLockSemaphore ); /* ͷŷͨʹȨ */
+
+	xTaskNotify( xHandleTaskLED, 1000, eSetValueWithOverwrite );/* ״̬LED˸Ϊ1000mSһ. */
+}
+
+static void tcp_client_disconnected( int id, void *arg, err_t err )
+{
+	LWIP_UNUSED_ARG(id);
+	LWIP_UNUSED_ARG(arg);
+	LWIP_UNUSED_ARG(err);
+	
+	LOCK_TCPIP_CORE();
+	tcp_client_server_conn = NULL;
+	UNLOCK_TCPIP_CORE();
+	
+	tcp_client_txbuf_release_all();	/* ѶϿ, δȷϵ NOCOPY ȫ */
+	
+#if TCP_CLIENT_FRAMING
+	frame_dec_reset( &tcp_client_dec );	/* û֡, µ֡ʼ */
+#endif
+	
+	xTaskNotify( xHandleTaskLED, 200, eSetValueWithOverwrite );/* Ͽ״̬LED˸Ϊ200mSһ. */
+}
+
+static void tcp_client_recv( int id, void *arg, const struct netbuf_iov *iov, int iovcnt )
+{
+	LWIP_UNUSED_ARG(id);
+	LWIP_UNUSED_ARG(arg);
+	
+	received_server_data_process_iov( iov, iovcnt );
+}
+
+#if TCP_CLIENT_FRAMING
+/* յ pbuf ֡, ; ֡ tcp_client_frame()  */
+static void tcp_client_recv_pbuf( int id, void *arg, struct pbuf *p )
+{
+	LWIP_UNUSED_ARG(id);
+	LWIP_UNUSED_ARG(arg);
+	
+	frame_dec_feed( &tcp_client_dec, p );
+}
+
+static void tcp_client_frame( void *arg, const struct frame_msg *msg )
+{
+	LWIP_UNUSED_ARG(arg);
+	
+	received_server_frame_process( msg );
+}
+#endif
+
+/*
+*********************************************************************************************************
+*	  : tcp_client_sent
+*	˵: Զ ACK ص,  tcpip ߳(ں)ִ. ͻпռʱ NOCOPY .
+*********************************************************************************************************
+*/
+static void tcp_client_sent( int id, void *arg )
+{
+	LWIP_UNUSED_ARG(id);
+	LWIP_UNUSED_ARG(arg);
+	
+	tcp_client_txbuf_reclaim();
+}
+
+/*
+*********************************************************************************************************
+*	  : received_server_data_process_iov
+*	˵: , Ƭα, Ƭֱָջ.
+*             Ҫʱʹ netbuf_iov_peek(), ĿƬʱŻ´.
+*	    : iov    Ƭα
+*             iovcnt Ƭ
+*	  ֵ: 0 ɹ,  
+*********************************************************************************************************
+*/
+int received_server_data_process_iov( const struct netbuf_iov *iov, int iovcnt )
+{
+	int i, ret = 0;
+	
+	for( i = 0; i < iovcnt && ret == 0; i++ )
+	{
+		ret = received_server_data_process( iov[i].base, iov[i].len );
+	}
+	
+	return ret;
+}
+
+int received_server_data_process( uint8_t *data, uint16_t len )
+{
+	 return send_server_data( data, len );
+}
+
+/*
+*********************************************************************************************************
+*	  : received_server_frame_process
+*	˵: һ֡, ӹִ. غɻڽ pbuf , ֻڱЧ:
+*             Ҫʱ frame_msg_data(), Ҫݿ. ʾ: ԭ.
+*	    : msg ֡
+*	  ֵ: 0 ɹ,  
+*********************************************************************************************************
+*/
+int received_server_frame_process( const struct frame_msg *msg )
+{
+	return send_server_frame( msg->type, msg->p, msg->off, msg->len );
+}
+
+/* , . ͻŲȫʱ ERR_WOULDBLOCK, ѷĲճ */
+int send_server_data( uint8_t *data, uint16_t len )
+{
+	int n = tcp_conn_mgr_send( tcp_client_conn_id, data, len );
+	
+	if( n < 0 )
+	{
+		return n;
+	}
+	
+	return ( n == len ) ? ERR_OK : ERR_WOULDBLOCK;
+}
+
+/* ü 1, Ϊ 0 ʱŻس. ߳ں */
+static void tcp_client_txbuf_unref( tcp_client_txbuf_t *txbuf )
+{
+	if( --txbuf->ref == 0 )
+	{
+		xSemaphoreGive( xTxBufFreeSemaphore );
+	}
+}
+
+/*
+*********************************************************************************************************
+*	  : tcp_client_txbuf_reclaim
+*	˵: ѱԶ ACK ѷɵ NOCOPY . ߳ں
+*********************************************************************************************************
+*/
+static void tcp_client_txbuf_reclaim( void )
+{
+	struct ethernetif_stats eth;
+	tcp_client_txbuf_t *txbuf;
+	struct tcp_pcb *pcb;
+	u16_t i, n = 0;
+	
+	if( tcp_client_txbuf_inflight_cnt == 0 || tcp_client_server_conn == NULL )
+	{
+		return;
+	}
+	
+	pcb = tcp_client_server_conn->pcb.tcp;
+	ethernetif_get_stats( &eth );
+	
+	for( i = 0; i < tcp_client_txbuf_inflight_cnt; i++ )
+	{
+		txbuf = tcp_client_txbuf_inflight[i];
 		
-		xTaskNotify( xHandleTaskLED, 200, eSetValueWithOverwrite );/* Ͽ״̬LED˸Ϊ200mSһ. */
+		if( !txbuf->acked && pcb != NULL && (s32_t)( pcb->lastack - txbuf->end_seq ) >= 0 )
+		{
+			/* ȷ, شܻ֡Ͷ */
+			txbuf->acked = 1;
+			txbuf->tx_mark = eth.tx_frames;
+		}
 		
-		/* Create a new connection identifier. */
-		tcp_client_server_conn = netconn_new( NETCONN_TCP );
-				
-		if( tcp_client_server_conn != NULL )
-		{		
-			//TCP ı ͻ˲Ĭϴ򿪣201812610:00:41SuoZhang
-			tcp_client_server_conn->pcb.tcp->so_options |= SOF_KEEPALIVE;
-
-			err = netconn_connect( tcp_client_server_conn, &server_ip, server_port );
-					
-			if(err == ERR_OK)
+		if( txbuf->acked && (s32_t)( eth.tx_completed - txbuf->tx_mark ) >= 0 )
+		{
+			tcp_client_txbuf_unref( txbuf );
+		}
+		else
+		{
+			tcp_client_txbuf_inflight[n++] = txbuf;
+		}
+	}
+	
+	tcp_client_txbuf_inflight_cnt = n;
+}
+
+/* ӶϿ; NOCOPY  */
+static void tcp_client_txbuf_release_all( void )
+{
+	u16_t i;
+	
+	LOCK_TCPIP_CORE();
+	for( i = 0; i < tcp_client_txbuf_inflight_cnt; i++ )
+	{
+		tcp_client_txbuf_unref( tcp_client_txbuf_inflight[i] );
+	}
+	tcp_client_txbuf_inflight_cnt = 0;
+	UNLOCK_TCPIP_CORE();
+}
+
+/*
+*********************************************************************************************************
+*	  : tcp_client_txbuf_alloc
+*	˵:  NOCOPY ͻһ TCP_CLIENT_TXBUF_SIZE ֽڵĻ, üΪ 1
+*	    : timeout ûплʱȴʱ, λ ms, 0 ȴ
+*	  ֵ: , NULL ʾûпл
+*********************************************************************************************************
+*/
+uint8_t *tcp_client_txbuf_alloc( uint32_t timeout )
+{
+	TickType_t start = xTaskGetTickCount();
+	int i;
+	
+	for( ;; )
+	{
+		LOCK_TCPIP_CORE();
+		tcp_client_txbuf_reclaim();
+		for( i = 0; i < TCP_CLIENT_TXBUF_CNT; i++ )
+		{
+			if( tcp_client_txbuf[i].ref == 0 )
 			{
-				log_i("TCP Server %s:%d connected sucess.", ipaddr_ntoa(&server_ip), server_port );
-						
-				xSemaphoreGive( xServerCommunicationLockSemaphore ); /* ͷŷͨʹȨ */
-
-				xTaskNotify( xHandleTaskLED, 1000, eSetValueWithOverwrite );/* ״̬LED˸Ϊ1000mSһ. */
-				
-				for( ;; )
-				{
-					/* receive data until the other host closes the connection */
-					if((err = netconn_recv(tcp_client_server_conn, &buf)) == ERR_OK) 
-					{
-								 //ȡһָnetbuf ṹеݵָ
-								 if((err = netbuf_data(buf, &data, &len)) == ERR_OK)
-								 {
-									  received_server_data_process( data, len );
-										netbuf_delete(buf);
-								 }
-								 else
-								 {
-									 log_e("err:netbuf_data(buf, &data, &len):%d.",err);
-								 }
-								
-					}
-					else//if((err = netconn_recv(conn, &buf)) == ERR_OK)
-					{
-						log_e("err:netconn_recv(conn, &buf):%d.",err);
-						netbuf_delete(buf);	
-						break; //ӷ˳ݵѭ½
-					}
-				 }
-			 }
-			
-			 log_e("err:TCP Server %s:%d connect fail,err:%d.", ipaddr_ntoa(&server_ip), server_port, err );
-			 netconn_close  ( tcp_client_server_conn );
-			 netconn_delete ( tcp_client_server_conn );		
-		   vTaskDelay(1000);
+				tcp_client_txbuf[i].ref = 1;
+				tcp_client_txbuf[i].acked = 0;
+				UNLOCK_TCPIP_CORE();
+				return tcp_client_txbuf[i].data;
+			}
 		}
-		else//(conn!=NULL)
+		UNLOCK_TCPIP_CORE();
+		
+		if( xTaskGetTickCount() - start >= pdMS_TO_TICKS( timeout ) )
 		{
-			log_e("err:Can not create tcp_client_server_conn.");
-			vTaskDelay(1000);
+			return NULL;
 		}
+		
+		/* ȴ, Զ ACK ʱ tcpip ̻߳, Ҳڼ */
+		xSemaphoreTake( xTxBufFreeSemaphore, pdMS_TO_TICKS( 10 ) );
 	}
 }
 
-int received_server_data_process( uint8_t *data, uint16_t len )
+/* ַתΪеĿƿ, ǳеĵַ NULL */
+static tcp_client_txbuf_t *tcp_client_txbuf_get( uint8_t *data )
 {
-	 return send_server_data( data, len );
+	uint32_t idx = ( (uint32_t)data - (uint32_t)tcp_client_txbuf ) / sizeof( tcp_client_txbuf_t );
+	
+	if( idx >= TCP_CLIENT_TXBUF_CNT || tcp_client_txbuf[idx].data != data )
+	{
+		return NULL;
+	}
+	return &tcp_client_txbuf[idx];
 }
 
-int send_server_data( uint8_t *data, uint16_t len )
+/*
+*********************************************************************************************************
+*	  : tcp_client_txbuf_free
+*	˵: ͷӦöԻ. ڷеĻڶԶ ACK Զ
+*	    : data  tcp_client_txbuf_alloc() Ļ
+*	  ֵ: 
+*********************************************************************************************************
+*/
+void tcp_client_txbuf_free( uint8_t *data )
 {
-												 
-	if( tcp_client_server_conn )
+	tcp_client_txbuf_t *txbuf = tcp_client_txbuf_get( data );
+	
+	if( txbuf == NULL )
 	{
-		return netconn_write( tcp_client_server_conn, data, len, NETCONN_COPY);
+		return;
 	}
-	else
-		return ERR_CONN; 
+	
+	LOCK_TCPIP_CORE();
+	tcp_client_txbuf_unref( txbuf );
+	UNLOCK_TCPIP_CORE();
+}
 
+/*
+*********************************************************************************************************
+*	  : send_server_data_nocopy
+*	˵: 㿽ͳл, . ڼ仺, Զ ACK ͷŸ,
+*             Ӧڴڼ䲻޸Ļ. ӦԼ tcp_client_txbuf_free() ͷ.
+*	    : data  tcp_client_txbuf_alloc() Ļ
+*             len  ݳ,  TCP_CLIENT_TXBUF_SIZE
+*	  ֵ: ѷ뷢Ͷеֽ, ͶʱС len; Ϊ err_t 
+*********************************************************************************************************
+*/
+int send_server_data_nocopy( uint8_t *data, uint16_t len )
+{
+	tcp_client_txbuf_t *txbuf = tcp_client_txbuf_get( data );
+	size_t written = 0;
+	err_t err;
+	
+	if( txbuf == NULL || len > TCP_CLIENT_TXBUF_SIZE )
+	{
+		return ERR_ARG;
+	}
+	
+	if( tcp_client_server_conn == NULL )
+	{
+		return ERR_CONN;
+	}
+	
+	err = netconn_write_partly( tcp_client_server_conn, data, len, NETCONN_NOCOPY | NETCONN_DONTBLOCK, &written );
+	if( err != ERR_OK && err != ERR_WOULDBLOCK )
+	{
+		return err;
+	}
+	
+	if( written > 0 )
+	{
+		LOCK_TCPIP_CORE();
+		if( tcp_client_server_conn->pcb.tcp != NULL &&
+		    tcp_client_txbuf_inflight_cnt < LWIP_ARRAYSIZE( tcp_client_txbuf_inflight ) )
+		{
+			/* snd_lbb ͬʱд, ֻûո, ǰȫ */
+			txbuf->end_seq = tcp_client_server_conn->pcb.tcp->snd_lbb;
+			txbuf->acked = 0;
+			txbuf->ref++;
+			tcp_client_txbuf_inflight[tcp_client_txbuf_inflight_cnt++] = txbuf;
+		}
+		UNLOCK_TCPIP_CORE();
+	}
+	
+	return (int)written;
+}
+
+/*
+*********************************************************************************************************
+*	  : send_server_records
+*	˵: һΰѶС¼ lwIP ͻ, ϲɾٵıĶ, 
+*	    : vectors ¼
+*             cnt     ¼
+*	  ֵ: ѷ뷢Ͷеֽ, ͶʱСڼ¼ܳ; Ϊ err_t 
+*********************************************************************************************************
+*/
+int send_server_records( struct netvector *vectors, uint16_t cnt )
+{
+	size_t written = 0;
+	err_t err;
+	
+	if( tcp_client_server_conn == NULL )
+	{
+		return ERR_CONN;
+	}
+	
+	err = netconn_write_vectors_partly( tcp_client_server_conn, vectors, cnt, NETCONN_COPY | NETCONN_DONTBLOCK, &written );
+	if( err != ERR_OK && err != ERR_WOULDBLOCK )
+	{
+		return err;
+	}
+	
+	return (int)written;
+}
+
+/*
+*********************************************************************************************************
+*	  : send_server_frame
+*	˵: һ֡, غ pbuf еһ (յ֡). ֡ͷغƬƬαֱӿ
+*             lwIP ͻ, ƴ. ͻŲ֡ʱ; ֻ֡һʱ
+*             (Ͷе pbuf ) Զ˰ֽͬں CRC һ֡.
+*	    : type ֡
+*             p    غڵ pbuf 
+*             off  غ p еƫ
+*             len  غֽ
+*	  ֵ: ERR_OK ֡ѷ뷢Ͷ, ERR_WOULDBLOCK ͻ,  err_t 
+*********************************************************************************************************
+*/
+int send_server_frame( u8_t type, const struct pbuf *p, u16_t off, u16_t len )
+{
+	struct netvector vec[TCP_CLIENT_FRAME_VEC];
+	u8_t hdr[FRAME_HDR_LEN];
+	u32_t space, batch, left = (u32_t)FRAME_HDR_LEN + len;
+	u16_t cnt, n;
+	int ret;
+	
+	if( len > FRAME_MAX_PAYLOAD )
+	{
+		return ERR_VAL;
+	}
+	
+	LOCK_TCPIP_CORE();
+	space = ( tcp_client_server_conn != NULL && tcp_client_server_conn->pcb.tcp != NULL ) ? tcp_sndbuf( tcp_client_server_conn->pcb.tcp ) : 0;
+	UNLOCK_TCPIP_CORE();
+	
+	if( tcp_client_server_conn == NULL )
+	{
+		return ERR_CONN;
+	}
+	if( space < left )
+	{
+		return ERR_WOULDBLOCK;
+	}
+	
+	frame_hdr_fill( hdr, type, p, off, len );
+	vec[0].ptr = hdr;
+	vec[0].len = FRAME_HDR_LEN;
+	cnt = 1;
+	batch = FRAME_HDR_LEN;
+	
+	while( p != NULL && off >= p->len )
+	{
+		off -= p->len;
+		p = p->next;
+	}
+	
+	/* غƬֱָ pbuf, Ƭαʱд */
+	while( 1 )
+	{
+		if( p != NULL && len > 0 && cnt < TCP_CLIENT_FRAME_VEC )
+		{
+			n = LWIP_MIN( (u16_t)( p->len - off ), len );
+			vec[cnt].ptr = (const u8_t *)p->payload + off;
+			vec[cnt].len = n;
+			cnt++;
+			batch += n;
+			len -= n;
+			off = 0;
+			p = p->next;
+			continue;
+		}
+		
+		ret = send_server_records( vec, cnt );
+		if( ret < 0 )
+		{
+			return ret;
+		}
+		left -= (u32_t)ret;
+		if( (u32_t)ret < batch || len == 0 || p == NULL )
+		{
+			break;
+		}
+		cnt = 0;
+		batch = 0;
+	}
+	
+	if( left > 0 )
+	{
+		log_w("frame type %u: %u bytes not queued.", type, (unsigned)left );
+		return ERR_MEM;
+	}
+	
+	return ERR_OK;
+}
+
+/*
+*********************************************************************************************************
+*	  : tcp_client_tx_pressure
+*	˵: ѯѹ, ߾ݴ,  lwIP 
+*	    : pressure 
+*	  ֵ: 
+*********************************************************************************************************
+*/
+void tcp_client_tx_pressure( tcp_client_tx_pressure_t *pressure )
+{
+	struct tcp_pcb *pcb;
+	int i;
+	
+	memset( pressure, 0, sizeof( *pressure ) );
+	
+	LOCK_TCPIP_CORE();
+	
+	tcp_client_txbuf_reclaim();
+	
+	for( i = 0; i < TCP_CLIENT_TXBUF_CNT; i++ )
+	{
+		if( tcp_client_txbuf[i].ref == 0 )
+		{
+			pressure->txbuf_free++;
+		}
+	}
+	
+	pcb = ( tcp_client_server_conn != NULL ) ? tcp_client_server_conn->pcb.tcp : NULL;
+	if( pcb != NULL )
+	{
+		pressure->snd_buf      = tcp_sndbuf( pcb );
+		pressure->snd_queuelen = tcp_sndqueuelen( pcb );
+		pressure->snd_wnd      = pcb->snd_wnd;
+		pressure->unacked      = pcb->snd_lbb - pcb->lastack;
+	}
+	
+	UNLOCK_TCPIP_CORE();
+	
+	/*  netconn Ŀджһ */
+	pressure->throttle = ( pcb == NULL ) ||
+	                     ( pressure->snd_buf <= TCP_SNDLOWAT ) ||
+	                     ( pressure->snd_queuelen >= TCP_SNDQUEUELOWAT ) ||
+	                     ( pressure->txbuf_free == 0 );
 }
 
 #endif /* LWIP_NETCONN */
@@ -17,10 +17,51 @@
 #define  __TCP_CLIENT_H__
 
 #include "lwip/opt.h"
+#include "lwip/api.h"
+#include "netbuf_iov.h"
+#include "frame_codec.h"
+
+/* 1: ݰ֡ (frame_codec.h) ,  received_server_frame_process();
+   0: ֽ received_server_data_process_iov() */
+#ifndef TCP_CLIENT_FRAMING
+#define TCP_CLIENT_FRAMING     1
+#endif
+
+/* send_server_frame() һ netconn дƬ (֡ͷ + غ pbuf) */
+#ifndef TCP_CLIENT_FRAME_VEC
+#define TCP_CLIENT_FRAME_VEC   8
+#endif
+
+/* NOCOPY ͻʹС */
+#ifndef TCP_CLIENT_TXBUF_CNT
+#define TCP_CLIENT_TXBUF_CNT   8
+#endif
+#ifndef TCP_CLIENT_TXBUF_SIZE
+#define TCP_CLIENT_TXBUF_SIZE  TCP_MSS
+#endif
+
+/* ѹ,  tcp_client_tx_pressure() ѯ */
+typedef struct
+{
+	u32_t snd_buf;       /* lwIP ͻʣֽ */
+	u16_t snd_queuelen;  /* Ͷе pbuf  */
+	u32_t snd_wnd;       /* Զ˽մ */
+	u32_t unacked;       /* Ŷӵδ ACK ֽ */
+	u16_t txbuf_free;    /*  NOCOPY  */
+	u8_t  throttle;      /* 1: Ӧͣ */
+} tcp_client_tx_pressure_t;
 	
-void tcp_client_conn_server_task( void );
+void tcp_client_init( void );
 
 int send_server_data( uint8_t *data, uint16_t len );
+int send_server_data_nocopy( uint8_t *data, uint16_t len );
+int send_server_records( struct netvector *vectors, uint16_t cnt );
+int send_server_frame( u8_t type, const struct pbuf *p, u16_t off, u16_t len );
+uint8_t *tcp_client_txbuf_alloc( uint32_t timeout );
+void tcp_client_txbuf_free( uint8_t *data );
+void tcp_client_tx_pressure( tcp_client_tx_pressure_t *pressure );
 int received_server_data_process( uint8_t *data, uint16_t len );
+int received_server_data_process_iov( const struct netbuf_iov *iov, int iovcnt );
+int received_server_frame_process( const struct frame_msg *msg );
 
 #endif
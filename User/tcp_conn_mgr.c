@@ -0,0 +1,608 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : tcp_conn_mgr
+*	文件名称 : tcp_conn_mgr.c
+*	版    本 : V1.0
+*	说    明 : 一个任务管理多个 TCP 客户端连接. netconn 设为非阻塞, 事件回调在 tcpip 线程中记录事件
+*              并唤醒管理任务, 管理任务按连接状态机完成连接, 接收, 断线重连 (指数退避).
+*              网线插上时由 eth_link_callback() 通知立即重连.
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月25日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "tcp_conn_mgr.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "tcp_conn_mgr_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#if LWIP_NETCONN
+
+#include "lwip/sys.h"
+#include "lwip/tcp.h"
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "tcp_profile.h"
+#include "net_boot.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* 回调记录的事件, 由管理任务处理 */
+#define TCP_CONN_EVT_RECV     0x01
+#define TCP_CONN_EVT_SEND     0x02
+#define TCP_CONN_EVT_ERR      0x04
+
+typedef struct
+{
+	ip_addr_t         ip;
+	u16_t             port;
+	struct netconn   *conn;
+	tcp_conn_state_t  state;
+	tcp_conn_cb_t     cb;
+	void             *arg;
+	volatile u8_t     events;
+	u32_t             timer;     /* IDLE: 下次连接的时刻, CONNECTING: 开始连接的时刻, ms */
+	u8_t              rtt_pending;
+	u32_t             rtt_seq;   /* 对端 ACK 到此序号时 RTT 采样结束 */
+	u32_t             rtt_start;
+	tcp_conn_stats_t  stats;
+} tcp_conn_t;
+
+static tcp_conn_t        tcp_conn_tab[TCP_CONN_MGR_MAX];
+static int               tcp_conn_cnt;
+static TaskHandle_t      tcp_conn_mgr_task = NULL;
+static SemaphoreHandle_t tcp_conn_mgr_mutex = NULL;  /* 保护 conn 指针, 发送与删除互斥 */
+static volatile u8_t     tcp_conn_mgr_link_kick;     /* 网线插上, 立即重连 */
+
+/* 在 tcpip 线程中通过 netconn 找到连接 */
+static tcp_conn_t *tcp_conn_find( struct netconn *conn )
+{
+	int i;
+
+	for( i = 0; i < tcp_conn_cnt; i++ )
+	{
+		if( tcp_conn_tab[i].conn == conn )
+		{
+			return &tcp_conn_tab[i];
+		}
+	}
+	return NULL;
+}
+
+/* 对端 ACK 到采样序号时结束 RTT 采样. 调用者持有内核锁 */
+static void tcp_conn_rtt_check( tcp_conn_t *c )
+{
+	struct tcp_pcb *pcb = ( c->conn != NULL ) ? c->conn->pcb.tcp : NULL;
+	u32_t rtt;
+
+	if( !c->rtt_pending || pcb == NULL || (s32_t)( pcb->lastack - c->rtt_seq ) < 0 )
+	{
+		return;
+	}
+
+	rtt = sys_now() - c->rtt_start;
+	c->rtt_pending = 0;
+
+	c->stats.rtt_last = rtt;
+	if( c->stats.rtt_avg == 0 )
+	{
+		c->stats.rtt_avg = rtt;
+		c->stats.rtt_min = rtt;
+	}
+	else
+	{
+		c->stats.rtt_avg = ( c->stats.rtt_avg * 7 + rtt ) / 8;
+	}
+	if( rtt < c->stats.rtt_min )
+	{
+		c->stats.rtt_min = rtt;
+	}
+	if( rtt > c->stats.rtt_max )
+	{
+		c->stats.rtt_max = rtt;
+	}
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_conn_netconn_event
+*	功能说明: netconn 事件回调, 在 tcpip 线程中(持有内核锁)执行. 只记录事件并唤醒管理任务,
+*             对端 ACK 时顺带完成 RTT 采样并调用连接的 sent 回调.
+*********************************************************************************************************
+*/
+static void tcp_conn_netconn_event( struct netconn *conn, enum netconn_evt evt, u16_t len )
+{
+	tcp_conn_t *c = tcp_conn_find( conn );
+
+	LWIP_UNUSED_ARG(len);
+
+	if( c == NULL )
+	{
+		return;
+	}
+
+	switch( evt )
+	{
+		case NETCONN_EVT_RCVPLUS:
+			c->events |= TCP_CONN_EVT_RECV;
+			break;
+
+		case NETCONN_EVT_SENDPLUS:
+			c->events |= TCP_CONN_EVT_SEND;
+			tcp_conn_rtt_check( c );
+			if( c->state == TCP_CONN_CONNECTED && c->cb.sent != NULL )
+			{
+				c->cb.sent( (int)( c - tcp_conn_tab ), c->arg );
+			}
+			break;
+
+		case NETCONN_EVT_ERROR:
+			c->events |= TCP_CONN_EVT_ERR;
+			break;
+
+		default:
+			return;
+	}
+
+	if( tcp_conn_mgr_task != NULL )
+	{
+		xTaskNotifyGive( tcp_conn_mgr_task );
+	}
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_conn_mgr_add
+*	功能说明: 登记一个要保持连接的服务器, 由 tcp_conn_mgr_run() 负责连接和重连. 在 tcp_conn_mgr_run()
+*             之前调用.
+*	形    参: ip   服务器 IP 地址, 如 "192.168.0.22"
+*             port 服务器端口
+*             cb   连接回调, 内容被复制
+*             arg  回调参数
+*	返 回 值: 连接编号, 负数为 err_t 错误码
+*********************************************************************************************************
+*/
+int tcp_conn_mgr_add( const char *ip, u16_t port, const tcp_conn_cb_t *cb, void *arg )
+{
+	tcp_conn_t *c;
+
+	if( tcp_conn_cnt >= TCP_CONN_MGR_MAX )
+	{
+		return ERR_MEM;
+	}
+
+	c = &tcp_conn_tab[tcp_conn_cnt];
+	memset( c, 0, sizeof( *c ) );
+
+	if( !ipaddr_aton( ip, &c->ip ) )
+	{
+		return ERR_ARG;
+	}
+
+	c->port = port;
+	c->cb   = *cb;
+	c->arg  = arg;
+	c->state = TCP_CONN_IDLE;
+	c->stats.backoff = TCP_CONN_MGR_BACKOFF_MIN;
+	c->timer = sys_now();
+
+	return tcp_conn_cnt++;
+}
+
+/* 开始非阻塞连接 */
+static void tcp_conn_start( tcp_conn_t *c, int id )
+{
+	struct netconn *conn;
+	err_t err;
+
+	log_i("conn %d connecting %s:%d......", id, ipaddr_ntoa(&c->ip), c->port );
+
+	conn = netconn_new_with_callback( NETCONN_TCP, tcp_conn_netconn_event );
+	if( conn == NULL )
+	{
+		err = ERR_MEM;
+	}
+	else
+	{
+		netconn_set_nonblocking( conn, 1 );
+
+		//打开TCP 的保活功能 （客户端不默认打开），2018年12月6日10:00:41，SuoZhang
+		conn->pcb.tcp->so_options |= SOF_KEEPALIVE;
+
+		//控制连接: 小窗口和发送缓冲, 大窗口只留给 TCP_PROFILE_BULK 的大块数据连接
+		tcp_profile_control( conn->pcb.tcp );
+
+		c->events = 0;
+		c->rtt_pending = 0;
+		c->conn  = conn;
+		c->state = TCP_CONN_CONNECTING;
+		c->timer = sys_now();
+
+		err = netconn_connect( conn, &c->ip, c->port );
+		if( err == ERR_INPROGRESS || err == ERR_OK )
+		{
+			return;   /* 结果由 SENDPLUS / ERROR 事件通知 */
+		}
+
+		xSemaphoreTake( tcp_conn_mgr_mutex, portMAX_DELAY );
+		c->conn = NULL;
+		xSemaphoreGive( tcp_conn_mgr_mutex );
+		netconn_delete( conn );
+	}
+
+	log_e("err:conn %d connect %s:%d fail,err:%d.", id, ipaddr_ntoa(&c->ip), c->port, err );
+	c->stats.failures++;
+	c->stats.last_err = err;
+	c->state = TCP_CONN_IDLE;
+	c->timer = sys_now() + c->stats.backoff;
+	c->stats.backoff = LWIP_MIN( c->stats.backoff * 2, TCP_CONN_MGR_BACKOFF_MAX );
+}
+
+/* 关闭连接, 退避后重连 */
+static void tcp_conn_drop( tcp_conn_t *c, int id, err_t err )
+{
+	struct netconn *conn = c->conn;
+	tcp_conn_state_t state = c->state;
+
+	xSemaphoreTake( tcp_conn_mgr_mutex, portMAX_DELAY );
+	c->conn = NULL;
+	c->state = TCP_CONN_IDLE;
+	xSemaphoreGive( tcp_conn_mgr_mutex );
+
+	c->stats.last_err = err;
+	c->timer = sys_now() + c->stats.backoff;
+
+	if( state == TCP_CONN_CONNECTED )
+	{
+		log_e("err:conn %d %s:%d closed,err:%d.", id, ipaddr_ntoa(&c->ip), c->port, err );
+		c->stats.disconnects++;
+		if( c->cb.disconnected != NULL )
+		{
+			c->cb.disconnected( id, c->arg, err );
+		}
+	}
+	else
+	{
+		log_e("err:conn %d connect %s:%d fail,err:%d.", id, ipaddr_ntoa(&c->ip), c->port, err );
+		c->stats.failures++;
+	}
+
+	/* 回调之后才删除, 应用在回调中清除自己保存的 netconn 指针 */
+	if( conn != NULL )
+	{
+		netconn_delete( conn );
+	}
+
+	c->stats.backoff = LWIP_MIN( c->stats.backoff * 2, TCP_CONN_MGR_BACKOFF_MAX );
+}
+
+/* 取出所有已到达的数据交给应用. 返回 ERR_OK 或连接错误 */
+static err_t tcp_conn_recv( tcp_conn_t *c, int id )
+{
+	struct netbuf *buf;
+	struct netbuf_iov iov[NETBUF_IOV_MAX];
+	struct pbuf *p;
+	int iovcnt;
+	err_t err;
+
+	while( ( err = netconn_recv( c->conn, &buf ) ) == ERR_OK )
+	{
+		c->stats.rx_bytes += netbuf_len( buf );
+
+		if( c->cb.recv_pbuf != NULL )
+		{
+			/* pbuf 链从 netbuf 中取出交给应用, 只释放 netbuf 本身 */
+			p = buf->p;
+			buf->p = buf->ptr = NULL;
+			netbuf_delete( buf );
+			c->cb.recv_pbuf( id, c->arg, p );
+			continue;
+		}
+
+		//把netbuf 的所有片段(pbuf 链)以片段表的形式交给应用，不拷贝
+		while( ( iovcnt = netbuf_iov_fill( buf, iov, NETBUF_IOV_MAX, NULL ) ) > 0 )
+		{
+			if( c->cb.recv != NULL )
+			{
+				c->cb.recv( id, c->arg, iov, iovcnt );
+			}
+		}
+		netbuf_delete( buf );
+	}
+
+	return ( err == ERR_WOULDBLOCK ) ? ERR_OK : err;
+}
+
+/* 处理一个连接的事件和定时 */
+static void tcp_conn_poll( tcp_conn_t *c, int id, u32_t now, u8_t link_up )
+{
+	u8_t events;
+	err_t err;
+
+	SYS_ARCH_DECL_PROTECT(lev);
+	SYS_ARCH_PROTECT(lev);
+	events = c->events;
+	c->events = 0;
+	SYS_ARCH_UNPROTECT(lev);
+
+	switch( c->state )
+	{
+		case TCP_CONN_IDLE:
+			if( link_up && (s32_t)( now - c->timer ) >= 0 )
+			{
+				tcp_conn_start( c, id );
+			}
+			break;
+
+		case TCP_CONN_CONNECTING:
+			if( events & ( TCP_CONN_EVT_ERR | TCP_CONN_EVT_SEND ) )
+			{
+				/* 连接完成或失败都会发出 SENDPLUS, 以 pcb 状态区分 */
+				LOCK_TCPIP_CORE();
+				err = ( c->conn->pcb.tcp != NULL && c->conn->pcb.tcp->state == ESTABLISHED ) ? ERR_OK : netconn_err( c->conn );
+				UNLOCK_TCPIP_CORE();
+
+				if( err == ERR_OK )
+				{
+					log_i("conn %d %s:%d connected sucess.", id, ipaddr_ntoa(&c->ip), c->port );
+					c->state = TCP_CONN_CONNECTED;
+					c->stats.connects++;
+					c->stats.backoff = TCP_CONN_MGR_BACKOFF_MIN;
+					net_boot_tcp_connected();	/* 启动后的第一次连接记录到备份 SRAM */
+					if( c->cb.connected != NULL )
+					{
+						c->cb.connected( id, c->arg );
+					}
+					/* 连接建立前就到达的数据 */
+					events |= TCP_CONN_EVT_RECV;
+				}
+				else
+				{
+					tcp_conn_drop( c, id, err != ERR_OK ? err : ERR_CONN );
+					break;
+				}
+			}
+			else if( now - c->timer >= TCP_CONN_MGR_CONNECT_TIMEOUT )
+			{
+				tcp_conn_drop( c, id, ERR_TIMEOUT );
+				break;
+			}
+			else
+			{
+				break;
+			}
+			/* 已连接, 继续处理接收 */
+
+		case TCP_CONN_CONNECTED:
+			if( events & ( TCP_CONN_EVT_RECV | TCP_CONN_EVT_ERR ) )
+			{
+				err = tcp_conn_recv( c, id );
+				if( err == ERR_OK && ( events & TCP_CONN_EVT_ERR ) )
+				{
+					err = netconn_err( c->conn );
+				}
+				if( err != ERR_OK )
+				{
+					tcp_conn_drop( c, id, err );
+					break;
+				}
+			}
+			/* 可写事件不够及时时 (低于低水位不通知), 这里补做 RTT 检查 */
+			LOCK_TCPIP_CORE();
+			tcp_conn_rtt_check( c );
+			UNLOCK_TCPIP_CORE();
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_conn_mgr_run
+*	功能说明: 连接管理任务主循环, 在 tcpip_init() 和 tcp_conn_mgr_add() 之后由调用任务执行, 不返回.
+*	形    参: 无
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void tcp_conn_mgr_run( void )
+{
+	u32_t now;
+	u8_t link_up;
+	int i;
+
+	tcp_conn_mgr_mutex = xSemaphoreCreateMutex();
+	if( NULL == tcp_conn_mgr_mutex )
+	{
+		log_e("err:tcp_conn_mgr_mutex == NULL,while(1).");
+		while(1);
+	}
+
+	tcp_conn_mgr_task = xTaskGetCurrentTaskHandle();
+
+	for( ;; )
+	{
+		ulTaskNotifyTake( pdTRUE, pdMS_TO_TICKS( TCP_CONN_MGR_TICK ) );
+
+		now = sys_now();
+		link_up = ( netif_default != NULL ) && netif_is_link_up( netif_default );
+
+		if( tcp_conn_mgr_link_kick )
+		{
+			tcp_conn_mgr_link_kick = 0;
+
+			/* 网线刚插上, 等待重连的连接不再退避 */
+			for( i = 0; i < tcp_conn_cnt; i++ )
+			{
+				tcp_conn_tab[i].stats.backoff = TCP_CONN_MGR_BACKOFF_MIN;
+				if( tcp_conn_tab[i].state == TCP_CONN_IDLE )
+				{
+					tcp_conn_tab[i].timer = now;
+				}
+			}
+		}
+
+		for( i = 0; i < tcp_conn_cnt; i++ )
+		{
+			tcp_conn_poll( &tcp_conn_tab[i], i, now, link_up );
+		}
+	}
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_conn_mgr_link_changed
+*	功能说明: 网线状态变化通知, 在 eth_link_callback() 中调用. 网线插上时立即重连所有断开的连接.
+*	形    参: link_up 1 网线插上, 0 网线断开
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void tcp_conn_mgr_link_changed( u8_t link_up )
+{
+	if( link_up )
+	{
+		tcp_conn_mgr_link_kick = 1;
+		if( tcp_conn_mgr_task != NULL )
+		{
+			xTaskNotifyGive( tcp_conn_mgr_task );
+		}
+	}
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_conn_mgr_send
+*	功能说明: 向连接发送数据, 数据被拷贝进 lwIP 发送缓冲区, 不阻塞. 可在任意任务中调用.
+*	形    参: id   连接编号
+*             data 数据
+*             len  长度
+*	返 回 值: 已放入发送队列的字节数, 发送队列满时小于 len; 负数为 err_t 错误码
+*********************************************************************************************************
+*/
+int tcp_conn_mgr_send( int id, const void *data, u16_t len )
+{
+	tcp_conn_t *c;
+	struct tcp_pcb *pcb;
+	size_t written = 0;
+	err_t err;
+
+	if( id < 0 || id >= tcp_conn_cnt || tcp_conn_mgr_mutex == NULL )
+	{
+		return ERR_ARG;
+	}
+	c = &tcp_conn_tab[id];
+
+	xSemaphoreTake( tcp_conn_mgr_mutex, portMAX_DELAY );
+
+	if( c->state != TCP_CONN_CONNECTED || c->conn == NULL )
+	{
+		xSemaphoreGive( tcp_conn_mgr_mutex );
+		return ERR_CONN;
+	}
+
+	err = netconn_write_partly( c->conn, data, len, NETCONN_COPY | NETCONN_DONTBLOCK, &written );
+
+	if( written > 0 )
+	{
+		LOCK_TCPIP_CORE();
+		c->stats.tx_bytes += written;
+
+		/* 数据已全部发出时开始 RTT 采样, 还有数据排队等窗口时不采样, 避免把排队时间算进去 */
+		pcb = c->conn->pcb.tcp;
+		if( !c->rtt_pending && pcb != NULL && pcb->unsent == NULL )
+		{
+			c->rtt_pending = 1;
+			c->rtt_seq   = pcb->snd_nxt;
+			c->rtt_start = sys_now();
+		}
+		UNLOCK_TCPIP_CORE();
+	}
+
+	xSemaphoreGive( tcp_conn_mgr_mutex );
+
+	if( err != ERR_OK && err != ERR_WOULDBLOCK )
+	{
+		return err;
+	}
+
+	return (int)written;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_conn_mgr_netconn
+*	功能说明: 取得已连接的 netconn, 用于零拷贝发送等需要直接操作 netconn 的场合.
+*             在 tcpip 线程中 (sent 回调) 调用是安全的, 其他任务中调用时连接可能随时被管理任务关闭.
+*	形    参: id 连接编号
+*	返 回 值: netconn, 未连接时为 NULL
+*********************************************************************************************************
+*/
+struct netconn *tcp_conn_mgr_netconn( int id )
+{
+	if( id < 0 || id >= tcp_conn_cnt || tcp_conn_tab[id].state != TCP_CONN_CONNECTED )
+	{
+		return NULL;
+	}
+	return tcp_conn_tab[id].conn;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_conn_mgr_get_stats
+*	功能说明: 读取连接统计, 包括 RTT 和已发出未确认的字节数
+*	形    参: id    连接编号
+*             stats 输出
+*	返 回 值: 0 成功, 负数为 err_t 错误码
+*********************************************************************************************************
+*/
+int tcp_conn_mgr_get_stats( int id, tcp_conn_stats_t *stats )
+{
+	tcp_conn_t *c;
+	struct tcp_pcb *pcb;
+
+	if( id < 0 || id >= tcp_conn_cnt )
+	{
+		return ERR_ARG;
+	}
+	c = &tcp_conn_tab[id];
+
+	LOCK_TCPIP_CORE();
+
+	*stats = c->stats;
+	stats->state = c->state;
+	stats->inflight = 0;
+	stats->queued = 0;
+
+	pcb = ( c->state == TCP_CONN_CONNECTED && c->conn != NULL ) ? c->conn->pcb.tcp : NULL;
+	if( pcb != NULL )
+	{
+		stats->inflight = pcb->snd_nxt - pcb->lastack;
+		stats->queued   = pcb->snd_lbb - pcb->snd_nxt;
+	}
+
+	UNLOCK_TCPIP_CORE();
+
+	return ERR_OK;
+}
+
+#endif /* LWIP_NETCONN */
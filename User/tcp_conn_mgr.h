@@ -0,0 +1,91 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : tcp_conn_mgr
+*	文件名称 : tcp_conn_mgr.h
+*	版    本 : V1.0
+*	说    明 : 单任务管理多个 TCP 客户端连接 (netconn 回调 + 非阻塞 netconn)
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月25日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __TCP_CONN_MGR_H__
+#define  __TCP_CONN_MGR_H__
+
+#include "lwip/opt.h"
+#include "lwip/api.h"
+#include "netbuf_iov.h"
+
+/* 最多管理的连接数, lwipopts.h 中 MEMP_NUM_NETCONN / MEMP_NUM_TCP_PCB 要留出余量 */
+#ifndef TCP_CONN_MGR_MAX
+#define TCP_CONN_MGR_MAX              8
+#endif
+
+/* 管理任务的周期, 单位 ms: 重连定时, 连接超时, RTT 采样 */
+#ifndef TCP_CONN_MGR_TICK
+#define TCP_CONN_MGR_TICK             50
+#endif
+
+/* 重连退避: 从 MIN 开始每次失败加倍, 最大 MAX, 单位 ms */
+#ifndef TCP_CONN_MGR_BACKOFF_MIN
+#define TCP_CONN_MGR_BACKOFF_MIN      500
+#endif
+#ifndef TCP_CONN_MGR_BACKOFF_MAX
+#define TCP_CONN_MGR_BACKOFF_MAX      30000
+#endif
+
+/* 建立连接超时, 单位 ms */
+#ifndef TCP_CONN_MGR_CONNECT_TIMEOUT
+#define TCP_CONN_MGR_CONNECT_TIMEOUT  5000
+#endif
+
+typedef enum
+{
+	TCP_CONN_IDLE = 0,      /* 等待重连时间到 */
+	TCP_CONN_CONNECTING,    /* 非阻塞连接进行中 */
+	TCP_CONN_CONNECTED,
+} tcp_conn_state_t;
+
+/* 连接回调, 除 sent 外都在管理任务中执行 */
+typedef struct
+{
+	void (*connected)( int id, void *arg );
+	void (*disconnected)( int id, void *arg, err_t err );
+	void (*recv)( int id, void *arg, const struct netbuf_iov *iov, int iovcnt );
+	/* 对端 ACK 释放了发送缓冲区, 在 tcpip 线程中执行 (持有内核锁), 可以为 NULL */
+	void (*sent)( int id, void *arg );
+	/* 不为 NULL 时代替 recv: 收到的 pbuf 链整个交给应用 (例如 frame_dec_feed()), 由应用释放 */
+	void (*recv_pbuf)( int id, void *arg, struct pbuf *p );
+} tcp_conn_cb_t;
+
+/* 单个连接的统计 */
+typedef struct
+{
+	tcp_conn_state_t state;
+	u32_t connects;         /* 连接成功次数 */
+	u32_t failures;         /* 连接失败次数 */
+	u32_t disconnects;      /* 已建立的连接断开次数 */
+	u32_t rx_bytes;
+	u32_t tx_bytes;
+	u32_t backoff;          /* 当前重连退避, ms */
+	u32_t rtt_last;         /* 最近一次 RTT 采样, ms */
+	u32_t rtt_avg;          /* 平滑 RTT (1/8 权重), ms */
+	u32_t rtt_min;
+	u32_t rtt_max;
+	u32_t inflight;         /* 已发出未被 ACK 的字节 */
+	u32_t queued;           /* 在发送缓冲区中还没有发出的字节 */
+	err_t last_err;
+} tcp_conn_stats_t;
+
+int  tcp_conn_mgr_add( const char *ip, u16_t port, const tcp_conn_cb_t *cb, void *arg );
+void tcp_conn_mgr_run( void );
+int  tcp_conn_mgr_send( int id, const void *data, u16_t len );
+struct netconn *tcp_conn_mgr_netconn( int id );
+void tcp_conn_mgr_link_changed( u8_t link_up );
+int  tcp_conn_mgr_get_stats( int id, tcp_conn_stats_t *stats );
+
+#endif
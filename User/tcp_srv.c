@@ -0,0 +1,825 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : tcp_srv
+*	文件名称 : tcp_srv.c
+*	版    本 : V1.0
+*	说    明 : Multi-client TCP server engine on the raw tcp_* API. Everything runs in the tcpip
+*              thread, a client costs a tcp_pcb and one slot of the client pool instead of a netconn
+*              and a task with its stack, so TCP_SRV_MAX_CLIENTS (16..32) HMI/SCADA clients fit.
+*
+*              Client states: ACTIVE receives and sends; DRAINING (closed by the application, by
+*              the client's FIN or by the idle timeout) writes out its TX buffer, then closes;
+*              CLOSING retries a tcp_close() that failed for memory from the poll callback.
+*
+*              RX: the received pbufs are copied into the client's RX buffer and freed at once, the
+*              receive buffers go back to the Ethernet driver. The window is opened by the bytes
+*              the application consumed; while its buffer is full the rest stays in the pbufs.
+*              TX: tcp_srv_send() only copies into the client's TX ring. One transmit pass (a
+*              sys_timeout of 0 ms, so that all the sends of a callback are batched) gives every
+*              client with data a turn of TCP_SRV_TX_QUANTUM bytes, round after round until the
+*              send buffers or the lwIP heap are full; the first client moves by one each pass.
+*              Admission: a client is refused (reset) when the pool or the listener is full or
+*              when its address already has TCP_SRV_MAX_PER_IP clients.
+*
+*              All the functions run in the tcpip thread (callbacks) or with the core locked.
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年05月05日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "tcp_srv.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "tcp_srv_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#include "lwip/tcp.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include <string.h>
+
+#if MEMP_NUM_TCP_PCB < TCP_SRV_MAX_CLIENTS
+#error "MEMP_NUM_TCP_PCB is below TCP_SRV_MAX_CLIENTS, see lwipopts.h"
+#endif
+
+#if TCP_SRV_MAX_CLIENTS > 255
+#error "TCP_SRV_MAX_CLIENTS too big, a client id holds the slot in 8 bits"
+#endif
+
+/* tcp_poll() interval, 500 ms units: idle check, close retry */
+#define TCP_SRV_POLL_INTERVAL         2
+
+typedef enum
+{
+  TCP_SRV_FREE = 0,
+  TCP_SRV_ACTIVE,
+  TCP_SRV_DRAINING,
+  TCP_SRV_CLOSING,
+} tcp_srv_state_t;
+
+typedef struct
+{
+  struct tcp_pcb *pcb;            /* NULL: free */
+  tcp_srv_cb_t    cb;
+  void           *arg;
+  u8_t            max_clients;
+  u8_t            clients;
+} tcp_srv_listener_t;
+
+typedef struct
+{
+  struct tcp_pcb     *pcb;
+  tcp_srv_listener_t *lsn;
+  struct pbuf        *rx_hold;    /* received, RX buffer full */
+  u32_t               last_ms;    /* last traffic */
+  u16_t               rx_len;
+  u16_t               tx_head;    /* first byte not written yet */
+  u16_t               tx_len;
+  err_t               reason;     /* passed to 'closed' */
+  u8_t                state;      /* tcp_srv_state_t */
+  u8_t                gen;        /* incremented when the slot is freed */
+  u8_t                tx_out;     /* written in this pass, tcp_output() due */
+} tcp_srv_client_t;
+
+static tcp_srv_listener_t tcp_srv_lsn[TCP_SRV_MAX_LISTEN];
+static tcp_srv_client_t   tcp_srv_client[TCP_SRV_MAX_CLIENTS];
+static u8_t tcp_srv_rx_buf[TCP_SRV_MAX_CLIENTS][TCP_SRV_RX_SIZE] __attribute__((section(TCP_SRV_BUF_SECTION)));
+static u8_t tcp_srv_tx_buf[TCP_SRV_MAX_CLIENTS][TCP_SRV_TX_SIZE] __attribute__((section(TCP_SRV_BUF_SECTION)));
+
+static struct tcp_srv_stats tcp_srv_stats;
+static u8_t tcp_srv_tx_scheduled;
+static u8_t tcp_srv_rr;                   /* client served first in the next pass */
+
+static void  tcp_srv_tx_run( void *arg );
+static err_t tcp_srv_recv_cb( void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err );
+static err_t tcp_srv_sent_cb( void *arg, struct tcp_pcb *pcb, u16_t len );
+static void  tcp_srv_err_cb( void *arg, err_t err );
+static err_t tcp_srv_poll_cb( void *arg, struct tcp_pcb *pcb );
+
+static int tcp_srv_slot( const tcp_srv_client_t *c )
+{
+  return (int)( c - tcp_srv_client );
+}
+
+static int tcp_srv_id( const tcp_srv_client_t *c )
+{
+  return ( (int)c->gen << 8 ) | tcp_srv_slot( c );
+}
+
+/* the client of an id, NULL when the slot was freed since */
+static tcp_srv_client_t *tcp_srv_get( int id )
+{
+  tcp_srv_client_t *c;
+
+  if( id < 0 || ( id & 0xFF ) >= TCP_SRV_MAX_CLIENTS )
+  {
+    return NULL;
+  }
+  c = &tcp_srv_client[id & 0xFF];
+  if( c->state == TCP_SRV_FREE || c->gen != (u8_t)( id >> 8 ) )
+  {
+    return NULL;
+  }
+  return c;
+}
+
+static void tcp_srv_tx_schedule( void )
+{
+  if( !tcp_srv_tx_scheduled )
+  {
+    tcp_srv_tx_scheduled = 1;
+    sys_timeout( 0, tcp_srv_tx_run, NULL );
+  }
+}
+
+static void tcp_srv_detach( struct tcp_pcb *pcb )
+{
+  tcp_arg( pcb, NULL );
+  tcp_recv( pcb, NULL );
+  tcp_sent( pcb, NULL );
+  tcp_err( pcb, NULL );
+  tcp_poll( pcb, NULL, 0 );
+}
+
+static void tcp_srv_attach( tcp_srv_client_t *c )
+{
+  tcp_arg( c->pcb, c );
+  tcp_recv( c->pcb, tcp_srv_recv_cb );
+  tcp_sent( c->pcb, tcp_srv_sent_cb );
+  tcp_err( c->pcb, tcp_srv_err_cb );
+  tcp_poll( c->pcb, tcp_srv_poll_cb, TCP_SRV_POLL_INTERVAL );
+}
+
+/* the pcb is gone or closed: free the slot and tell the application */
+static void tcp_srv_release( tcp_srv_client_t *c )
+{
+  tcp_srv_listener_t *lsn = c->lsn;
+  int id = tcp_srv_id( c );
+
+  if( c->rx_hold != NULL )
+  {
+    pbuf_free( c->rx_hold );
+    c->rx_hold = NULL;
+  }
+  c->pcb = NULL;
+  c->state = TCP_SRV_FREE;
+  c->gen++;
+  lsn->clients--;
+  tcp_srv_stats.clients--;
+
+  if( lsn->cb.closed != NULL )
+  {
+    lsn->cb.closed( id, lsn->arg, c->reason );
+  }
+}
+
+static void tcp_srv_abort( tcp_srv_client_t *c, err_t reason )
+{
+  struct tcp_pcb *pcb = c->pcb;
+
+  tcp_srv_detach( pcb );
+  tcp_abort( pcb );
+  c->reason = reason;
+  tcp_srv_stats.aborted++;
+  tcp_srv_release( c );
+}
+
+/* TX buffer written out: FIN after the queued data */
+static void tcp_srv_finish( tcp_srv_client_t *c )
+{
+  struct tcp_pcb *pcb = c->pcb;
+
+  /* tcp_close() may free the pcb at once */
+  tcp_srv_detach( pcb );
+  if( tcp_close( pcb ) != ERR_OK )
+  {
+    /* no memory for the FIN, retried by the poll callback */
+    tcp_srv_attach( c );
+    c->state = TCP_SRV_CLOSING;
+    return;
+  }
+  tcp_srv_release( c );
+}
+
+/* stop receiving, close once the TX buffer is written out (in the transmit pass) */
+static void tcp_srv_shutdown( tcp_srv_client_t *c, err_t reason )
+{
+  if( c->state != TCP_SRV_ACTIVE )
+  {
+    return;
+  }
+  c->state = TCP_SRV_DRAINING;
+  c->reason = reason;
+  if( c->rx_hold != NULL )
+  {
+    tcp_recved( c->pcb, c->rx_hold->tot_len );
+    pbuf_free( c->rx_hold );
+    c->rx_hold = NULL;
+  }
+  tcp_srv_tx_schedule();
+}
+
+/* pass the RX buffer, topped up from the held pbufs, to the application */
+static void tcp_srv_rx_process( tcp_srv_client_t *c )
+{
+  tcp_srv_listener_t *lsn = c->lsn;
+  u8_t *rx = tcp_srv_rx_buf[tcp_srv_slot( c )];
+  u16_t n, used;
+
+  while( c->state == TCP_SRV_ACTIVE )
+  {
+    if( c->rx_hold != NULL && c->rx_len < TCP_SRV_RX_SIZE )
+    {
+      n = LWIP_MIN( TCP_SRV_RX_SIZE - c->rx_len, c->rx_hold->tot_len );
+      pbuf_copy_partial( c->rx_hold, rx + c->rx_len, n, 0 );
+      c->rx_len += n;
+      c->rx_hold = pbuf_free_header( c->rx_hold, n );
+    }
+    if( c->rx_len == 0 )
+    {
+      break;
+    }
+
+    used = lsn->cb.recv( tcp_srv_id( c ), lsn->arg, rx, c->rx_len );
+    if( used > c->rx_len )
+    {
+      used = c->rx_len;
+    }
+    if( used == 0 )
+    {
+      break;
+    }
+    c->rx_len -= used;
+    memmove( rx, rx + used, c->rx_len );
+    if( c->state == TCP_SRV_ACTIVE )
+    {
+      tcp_recved( c->pcb, used );
+    }
+    if( c->rx_hold == NULL )
+    {
+      break;
+    }
+  }
+}
+
+static err_t tcp_srv_recv_cb( void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err )
+{
+  tcp_srv_client_t *c = (tcp_srv_client_t *)arg;
+
+  LWIP_UNUSED_ARG(err);
+
+  if( p == NULL )
+  {
+    /* FIN of the client, the replies queued still go out */
+    if( c != NULL )
+    {
+      tcp_srv_shutdown( c, ERR_OK );
+    }
+    return ERR_OK;
+  }
+
+  if( c == NULL || c->state != TCP_SRV_ACTIVE )
+  {
+    tcp_recved( pcb, p->tot_len );
+    pbuf_free( p );
+    return ERR_OK;
+  }
+
+  c->last_ms = sys_now();
+  tcp_srv_stats.rx_bytes += p->tot_len;
+  if( c->rx_hold == NULL )
+  {
+    c->rx_hold = p;
+  }
+  else
+  {
+    pbuf_cat( c->rx_hold, p );
+  }
+
+  tcp_srv_rx_process( c );
+  if( c->rx_hold != NULL )
+  {
+    tcp_srv_stats.rx_full++;
+  }
+  return ERR_OK;
+}
+
+static err_t tcp_srv_sent_cb( void *arg, struct tcp_pcb *pcb, u16_t len )
+{
+  tcp_srv_client_t *c = (tcp_srv_client_t *)arg;
+
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(len);
+
+  if( c != NULL )
+  {
+    c->last_ms = sys_now();
+    if( c->tx_len > 0 )
+    {
+      tcp_srv_tx_schedule();
+    }
+  }
+  return ERR_OK;
+}
+
+/* the pcb is already freed */
+static void tcp_srv_err_cb( void *arg, err_t err )
+{
+  tcp_srv_client_t *c = (tcp_srv_client_t *)arg;
+
+  if( c == NULL )
+  {
+    return;
+  }
+  c->pcb = NULL;
+  c->reason = err;
+  tcp_srv_stats.aborted++;
+  tcp_srv_release( c );
+}
+
+static err_t tcp_srv_poll_cb( void *arg, struct tcp_pcb *pcb )
+{
+  tcp_srv_client_t *c = (tcp_srv_client_t *)arg;
+
+  if( c == NULL )
+  {
+    tcp_abort( pcb );
+    return ERR_ABRT;
+  }
+
+  if( c->state == TCP_SRV_CLOSING )
+  {
+    tcp_srv_finish( c );
+    return ERR_OK;
+  }
+
+#if TCP_SRV_IDLE_TIMEOUT
+  if( (u32_t)( sys_now() - c->last_ms ) > TCP_SRV_IDLE_TIMEOUT )
+  {
+    tcp_srv_stats.reaped++;
+    if( c->state == TCP_SRV_DRAINING )
+    {
+      /* the client does not take the rest of its data either */
+      tcp_srv_abort( c, ERR_TIMEOUT );
+      return ERR_ABRT;
+    }
+    tcp_srv_shutdown( c, ERR_TIMEOUT );
+  }
+#endif
+
+  if( c->rx_hold != NULL )
+  {
+    tcp_srv_rx_process( c );
+  }
+  if( c->tx_len > 0 || c->state == TCP_SRV_DRAINING )
+  {
+    tcp_srv_tx_schedule();
+  }
+  return ERR_OK;
+}
+
+/* one turn of a client: up to TCP_SRV_TX_QUANTUM bytes within its send buffer.
+   Returns the bytes written, -1 when the lwIP heap is exhausted. */
+static int tcp_srv_tx_client( tcp_srv_client_t *c )
+{
+  u8_t *tx = tcp_srv_tx_buf[tcp_srv_slot( c )];
+  u16_t quantum = TCP_SRV_TX_QUANTUM;
+  u16_t n;
+  int written = 0;
+  err_t err;
+
+  while( quantum > 0 && c->tx_len > 0 )
+  {
+    n = LWIP_MIN( c->tx_len, TCP_SRV_TX_SIZE - c->tx_head );   /* contiguous part of the ring */
+    n = LWIP_MIN( n, quantum );
+    n = LWIP_MIN( n, tcp_sndbuf( c->pcb ) );
+    if( n == 0 || tcp_sndqueuelen( c->pcb ) >= TCP_SND_QUEUELEN )
+    {
+      break;
+    }
+
+    err = tcp_write( c->pcb, tx + c->tx_head, n,
+                     TCP_WRITE_FLAG_COPY | ( c->tx_len > n ? TCP_WRITE_FLAG_MORE : 0 ) );
+    if( err != ERR_OK )
+    {
+      if( err == ERR_MEM )
+      {
+        written = -1;
+      }
+      break;
+    }
+
+    c->tx_head = ( c->tx_head + n ) % TCP_SRV_TX_SIZE;
+    c->tx_len -= n;
+    quantum -= n;
+    written += n;
+    tcp_srv_stats.tx_bytes += n;
+    c->tx_out = 1;
+  }
+
+  return written;
+}
+
+/* sys_timeout handler: round-robin transmit pass over all the clients */
+static void tcp_srv_tx_run( void *arg )
+{
+  tcp_srv_listener_t *lsn;
+  tcp_srv_client_t *c;
+  int i, k, progress, ret, stall = 0;
+
+  LWIP_UNUSED_ARG(arg);
+
+  tcp_srv_tx_scheduled = 0;
+  tcp_srv_stats.tx_rounds++;
+
+  do
+  {
+    progress = 0;
+    for( k = 0; k < TCP_SRV_MAX_CLIENTS && !stall; k++ )
+    {
+      c = &tcp_srv_client[( tcp_srv_rr + k ) % TCP_SRV_MAX_CLIENTS];
+      if( ( c->state != TCP_SRV_ACTIVE && c->state != TCP_SRV_DRAINING ) || c->tx_len == 0 )
+      {
+        continue;
+      }
+      ret = tcp_srv_tx_client( c );
+      if( ret < 0 )
+      {
+        stall = 1;
+      }
+      else if( ret > 0 )
+      {
+        progress = 1;
+      }
+    }
+  }
+  while( progress && !stall );
+
+  tcp_srv_rr = (u8_t)( ( tcp_srv_rr + 1 ) % TCP_SRV_MAX_CLIENTS );
+  if( stall )
+  {
+    tcp_srv_stats.tx_mem_stall++;
+  }
+
+  for( i = 0; i < TCP_SRV_MAX_CLIENTS; i++ )
+  {
+    c = &tcp_srv_client[i];
+    if( c->state != TCP_SRV_ACTIVE && c->state != TCP_SRV_DRAINING )
+    {
+      continue;
+    }
+    lsn = c->lsn;
+
+    if( c->tx_out )
+    {
+      c->tx_out = 0;
+      c->last_ms = sys_now();
+      tcp_output( c->pcb );
+      if( c->state == TCP_SRV_ACTIVE )
+      {
+        /* space for the application, and for requests held for it */
+        if( lsn->cb.sent != NULL )
+        {
+          lsn->cb.sent( tcp_srv_id( c ), lsn->arg, TCP_SRV_TX_SIZE - c->tx_len );
+        }
+        if( c->rx_hold != NULL )
+        {
+          tcp_srv_rx_process( c );
+        }
+      }
+    }
+
+    if( c->state == TCP_SRV_DRAINING && c->tx_len == 0 )
+    {
+      tcp_srv_finish( c );
+    }
+  }
+}
+
+static err_t tcp_srv_accept_cb( void *arg, struct tcp_pcb *newpcb, err_t err )
+{
+  tcp_srv_listener_t *lsn = (tcp_srv_listener_t *)arg;
+  tcp_srv_client_t *c = NULL;
+  int i, same_ip = 0;
+
+  if( err != ERR_OK || newpcb == NULL || lsn == NULL )
+  {
+    return ERR_VAL;
+  }
+
+  for( i = 0; i < TCP_SRV_MAX_CLIENTS; i++ )
+  {
+    if( tcp_srv_client[i].state == TCP_SRV_FREE )
+    {
+      if( c == NULL )
+      {
+        c = &tcp_srv_client[i];
+      }
+    }
+    else if( ip_addr_cmp( &tcp_srv_client[i].pcb->remote_ip, &newpcb->remote_ip ) )
+    {
+      same_ip++;
+    }
+  }
+
+  if( c == NULL || lsn->clients >= lsn->max_clients )
+  {
+    tcp_srv_stats.rejected_full++;
+    tcp_abort( newpcb );
+    return ERR_ABRT;
+  }
+  if( TCP_SRV_MAX_PER_IP && same_ip >= TCP_SRV_MAX_PER_IP )
+  {
+    tcp_srv_stats.rejected_ip++;
+    tcp_abort( newpcb );
+    return ERR_ABRT;
+  }
+
+  c->pcb     = newpcb;
+  c->lsn     = lsn;
+  c->rx_hold = NULL;
+  c->last_ms = sys_now();
+  c->rx_len  = 0;
+  c->tx_head = 0;
+  c->tx_len  = 0;
+  c->reason  = ERR_OK;
+  c->tx_out  = 0;
+  c->state   = TCP_SRV_ACTIVE;
+
+  lsn->clients++;
+  tcp_srv_stats.accepted++;
+  tcp_srv_stats.clients++;
+  if( tcp_srv_stats.clients > tcp_srv_stats.clients_max )
+  {
+    tcp_srv_stats.clients_max = tcp_srv_stats.clients;
+  }
+
+  tcp_srv_attach( c );
+#if TCP_SRV_NODELAY
+  tcp_nagle_disable( newpcb );
+#endif
+
+  if( lsn->cb.accepted != NULL && lsn->cb.accepted( tcp_srv_id( c ), lsn->arg ) != ERR_OK )
+  {
+    tcp_srv_abort( c, ERR_ABRT );
+    return ERR_ABRT;
+  }
+  return ERR_OK;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_srv_listen
+*	功能说明: 在一个端口上开始服务, 可以在任意任务中调用
+*	形    参: port        端口
+*             max_clients 这个端口最多同时服务的客户端, 0 或大于 TCP_SRV_MAX_CLIENTS 时为 TCP_SRV_MAX_CLIENTS
+*             cb          回调, 内容被复制, recv 必须有
+*             arg         回调参数
+*	返 回 值: >= 0 成功, -1 失败
+*********************************************************************************************************
+*/
+int tcp_srv_listen( u16_t port, u8_t max_clients, const tcp_srv_cb_t *cb, void *arg )
+{
+  tcp_srv_listener_t *lsn = NULL;
+  struct tcp_pcb *pcb, *lpcb;
+  int i;
+
+  if( cb == NULL || cb->recv == NULL )
+  {
+    return -1;
+  }
+  if( max_clients == 0 || max_clients > TCP_SRV_MAX_CLIENTS )
+  {
+    max_clients = TCP_SRV_MAX_CLIENTS;
+  }
+
+  LOCK_TCPIP_CORE();
+
+  for( i = 0; i < TCP_SRV_MAX_LISTEN; i++ )
+  {
+    if( tcp_srv_lsn[i].pcb == NULL )
+    {
+      lsn = &tcp_srv_lsn[i];
+      break;
+    }
+  }
+  if( lsn == NULL )
+  {
+    UNLOCK_TCPIP_CORE();
+    log_e("no free listener, TCP_SRV_MAX_LISTEN %d", TCP_SRV_MAX_LISTEN);
+    return -1;
+  }
+
+  pcb = tcp_new_ip_type( IPADDR_TYPE_ANY );
+  if( pcb == NULL )
+  {
+    UNLOCK_TCPIP_CORE();
+    log_e("port %u: no tcp_pcb", (unsigned)port);
+    return -1;
+  }
+  if( tcp_bind( pcb, IP_ANY_TYPE, port ) != ERR_OK )
+  {
+    tcp_close( pcb );
+    UNLOCK_TCPIP_CORE();
+    log_e("port %u: bind failed", (unsigned)port);
+    return -1;
+  }
+  lpcb = tcp_listen_with_backlog( pcb, max_clients );
+  if( lpcb == NULL )
+  {
+    tcp_close( pcb );
+    UNLOCK_TCPIP_CORE();
+    log_e("port %u: no listen pcb", (unsigned)port);
+    return -1;
+  }
+
+  lsn->pcb = lpcb;
+  lsn->cb = *cb;
+  lsn->arg = arg;
+  lsn->max_clients = max_clients;
+  lsn->clients = 0;
+  tcp_arg( lpcb, lsn );
+  tcp_accept( lpcb, tcp_srv_accept_cb );
+
+  UNLOCK_TCPIP_CORE();
+
+  log_i("port %u: up to %u clients, RX %u / TX %u bytes each", (unsigned)port, (unsigned)max_clients,
+        (unsigned)TCP_SRV_RX_SIZE, (unsigned)TCP_SRV_TX_SIZE);
+  return i;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_srv_send
+*	功能说明: 把数据复制到客户端的发送缓冲区, 由发送轮询写入 TCP. 全部放入或全部不放入.
+*	形    参: id   客户端
+*             data 数据
+*             len  长度
+*	返 回 值: ERR_OK, ERR_MEM 发送缓冲区空间不够 (等 sent 回调), ERR_CONN 客户端已关闭
+*********************************************************************************************************
+*/
+err_t tcp_srv_send( int id, const void *data, u16_t len )
+{
+  tcp_srv_client_t *c = tcp_srv_get( id );
+  u8_t *tx;
+  u16_t tail, n;
+
+  if( c == NULL || c->state != TCP_SRV_ACTIVE )
+  {
+    return ERR_CONN;
+  }
+  if( len > TCP_SRV_TX_SIZE - c->tx_len )
+  {
+    return ERR_MEM;
+  }
+
+  tx = tcp_srv_tx_buf[tcp_srv_slot( c )];
+  tail = ( c->tx_head + c->tx_len ) % TCP_SRV_TX_SIZE;
+  n = LWIP_MIN( len, TCP_SRV_TX_SIZE - tail );
+  MEMCPY( tx + tail, data, n );
+  MEMCPY( tx, (const u8_t *)data + n, len - n );
+  c->tx_len += len;
+
+  tcp_srv_tx_schedule();
+  return ERR_OK;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_srv_tx_space
+*	功能说明: 客户端发送缓冲区的空闲字节
+*	形    参: id 客户端
+*	返 回 值: 空闲字节, 0: 已满或客户端已关闭
+*********************************************************************************************************
+*/
+u16_t tcp_srv_tx_space( int id )
+{
+  tcp_srv_client_t *c = tcp_srv_get( id );
+
+  if( c == NULL || c->state != TCP_SRV_ACTIVE )
+  {
+    return 0;
+  }
+  return TCP_SRV_TX_SIZE - c->tx_len;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_srv_close
+*	功能说明: 关闭客户端: 不再接收, 发送缓冲区中的数据发完后关闭连接, 然后调用 closed 回调 (ERR_OK)
+*	形    参: id 客户端
+*	返 回 值: ERR_OK, ERR_CONN 客户端已关闭
+*********************************************************************************************************
+*/
+err_t tcp_srv_close( int id )
+{
+  tcp_srv_client_t *c = tcp_srv_get( id );
+
+  if( c == NULL || c->state != TCP_SRV_ACTIVE )
+  {
+    return ERR_CONN;
+  }
+  tcp_srv_shutdown( c, ERR_OK );
+  return ERR_OK;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_srv_peer
+*	功能说明: 客户端的地址与端口
+*	形    参: id   客户端
+*             ip   输出, 可以为 NULL
+*             port 输出, 可以为 NULL
+*	返 回 值: ERR_OK, ERR_CONN 客户端已关闭
+*********************************************************************************************************
+*/
+err_t tcp_srv_peer( int id, ip_addr_t *ip, u16_t *port )
+{
+  tcp_srv_client_t *c = tcp_srv_get( id );
+
+  if( c == NULL )
+  {
+    return ERR_CONN;
+  }
+  if( ip != NULL )
+  {
+    ip_addr_copy( *ip, c->pcb->remote_ip );
+  }
+  if( port != NULL )
+  {
+    *port = c->pcb->remote_port;
+  }
+  return ERR_OK;
+}
+
+#if TCP_SRV_ECHO_PORT
+/* echo: as much as the TX buffer takes, the rest waits in the RX buffer */
+static u16_t tcp_srv_echo_recv( int id, void *arg, const u8_t *data, u16_t len )
+{
+  u16_t n = LWIP_MIN( len, tcp_srv_tx_space( id ) );
+
+  LWIP_UNUSED_ARG(arg);
+
+  if( n > 0 && tcp_srv_send( id, data, n ) != ERR_OK )
+  {
+    n = 0;
+  }
+  return n;
+}
+
+static const tcp_srv_cb_t tcp_srv_echo_cb =
+{
+  NULL,
+  tcp_srv_echo_recv,
+  NULL,
+  NULL,
+};
+#endif
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_srv_start
+*	功能说明: 启动内置的服务 (TCP_SRV_ECHO_PORT 上的 echo)
+*	形    参: 无
+*	返 回 值: ERR_OK 成功
+*********************************************************************************************************
+*/
+err_t tcp_srv_start( void )
+{
+#if TCP_SRV_ECHO_PORT
+  if( tcp_srv_listen( TCP_SRV_ECHO_PORT, 0, &tcp_srv_echo_cb, NULL ) < 0 )
+  {
+    return ERR_MEM;
+  }
+#endif
+  return ERR_OK;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tcp_srv_get_stats
+*	功能说明: 读取统计
+*	形    参: st 输出
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void tcp_srv_get_stats( struct tcp_srv_stats *st )
+{
+  LOCK_TCPIP_CORE();
+  *st = tcp_srv_stats;
+  UNLOCK_TCPIP_CORE();
+}
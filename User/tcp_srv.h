@@ -0,0 +1,115 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : tcp_srv
+*	文件名称 : tcp_srv.h
+*	版    本 : V1.0
+*	说    明 : multi-client TCP server on the raw API, running in the tcpip thread: fixed RX/TX
+*              buffers per client, round-robin transmit, idle clients reaped, admission control
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年05月05日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __TCP_SRV_H__
+#define  __TCP_SRV_H__
+
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+
+/* clients served at once by all the listeners. lwipopts.h sizes MEMP_NUM_TCP_PCB with it, a
+   raw API client takes a tcp_pcb and no netconn. */
+#ifndef TCP_SRV_MAX_CLIENTS
+#define TCP_SRV_MAX_CLIENTS           16
+#endif
+
+/* ports served */
+#ifndef TCP_SRV_MAX_LISTEN
+#define TCP_SRV_MAX_LISTEN            2
+#endif
+
+/* clients from one IP address, 0: no limit */
+#ifndef TCP_SRV_MAX_PER_IP
+#define TCP_SRV_MAX_PER_IP            4
+#endif
+
+/* buffers of every client, bytes. A request must fit in the RX buffer. */
+#ifndef TCP_SRV_RX_SIZE
+#define TCP_SRV_RX_SIZE               1024
+#endif
+#ifndef TCP_SRV_TX_SIZE
+#define TCP_SRV_TX_SIZE               2048
+#endif
+#ifndef TCP_SRV_BUF_SECTION
+#define TCP_SRV_BUF_SECTION           ".SdramSection"
+#endif
+
+/* bytes a client may pass to tcp_write() in its turn of a transmit round */
+#ifndef TCP_SRV_TX_QUANTUM
+#define TCP_SRV_TX_QUANTUM            TCP_MSS
+#endif
+
+/* clients without traffic for this long are closed, ms, 0: never */
+#ifndef TCP_SRV_IDLE_TIMEOUT
+#define TCP_SRV_IDLE_TIMEOUT          60000
+#endif
+
+/* 1: Nagle off, the replies to short requests leave at once */
+#ifndef TCP_SRV_NODELAY
+#define TCP_SRV_NODELAY               1
+#endif
+
+/* built-in echo service on this port, e.g. as the target of a load generator, 0: none */
+#ifndef TCP_SRV_ECHO_PORT
+#define TCP_SRV_ECHO_PORT             7
+#endif
+
+/*
+ * Callbacks of a listener, run in the tcpip thread. A client id stays valid until 'closed'
+ * (slot and generation, a stale id is refused).
+ */
+typedef struct
+{
+  /* client admitted, anything but ERR_OK closes it again */
+  err_t (*accepted)( int id, void *arg );
+  /* data in the RX buffer of the client, returns the bytes consumed (every complete request);
+     the rest is passed again with the next data. While nothing is consumed from a full buffer
+     the client is held off by the TCP window and the call is repeated after the client's data
+     went out; a request longer than TCP_SRV_RX_SIZE has to be closed by the application. */
+  u16_t (*recv)( int id, void *arg, const u8_t *data, u16_t len );
+  /* TX buffer space freed, may be NULL */
+  void (*sent)( int id, void *arg, u16_t space );
+  /* client gone: ERR_OK closed, ERR_TIMEOUT idle, ERR_ABRT refused by 'accepted',
+     ERR_RST / ERR_ABRT / ERR_CLSD from the stack */
+  void (*closed)( int id, void *arg, err_t err );
+} tcp_srv_cb_t;
+
+struct tcp_srv_stats
+{
+  u32_t clients;                  /* connected now */
+  u32_t clients_max;
+  u32_t accepted;
+  u32_t rejected_full;            /* listener or pool full */
+  u32_t rejected_ip;              /* TCP_SRV_MAX_PER_IP */
+  u32_t reaped;                   /* idle timeout */
+  u32_t aborted;                  /* reset, error, or refused by 'accepted' */
+  u32_t rx_bytes;
+  u32_t tx_bytes;
+  u32_t rx_full;                  /* RX buffer full, received data held in its pbufs */
+  u32_t tx_rounds;                /* round-robin transmit passes */
+  u32_t tx_mem_stall;             /* passes cut short by the lwIP heap */
+};
+
+int   tcp_srv_listen( u16_t port, u8_t max_clients, const tcp_srv_cb_t *cb, void *arg );
+err_t tcp_srv_send( int id, const void *data, u16_t len );
+u16_t tcp_srv_tx_space( int id );
+err_t tcp_srv_close( int id );
+err_t tcp_srv_peer( int id, ip_addr_t *ip, u16_t *port );
+err_t tcp_srv_start( void );
+void  tcp_srv_get_stats( struct tcp_srv_stats *st );
+
+#endif
@@ -0,0 +1,516 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : tftp_qspi
+*	文件名称 : tftp_qspi.c
+*	版    本 : V1.0
+*	说    明 : Files uploaded with TFTP (octet mode, write requests only) are programmed into the
+*              W25Q256: "fs.img" (makefsdata -img) replaces the httpd image, "firmware.bin" goes
+*              to its own region. Transfers negotiate the blksize option (RFC 2348) up to
+*              TFTP_MAX_BLKSIZE, 1468 bytes fill one Ethernet frame.
+*
+*              Pipeline (TFTP_QSPI_PIPELINE 1): the tcpip thread copies each block into a ring in
+*              the SDRAM and acknowledges it at once, the writer task programs the ring into the
+*              flash page by page and, while no data is waiting, erases 64KB blocks ahead of it.
+*              Erase and program overlap the network; when the ring is nearly full the ACK is held
+*              (tftp_write_pending()) until the writer has made room, so the client slows down
+*              instead of losing blocks. The last block is acknowledged only after the flash
+*              content has been compared with the CRC32 of the received bytes: a client that
+*              sees the transfer complete knows the file is in the flash.
+*
+*              Baseline (TFTP_QSPI_PIPELINE 0): erase a 4KB sector when the data reaches it and
+*              program, in the tcpip thread, before the block is acknowledged.
+*
+*              The flash leaves the memory-mapped mode during the upload: httpd serves fsdata.c
+*              meanwhile (fs_qspi_suspend()), connections still sending from the flash are
+*              given TFTP_QSPI_DRAIN_MS to finish.
+*
+*              Test: tftp -m binary 192.168.0.11 -c put fs.img  (or: curl -T fs.img tftp://...)
+*                    atftp --option "blksize 1468" -p -l fs.img 192.168.0.11
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月30日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "tftp_qspi.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "tftp_qspi_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#include "lwip/sys.h"
+#include "lwip/tcpip.h"
+#include "lwip/def.h"
+#include "lwip/pbuf.h"
+#include "lwip/apps/tftp_server.h"
+#include "fs_qspi.h"
+#include <string.h>
+
+#include "stm32h7xx_hal.h"
+#include "bsp_dwt.h"
+#include "bsp_qspi_w25q256.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if !LWIP_TCPIP_CORE_LOCKING
+#error "tftp_qspi needs LWIP_TCPIP_CORE_LOCKING"
+#endif
+
+#if (TFTP_QSPI_RING_SIZE % QSPI_PAGE_SIZE) || (TFTP_QSPI_RING_SIZE < 4 * TFTP_MAX_BLKSIZE)
+#error "TFTP_QSPI_RING_SIZE must be a multiple of QSPI_PAGE_SIZE and hold a few blocks"
+#endif
+
+typedef struct
+{
+  const char *name;
+  u32_t offset;                   /* in the flash, QSPI_BLOCK_SIZE aligned */
+  u32_t size;
+} tftp_qspi_region_t;
+
+static const tftp_qspi_region_t tftp_qspi_regions[] =
+{
+  { TFTP_QSPI_FS_NAME, FS_QSPI_IMAGE_OFFSET, FS_QSPI_IMAGE_MAX },
+  { TFTP_QSPI_FW_NAME, TFTP_QSPI_FW_OFFSET,  TFTP_QSPI_FW_SIZE },
+};
+
+static u8_t tftp_qspi_ring[TFTP_QSPI_RING_SIZE] __attribute__((section(TFTP_QSPI_RING_SECTION), aligned(32)));
+
+/*
+ * Byte offsets into the region: [tail, head) received and not programmed,
+ * the ring holds them at offset % TFTP_QSPI_RING_SIZE. head is written by the
+ * tcpip thread only, tail and erased by the programming side only.
+ */
+static volatile u32_t tftp_qspi_head;
+static volatile u32_t tftp_qspi_tail;
+static u32_t tftp_qspi_erased;            /* flash erased below this offset */
+static u32_t tftp_qspi_crc;               /* of [0, head) */
+static u32_t tftp_qspi_t_start;
+
+/* NULL: no upload; set by open(), cleared once the upload is finished */
+static const tftp_qspi_region_t * volatile tftp_qspi_region;
+static volatile u8_t tftp_qspi_end;       /* the last block is in the ring */
+static volatile u8_t tftp_qspi_abort;     /* the transfer was closed early */
+static u8_t tftp_qspi_held;               /* an ACK waits for ring space, core locked */
+static u8_t tftp_qspi_done;               /* the result was reported, core locked */
+
+static sys_thread_t tftp_qspi_writer;
+
+static struct tftp_qspi_stats tftp_qspi_stats;
+
+/* DWT cycles to µs */
+static u32_t tftp_qspi_us( u32_t t0 )
+{
+  return (DWT_CYCCNT - t0) / (SystemCoreClock / 1000000);
+}
+
+/* program [tail, head): whole pages, and the partial one too when last. Erases on demand. */
+static void tftp_qspi_program( u8_t last )
+{
+  const tftp_qspi_region_t *r = tftp_qspi_region;
+  u32_t head = tftp_qspi_head;
+  u32_t tail = tftp_qspi_tail;
+  u32_t len, t0;
+  u8_t *src;
+
+  while( (head - tail >= QSPI_PAGE_SIZE) || (last && (tail != head)) )
+  {
+    if( tftp_qspi_abort )
+    {
+      return;
+    }
+
+    len = LWIP_MIN( head - tail, QSPI_PAGE_SIZE );
+
+    while( tail + len > tftp_qspi_erased )
+    {
+      t0 = DWT_CYCCNT;
+#if TFTP_QSPI_PIPELINE
+      if( ((tftp_qspi_erased % QSPI_BLOCK_SIZE) == 0) && (tftp_qspi_erased + QSPI_BLOCK_SIZE <= r->size) )
+      {
+        QSPI_EraseBlock( r->offset + tftp_qspi_erased );
+        tftp_qspi_erased += QSPI_BLOCK_SIZE;
+      }
+      else
+#endif
+      {
+        QSPI_EraseSector( r->offset + tftp_qspi_erased );
+        tftp_qspi_erased += QSPI_SECTOR_SIZE;
+      }
+      tftp_qspi_stats.erase_us += tftp_qspi_us( t0 );
+      tftp_qspi_stats.erases++;
+    }
+
+    /* pages never straddle the end of the ring, its size is a multiple of a page */
+    src = &tftp_qspi_ring[tail % TFTP_QSPI_RING_SIZE];
+    SCB_CleanDCache_by_Addr( (uint32_t *)((u32_t)src & ~31UL), ((len + ((u32_t)src & 31UL)) + 31) & ~31UL );
+
+    t0 = DWT_CYCCNT;
+    QSPI_WriteBuffer( src, r->offset + tail, (uint16_t)len );
+    tftp_qspi_stats.program_us += tftp_qspi_us( t0 );
+
+    tail += len;
+    tftp_qspi_tail = tail;
+  }
+}
+
+/* back to the memory-mapped mode and compare the flash with the received bytes */
+static int tftp_qspi_verify( void )
+{
+  const tftp_qspi_region_t *r = tftp_qspi_region;
+  u32_t addr = QSPI_MMAP_ADDR + r->offset;
+  u32_t t0;
+  int ok;
+
+  QSPI_MemoryMapped();
+
+  /* the cache may hold what the flash contained before */
+  if( tftp_qspi_erased != 0 )
+  {
+    SCB_InvalidateDCache_by_Addr( (uint32_t *)addr, (int32_t)tftp_qspi_erased );
+  }
+
+  if( tftp_qspi_abort || (tftp_qspi_tail != tftp_qspi_head) )
+  {
+    return -1;
+  }
+
+  t0 = DWT_CYCCNT;
+  ok = (fs_qspi_crc32( 0, (const void *)addr, tftp_qspi_head ) == tftp_qspi_crc);
+  tftp_qspi_stats.verify_us = tftp_qspi_us( t0 );
+
+  return ok ? 0 : -1;
+}
+
+/* account and log the upload, called with the core locked */
+static void tftp_qspi_report( int result )
+{
+  u32_t ms = sys_now() - tftp_qspi_t_start;
+
+  tftp_qspi_stats.bytes = tftp_qspi_head;
+  tftp_qspi_stats.ms    = ms;
+  if( result == 0 )
+  {
+    tftp_qspi_stats.uploads++;
+    log_i("%s: %u bytes in %u ms, %u KB/s, blksize %u, erase %u ms, program %u ms, verify %u ms, %u ACK held",
+          tftp_qspi_region->name, (unsigned)tftp_qspi_head, (unsigned)ms,
+          (unsigned)(ms ? tftp_qspi_head / ms : 0), (unsigned)tftp_blksize(),
+          (unsigned)(tftp_qspi_stats.erase_us / 1000), (unsigned)(tftp_qspi_stats.program_us / 1000),
+          (unsigned)(tftp_qspi_stats.verify_us / 1000), (unsigned)tftp_qspi_stats.ack_held);
+  }
+  else
+  {
+    tftp_qspi_stats.failed++;
+    log_e("%s: upload %s after %u bytes, the region holds no valid file",
+          tftp_qspi_region->name, tftp_qspi_abort ? "aborted" : "failed the CRC check", (unsigned)tftp_qspi_head);
+  }
+}
+
+#if TFTP_QSPI_PIPELINE
+/*
+*********************************************************************************************************
+*	函 数 名: tftp_qspi_writer_thread
+*	功能说明: 写入任务：等待httpd释放QSPI Flash，退出内存映射，边接收边擦除、编程，校验后应答最后一块
+*	形    参: arg 未使用
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+static void tftp_qspi_writer_thread( void *arg )
+{
+  const tftp_qspi_region_t *r;
+  u32_t t_claim;
+  int busy, result;
+
+  LWIP_UNUSED_ARG(arg);
+
+  for( ;; )
+  {
+    ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+    r = tftp_qspi_region;
+    if( r == NULL )
+    {
+      continue;
+    }
+
+    /* wait for httpd to stop reading the flash, reset it after TFTP_QSPI_DRAIN_MS */
+    t_claim = sys_now();
+    do
+    {
+      LOCK_TCPIP_CORE();
+      busy = fs_qspi_suspend( (sys_now() - t_claim) > TFTP_QSPI_DRAIN_MS );
+      UNLOCK_TCPIP_CORE();
+      if( busy )
+      {
+        vTaskDelay( pdMS_TO_TICKS(10) );
+      }
+    } while( busy );
+
+    QSPI_MemoryMappedExit();
+
+    while( !tftp_qspi_abort )
+    {
+      tftp_qspi_program( tftp_qspi_end );
+
+      if( tftp_qspi_end && (tftp_qspi_tail == tftp_qspi_head) )
+      {
+        break;
+      }
+
+      /* room again for a block: acknowledge the one held */
+      if( tftp_qspi_held && (TFTP_QSPI_RING_SIZE - (tftp_qspi_head - tftp_qspi_tail) >= TFTP_MAX_BLKSIZE) )
+      {
+        LOCK_TCPIP_CORE();
+        if( tftp_qspi_held )
+        {
+          tftp_qspi_held = 0;
+          tftp_write_done( 0 );
+        }
+        UNLOCK_TCPIP_CORE();
+      }
+
+      /* nothing to program: erase ahead, one unit then look at the ring again */
+      if( (tftp_qspi_head - tftp_qspi_tail < QSPI_PAGE_SIZE) && !tftp_qspi_end &&
+          (tftp_qspi_erased - tftp_qspi_tail < TFTP_QSPI_ERASE_AHEAD) && (tftp_qspi_erased < r->size) )
+      {
+        u32_t t0 = DWT_CYCCNT;
+
+        if( ((tftp_qspi_erased % QSPI_BLOCK_SIZE) == 0) && (tftp_qspi_erased + QSPI_BLOCK_SIZE <= r->size) )
+        {
+          QSPI_EraseBlock( r->offset + tftp_qspi_erased );
+          tftp_qspi_erased += QSPI_BLOCK_SIZE;
+        }
+        else
+        {
+          QSPI_EraseSector( r->offset + tftp_qspi_erased );
+          tftp_qspi_erased += QSPI_SECTOR_SIZE;
+        }
+        tftp_qspi_stats.erase_us += tftp_qspi_us( t0 );
+        tftp_qspi_stats.erases++;
+        continue;
+      }
+
+      /* a block arrives, the last one, or close() */
+      if( (tftp_qspi_head - tftp_qspi_tail < QSPI_PAGE_SIZE) && !tftp_qspi_end )
+      {
+        ulTaskNotifyTake( pdTRUE, pdMS_TO_TICKS(100) );
+      }
+    }
+
+    result = tftp_qspi_verify();
+
+    LOCK_TCPIP_CORE();
+    fs_qspi_init();
+    tftp_qspi_report( result );
+    tftp_qspi_done = 1;
+    tftp_write_done( result );           /* the last ACK, or an error; closes the transfer */
+    tftp_qspi_region = NULL;
+    UNLOCK_TCPIP_CORE();
+  }
+}
+#endif /* TFTP_QSPI_PIPELINE */
+
+static void* tftp_qspi_open( const char* fname, const char* mode, u8_t write )
+{
+  const tftp_qspi_region_t *r = NULL;
+  u32_t i;
+
+  if( !write || (lwip_stricmp( mode, "octet" ) != 0) || (tftp_qspi_region != NULL) )
+  {
+    return NULL;
+  }
+
+  for( i = 0; i < LWIP_ARRAYSIZE(tftp_qspi_regions); i++ )
+  {
+    if( lwip_stricmp( fname, tftp_qspi_regions[i].name ) == 0 )
+    {
+      r = &tftp_qspi_regions[i];
+    }
+  }
+  if( r == NULL )
+  {
+    return NULL;
+  }
+
+  tftp_qspi_head   = 0;
+  tftp_qspi_tail   = 0;
+  tftp_qspi_erased = 0;
+  tftp_qspi_crc    = 0;
+  tftp_qspi_end    = 0;
+  tftp_qspi_abort  = 0;
+  tftp_qspi_held   = 0;
+  tftp_qspi_done   = 0;
+  tftp_qspi_stats.erase_us   = 0;
+  tftp_qspi_stats.program_us = 0;
+  tftp_qspi_stats.verify_us  = 0;
+  tftp_qspi_stats.erases     = 0;
+  tftp_qspi_stats.ack_held   = 0;
+  tftp_qspi_t_start = sys_now();
+  tftp_qspi_region  = r;
+
+  log_i("receiving %s into the QSPI flash at 0x%08x", r->name, (unsigned)r->offset);
+
+#if TFTP_QSPI_PIPELINE
+  xTaskNotifyGive( tftp_qspi_writer );
+#else
+  /* no draining: connections sending from the flash are reset */
+  fs_qspi_suspend( 1 );
+  QSPI_MemoryMappedExit();
+#endif
+
+  return (void *)r;
+}
+
+static void tftp_qspi_close( void* handle )
+{
+  LWIP_UNUSED_ARG(handle);
+
+  if( tftp_qspi_done || (tftp_qspi_region == NULL) )
+  {
+    return;
+  }
+
+  /* timeout, error from the client, or write() refused the data */
+  tftp_qspi_abort = 1;
+#if TFTP_QSPI_PIPELINE
+  xTaskNotifyGive( tftp_qspi_writer );
+#else
+  tftp_qspi_verify();
+  fs_qspi_init();
+  tftp_qspi_report( -1 );
+  tftp_qspi_region = NULL;
+#endif
+}
+
+static int tftp_qspi_read( void* handle, void* buf, int bytes )
+{
+  LWIP_UNUSED_ARG(handle);
+  LWIP_UNUSED_ARG(buf);
+  LWIP_UNUSED_ARG(bytes);
+  return -1;
+}
+
+static int tftp_qspi_write( void* handle, struct pbuf* p )
+{
+  const tftp_qspi_region_t *r = (const tftp_qspi_region_t *)handle;
+  u32_t head = tftp_qspi_head;
+  u32_t off, n;
+  u16_t copied = 0;
+
+  if( (u32_t)p->tot_len > r->size - head )
+  {
+    log_e("%s: larger than the region, %u bytes", r->name, (unsigned)r->size);
+    return -1;
+  }
+
+  /* the write callback only runs with room for a whole block, see the held ACK */
+  while( copied < p->tot_len )
+  {
+    off = (head + copied) % TFTP_QSPI_RING_SIZE;
+    n   = LWIP_MIN( (u32_t)(p->tot_len - copied), TFTP_QSPI_RING_SIZE - off );
+    pbuf_copy_partial( p, &tftp_qspi_ring[off], (u16_t)n, copied );
+    tftp_qspi_crc = fs_qspi_crc32( tftp_qspi_crc, &tftp_qspi_ring[off], n );
+    copied += (u16_t)n;
+  }
+
+  __DMB();                                /* the data before the new head */
+  tftp_qspi_head = head + p->tot_len;
+
+#if TFTP_QSPI_PIPELINE
+  if( p->tot_len < tftp_blksize() )
+  {
+    tftp_qspi_end = 1;
+    tftp_write_pending();               /* ACK after the CRC check */
+  }
+  else if( TFTP_QSPI_RING_SIZE - (tftp_qspi_head - tftp_qspi_tail) < TFTP_MAX_BLKSIZE )
+  {
+    tftp_qspi_held = 1;
+    tftp_qspi_stats.ack_held++;
+    tftp_write_pending();
+  }
+  xTaskNotifyGive( tftp_qspi_writer );
+  return 0;
+#else
+  if( p->tot_len < tftp_blksize() )
+  {
+    int result;
+
+    tftp_qspi_end = 1;
+    tftp_qspi_program( 1 );
+    result = tftp_qspi_verify();
+    fs_qspi_init();
+    tftp_qspi_report( result );
+    tftp_qspi_done = 1;
+    tftp_qspi_region = NULL;
+    return result;
+  }
+  tftp_qspi_program( 0 );
+  return 0;
+#endif
+}
+
+static const struct tftp_context tftp_qspi_ctx =
+{
+  tftp_qspi_open,
+  tftp_qspi_close,
+  tftp_qspi_read,
+  tftp_qspi_write
+};
+
+/*
+*********************************************************************************************************
+*	函 数 名: tftp_qspi_start
+*	功能说明: 启动TFTP服务器（UDP 69端口），接收的文件写入QSPI Flash
+*	形    参: 无
+*	返 回 值: ERR_OK 成功
+*********************************************************************************************************
+*/
+err_t tftp_qspi_start( void )
+{
+  err_t err;
+
+#if TFTP_QSPI_PIPELINE
+  if( tftp_qspi_writer == NULL )
+  {
+    tftp_qspi_writer = sys_thread_new( "tftp_qspi", tftp_qspi_writer_thread, NULL, 512, TFTP_QSPI_TASK_PRIO );
+  }
+#endif
+
+  LOCK_TCPIP_CORE();
+  err = tftp_init( &tftp_qspi_ctx );
+  UNLOCK_TCPIP_CORE();
+
+  if( err != ERR_OK )
+  {
+    log_e("tftp_init failed: %d", (int)err);
+  }
+  return err;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: tftp_qspi_get_stats
+*	功能说明: 读取最近一次上传的统计
+*	形    参: st 输出
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void tftp_qspi_get_stats( struct tftp_qspi_stats *st )
+{
+  LOCK_TCPIP_CORE();
+  *st = tftp_qspi_stats;
+  UNLOCK_TCPIP_CORE();
+}
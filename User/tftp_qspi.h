@@ -0,0 +1,80 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : tftp_qspi
+*	文件名称 : tftp_qspi.h
+*	版    本 : V1.0
+*	说    明 : TFTP server storage backend: uploads (WRQ) are written into the W25Q256 QSPI flash,
+*              the sector erases run ahead of the incoming blocks, the flash is checked by CRC32
+*              before the last block is acknowledged
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月30日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __TFTP_QSPI_H__
+#define  __TFTP_QSPI_H__
+
+#include "lwip/opt.h"
+#include "lwip/err.h"
+
+/* file names accepted by the server and the flash regions they are written to */
+#define TFTP_QSPI_FS_NAME             "fs.img"         /* httpd image, see fs_qspi.h */
+#define TFTP_QSPI_FW_NAME             "firmware.bin"
+
+#ifndef TFTP_QSPI_FW_OFFSET
+#define TFTP_QSPI_FW_OFFSET           (16 * 1024 * 1024)
+#endif
+#ifndef TFTP_QSPI_FW_SIZE
+#define TFTP_QSPI_FW_SIZE             (8 * 1024 * 1024)
+#endif
+
+/* 1: a writer task erases 64KB blocks ahead and programs while the network receives,
+   0: erase-then-write of 4KB sectors in the tcpip thread (baseline for comparison) */
+#ifndef TFTP_QSPI_PIPELINE
+#define TFTP_QSPI_PIPELINE            1
+#endif
+
+/* blocks received and not programmed yet, bytes. It lives in the SDRAM; when less than
+   one block is free the ACK is held until the writer has caught up. */
+#ifndef TFTP_QSPI_RING_SIZE
+#define TFTP_QSPI_RING_SIZE           (256 * 1024)
+#endif
+#ifndef TFTP_QSPI_RING_SECTION
+#define TFTP_QSPI_RING_SECTION        ".SdramSection"
+#endif
+
+/* erased bytes kept ahead of the programmed ones while the flash would be idle */
+#ifndef TFTP_QSPI_ERASE_AHEAD
+#define TFTP_QSPI_ERASE_AHEAD         (2 * 64 * 1024)
+#endif
+
+/* httpd connections still sending from the flash are reset after this long, ms */
+#ifndef TFTP_QSPI_DRAIN_MS
+#define TFTP_QSPI_DRAIN_MS            2000
+#endif
+
+#ifndef TFTP_QSPI_TASK_PRIO
+#define TFTP_QSPI_TASK_PRIO           (tskIDLE_PRIORITY + 1)
+#endif
+
+struct tftp_qspi_stats
+{
+  u32_t bytes;                    /* received in the last upload */
+  u32_t ms;                       /* WRQ to the last ACK */
+  u32_t erase_us;                 /* flash busy erasing, programming, verifying */
+  u32_t program_us;
+  u32_t verify_us;
+  u32_t erases;                   /* 64KB blocks and 4KB sectors */
+  u32_t ack_held;                 /* ACKs held for ring space */
+  u32_t uploads;                  /* completed and verified */
+  u32_t failed;                   /* aborted or CRC mismatch */
+};
+
+err_t tftp_qspi_start( void );
+void tftp_qspi_get_stats( struct tftp_qspi_stats *st );
+
+#endif
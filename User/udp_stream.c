@@ -0,0 +1,520 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : udp_stream
+*	文件名称 : udp_stream.c
+*	版    本 : V1.0
+*	说    明 : Records written by the producer tasks are appended to a ring buffer, packed into
+*              datagrams in place: a struct udp_stream_hdr, then the records, contiguous in the
+*              ring. A datagram is closed when it is full (UDP_STREAM_DGRAM_SIZE) or when
+*              UDP_STREAM_FLUSH_MS expires, then sent from the tcpip thread as a PBUF_REF
+*              custom pbuf pointing into the ring; the Ethernet DMA reads the records where
+*              the producer wrote them. The free callback of the pbuf, once the driver has
+*              reclaimed the frame, gives the ring space back.
+*
+*              Host test (NETIF_HOST, TAP device): define UDP_STREAM_IP as the tap0 address
+*              and UDP_STREAM_BENCH 1, then watch with "tcpdump -i tap0 udp port 5141".
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月28日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#include "udp_stream.h"
+
+/**
+ * Log default configuration for EasyLogger.
+ * NOTE: Must defined before including the <elog.h>
+ */
+#if !defined(LOG_TAG)
+#define LOG_TAG                    "udp_stream_tag:"
+#endif
+#undef LOG_LVL
+#if defined(XX_LOG_LVL)
+    #define LOG_LVL                    XX_LOG_LVL
+#endif
+
+#include "elog.h"
+
+#include "lwip/sys.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include <string.h>
+
+#if defined(NETIF_HOST)
+#include <time.h>
+#else
+#include "stm32h7xx_hal.h"
+#include "bsp_dwt.h"
+#endif
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if !LWIP_UDP || !LWIP_SUPPORT_CUSTOM_PBUF
+#error "udp_stream needs LWIP_UDP and LWIP_SUPPORT_CUSTOM_PBUF"
+#endif
+
+#if (UDP_STREAM_DGRAM_SIZE > 0xFFFF) || (UDP_STREAM_DGRAM_SIZE < (20 + 2 + UDP_STREAM_RECORD_MAX))
+#error "UDP_STREAM_DGRAM_SIZE must hold the header and one UDP_STREAM_RECORD_MAX record"
+#endif
+
+#define UDP_STREAM_HDR_LEN            sizeof(struct udp_stream_hdr)
+#define UDP_STREAM_REC_LEN(len)       (2 + (u32_t)(len))     /* u16_t length + the bytes */
+
+/* one datagram of the queue */
+typedef struct
+{
+  struct pbuf_custom pc;          /* first member: the free callback gets &pc.pbuf */
+  u32_t start;                    /* ring offset of the header */
+  u32_t span;                     /* ring bytes taken: len, plus the bytes skipped at the ring end */
+  u32_t first_record;
+  u32_t timestamp;
+  u16_t len;                      /* header + records */
+  u16_t records;
+  u8_t  done;                     /* released by lwIP, waiting for the older ones */
+} udp_stream_dgram_t;
+
+/* u32_t for the alignment of the first header */
+static u32_t udp_stream_ring[UDP_STREAM_RING_SIZE / 4];
+#define UDP_STREAM_RING               ((u8_t *)udp_stream_ring)
+
+static udp_stream_dgram_t udp_stream_queue[UDP_STREAM_QUEUE_LEN];
+
+/*
+ * Free running datagram counters: [free, send) in lwIP or the Tx ring,
+ * [send, head) closed and waiting for the tcpip thread, head is being filled
+ * when udp_stream_open is set. Producers, the tcpip thread and the free
+ * callback share them under SYS_ARCH_PROTECT.
+ */
+static u32_t udp_stream_head;
+static u32_t udp_stream_send;
+static u32_t udp_stream_free;
+static u8_t  udp_stream_open;
+static u8_t  udp_stream_scheduled;  /* udp_stream_send_cb() is queued to the tcpip thread */
+
+static u32_t udp_stream_wr;         /* ring offset of the next record */
+static u32_t udp_stream_used;       /* ring bytes taken */
+static u32_t udp_stream_record_seq;
+static u32_t udp_stream_dgram_seq;
+
+static struct udp_pcb *udp_stream_pcb;
+static ip_addr_t udp_stream_dst;
+
+static struct udp_stream_stats udp_stream_stats;
+
+static u32_t udp_stream_time( void )
+{
+#if defined(NETIF_HOST)
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (u32_t)(ts.tv_sec * 1000000000UL + ts.tv_nsec);
+#else
+  return DWT_CYCCNT;
+#endif
+}
+
+/* start datagram udp_stream_head with room for a record of need bytes, called protected */
+static err_t udp_stream_open_dgram( u32_t need )
+{
+  udp_stream_dgram_t *d;
+  u32_t start = udp_stream_wr;
+  u32_t skip = 0;
+
+  if( udp_stream_head - udp_stream_free >= UDP_STREAM_QUEUE_LEN )
+  {
+    return ERR_MEM;
+  }
+
+  /* a datagram is contiguous: skip the end of the ring if it does not fit */
+  if( start + UDP_STREAM_HDR_LEN + need > UDP_STREAM_RING_SIZE )
+  {
+    skip  = UDP_STREAM_RING_SIZE - start;
+    start = 0;
+  }
+  if( udp_stream_used + skip + UDP_STREAM_HDR_LEN + need > UDP_STREAM_RING_SIZE )
+  {
+    return ERR_MEM;
+  }
+
+  d = &udp_stream_queue[udp_stream_head % UDP_STREAM_QUEUE_LEN];
+  d->start        = start;
+  d->span         = skip + UDP_STREAM_HDR_LEN;
+  d->first_record = udp_stream_record_seq;
+  d->timestamp    = UDP_STREAM_TIMESTAMP();
+  d->len          = UDP_STREAM_HDR_LEN;
+  d->records      = 0;
+  d->done         = 0;
+
+  udp_stream_used += skip + UDP_STREAM_HDR_LEN;
+  udp_stream_wr    = start + UDP_STREAM_HDR_LEN;
+  udp_stream_open  = 1;
+
+  if( udp_stream_head - udp_stream_free + 1 > udp_stream_stats.queue_peak )
+  {
+    udp_stream_stats.queue_peak = udp_stream_head - udp_stream_free + 1;
+  }
+  return ERR_OK;
+}
+
+/* hand the datagram being filled to the tcpip thread, called protected */
+static void udp_stream_close_dgram( void )
+{
+  udp_stream_open = 0;
+  udp_stream_head++;
+}
+
+/* custom pbuf free: the driver is done with the datagram, give its ring space back in order */
+static void udp_stream_pbuf_free( struct pbuf *p )
+{
+  udp_stream_dgram_t *d = (udp_stream_dgram_t *)p;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  d->done = 1;
+  while( udp_stream_free != udp_stream_send )
+  {
+    d = &udp_stream_queue[udp_stream_free % UDP_STREAM_QUEUE_LEN];
+    if( !d->done )
+    {
+      break;
+    }
+    d->done = 0;
+    udp_stream_used -= d->span;
+    udp_stream_free++;
+  }
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+/* send the closed datagrams, in the tcpip thread */
+static void udp_stream_send_pending( void )
+{
+  udp_stream_dgram_t *d;
+  struct udp_stream_hdr hdr;
+  struct pbuf *p;
+  u32_t seq, t0;
+  err_t err;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  for( ;; )
+  {
+    SYS_ARCH_PROTECT(lev);
+    if( udp_stream_send == udp_stream_head )
+    {
+      SYS_ARCH_UNPROTECT(lev);
+      break;
+    }
+    d   = &udp_stream_queue[udp_stream_send % UDP_STREAM_QUEUE_LEN];
+    seq = udp_stream_dgram_seq++;
+    udp_stream_send++;
+    SYS_ARCH_UNPROTECT(lev);
+
+    t0 = udp_stream_time();
+
+    hdr.magic        = UDP_STREAM_MAGIC;
+    hdr.version      = UDP_STREAM_VERSION;
+    hdr.records      = d->records;
+    hdr.seq          = seq;
+    hdr.first_record = d->first_record;
+    hdr.timestamp    = d->timestamp;
+    memcpy( UDP_STREAM_RING + d->start, &hdr, sizeof(hdr) );
+
+    d->pc.custom_free_function = udp_stream_pbuf_free;
+    p = pbuf_alloced_custom( PBUF_RAW, d->len, PBUF_REF, &d->pc, UDP_STREAM_RING + d->start, d->len );
+
+    /* udp_sendto() chains its own header pbuf in front of the reference */
+    err = udp_sendto( udp_stream_pcb, p, &udp_stream_dst, UDP_STREAM_PORT );
+    if( err != ERR_OK )
+    {
+      udp_stream_stats.send_err++;
+    }
+    pbuf_free( p );
+
+    udp_stream_stats.datagrams++;
+    udp_stream_stats.send_time = (udp_stream_stats.send_time * 7 + (udp_stream_time() - t0)) / 8;
+  }
+}
+
+/* tcpip_try_callback() handler */
+static void udp_stream_send_cb( void *arg )
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  LWIP_UNUSED_ARG(arg);
+
+  SYS_ARCH_PROTECT(lev);
+  udp_stream_scheduled = 0;
+  SYS_ARCH_UNPROTECT(lev);
+
+  udp_stream_send_pending();
+}
+
+/* wake the tcpip thread once for any number of closed datagrams */
+static void udp_stream_schedule( void )
+{
+  u8_t run;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  run = !udp_stream_scheduled;
+  udp_stream_scheduled = 1;
+  SYS_ARCH_UNPROTECT(lev);
+
+  if( run && (tcpip_try_callback( udp_stream_send_cb, NULL ) != ERR_OK) )
+  {
+    /* tcpip mbox full: the flush timer sends them */
+    SYS_ARCH_PROTECT(lev);
+    udp_stream_scheduled = 0;
+    SYS_ARCH_UNPROTECT(lev);
+  }
+}
+
+/* sys_timeout handler, runs in the tcpip thread: the deadline of the datagram being filled */
+static void udp_stream_flush( void *arg )
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  LWIP_UNUSED_ARG(arg);
+
+  SYS_ARCH_PROTECT(lev);
+  if( udp_stream_open && (udp_stream_queue[udp_stream_head % UDP_STREAM_QUEUE_LEN].records != 0) )
+  {
+    udp_stream_close_dgram();
+    udp_stream_stats.flush_deadline++;
+  }
+  SYS_ARCH_UNPROTECT(lev);
+
+  udp_stream_send_pending();
+
+  sys_timeout( UDP_STREAM_FLUSH_MS, udp_stream_flush, NULL );
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: udp_stream_write
+*	功能说明: 写入一条记录, 复制到环形缓冲区, 不等待发送. 任意任务中调用, 不能在中断中调用
+*	形    参: data 记录, len 记录长度 1..UDP_STREAM_RECORD_MAX
+*	返 回 值: ERR_OK, 缓冲区或队列满时 ERR_MEM (记录丢弃, 见 udp_stream_pressure), 参数错误 ERR_VAL
+*********************************************************************************************************
+*/
+err_t udp_stream_write( const void *data, u16_t len )
+{
+  udp_stream_dgram_t *d;
+  u32_t need = UDP_STREAM_REC_LEN(len);
+  u8_t *dst;
+  u8_t kick = 0;
+  err_t err = ERR_OK;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  if( (len == 0) || (len > UDP_STREAM_RECORD_MAX) || (udp_stream_pcb == NULL) )
+  {
+    return ERR_VAL;
+  }
+
+  SYS_ARCH_PROTECT(lev);
+
+  if( udp_stream_open )
+  {
+    d = &udp_stream_queue[udp_stream_head % UDP_STREAM_QUEUE_LEN];
+    if( (d->len + need > UDP_STREAM_DGRAM_SIZE) || (udp_stream_wr + need > UDP_STREAM_RING_SIZE) )
+    {
+      udp_stream_close_dgram();
+      udp_stream_stats.flush_size++;
+      kick = 1;
+    }
+  }
+
+  if( !udp_stream_open )
+  {
+    err = udp_stream_open_dgram( need );
+  }
+  else if( udp_stream_used + need > UDP_STREAM_RING_SIZE )
+  {
+    err = ERR_MEM;
+  }
+
+  if( err == ERR_OK )
+  {
+    d   = &udp_stream_queue[udp_stream_head % UDP_STREAM_QUEUE_LEN];
+    dst = UDP_STREAM_RING + udp_stream_wr;
+    memcpy( dst, &len, 2 );
+    memcpy( dst + 2, data, len );
+
+    udp_stream_wr   += need;
+    udp_stream_used += need;
+    d->len          += (u16_t)need;
+    d->span         += need;
+    d->records++;
+    udp_stream_record_seq++;
+    udp_stream_stats.records++;
+    if( udp_stream_used > udp_stream_stats.ring_peak )
+    {
+      udp_stream_stats.ring_peak = udp_stream_used;
+    }
+
+    /* no room left for the smallest record: send it now */
+    if( d->len + UDP_STREAM_REC_LEN(1) > UDP_STREAM_DGRAM_SIZE )
+    {
+      udp_stream_close_dgram();
+      udp_stream_stats.flush_size++;
+      kick = 1;
+    }
+  }
+  else
+  {
+    udp_stream_stats.dropped++;
+  }
+
+  SYS_ARCH_UNPROTECT(lev);
+
+  if( kick )
+  {
+    udp_stream_schedule();
+  }
+  return err;
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: udp_stream_pressure
+*	功能说明: 发送队列压力, 环形缓冲区和数据报队列中占用较多者的百分比, 生产者据此降低速率
+*	形    参: 无
+*	返 回 值: 0..100, 100 时 udp_stream_write() 开始丢弃记录
+*********************************************************************************************************
+*/
+u32_t udp_stream_pressure( void )
+{
+  u32_t ring, queue;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  ring  = udp_stream_used * 100 / UDP_STREAM_RING_SIZE;
+  queue = (udp_stream_head - udp_stream_free + udp_stream_open) * 100 / UDP_STREAM_QUEUE_LEN;
+  SYS_ARCH_UNPROTECT(lev);
+
+  return LWIP_MAX( ring, queue );
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: udp_stream_get_stats
+*	功能说明: 取计数器和当前占用, 任意任务中调用
+*	形    参: st 目的地址
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void udp_stream_get_stats( struct udp_stream_stats *st )
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  *st = udp_stream_stats;
+  st->ring_used  = udp_stream_used;
+  st->queue_used = udp_stream_head - udp_stream_free + udp_stream_open;
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+/*
+*********************************************************************************************************
+*	函 数 名: udp_stream_start
+*	功能说明: 创建 UDP 控制块并启动发送期限定时器, 在 netif 初始化之后调用
+*	形    参: 无
+*	返 回 值: ERR_OK, 未定义 UDP_STREAM_IP 时 ERR_ARG, 内存不足时 ERR_MEM
+*********************************************************************************************************
+*/
+err_t udp_stream_start( void )
+{
+#ifdef UDP_STREAM_IP
+  LOCK_TCPIP_CORE();
+
+  ipaddr_aton( UDP_STREAM_IP, &udp_stream_dst );
+  udp_stream_pcb = udp_new();
+  if( udp_stream_pcb == NULL )
+  {
+    UNLOCK_TCPIP_CORE();
+    log_e( "udp_stream udp_new failed" );
+    return ERR_MEM;
+  }
+
+  sys_timeout( UDP_STREAM_FLUSH_MS, udp_stream_flush, NULL );
+
+  UNLOCK_TCPIP_CORE();
+
+  log_i( "udp_stream to %s:%d, ring %u bytes, %u datagrams of %u bytes, flush %u ms",
+         UDP_STREAM_IP, UDP_STREAM_PORT, (unsigned)UDP_STREAM_RING_SIZE, (unsigned)UDP_STREAM_QUEUE_LEN,
+         (unsigned)UDP_STREAM_DGRAM_SIZE, (unsigned)UDP_STREAM_FLUSH_MS );
+  return ERR_OK;
+#else
+  log_w( "udp_stream: UDP_STREAM_IP not defined" );
+  return ERR_ARG;
+#endif
+}
+
+#if UDP_STREAM_BENCH
+/* producer at the lowest priority above idle: writes as fast as the stream takes the records */
+static void udp_stream_bench_thread( void *arg )
+{
+  u8_t rec[UDP_STREAM_BENCH_SIZE];
+  struct udp_stream_stats st;
+  u32_t t0, ms, n = 0, backoff = 0;
+
+  LWIP_UNUSED_ARG(arg);
+
+  memset( rec, 0xA5, sizeof(rec) );
+
+  t0 = sys_now();
+  while( (ms = sys_now() - t0) < UDP_STREAM_BENCH_MS )
+  {
+    memcpy( rec, &n, sizeof(n) );
+    if( udp_stream_write( rec, sizeof(rec) ) == ERR_OK )
+    {
+      n++;
+    }
+    else
+    {
+      backoff++;
+      sys_msleep( 1 );
+    }
+  }
+
+  udp_stream_get_stats( &st );
+
+  log_i( "udp_stream bench: %u records of %u bytes in %u ms, %u records/s, %u datagrams/s",
+         (unsigned)n, (unsigned)sizeof(rec), (unsigned)ms,
+         (unsigned)(n / ms * 1000 + n % ms * 1000 / ms),
+         (unsigned)(st.datagrams / ms * 1000 + st.datagrams % ms * 1000 / ms) );
+  log_i( "udp_stream bench: dropped %u (backoff %u), send err %u, flush size %u deadline %u, ring peak %u, queue peak %u, %u %s per datagram",
+         (unsigned)st.dropped, (unsigned)backoff, (unsigned)st.send_err,
+         (unsigned)st.flush_size, (unsigned)st.flush_deadline,
+         (unsigned)st.ring_peak, (unsigned)st.queue_peak, (unsigned)st.send_time,
+#if defined(NETIF_HOST)
+         "ns"
+#else
+         "cycles"
+#endif
+         );
+
+  vTaskDelete( NULL );
+}
+#endif /* UDP_STREAM_BENCH */
+
+/*
+*********************************************************************************************************
+*	函 数 名: udp_stream_bench_start
+*	功能说明: UDP_STREAM_BENCH 为 1 时创建生产者任务, 以最大速率写入 UDP_STREAM_BENCH_MS 毫秒,
+*             然后输出记录速率, 丢弃数, 队列压力和每个数据报的发送开销
+*	形    参: 无
+*	返 回 值: 无
+*********************************************************************************************************
+*/
+void udp_stream_bench_start( void )
+{
+#if UDP_STREAM_BENCH
+  sys_thread_new( "udp_bench", udp_stream_bench_thread, NULL, 512, tskIDLE_PRIORITY + 1 );
+#endif
+}
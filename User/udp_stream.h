@@ -0,0 +1,107 @@
+/*
+*********************************************************************************************************
+*
+*	模块名称 : udp_stream
+*	文件名称 : udp_stream.h
+*	版    本 : V1.0
+*	说    明 : batched UDP telemetry streamer: records written by any task are packed into
+*              MTU sized datagrams in a ring buffer and sent by reference (no copy into pbufs)
+*
+*	修改记录 :
+*						版本号    日期        作者       说明
+*						V1.0  2019年04月28日  suozhang   首次发布
+*
+*********************************************************************************************************
+*/
+
+#ifndef  __UDP_STREAM_H__
+#define  __UDP_STREAM_H__
+
+#include "lwip/opt.h"
+#include "lwip/err.h"
+
+/* define to stream to this collector, e.g. "192.168.0.22" */
+/* #define UDP_STREAM_IP              "192.168.0.22" */
+
+#ifndef UDP_STREAM_PORT
+#define UDP_STREAM_PORT               5141
+#endif
+
+/* ring buffer holding the records until their datagram has left the Ethernet DMA, bytes */
+#ifndef UDP_STREAM_RING_SIZE
+#define UDP_STREAM_RING_SIZE          (32 * 1024)
+#endif
+
+/* datagrams built and not yet released (queued, in lwIP or in the Tx ring) */
+#ifndef UDP_STREAM_QUEUE_LEN
+#define UDP_STREAM_QUEUE_LEN          32
+#endif
+
+/* UDP payload of a datagram, header included: one Ethernet frame without IP fragmentation */
+#ifndef UDP_STREAM_DGRAM_SIZE
+#define UDP_STREAM_DGRAM_SIZE         (1500 - 20 - 8)
+#endif
+
+/* a record waits at most this long for its datagram to fill, ms */
+#ifndef UDP_STREAM_FLUSH_MS
+#define UDP_STREAM_FLUSH_MS           10
+#endif
+
+/* largest record accepted by udp_stream_write(), it is copied in a critical section */
+#ifndef UDP_STREAM_RECORD_MAX
+#define UDP_STREAM_RECORD_MAX         256
+#endif
+
+/* timestamp of the first record of a datagram, ms by default */
+#ifndef UDP_STREAM_TIMESTAMP
+#define UDP_STREAM_TIMESTAMP()        sys_now()
+#endif
+
+/* 1: udp_stream_bench_start() runs a producer task, record size / duration below */
+#ifndef UDP_STREAM_BENCH
+#define UDP_STREAM_BENCH              0
+#endif
+#define UDP_STREAM_BENCH_SIZE         24
+#define UDP_STREAM_BENCH_MS           10000
+
+/* first word of every datagram ("USTR" read as little endian) and layout version */
+#define UDP_STREAM_MAGIC              0x52545355UL
+#define UDP_STREAM_VERSION            1
+
+/*
+ * Datagram: this header, then `records` records, each a u16_t length and its bytes.
+ * Little endian. A gap in seq is a lost datagram, a gap in first_record a lost
+ * record (refused by udp_stream_write(), see dropped below).
+ */
+struct udp_stream_hdr
+{
+  u32_t magic;
+  u16_t version;
+  u16_t records;
+  u32_t seq;                      /* datagram sequence number */
+  u32_t first_record;             /* sequence number of the first record */
+  u32_t timestamp;                /* UDP_STREAM_TIMESTAMP() of the first record */
+};
+
+struct udp_stream_stats
+{
+  u32_t records;                  /* accepted by udp_stream_write() */
+  u32_t dropped;                  /* refused: ring or queue full */
+  u32_t datagrams;                /* handed to udp_sendto() */
+  u32_t send_err;                 /* udp_sendto() failures, their records are lost */
+  u32_t flush_size;               /* datagrams sent full */
+  u32_t flush_deadline;           /* datagrams sent by the UDP_STREAM_FLUSH_MS deadline */
+  u32_t ring_used;                /* bytes, now and high-water */
+  u32_t ring_peak;
+  u32_t queue_used;               /* datagrams, now and high-water */
+  u32_t queue_peak;
+  u32_t send_time;                /* sending one datagram in the tcpip thread, cycles (ns on the host) */
+};
+
+err_t udp_stream_start( void );
+err_t udp_stream_write( const void *data, u16_t len );
+u32_t udp_stream_pressure( void );
+void udp_stream_get_stats( struct udp_stream_stats *st );
+void udp_stream_bench_start( void );
+
+#endif